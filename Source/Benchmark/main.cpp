@@ -0,0 +1,54 @@
+#define PY_SSIZE_T_CLEAN
+
+#include "CmdParser.h"
+#include "Config.h"
+#include "Core.h"
+#include "Asset/AssetManager.h"
+#include "Asset/DerivedDataCache.h"
+#include "Asset/TextureResidencyManager.h"
+#include "AsyncWorker/WorkDispatcher.h"
+#include "Core/ThreadManager.h"
+#include "Editor/CookBenchmark.h"
+#include "Editor/TextureBenchmark.h"
+#include "FileSystem/FileIOBenchmark.h"
+#include "FileSystem/FileIOManager.h"
+
+// Runs engine benchmarks without renderer or scripting, only modules they need are brought up.
+// Pick benchmarks with -fileio, -cook and -texture, all of them run if none is given.
+int main(int argc, char** argv)
+{
+    using namespace Koala;
+    ThreadTLS::Initialize(EThreadType::MainThread);
+    CmdParser::Initialize(argc, argv);
+    if (CmdParser::Get().HasArg("debug"))
+        spdlog::set_level(spdlog::level::debug);
+
+    Config::Get().Initialize_MainThread();
+    AsyncWorker::WorkDispatcher::Get().Initialize_MainThread();
+    AsyncWorker::WorkDispatcher::Get().CreateThread();
+    FileIO::FileIOManager::Get().Initialize_MainThread();
+    AssetManager::Get().Initialize_MainThread();
+    DerivedDataCache::Get().Initialize_MainThread();
+    // Loaded textures register with it.
+    TextureResidencyManager::Get().Initialize_MainThread();
+
+    const bool bRunFileIO = CmdParser::Get().HasArg("fileio");
+    const bool bRunCook = CmdParser::Get().HasArg("cook");
+    const bool bRunTexture = CmdParser::Get().HasArg("texture");
+    const bool bRunAll = !bRunFileIO && !bRunCook && !bRunTexture;
+    if (bRunAll || bRunFileIO)
+        FileIO::RunFileIOBenchmarks();
+    if (bRunAll || bRunCook)
+        RunCookBenchmarks();
+    if (bRunAll || bRunTexture)
+        RunTextureBenchmarks();
+
+    // Reverse order of initialization.
+    TextureResidencyManager::Get().Shutdown_MainThread();
+    DerivedDataCache::Get().Shutdown_MainThread();
+    AssetManager::Get().Shutdown_MainThread();
+    FileIO::FileIOManager::Get().Shutdown_MainThread();
+    AsyncWorker::WorkDispatcher::Get().Shutdown_MainThread();
+    Config::Get().Shutdown_MainThread();
+    return 0;
+}
@@ -44,7 +44,16 @@ namespace Koala
         {
             return SaveAssetUnbaked(file);
         }
-        virtual HashedString GetAssetFilePath() = 0;
+        // Version of Bake() output, to be bumped on any change of baked data for same input.
+        // Part of DerivedDataCache keys, so stale cached bakes are never used.
+        NODISCARD virtual uint32_t GetBakeVersion() const { return 0; }
+        // Hash of settings Bake() output depends on, part of DerivedDataCache keys.
+        NODISCARD virtual uint64_t GetBakeSettingsHash() const { return 0; }
+
+        virtual HashedString GetAssetFilePath() { return assetFilePath; }
+        void SetAssetFilePath(HashedString inPath) { assetFilePath = inPath; }
+        // Bytes of memory held by loaded asset, counted against AssetManager memory budget.
+        NODISCARD virtual size_t GetMemorySize() const { return 0; }
 
         FORCEINLINE bool IsBakedData() const
         {
@@ -52,5 +61,6 @@ namespace Koala
         }
     protected:
         bool bBaked{false};
+        HashedString assetFilePath;
     };
 }
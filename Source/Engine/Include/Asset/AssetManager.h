@@ -0,0 +1,161 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <typeindex>
+#include <unordered_map>
+
+#include "Asset.h"
+#include "Core/KoalaLogger.h"
+#include "Core/ModuleInterface.h"
+
+namespace Koala
+{
+    enum class EAssetLoadState: uint8_t
+    {
+        Loading,
+        Loaded,
+        Failed,
+    };
+
+    // One asset known to AssetManager. Shared by all handles of the asset, kept by manager until evicted.
+    struct AssetEntry
+    {
+        HashedString                  path;
+        std::type_index               type{typeid(void)};
+        std::shared_ptr<IAsset>       asset;
+        std::atomic<EAssetLoadState>  state{EAssetLoadState::Loading};
+        // Ready with load result once loading is finished.
+        std::promise<bool>            loadPromise;
+        std::shared_future<bool>      loadFuture;
+        // Memory of loaded asset, refreshed every tick as it may change after loading (e.g. streamed texture mips).
+        size_t                        memorySize{0};
+        // Tick number of last request, least recently requested assets are evicted first.
+        uint64_t                      lastRequestTick{0};
+    };
+
+    // Reference to an asset, assets referenced by any handle are never evicted.
+    template <typename T>
+    class TAssetHandle
+    {
+    public:
+        TAssetHandle() = default;
+        explicit TAssetHandle(std::shared_ptr<AssetEntry> inEntry): entry(std::move(inEntry)) {}
+
+        NODISCARD FORCEINLINE bool IsValid() const { return entry != nullptr; }
+        NODISCARD FORCEINLINE EAssetLoadState GetState() const { return entry ? entry->state.load() : EAssetLoadState::Failed; }
+        NODISCARD FORCEINLINE bool IsLoaded() const { return GetState() == EAssetLoadState::Loaded; }
+        NODISCARD FORCEINLINE HashedString GetPath() const { return entry ? entry->path : HashedString(); }
+
+        // Asset once loaded, nullptr before.
+        NODISCARD FORCEINLINE T* Get() const { return IsLoaded() ? static_cast<T*>(entry->asset.get()) : nullptr; }
+        FORCEINLINE T* operator->() const { return Get(); }
+        // Shared ownership of loaded asset. It does not keep the entry from being evicted, systems following
+        // the asset (e.g. TextureResidencyManager) hold it weakly.
+        NODISCARD std::shared_ptr<T> GetShared() const
+        {
+            return IsLoaded() ? std::static_pointer_cast<T>(entry->asset) : nullptr;
+        }
+
+        // Ready with true once asset is loaded, false if it failed.
+        NODISCARD std::shared_future<bool> GetFuture() const
+        {
+            if (entry)
+                return entry->loadFuture;
+            std::promise<bool> failed;
+            failed.set_value(false);
+            return failed.get_future().share();
+        }
+        // Block until loaded, see FileIOManager::WaitForResult(). Return false if loading failed.
+        bool Wait() const;
+
+        void Reset() { entry.reset(); }
+    private:
+        std::shared_ptr<AssetEntry> entry;
+    };
+
+    // Assets by path. Requests for an asset already known share its entry, so each asset is loaded once however many
+    // times it is requested, also while loading. Files are opened on I/O threads and parsed on AsyncWorker.
+    // Loaded assets no handle refers to stay cached, least recently requested are evicted when memory of loaded assets
+    // exceeds budget (config asset.memorybudgetmb). Loaded textures are registered to TextureResidencyManager.
+    class AssetManager: public IModule
+    {
+    public:
+        KOALA_IMPLEMENT_SINGLETON(AssetManager)
+        bool Initialize_MainThread() override;
+        bool Shutdown_MainThread() override;
+        // Evict over budget.
+        void Tick_MainThread(float deltaTime) override;
+
+        // Request asset, loading it if not loaded or loading yet. Can be called from any thread.
+        // Return invalid handle if path is already known as asset of another type.
+        template <typename T>
+        TAssetHandle<T> LoadAsync(HashedString path)
+        {
+            static_assert(std::is_base_of_v<IAsset, T>, "T must be an asset.");
+            bool bNewEntry = false;
+            std::shared_ptr<AssetEntry> entry = FindOrAddEntry(path, typeid(T), [] { return std::make_shared<T>(); }, bNewEntry);
+            if (bNewEntry)
+                StartLoad(entry);
+            return TAssetHandle<T>(std::move(entry));
+        }
+
+        // LoadAsync() and wait.
+        template <typename T>
+        TAssetHandle<T> Load(HashedString path)
+        {
+            TAssetHandle<T> handle = LoadAsync<T>(path);
+            handle.Wait();
+            return handle;
+        }
+
+        // Evict unreferenced assets, least recently requested first, until loaded assets fit in targetBytes.
+        // Return number of bytes freed.
+        size_t Evict(size_t targetBytes);
+        void SetMemoryBudget(size_t bytes) { memoryBudget = bytes; }
+        NODISCARD size_t GetMemoryBudget() const { return memoryBudget; }
+        NODISCARD size_t GetLoadedMemory() const { return loadedMemory.load(); }
+        NODISCARD uint32_t GetNumLoading() const { return numLoading.load(); }
+        NODISCARD size_t GetNumAssets() const;
+    private:
+        std::shared_ptr<AssetEntry> FindOrAddEntry(HashedString path, std::type_index type,
+            const std::function<std::shared_ptr<IAsset>()> &createAsset, bool &bOutNewEntry);
+        void StartLoad(const std::shared_ptr<AssetEntry> &entry);
+        void ParseAsset(const std::shared_ptr<AssetEntry> &entry, FileIO::FileHandle handle);
+        void FinishLoad(const std::shared_ptr<AssetEntry> &entry, bool bOk);
+
+        mutable std::mutex                                             mutex;
+        std::unordered_map<HashedString, std::shared_ptr<AssetEntry>>  entries;
+        std::atomic<size_t>                                            loadedMemory{0};
+        size_t                                                         memoryBudget{512ull << 20};
+        std::atomic<uint64_t>                                          tickNumber{0};
+        std::atomic<uint32_t>                                          numLoading{0};
+    };
+
+    template <typename T>
+    bool TAssetHandle<T>::Wait() const
+    {
+        if (!entry)
+            return false;
+        return FileIO::FileIOManager::Get().WaitForResult(entry->loadFuture);
+    }
+}
@@ -0,0 +1,121 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Asset.h"
+#include "Core/ModuleInterface.h"
+
+namespace Koala
+{
+    struct DerivedDataCacheStats
+    {
+        uint64_t numHits{0};
+        uint64_t numMisses{0};
+        uint64_t numEvicted{0};
+        uint64_t numEntries{0};
+        uint64_t size{0};
+    };
+
+    // Local cache of baked data, one file per entry under cache directory, named after its key.
+    // Key is a hash of everything the data is derived from: source bytes, bake settings and bake code version,
+    // see MakeKey(). A changed input gets a new key, entries are never updated in place.
+    // Size is bounded, least recently used entries are evicted first. Use is recorded in file modification time,
+    // so the order survives restarts.
+    // Thread safe. Entries are written to temporary files and renamed into place, so other threads, and other
+    // processes sharing the directory, never see partial entries. Size budget covers entries this process knows of.
+    // Open() and Close() must not be called while cache is in use.
+    class DerivedDataCache: public IModule
+    {
+    public:
+        KOALA_IMPLEMENT_SINGLETON(DerivedDataCache)
+        // Open directory with size budget from config (ddc.path, ddc.maxsizemb). Empty path disables cache.
+        bool Initialize_MainThread() override;
+        bool Shutdown_MainThread() override;
+        void Tick_MainThread(float) override {}
+
+        // Use directory as cache, indexing entries already in it, and evict down to maxSize bytes.
+        bool Open(const std::filesystem::path &inDirectory, uint64_t inMaxSize);
+        void Close();
+        NODISCARD bool IsOpen() const;
+
+        // Key of asset baked from source with given hash, covers asset type, bake version and settings.
+        NODISCARD static uint64_t MakeKey(const IAsset &asset, uint64_t sourceHash);
+
+        // Copy data cached under key to destination. Return false on miss.
+        bool Fetch(uint64_t key, const std::filesystem::path &destination);
+        // Read data cached under key. Return false on miss.
+        bool Get(uint64_t key, std::vector<uint8_t> &outData);
+        // Store data under key.
+        bool Put(uint64_t key, const void *data, size_t size);
+
+        // Fetch key into destination, or on miss, let build write data and store it. Build returns false on failure,
+        // nothing is stored then. bOutHit tells whether build was skipped. Return false if there is no data.
+        bool FetchOrBuild(uint64_t key, const std::filesystem::path &destination,
+            const std::function<bool(FileIO::WriteFileStream&)> &build, bool *bOutHit = nullptr);
+
+        // Evict least recently used entries until size is at most targetSize bytes.
+        void Trim(uint64_t targetSize);
+        void SetMaxSize(uint64_t inMaxSize);
+        NODISCARD DerivedDataCacheStats GetStats() const;
+        NODISCARD std::filesystem::path GetDirectory() const;
+
+    private:
+        struct Entry
+        {
+            uint64_t key;
+            uint64_t size;
+        };
+
+        NODISCARD std::filesystem::path GetEntryPath(uint64_t key) const;
+        NODISCARD std::filesystem::path MakeTemporaryPath(uint64_t key);
+        // Find entry and mark it most recently used. Entries added by other processes are picked up from disk.
+        bool Touch(uint64_t key, std::filesystem::path &outPath);
+        // Entry file turned out missing or unreadable, forget it.
+        void Forget(uint64_t key);
+        // Move written temporary file into place as entry of key.
+        bool Commit(uint64_t key, const std::filesystem::path &temporaryPath);
+        void AddEntry_Locked(uint64_t key, uint64_t entrySize);
+        // Unlink victims from index, caller deletes their files with DeleteEntryFiles() after unlocking.
+        std::vector<uint64_t> Trim_Locked(uint64_t targetSize);
+        // Delete files of evicted keys, except keys indexed again meanwhile. Takes the lock per key.
+        void DeleteEntryFiles(const std::vector<uint64_t> &keys) const;
+
+        mutable std::mutex    mutex;
+        std::filesystem::path directory;
+        uint64_t              maxSize{0};
+        uint64_t              size{0};
+        // Most recently used first.
+        std::list<Entry>      lruList;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> entries;
+
+        std::atomic<uint64_t> numHits{0};
+        std::atomic<uint64_t> numMisses{0};
+        std::atomic<uint64_t> numEvicted{0};
+        // Temporary file names are unique per process instance and write.
+        uint64_t              instanceId{0};
+        std::atomic<uint64_t> temporaryCounter{0};
+    };
+}
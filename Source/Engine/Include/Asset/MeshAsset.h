@@ -17,29 +17,156 @@
 //CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #pragma once
 #include "Asset.h"
-#include "Math/MathDefinations.h"
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include "VertexFormat.h"
 
 namespace Koala
 {
-    struct Vector
+    struct MeshBakeSettings
     {
-        Vec3f position{};
-        Vec3f normal{};
-        Vec2f uv{};
+        // Remove duplicate vertices, reorder triangles for vertex cache and overdraw, reorder vertices for fetch.
+        bool          bOptimize{true};
+        // Overdraw ordering may make vertex cache efficiency (ACMR) this much worse.
+        float         overdrawThreshold{1.05f};
+        // Float keeps vertices in format set by PackVertices().
+        EVertexFormat vertexFormat{EVertexFormat::Float};
+        // Store indices as 16 bits when vertices fit.
+        bool          bAllow16BitIndices{true};
+
+        // LOD chain, LOD0 included. Each LOD aims at lodReduction of triangles of previous one.
+        uint32_t      maxLODs{4};
+        float         lodReduction{0.5f};
+        // Chain stops at this simplification error, relative to radius of mesh bounds.
+        float         lodMaxError{0.05f};
+        // LOD is used once its error projects to less than lodPixelError pixels on a view lodReferenceHeight pixels high.
+        float         lodPixelError{1.0f};
+        float         lodReferenceHeight{1080.0f};
+
+        // Split every LOD into meshlets for cluster culling.
+        bool          bBuildMeshlets{true};
+        uint32_t      meshletMaxVertices{MeshletMaxVertices};
+        uint32_t      meshletMaxTriangles{MeshletMaxTriangles};
     };
+
+    // Range of index buffer drawing one LOD, all LODs share vertices.
+    struct MeshLOD
+    {
+        uint32_t firstIndex{0};
+        uint32_t numIndices{0};
+        // Used while mesh bounds cover at most this fraction of view height, see Renderer::SelectMeshLOD().
+        float    screenSize{0};
+        // Simplification error relative to radius of mesh bounds.
+        float    error{0};
+    };
+
+    struct MeshOptimizationStats
+    {
+        size_t numVerticesBefore{0};
+        size_t numVerticesAfter{0};
+        // Average cache misses per triangle, see ComputeACMR().
+        float  acmrBefore{0};
+        float  acmrAfter{0};
+    };
+
     class MeshAsset : public IAsset
     {
     public:
         bool LoadAsset(FileIO::ReadFileStream &file) override;
         bool SaveAssetUnbaked(FileIO::WriteFileStream &file) override;
+        // Run PrepareBake() unless already done, then write in baked layout.
+        bool Bake(FileIO::WriteFileStream &file) override;
+
+        // Replace mesh with unbaked triangle list, e.g. read from source file. Packed data, LODs and meshlets are dropped.
+        void SetMeshData(std::vector<Vector> inVertices, std::vector<uint32_t> inIndices);
+
+        void SetBakeSettings(const MeshBakeSettings &inSettings) { bakeSettings = inSettings; }
+        NODISCARD const MeshBakeSettings& GetBakeSettings() const { return bakeSettings; }
+        // Optimize and pack according to bake settings, in memory. Meshes are independent, can run on any thread,
+        // AssetImporter bakes many of them in parallel on worker threads.
+        MeshOptimizationStats PrepareBake();
+
+        // Deduplicate vertices, drop degenerate triangles, optimize triangle order for vertex cache and overdraw,
+        // and vertex order for fetch.
+        // Existing LODs are dropped, LOD0 is optimized.
+        MeshOptimizationStats Optimize(float overdrawThreshold = 1.05f);
+        // Build LOD chain from LOD0 according to bake settings. LODs are appended to index buffer.
+        void GenerateLODs();
+        // Split every LOD into meshlets according to bake settings. Optimize() and GenerateLODs() drop meshlets.
+        void BuildMeshlets();
+
+        // Encode vertices into packed format, positions quantized against their bounds.
+        // Both representations are kept until ReleaseUnpackedVertices().
+        void PackVertices(EVertexFormat format);
+        // Decode packed vertices (e.g. of a mesh loaded from packed baked file) back to full precision.
+        // Return false if there is nothing packed.
+        bool UnpackVertices();
+        void ReleaseUnpackedVertices();
 
-        inline HashedString GetAssetFilePath() override
+        // Format, stride and data of vertices as they are going to be uploaded: packed if available, full precision otherwise.
+        NODISCARD FORCEINLINE EVertexFormat GetVertexFormat() const { return packedVertexFormat; }
+        NODISCARD FORCEINLINE size_t GetVertexStride() const { return Koala::GetVertexStride(packedVertexFormat); }
+        NODISCARD FORCEINLINE const void* GetVertexData() const
         {
-            return 0;
+            return packedVertexFormat == EVertexFormat::Float ? static_cast<const void*>(vertices.data()) : packedVertices.data();
         }
+        NODISCARD FORCEINLINE size_t GetNumVertices() const
+        {
+            return packedVertexFormat == EVertexFormat::Float ? vertices.size() : packedVertices.size() / GetVertexStride();
+        }
+        NODISCARD FORCEINLINE const VertexQuantizationBounds& GetQuantizationBounds() const { return quantizationBounds; }
+
+        // Widen 16-bit indices of a mesh loaded from baked file. Return false if there are none.
+        bool UnpackIndices();
+        // Stride and data of indices as they are going to be uploaded: 16-bit if loaded so, 32-bit otherwise.
+        NODISCARD FORCEINLINE size_t GetIndexStride() const { return indices16.empty() ? sizeof(uint32_t) : sizeof(uint16_t); }
+        NODISCARD FORCEINLINE const void* GetIndexData() const
+        {
+            return indices16.empty() ? static_cast<const void*>(indices.data()) : indices16.data();
+        }
+        NODISCARD FORCEINLINE size_t GetNumIndices() const { return indices16.empty() ? indices.size() : indices16.size(); }
+
+        // A mesh without LOD chain has one LOD covering all indices.
+        NODISCARD FORCEINLINE uint32_t GetNumLODs() const { return lods.empty() ? 1 : static_cast<uint32_t>(lods.size()); }
+        NODISCARD MeshLOD GetLOD(uint32_t lodIndex) const;
+        NODISCARD FORCEINLINE const BoundingSphere& GetBounds() const { return bounds; }
+
+        NODISCARD FORCEINLINE bool HasMeshlets() const { return !meshlets.empty(); }
+        NODISCARD FORCEINLINE const std::vector<Meshlet>& GetMeshlets() const { return meshlets; }
+        NODISCARD FORCEINLINE const std::vector<uint32_t>& GetMeshletVertices() const { return meshletVertices; }
+        NODISCARD FORCEINLINE const std::vector<uint8_t>& GetMeshletTriangles() const { return meshletTriangles; }
+        // Meshlets of a LOD as first and count in GetMeshlets(), empty without meshlets.
+        NODISCARD std::pair<uint32_t, uint32_t> GetLODMeshletRange(uint32_t lodIndex) const;
+
+        NODISCARD size_t GetMemorySize() const override;
+        NODISCARD uint32_t GetBakeVersion() const override;
+        NODISCARD uint64_t GetBakeSettingsHash() const override;
 
     protected:
+        bool WriteMeshData(FileIO::WriteFileStream &file, EVertexFormat format, size_t indexStride);
+        void ClearMeshlets();
+        NODISCARD bool ValidateMeshlets(uint64_t numVertices) const;
+
         std::vector<Vector>   vertices;
         std::vector<uint32_t> indices;
+
+        // Vertices in packedVertexFormat, unless it is Float. After loading a packed mesh only these are filled.
+        EVertexFormat            packedVertexFormat{EVertexFormat::Float};
+        std::vector<uint8_t>     packedVertices;
+        VertexQuantizationBounds quantizationBounds{};
+        // Indices of a mesh loaded with 16-bit indices, indices is empty then.
+        std::vector<uint16_t>    indices16;
+
+        std::vector<MeshLOD>     lods;
+        BoundingSphere           bounds;
+
+        // Meshlets of all LODs, LOD l owns [lodMeshletOffsets[l], lodMeshletOffsets[l + 1]).
+        std::vector<Meshlet>     meshlets;
+        std::vector<uint32_t>    meshletVertices;
+        std::vector<uint8_t>     meshletTriangles;
+        std::vector<uint32_t>    lodMeshletOffsets;
+
+        MeshBakeSettings         bakeSettings;
+        bool                     bBakePrepared{false};
     };
 }
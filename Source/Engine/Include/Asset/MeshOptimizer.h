@@ -0,0 +1,54 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <vector>
+
+#include "VertexFormat.h"
+
+namespace Koala
+{
+    // Post-transform vertex cache size the optimizations and statistics assume.
+    constexpr uint32_t MeshOptimizerCacheSize = 32;
+
+    // Merge vertices with identical attributes (bitwise), remapping indices. Return number of vertices left.
+    size_t DeduplicateVertices(std::vector<Vector> &vertices, std::vector<uint32_t> &indices);
+
+    // Reorder triangles for post-transform vertex cache reuse (Forsyth, Linear-Speed Vertex Cache Optimisation).
+    void OptimizeVertexCache(std::vector<uint32_t> &indices, size_t numVertices);
+
+    // Reorder clusters of triangles so that outer surfaces are drawn first and occlude inner ones
+    // (Sander et al., Fast Triangle Reordering for Vertex Locality and Reduced Overdraw).
+    // Clusters are cut so that ACMR gets at most threshold times worse. Run after OptimizeVertexCache().
+    void OptimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<Vector> &vertices, float threshold = 1.05f);
+
+    // Reorder vertices in order of first use, so that fetches walk memory forward. Unused vertices are dropped.
+    void OptimizeVertexFetch(std::vector<Vector> &vertices, std::vector<uint32_t> &indices);
+
+    struct BoundingSphere
+    {
+        Vec3f center{0, 0, 0};
+        float radius{0};
+    };
+
+    // Sphere around bounding box center, covering all positions. Not minimal, within sqrt(3) of it.
+    NODISCARD BoundingSphere ComputeBoundingSphere(const std::vector<Vector> &vertices);
+
+    // Average cache misses per triangle with FIFO cache of given size: 3 is worst, about 0.6 is good for closed meshes.
+    NODISCARD float ComputeACMR(const std::vector<uint32_t> &indices, size_t numVertices, uint32_t cacheSize = MeshOptimizerCacheSize);
+}
@@ -0,0 +1,34 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <vector>
+
+#include "VertexFormat.h"
+
+namespace Koala
+{
+    // Simplify triangle list by collapsing edges in order of quadric error (Garland and Heckbert, Surface Simplification
+    // Using Quadric Error Metrics), until at most targetIndexCount indices are left or the next collapse would exceed targetError.
+    // A vertex collapses onto a neighbour, no vertex is moved or created, so the result indexes the same vertices.
+    // Vertices sharing position with another vertex (attribute seams) or on open borders stay,
+    // so that UV and normal discontinuities do not crack and open edges do not shrink.
+    // Errors are distances relative to radius of mesh bounds, outError receives the largest error of collapses done.
+    NODISCARD std::vector<uint32_t> SimplifyMesh(const std::vector<Vector> &vertices, const std::vector<uint32_t> &indices,
+        size_t targetIndexCount, float targetError, float *outError = nullptr);
+}
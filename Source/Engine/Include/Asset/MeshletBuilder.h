@@ -0,0 +1,65 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <vector>
+
+#include "VertexFormat.h"
+
+namespace Koala
+{
+    // Limits fitting mesh shader workgroups, 124 triangles leave room for 4 byte primitive count in 128 * 3 byte index space.
+    constexpr uint32_t MeshletMaxVertices = 64;
+    constexpr uint32_t MeshletMaxTriangles = 124;
+
+    // Small cluster of triangles with bounds for culling. Triangles index meshlet vertices (3 bytes each),
+    // meshlet vertices index mesh vertices.
+    struct Meshlet
+    {
+        uint32_t firstVertex{0};
+        uint32_t firstTriangle{0};
+        uint32_t numVertices{0};
+        uint32_t numTriangles{0};
+        float    center[3]{};
+        float    radius{0};
+        // Meshlet faces away from any view position p with dot(normalize(coneApex - p), coneAxis) >= coneCutoff.
+        // Cutoff is 1 when normals spread too much for the test to ever pass.
+        float    coneApex[3]{};
+        float    coneCutoff{1};
+        float    coneAxis[3]{};
+        uint32_t reserved{0};
+    };
+    static_assert(sizeof(Meshlet) == 64);
+
+    // Split triangle list into meshlets, appending to outputs. Triangles are grown from adjacent ones that add fewest
+    // new vertices, closest to meshlet centre. Result depends on input only, so it is the same on every run and machine.
+    void BuildMeshlets(const std::vector<Vector> &vertices, const uint32_t *indices, size_t numIndices,
+        std::vector<Meshlet> &meshlets, std::vector<uint32_t> &meshletVertices, std::vector<uint8_t> &meshletTriangles,
+        uint32_t maxVertices = MeshletMaxVertices, uint32_t maxTriangles = MeshletMaxTriangles);
+
+    // Fill bounding sphere and normal cone of a meshlet from its triangles.
+    void ComputeMeshletBounds(Meshlet &meshlet, const std::vector<Vector> &vertices,
+        const uint32_t *meshletVertices, const uint8_t *meshletTriangles);
+
+    NODISCARD FORCEINLINE bool IsMeshletBackFacing(const Meshlet &meshlet, const Vec3f &viewPosition)
+    {
+        const Vec3f toApex = Vec3f(meshlet.coneApex[0], meshlet.coneApex[1], meshlet.coneApex[2]) - viewPosition;
+        const Vec3f axis(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]);
+        return toApex.dot(axis) >= meshlet.coneCutoff * toApex.norm();
+    }
+}
@@ -0,0 +1,57 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Definations.h"
+#include "Renderer/PixelFormat.h"
+
+namespace Koala
+{
+    enum class EMipFilter: uint32_t
+    {
+        // Average of 2x2 pixels, cheapest, blurs least but aliases fine detail.
+        Box     = 0,
+        // Sinc windowed by Kaiser window over 3 pixels of the smaller mip, sharp with little ringing.
+        Kaiser  = 1,
+        // Lanczos 3, sharpest, rings most around hard edges.
+        Lanczos = 2,
+    };
+
+    struct MipGenerationSettings
+    {
+        EMipFilter filter{EMipFilter::Kaiser};
+        // Color channels of 8-bit formats hold sRGB encoded values, they are filtered in linear space. Alpha of
+        // 4 channel formats is always linear. Ignored for 16 and 32-bit formats.
+        bool       bSRGB{false};
+        // Most mips to generate including mip 0, 0 for full chain down to 1x1.
+        uint32_t   maxMips{0};
+    };
+
+    // Generate mip chain of width x height image of uncompressed format, rows tightly packed. Mip 0 is a copy of
+    // image, each next mip is max(1, half) of previous size along each axis, filtered from the previous one in float
+    // without requantizing in between. 8 and 16-bit formats are taken as unsigned normalized, 32-bit as float.
+    // Rows are split across worker threads unless called from one. Empty for block compressed formats.
+    NODISCARD std::vector<std::vector<uint8_t>> GenerateMips(EPixelFormat format, const uint8_t *data, uint32_t width,
+        uint32_t height, const MipGenerationSettings &settings = {});
+
+    // Number of mips of full chain of width x height image.
+    NODISCARD uint32_t GetNumMipsInChain(uint32_t width, uint32_t height);
+}
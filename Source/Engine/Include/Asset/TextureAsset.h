@@ -0,0 +1,133 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "Asset.h"
+#include "MipGenerator.h"
+#include "TextureCompression.h"
+#include "Renderer/PixelFormat.h"
+
+namespace Koala
+{
+    constexpr uint32_t TextureMaxMips = 16;
+    // Smallest mips are packed into mip tail until it would grow over this size.
+    constexpr uint64_t TextureMipTailMaxSize = 64 * 1024;
+
+    // Where a mip is stored in baked texture file.
+    struct TextureMipRange
+    {
+        uint64_t offset{0};
+        uint64_t size{0};
+    };
+
+    struct TextureBakeSettings
+    {
+        // Block compressed format RGBA8 textures are baked in, PF_R8G8B8A8 keeps them as they are.
+        EPixelFormat               compressedFormat{PF_R8G8B8A8};
+        ETextureCompressionQuality compressionQuality{ETextureCompressionQuality::Normal};
+        // Replace mips after mip 0 with generated ones before compressing, see GenerateMips().
+        bool                       bGenerateMips{false};
+        MipGenerationSettings      mipSettings;
+    };
+
+    // 2D texture with mip chain. Baked file stores mips back to front: header, then mip tail (smallest mips, packed),
+    // then larger mips, each aligned for direct reads, mip 0 last. Loading reads header and mip tail only, in one
+    // contiguous read, larger mips are streamed in and out by TextureResidencyManager.
+    class TextureAsset : public IAsset
+    {
+    public:
+        bool LoadAsset(FileIO::ReadFileStream &file) override;
+        // Texture is always saved in baked layout, all mips must be resident.
+        bool SaveAssetUnbaked(FileIO::WriteFileStream &file) override;
+        // Generate mips and compress according to bake settings, then save.
+        bool Bake(FileIO::WriteFileStream &file) override;
+
+        // Replace texture with mip chain, mip 0 is most detailed, each next one half of previous size (at least 1).
+        // Return false if sizes of mips do not match format and dimensions.
+        bool SetMips(EPixelFormat format, uint32_t width, uint32_t height, std::vector<std::vector<uint8_t>> inMips);
+        // Replace mips after mip 0 with chain generated from it, at most TextureMaxMips. Texture must be uncompressed
+        // with all mips resident.
+        bool GenerateMips(const MipGenerationSettings &settings);
+        // Block compress all mips of RGBA8 texture into format, see CompressImage(). All mips must be resident.
+        bool Compress(EPixelFormat format, ETextureCompressionQuality quality);
+
+        void SetBakeSettings(const TextureBakeSettings &inSettings) { bakeSettings = inSettings; }
+        NODISCARD const TextureBakeSettings& GetBakeSettings() const { return bakeSettings; }
+
+        NODISCARD FORCEINLINE EPixelFormat GetPixelFormat() const { return pixelFormat; }
+        NODISCARD FORCEINLINE uint32_t GetWidth() const { return width; }
+        NODISCARD FORCEINLINE uint32_t GetHeight() const { return height; }
+        NODISCARD FORCEINLINE uint32_t GetNumMips() const { return numMips; }
+        NODISCARD FORCEINLINE uint32_t GetMipWidth(uint32_t mip) const { return std::max(width >> mip, 1u); }
+        NODISCARD FORCEINLINE uint32_t GetMipHeight(uint32_t mip) const { return std::max(height >> mip, 1u); }
+        NODISCARD FORCEINLINE uint64_t GetMipSize(uint32_t mip) const { return ComputeImageSize(pixelFormat, GetMipWidth(mip), GetMipHeight(mip)); }
+        // Mips from this one to the last form mip tail, which is always resident.
+        NODISCARD FORCEINLINE uint32_t GetFirstTailMip() const { return firstTailMip; }
+        NODISCARD FORCEINLINE const TextureMipRange& GetMipRange(uint32_t mip) const { return mipRanges[mip]; }
+
+        // Most detailed mip in memory, mips after it are all in memory too.
+        NODISCARD uint32_t GetFirstResidentMip() const;
+        // Data of resident mip, empty if not resident. Stays valid until next TextureResidencyManager tick.
+        NODISCARD std::span<const uint8_t> GetMipData(uint32_t mip) const;
+        // Bytes of resident mips.
+        NODISCARD uint64_t GetResidentSize() const;
+        NODISCARD size_t GetMemorySize() const override;
+        NODISCARD uint32_t GetBakeVersion() const override;
+        NODISCARD uint64_t GetBakeSettingsHash() const override;
+
+        // Texture is going to be drawn covering this many pixels along its larger side. Can be called from any thread,
+        // largest request since last TextureResidencyManager tick decides which mips are wanted.
+        void RequestScreenSize(float screenSize);
+
+    protected:
+        friend class TextureResidencyManager;
+
+        void ComputeLayout();
+
+        EPixelFormat pixelFormat{PF_R8G8B8A8};
+        uint32_t     width{0};
+        uint32_t     height{0};
+        uint32_t     numMips{0};
+        uint32_t     firstTailMip{0};
+        std::vector<TextureMipRange> mipRanges;
+        // Where asset starts in file it was loaded from, mip ranges are relative to it.
+        uint64_t     fileOffset{0};
+
+        // Residency, changed by TextureResidencyManager.
+        mutable std::mutex                residencyMutex;
+        std::vector<std::vector<uint8_t>> mipData;
+        uint32_t                          firstResidentMip{0};
+        bool                              bStreamingIn{false};
+        // Reading mips from file failed, texture keeps what it has.
+        bool                              bStreamInFailed{false};
+
+        // Largest requested screen size since last tick, in pixels.
+        std::atomic<uint32_t>             requestedScreenSize{0};
+        // Kept by manager: last requested screen size and tick it was requested on.
+        uint32_t                          lastScreenSize{0};
+        uint64_t                          lastRequestTick{0};
+
+        TextureBakeSettings               bakeSettings;
+    };
+}
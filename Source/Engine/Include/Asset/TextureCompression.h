@@ -0,0 +1,59 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Definations.h"
+#include "Renderer/PixelFormat.h"
+
+namespace Koala
+{
+    enum class ETextureCompressionQuality: uint32_t
+    {
+        // Color endpoints at extremes of estimated principal axis, alpha endpoints at block range.
+        Fast   = 0,
+        // Color endpoints refined once by least squares, alpha also tried with exact 0 and 255.
+        Normal = 1,
+        // Up to four refinement passes, alpha endpoints searched inside block range.
+        High   = 2,
+    };
+
+    // Compress one 4x4 block of RGBA8 pixels (row by row, 64 bytes) into block of format.
+    // PF_DXT1 (BC1) is opaque, alpha is dropped. PF_DXT3 (BC2) stores 4-bit alpha, PF_DXT5 (BC3) interpolated alpha.
+    // PF_BC5 stores red and green only, e.g. of tangent space normals.
+    void EncodeBlock(EPixelFormat format, const uint8_t *rgba, uint8_t *outBlock, ETextureCompressionQuality quality);
+    // Decode one block into 4x4 RGBA8 pixels. BC5 decodes blue as 0 and alpha as 255. BC1 alpha is 255, apart from
+    // transparent pixels of 3 color blocks, which encoder never writes.
+    void DecodeBlock(EPixelFormat format, const uint8_t *block, uint8_t *outRgba);
+
+    // Compress RGBA8 image of width x height pixels, rows tightly packed, into ComputeImageSize(format, width, height)
+    // bytes. Blocks over the image edge repeat its last row and column. Block rows are split across worker threads
+    // unless called from one. Return false if format is not block compressed.
+    bool CompressImage(EPixelFormat format, const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *outData,
+        ETextureCompressionQuality quality = ETextureCompressionQuality::Normal);
+    NODISCARD std::vector<uint8_t> CompressImage(EPixelFormat format, const std::vector<uint8_t> &rgba, uint32_t width,
+        uint32_t height, ETextureCompressionQuality quality = ETextureCompressionQuality::Normal);
+    // Decode compressed image into width x height RGBA8 pixels. Return false if format is not block compressed.
+    bool DecompressImage(EPixelFormat format, const uint8_t *data, uint32_t width, uint32_t height, uint8_t *outRgba);
+
+    // Peak signal to noise ratio in dB between RGBA8 images over channels set in channelMask (bit 0 red .. bit 3 alpha).
+    // Infinity for identical images.
+    NODISCARD double ComputeImagePSNR(const uint8_t *rgba, const uint8_t *otherRgba, size_t numPixels, uint32_t channelMask = 0x7);
+}
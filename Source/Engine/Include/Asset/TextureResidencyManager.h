@@ -0,0 +1,107 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "TextureAsset.h"
+#include "Core/ModuleInterface.h"
+
+namespace Koala
+{
+    struct TextureResidencyStats
+    {
+        uint32_t numTextures{0};
+        uint32_t numStreamingIn{0};
+        // Textures getting fewer mips than their screen size wants, to stay within budget.
+        uint32_t numOverBudget{0};
+        uint64_t residentSize{0};
+        // Bytes of mips wanted after fitting to budget, resident size heads towards it.
+        uint64_t wantedSize{0};
+        uint64_t budget{0};
+        uint64_t numMipsStreamedIn{0};
+        uint64_t numMipsStreamedOut{0};
+    };
+
+    // Decides which mips of registered textures are kept in memory. Each tick, the mip a texture needs follows from
+    // the screen size it was requested with (TextureAsset::RequestScreenSize()), textures not requested for a while
+    // drop to their mip tail. When wanted mips exceed the memory budget (config texture.residency.budgetmb), mips
+    // with most texels per screen pixel are dropped first. Mips are streamed out at once, and streamed in by reading
+    // them from the texture's file, most visible textures first, with bounded bytes in flight.
+    // Residency is kept on CPU side only. RHI textures are not made from it yet, the RHI can not upload data into
+    // textures.
+    class TextureResidencyManager: public IModule
+    {
+    public:
+        KOALA_IMPLEMENT_SINGLETON(TextureResidencyManager)
+        bool Initialize_MainThread() override;
+        // Wait for streaming in flight and drop all textures.
+        bool Shutdown_MainThread() override;
+        // Update wanted mips, stream out and start streaming in.
+        void Tick_MainThread(float deltaTime) override;
+
+        // Follow texture. It is held weakly, textures are dropped once released. Can be called from any thread.
+        void Register(const std::shared_ptr<TextureAsset> &texture);
+        // Stop following texture, e.g. when its owner evicts it. Can be called from any thread.
+        void Unregister(const TextureAsset *texture);
+
+        void SetBudget(uint64_t bytes) { budget = bytes; }
+        NODISCARD uint64_t GetBudget() const { return budget; }
+        void SetMaxInFlightSize(uint64_t bytes) { maxInFlightSize = bytes; }
+        NODISCARD TextureResidencyStats GetStats() const;
+        // Wait for all streaming in flight, ticking FileIO. Main thread only.
+        void Flush();
+
+        // Most detailed mip worth keeping for texture covering screenSize pixels along its larger side, shifted
+        // by mipBias mips (positive for less detail). Never beyond mip tail.
+        NODISCARD static uint32_t ComputeWantedMip(const TextureAsset &texture, float screenSize, float mipBias = 0.0f);
+
+    private:
+        struct TextureState
+        {
+            std::shared_ptr<TextureAsset> texture;
+            uint32_t wantedMip{0};
+            uint32_t firstResidentMip{0};
+            uint32_t screenSize{0};
+        };
+
+        // Drop mips until wanted size fits in budget, return number of textures cut.
+        uint32_t FitToBudget(std::vector<TextureState> &states, uint64_t &inOutWantedSize) const;
+        void StreamOut(TextureState &state);
+        void StartStreamIn(TextureState &state);
+
+        mutable std::mutex                       mutex;
+        std::vector<std::weak_ptr<TextureAsset>> textures;
+        std::vector<std::shared_future<void>>    pendingStreamIns;
+
+        uint64_t                                 budget{1024ull << 20};
+        uint64_t                                 maxInFlightSize{64ull << 20};
+        // Textures not requested for this many ticks drop to their mip tail.
+        uint64_t                                 keepTicks{60};
+        uint64_t                                 tickNumber{0};
+        std::atomic<uint64_t>                    inFlightSize{0};
+
+        std::atomic<uint64_t>                    numMipsStreamedIn{0};
+        std::atomic<uint64_t>                    numMipsStreamedOut{0};
+        TextureResidencyStats                    lastStats;
+    };
+}
@@ -0,0 +1,92 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <cstdint>
+
+#include "Definations.h"
+#include "Math/MathDefinations.h"
+
+namespace Koala
+{
+    struct Vector
+    {
+        Vec3f position{};
+        Vec3f normal{};
+        Vec2f uv{};
+    };
+
+    // Layouts vertices can be baked in. Packed layouts quantize positions against mesh bounds,
+    // store normals octahedral encoded and UVs as half floats.
+    enum class EVertexFormat: uint32_t
+    {
+        // Vector as it is, 32 bytes.
+        Float    = 0,
+        // PackedVertex16, 16 bytes.
+        Packed16 = 1,
+        // PackedVertex12, 12 bytes.
+        Packed12 = 2,
+    };
+
+    // 16-bit position per axis, 16-bit snorm octahedral normal, half UV.
+    struct PackedVertex16
+    {
+        uint16_t position[3];
+        uint16_t reserved;
+        int16_t  normal[2];
+        uint16_t uv[2];
+    };
+
+    // 16-bit position per axis, 8-bit snorm octahedral normal (about 1 degree error), half UV.
+    struct PackedVertex12
+    {
+        uint16_t position[3];
+        int8_t   normal[2];
+        uint16_t uv[2];
+    };
+
+    static_assert(sizeof(PackedVertex16) == 16 && sizeof(PackedVertex12) == 12);
+
+    // Quantized position q of an axis is dequantized as min + q * scale.
+    struct VertexQuantizationBounds
+    {
+        float min[3]{};
+        float scale[3]{};
+    };
+
+    NODISCARD size_t GetVertexStride(EVertexFormat format);
+
+    // Bounds covering all positions with 16-bit precision.
+    NODISCARD VertexQuantizationBounds ComputeQuantizationBounds(const Vector *vertices, size_t numVertices);
+
+    // Encode vertices into packed format. Output must have room for numVertices * GetVertexStride(format) bytes.
+    // Normals are expected to be normalized.
+    void EncodeVertices(const Vector *vertices, size_t numVertices, const VertexQuantizationBounds &bounds,
+        EVertexFormat format, void *outPacked);
+    // Decode packed vertices, normals are normalized.
+    void DecodeVertices(const void *packed, size_t numVertices, const VertexQuantizationBounds &bounds,
+        EVertexFormat format, Vector *outVertices);
+
+    // Round to nearest even, overflow becomes infinity.
+    NODISCARD uint16_t FloatToHalf(float value);
+    NODISCARD float HalfToFloat(uint16_t value);
+
+    // Map unit vector onto [-1, 1]^2 square.
+    NODISCARD Vec2f OctahedralEncode(const Vec3f &normal);
+    NODISCARD Vec3f OctahedralDecode(const Vec2f &encoded);
+}
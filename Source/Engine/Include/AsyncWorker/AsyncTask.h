@@ -16,6 +16,8 @@
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #pragma once
+#include <functional>
+
 #include "TaskSet.h"
 #include "WorkDispatcher.h"
 
@@ -40,4 +42,8 @@ namespace Koala
         }
         return ptr;
     }
+
+    // Call rangeFunction(first, end) over ranges covering [0, numItems), split across worker threads if bParallel.
+    // Runs on calling thread when called from worker thread, waiting there could take the workers it waits for.
+    void ParallelForRanges(size_t numItems, bool bParallel, const std::function<void(size_t, size_t)> &rangeFunction);
 }
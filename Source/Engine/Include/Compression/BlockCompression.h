@@ -0,0 +1,85 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <vector>
+
+#include "Definations.h"
+#include "Compression.h"
+
+namespace Koala
+{
+    // Block compressed stream layout:
+    //   CompressedBlockHeader
+    //   uint32 stored size of each block, UncompressedBlockFlag set if block is stored raw
+    //   Blocks, each decodable on its own
+    // Every block holds blockSize bytes of uncompressed data, except the last one.
+    constexpr uint32_t CompressedBlockMagic = 0x4B4C424B; // "KBLK"
+    constexpr uint32_t MinCompressionBlockSize = 64 * 1024;
+    constexpr uint32_t MaxCompressionBlockSize = 256 * 1024;
+    constexpr uint32_t DefaultCompressionBlockSize = 128 * 1024;
+    constexpr uint32_t UncompressedBlockFlag = 0x80000000u;
+
+    struct CompressedBlockHeader
+    {
+        uint32_t magic{CompressedBlockMagic};
+        uint32_t blockSize{DefaultCompressionBlockSize};
+        uint64_t uncompressedSize{0};
+        uint32_t numBlocks{0};
+        ECompressionMethod method{ECompressionMethod::None};
+        uint8_t  padding[3]{};
+    };
+    static_assert(sizeof(CompressedBlockHeader) == 24);
+
+    // Parsed header and block table of a block compressed stream.
+    class CompressedBlockTable
+    {
+    public:
+        // Bytes needed to hold header and table of a stream of given uncompressed size, with any valid block size.
+        // Reading this many bytes from stream start is enough for Parse().
+        static size_t GetMaxTableSize(uint64_t uncompressedSize);
+
+        // Return false if data is not a valid stream header, or the table is truncated.
+        bool Parse(const void *data, size_t size);
+
+        NODISCARD FORCEINLINE const CompressedBlockHeader& GetHeader() const { return header; }
+        NODISCARD FORCEINLINE uint32_t GetNumBlocks() const { return header.numBlocks; }
+        // Offset of block from stream start.
+        NODISCARD FORCEINLINE uint64_t GetBlockOffset(uint32_t index) const { return blockOffsets[index]; }
+        NODISCARD FORCEINLINE uint32_t GetBlockStoredSize(uint32_t index) const { return blockSizes[index] & ~UncompressedBlockFlag; }
+        NODISCARD uint32_t GetBlockUncompressedSize(uint32_t index) const;
+        // Total size of stream, header included.
+        NODISCARD uint64_t GetStreamSize() const;
+
+        // Decode one block into dst, which holds GetBlockUncompressedSize(index) bytes.
+        bool DecodeBlock(uint32_t index, const void *blockData, void *dst) const;
+    private:
+        CompressedBlockHeader header;
+        std::vector<uint32_t> blockSizes;
+        std::vector<uint64_t> blockOffsets;
+    };
+
+    namespace Compression
+    {
+        // Compress into block compressed stream. blockSize is clamped to [MinCompressionBlockSize, MaxCompressionBlockSize].
+        std::vector<uint8_t> CompressBlocks(ECompressionMethod method, const void *src, size_t srcSize,
+            uint32_t blockSize = DefaultCompressionBlockSize);
+        // Decode whole stream on calling thread. dstSize must be exact uncompressed size.
+        bool DecompressBlocks(const void *src, size_t srcSize, void *dst, size_t dstSize);
+    }
+}
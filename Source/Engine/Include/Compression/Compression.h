@@ -0,0 +1,47 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace Koala
+{
+    // Stored in pak TOC and asset headers, values must stay stable.
+    enum class ECompressionMethod: uint8_t
+    {
+        None = 0,
+        // LZ4 block format, fast decode.
+        LZ4  = 1,
+    };
+
+    namespace Compression
+    {
+        const char* GetCompressionMethodName(ECompressionMethod method);
+
+        // Worst case size of compressing inSize bytes.
+        size_t GetCompressBound(ECompressionMethod method, size_t inSize);
+
+        // Compress src into dst. Return compressed size, or 0 if failed or result does not fit in dstCapacity.
+        size_t Compress(ECompressionMethod method, const void *src, size_t srcSize, void *dst, size_t dstCapacity);
+
+        // Decompress src into dst, dstSize must be exact uncompressed size.
+        // Return false if data is corrupted. Never reads or writes out of given ranges.
+        bool Decompress(ECompressionMethod method, const void *src, size_t srcSize, void *dst, size_t dstSize);
+    }
+}
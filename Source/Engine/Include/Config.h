@@ -19,6 +19,7 @@
 
 
 #pragma once
+#include <cstdint>
 #include <optional>
 #include <shared_mutex>
 
@@ -42,6 +43,8 @@ namespace Koala
         std::optional<std::string> GetSetting(std::string key, std::string defaultValue = "") const;
         // TODO: This should be replaced by CVar. Removed it after console variable is working.
         std::string GetSettingAndWriteDefault(std::string key, std::string defaultValue, bool bWriteIntoEngineConfig = false);
+        // As GetSettingAndWriteDefault(), for unsigned integers. Malformed values are logged and defaultValue is used.
+        uint64_t GetUIntSettingAndWriteDefault(std::string key, uint64_t defaultValue, bool bWriteIntoEngineConfig = false);
         void SetSetting(std::string key, std::string value, bool bWriteIntoEngineConfig = false);
     private:
         mutable std::shared_mutex globalConfigLock;
@@ -0,0 +1,45 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#include "Definations.h"
+
+namespace Koala
+{
+    // Fast non-cryptographic 64-bit hash of bytes, for cache keys and change detection of file contents.
+    // Stable across runs and platforms of same endianness, hashes can be stored on disk.
+    NODISCARD uint64_t HashMemory(const void *data, size_t size, uint64_t seed = 0);
+
+    // Fold value into hash, order dependent.
+    NODISCARD FORCEINLINE uint64_t HashCombine(uint64_t hash, uint64_t value)
+    {
+        hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+        hash ^= hash >> 31;
+        hash *= 0xbf58476d1ce4e5b9ull;
+        return hash ^ (hash >> 29);
+    }
+
+    NODISCARD FORCEINLINE uint64_t HashCombine(uint64_t hash, float value)
+    {
+        return HashCombine(hash, static_cast<uint64_t>(std::bit_cast<uint32_t>(value)));
+    }
+}
@@ -15,9 +15,84 @@
 //OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
 //WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
 //CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
 #pragma once
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Asset/DerivedDataCache.h"
+#include "Asset/MeshAsset.h"
 
 namespace Koala
 {
-    
+    enum class EAssetImportStatus
+    {
+        Imported,
+        // Source and settings did not change since output was baked, skipped.
+        UpToDate,
+        Failed,
+    };
+
+    struct AssetImportResult
+    {
+        std::filesystem::path source;
+        std::filesystem::path output;
+        EAssetImportStatus    status{EAssetImportStatus::Failed};
+        // Imported output was fetched from derived data cache instead of baked.
+        bool                  bFromCache{false};
+        std::string           error;
+    };
+
+    // Read mesh source file (OBJ, glTF, or anything else assimp reads) into mesh, as unbaked triangle list.
+    // Meshes of the scene are merged with node transforms applied. Return false and set error on failure.
+    // Can run on any thread.
+    bool ImportMesh(const std::filesystem::path &source, MeshAsset &mesh, std::string &error);
+
+    // Import mesh sources and bake them into output directory, many files in parallel on worker threads.
+    // Content hash of every input (source file, files it references, bake settings) is recorded in a manifest
+    // in output directory. Inputs whose hash matches the one their output was baked from are skipped,
+    // so re-importing a project only redoes changed assets. Bakes go through derived data cache, so sources
+    // baked before with same settings, in this or another output directory, are copied instead of baked again.
+    // Must be used on main thread, FileIOManager is ticked while waiting for workers.
+    class AssetImporter
+    {
+    public:
+        explicit AssetImporter(std::filesystem::path inOutputDirectory, const MeshBakeSettings &inSettings = {});
+
+        // Outputs keep their path relative to sourceRoot, or take file name only if sourceRoot is empty.
+        std::vector<AssetImportResult> Import(const std::vector<std::filesystem::path> &sources,
+            const std::filesystem::path &sourceRoot = {});
+        // Import every supported file under directory, recursively.
+        std::vector<AssetImportResult> ImportDirectory(const std::filesystem::path &directory);
+
+        // Ignore manifest, import every source again. Derived data cache is still used.
+        void SetForceReimport(bool bForce) { bForceReimport = bForce; }
+        // Cache to bake through, DerivedDataCache::Get() by default. Nullptr disables it.
+        void SetDerivedDataCache(DerivedDataCache *inCache) { derivedDataCache = inCache; }
+
+        NODISCARD static bool IsSupportedSourceFile(const std::filesystem::path &path);
+        NODISCARD std::filesystem::path GetOutputPath(const std::filesystem::path &source,
+            const std::filesystem::path &sourceRoot = {}) const;
+        NODISCARD FORCEINLINE const std::filesystem::path& GetOutputDirectory() const { return outputDirectory; }
+
+    private:
+        AssetImportResult ImportSource(const std::filesystem::path &source, const std::filesystem::path &output,
+            uint64_t &outInputHash) const;
+        NODISCARD std::string GetManifestKey(const std::filesystem::path &output) const;
+        void LoadManifest();
+        bool SaveManifest() const;
+
+        std::filesystem::path outputDirectory;
+        MeshBakeSettings      settings;
+        // Hash of bake settings, bake version and importer version, part of every input hash.
+        uint64_t              settingsHash{0};
+        bool                  bForceReimport{false};
+        DerivedDataCache     *derivedDataCache{&DerivedDataCache::Get()};
+
+        // Output path relative to output directory -> hash of inputs it was baked from.
+        std::unordered_map<std::string, uint64_t> manifest;
+        bool                                      bManifestLoaded{false};
+    };
 }
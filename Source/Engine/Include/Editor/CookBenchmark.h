@@ -0,0 +1,33 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <cstdint>
+#include <filesystem>
+
+namespace Koala
+{
+    // Cook (import and bake) generated mesh sources in given directory three times and log time of each pass:
+    // cold (empty derived data cache and output), warm (filled cache, empty output, bakes are fetched from cache)
+    // and up to date (import manifest skips every source). Uses own cache, files are removed after.
+    // FileIOManager and worker threads must be running, FileIO is ticked while waiting.
+    void RunCookBenchmark(const std::filesystem::path &directory, uint32_t numSources, uint32_t gridSize);
+
+    // Directory and workload are taken from config (cook.benchmark.dir, cook.benchmark.numsources, cook.benchmark.gridsize).
+    void RunCookBenchmarks();
+}
@@ -0,0 +1,60 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <mutex>
+#include <vector>
+
+#include "Definations.h"
+#include "FileIOBackend.h"
+
+namespace Koala::FileIO
+{
+    // Fixed set of staging buffers aligned to DirectIOAlignment, carved from one allocation.
+    // Used by I/O threads when an unbuffered read is not aligned: the aligned range is read into
+    // a staging buffer, then the requested bytes are copied out. Thread-safe.
+    class DirectIOBufferPool
+    {
+    public:
+        DirectIOBufferPool() = default;
+        ~DirectIOBufferPool();
+
+        DirectIOBufferPool(const DirectIOBufferPool&) = delete;
+        DirectIOBufferPool& operator=(const DirectIOBufferPool&) = delete;
+
+        // inBufferSize is rounded up to DirectIOAlignment.
+        void Initialize(size_t inBufferSize, uint32_t inNumBuffers);
+        void Shutdown();
+
+        // Return a free staging buffer, or nullptr if all buffers are in use.
+        NODISCARD void* Acquire();
+        void Release(void *buffer);
+
+        NODISCARD bool IsPooledBuffer(const void *buffer) const;
+        NODISCARD FORCEINLINE size_t GetBufferSize() const { return bufferSize; }
+        // The whole pool as one span, to be registered to backend.
+        NODISCARD std::vector<FileIOBufferSpan> GetBufferSpans() const;
+    private:
+        uint8_t *memory{nullptr};
+        size_t   bufferSize{0};
+        uint32_t numBuffers{0};
+
+        std::mutex mutex;
+        std::vector<void*> freeBuffers;
+    };
+}
@@ -17,9 +17,12 @@
 //CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #pragma once
-#include <fstream>
+#include <atomic>
 #include <unordered_map>
 
+#include "FileTypes.h"
+#include "MappedFile.h"
+#include "Compression/Compression.h"
 #include "Core/ModuleInterface.h"
 #include "Core/HashedString.h"
 #include "Core/ThreadInterface.h"
@@ -27,51 +30,38 @@
 
 namespace Koala::FileIO
 {
-    enum EFileOpenMode
-    {
-        OpenFileAsBinary = 1 << 0,
-        OpenFileAsText   = 1 << 1,
-        OpenFileAtAppend = 1 << 2,
-        OpenFileForRead   = 1 << 3,
-        OpenFileForWrite  = 1 << 4,
-    };
-    typedef uint32_t EOpenFileModes;
-
-    enum class EFilePriority
-    {
-        Highest = 5,
-        High    = 4,
-        Normal  = 3,
-        Low     = 2,
-        Lowest  = 1
-    };
-
+    class PakFile;
     struct FileHandleData
     {
         HashedString     fileName;
         size_t         fileSize;
         EOpenFileModes openMode;
         EFilePriority  priority{EFilePriority::Normal};
-        std::fstream   fileStream;
+        NativeFileHandle nativeHandle{InvalidNativeFileHandle};
 
+        // The write thread all writes of this file are queued to. Reads are not pinned to any thread.
         IThread        *currWorkingIOThread{nullptr};
 
+        // Set if file is an entry of a mounted pak. Native handle is owned by pak,
+        // I/O offsets are relative to baseOffset and must stay within storedSize.
+        std::shared_ptr<PakFile> pak;
+        uint64_t         baseOffset{0};
+        // Bytes stored in pak, differs from fileSize if entry is compressed.
+        uint64_t         storedSize{0};
+        ECompressionMethod compression{ECompressionMethod::None};
+        // Bumped when a write of this file is requested and again when it finishes. Data read while it changed may be stale.
+        std::atomic<uint64_t> writeGeneration{0};
 
         FileHandleData() = default;
 
         FORCEINLINE bool IsValid() const
         {
-            return fileName.GetHash() != 0 && fileStream.is_open() && fileStream.good();
-        }
-
-        FORCEINLINE bool IsEOF() const
-        {
-            return fileStream.eof();
+            return fileName.GetHash() != 0 && IsOpened();
         }
 
         FORCEINLINE bool IsOpened() const
         {
-            return fileStream.is_open();
+            return nativeHandle != InvalidNativeFileHandle;
         }
 
         FORCEINLINE bool IsOpenedForReadOnly() const
@@ -89,6 +79,21 @@ namespace Koala::FileIO
         {
             return IsValid() && openMode & (uint32_t)EFileOpenMode::OpenFileForWrite;
         }
+
+        FORCEINLINE bool IsDirectIO() const
+        {
+            return openMode & (uint32_t)EFileOpenMode::OpenFileUnbuffered;
+        }
+
+        FORCEINLINE bool IsPakEntry() const
+        {
+            return pak != nullptr;
+        }
+
+        FORCEINLINE bool IsCompressed() const
+        {
+            return compression != ECompressionMethod::None;
+        }
     };
 
     typedef std::shared_ptr<FileHandleData> FileHandle;
@@ -101,11 +106,37 @@ namespace Koala::FileIO
         FileHandle OpenFileForWrite(HashedString path, EOpenFileModes openMode = EFileOpenMode::OpenFileAsBinary);
         
         void CloseFile(FileHandle &handle);
+
+        // Metadata of a file on disk or in a mounted pak. Results of disk lookups, including missing files, are cached.
+        // Opening a file for write and closing it drop its entry, opening for read only drops a cached missing file.
+        // Files changed by others need InvalidateFileStat().
+        FileStat StatFile(HashedString path);
+        // Return false if path has no cached metadata.
+        bool FindCachedFileStat(HashedString path, FileStat &outStat);
+        void InvalidateFileStat(HashedString path);
+        void ClearFileStatCache();
+
+        // Map whole file into memory for reading. Mapping the same file again returns the shared view.
+        // Return nullptr if the file cannot be mapped (not exist, or opened for write).
+        MappedFileRef MapFileForRead(HashedString path, EMappedFileAccessHint hint = EMappedFileAccessHint::Normal);
+
+        // Mount pak, its entries can then be opened by OpenFileForRead() with entry path, as if they were files.
+        // Paks mounted later take precedence, and all of them over loose files on disk.
+        bool MountPak(HashedString pakPath);
+        void UnmountPak(HashedString pakPath);
     private:
         void CalcFileSize(FileHandle & inHandle);
+        // Requires mutex held.
+        FileHandle OpenPakEntryForRead(HashedString path, EOpenFileModes openMode);
 
         std::unordered_map<HashedString, FileHandle>  openedFilesForRead;
         std::unordered_map<HashedString, FileHandle> openedFilesForWrite;
+        std::unordered_map<HashedString, std::weak_ptr<MappedFileView>> mappedFiles;
+        std::vector<std::shared_ptr<PakFile>>          mountedPaks;
         std::mutex                                      mutex;
+
+        // Separate lock, stat lookups do not wait for files being opened.
+        std::unordered_map<HashedString, FileStat>      fileStatCache;
+        std::mutex                                      mutexFileStatCache;
     };
 }
@@ -0,0 +1,107 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Definations.h"
+#include "FileTypes.h"
+
+namespace Koala::FileIO
+{
+    enum class EFileIOBackend: uint8_t
+    {
+        // Blocking positional I/O (pread/pwrite), executed by the I/O thread pool. Always available.
+        Synchronous,
+        // Linux io_uring. Many in-flight requests per I/O thread, batched submission.
+        IOUring,
+    };
+
+    enum class EFileIOOpType: uint8_t
+    {
+        Read,
+        Write,
+        // Write spans back to back with one call (pwritev).
+        WriteGather,
+        // Flush written data of file to storage, result is 0 on success.
+        Sync
+    };
+
+    // A memory range that will be used as I/O buffer repeatedly (e.g. streaming staging buffers).
+    // Backends may pin them in kernel to avoid per-request page mapping.
+    // Also used as a piece of gather write, layout matches iovec.
+    struct FileIOBufferSpan
+    {
+        void  *buffer{nullptr};
+        size_t size{0};
+    };
+
+    // Gather writes are split into requests of at most this many spans (IOV_MAX on Linux).
+    constexpr uint32_t MaxGatherSpansPerRequest = 1024;
+
+    // One positional read/write issued to backend.
+    struct FileIORequest
+    {
+        NativeFileHandle nativeHandle{InvalidNativeFileHandle};
+        EFileIOOpType    opType{EFileIOOpType::Read};
+        int64_t          offset{0};
+        // Total size of spans for gather writes.
+        int64_t          size{0};
+        void            *buffer{nullptr};
+        // Used by WriteGather instead of buffer.
+        const FileIOBufferSpan *spans{nullptr};
+        uint32_t         numSpans{0};
+        // Used by Sync.
+        EFileSyncMode    syncMode{EFileSyncMode::None};
+
+        // Filled by backend. >= 0: transferred bytes (may less than size), < 0: error.
+        int64_t          result{0};
+    };
+
+    // Backend instances are NOT thread-safe. Each I/O thread owns its own backend.
+    class IFileIOBackend
+    {
+    public:
+        virtual ~IFileIOBackend() = default;
+
+        virtual bool Initialize(uint32_t inQueueDepth) = 0;
+        virtual void Shutdown() = 0;
+
+        NODISCARD virtual EFileIOBackend GetType() const = 0;
+        // Maximum number of requests can be submitted in one batch.
+        NODISCARD virtual uint32_t GetQueueDepth() const = 0;
+
+        // Submit all requests in one batch, and block until all of them are completed.
+        // Writes and syncs of the same file run in batch order. Once one of them falls short or fails, the later ones
+        // of that file are not performed and get -ECANCELED, so the rest can be resubmitted without reordering.
+        virtual void SubmitAndWait(FileIORequest *requests, uint32_t numRequests) = 0;
+
+        // Replace registered buffers. Pass empty vector to unregister all.
+        virtual bool RegisterBuffers(const std::vector<FileIOBufferSpan> &buffers) = 0;
+    };
+
+    const char* GetFileIOBackendName(EFileIOBackend inBackend);
+    // Parse config string. Return Synchronous if unknown.
+    EFileIOBackend ParseFileIOBackendName(const std::string &inName);
+    // Test whether given backend can be created on this platform and kernel.
+    bool IsFileIOBackendSupported(EFileIOBackend inBackend);
+    // Create and initialize backend. Fallback to Synchronous backend if requested one cannot be initialized.
+    std::unique_ptr<IFileIOBackend> CreateFileIOBackend(EFileIOBackend inBackend, uint32_t inQueueDepth);
+}
@@ -0,0 +1,34 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <filesystem>
+#include <string>
+
+namespace Koala::FileIO
+{
+    // Run FileIO workloads in given directory and log throughput and latency of each:
+    // sequential write and read of large files, random 4KB reads, many small files (open, read, close),
+    // and mixed priority reads, where high priority latency is measured under background load.
+    // Files are created before and removed after. FileIOManager must be initialized, it is ticked while waiting.
+    void RunFileIOBenchmark(const std::filesystem::path &directory, const std::string &label, bool bUnbuffered);
+
+    // Run on tmpfs and on disk, directories are taken from config (fileio.benchmark.tmpfsdir, fileio.benchmark.diskdir).
+    // Disk reads bypass page cache, otherwise they would only measure memory copies of just written files.
+    void RunFileIOBenchmarks();
+}
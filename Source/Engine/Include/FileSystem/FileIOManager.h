@@ -17,19 +17,124 @@
 //CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #pragma once
+#include <atomic>
+#include <future>
+#include <mutex>
 #include <queue>
 #include <stdbool.h>
 #include <unordered_map>
 #include <unordered_set>
 
 #include "Core/HashedString.h"
+#include "DirectIOBufferPool.h"
 #include "File.h"
+#include "FileIOBackend.h"
+#include "FileIOScheduler.h"
+#include "FileIOStats.h"
 #include "FileIOTask.h"
+#include "WriteBehindBuffer.h"
 #include "Core/ModuleInterface.h"
 #include "Core/ThreadInterface.h"
+#include "Core/ThreadManager.h"
 
 namespace Koala::FileIO
 {
+    // Read request as submitted by caller, before coalescing and splitting.
+    struct PendingReadRequest
+    {
+        FileHandle     handle;
+        int64_t        offset{0};
+        int64_t        size{0};
+        void          *buffer{nullptr};
+        FileIOCallback callback;
+        EFileIOCompletionMode completionMode{EFileIOCompletionMode::MainThread};
+        FileIOClock::time_point submitTime;
+        EFilePriority  priority{EFilePriority::Normal};
+        FileIOClock::time_point deadline{FileIOClock::time_point::max()};
+        FileIORequestRef control;
+
+        NODISCARD FORCEINLINE EFilePriority GetPriority() const
+        {
+            return control ? control->GetPriority() : priority;
+        }
+    };
+
+    // handle is nullptr if file cannot be opened.
+    typedef std::function<void(FileHandle handle)> FileOpenCallback;
+    typedef std::function<void(const FileStat &stat)> FileStatCallback;
+
+    enum class EFileMetadataOp: uint8_t
+    {
+        Open,
+        Stat,
+        Close
+    };
+
+    // Open, stat or close request, run on I/O thread.
+    struct FileMetadataRequest
+    {
+        EFileMetadataOp  op{EFileMetadataOp::Stat};
+        HashedString     path;
+        EOpenFileModes   openMode{EFileOpenMode::OpenFileAsBinary};
+        // File to close.
+        FileHandle       handle;
+        FileOpenCallback openCallback;
+        FileStatCallback statCallback;
+        std::function<void()> closeCallback;
+        EFileIOCompletionMode completionMode{EFileIOCompletionMode::MainThread};
+        FileIOClock::time_point submitTime;
+    };
+
+    // Finished request waiting to be delivered to its callback.
+    struct FileIOCompletion
+    {
+        FileIOCallback callback;
+        EFileIOCompletionMode completionMode{EFileIOCompletionMode::MainThread};
+        FileIOClock::time_point submitTime;
+        // Latency statistics are accounted per priority, together with deadline misses.
+        EFilePriority priority{EFilePriority::Normal};
+        FileIOClock::time_point deadline{FileIOClock::time_point::max()};
+        bool        bOK{false};
+        int64_t     performedSize{0};
+        const void *buffer{nullptr};
+    };
+
+    // One read into an internal buffer, serving several caller requests (merged reads and readahead).
+    // The last staged read of each file is kept, later requests inside its range are served from memory, until a
+    // request reaches past its end or a write of the file is requested or finishes (see FileHandleData::writeGeneration).
+    // Finished on I/O thread, so state below is guarded by mutex.
+    struct StagedRead
+    {
+        std::mutex mutex;
+        int64_t offset{0};
+        int64_t size{0};
+        int64_t performedSize{0};
+        // Write generation of file when read was issued.
+        uint64_t writeGeneration{0};
+        bool    bReady{false};
+        bool    bOK{false};
+        std::vector<uint8_t> data;
+        // Requests waiting for this read to finish.
+        std::vector<PendingReadRequest> waiters;
+
+        // Requires mutex held.
+        NODISCARD FORCEINLINE bool Covers(int64_t inOffset, int64_t inSize) const
+        {
+            return inOffset >= offset && inOffset + inSize <= offset + size && !(bReady && !bOK);
+        }
+        // Copy requested range into caller's buffer and deliver its completion. Requires bReady.
+        void Serve(PendingReadRequest &request) const;
+    };
+
+    // Per-file access pattern tracking, used to size readahead window.
+    struct FileReadState
+    {
+        std::weak_ptr<FileHandleData> handle;
+        int64_t nextExpectedOffset{-1};
+        int64_t readAheadWindow{0};
+        std::shared_ptr<StagedRead> lastStagedRead;
+    };
+
     class FileIOManager: IModule
     {
     public:
@@ -38,14 +143,140 @@ namespace Koala::FileIO
         bool Shutdown_MainThread() override;
         void Tick_MainThread(float deltaTime) override;
 
-        void RequestReadFileAsync(FileHandle inHandle, size_t offset, size_t size, void *buffer, FileIOCallback callback = nullptr);
-        void RequestWriteFileAsync(FileHandle inHandle, size_t offset, size_t size, const void *buffer, FileIOCallback callback = nullptr);
+        // Returned control can cancel or reprioritize the request while it is queued or being read.
+        FileIORequestRef RequestReadFileAsync(FileHandle inHandle, size_t offset, size_t size, void *buffer, FileIOCallback callback = nullptr,
+            EFileIOCompletionMode completionMode = EFileIOCompletionMode::MainThread, const FileIORequestOptions &options = {});
+        // Writes keep submission order per file, only cancellation is honored.
+        FileIORequestRef RequestWriteFileAsync(FileHandle inHandle, size_t offset, size_t size, const void *buffer, FileIOCallback callback = nullptr,
+            EFileIOCompletionMode completionMode = EFileIOCompletionMode::MainThread);
+
+        // Write spans back to back starting at offset, with as few syscalls as possible (pwritev).
+        // Buffers are not copied and must stay alive until callback.
+        FileIORequestRef RequestWriteGatherAsync(FileHandle inHandle, size_t offset, std::vector<FileIOBufferSpan> spans,
+            FileIOCallback callback = nullptr, EFileIOCompletionMode completionMode = EFileIOCompletionMode::MainThread);
+        // Barrier: all writes of file requested before are flushed to storage before callback, writes requested after
+        // start once it is done. Writes without barrier may stay in OS cache for a while.
+        FileIORequestRef RequestSyncFileAsync(FileHandle inHandle, EFileSyncMode syncMode = EFileSyncMode::Data,
+            FileIOCallback callback = nullptr, EFileIOCompletionMode completionMode = EFileIOCompletionMode::MainThread);
+
+        // Buffer collecting small sequential writes of file (see WriteBehindBuffer). Flushed by tick when due.
+        // flushSize and flushInterval of 0 take defaults from config.
+        std::shared_ptr<WriteBehindBuffer> CreateWriteBehindBuffer(FileHandle inHandle, size_t startOffset = 0,
+            size_t flushSize = 0, FileIOClock::duration flushInterval = {});
+
+        // Read a block compressed stream (see BlockCompression.h) stored at streamOffset of file, decoded into buffer.
+        // size is the uncompressed size. Blocks are read separately and decoded on AsyncWorker as they arrive.
+        // Used for compressed pak entries, and compressed data stored inside asset files.
+        FileIORequestRef RequestReadBlockCompressedAsync(FileHandle inHandle, size_t streamOffset, size_t size, void *buffer,
+            FileIOCallback callback = nullptr, EFileIOCompletionMode completionMode = EFileIOCompletionMode::MainThread,
+            const FileIORequestOptions &options = {});
+
+        // Open, stat and close files on I/O threads, so that caller never waits for file system.
+        // Requests are collected and run in batches on read threads, in submission order within a batch.
+        // File is opened for write if openMode has EFileOpenMode::OpenFileForWrite, otherwise for read.
+        void RequestOpenFileAsync(HashedString path, EOpenFileModes openMode, FileOpenCallback callback,
+            EFileIOCompletionMode completionMode = EFileIOCompletionMode::MainThread);
+        // Callback always runs through completionMode, even if metadata of path is cached (see FileManager::StatFile).
+        void RequestStatFileAsync(HashedString path, FileStatCallback callback,
+            EFileIOCompletionMode completionMode = EFileIOCompletionMode::MainThread);
+        // All I/O of the file must be finished before.
+        void RequestCloseFileAsync(FileHandle inHandle, std::function<void()> callback = nullptr,
+            EFileIOCompletionMode completionMode = EFileIOCompletionMode::MainThread);
+
+        // Hand finished request over to its callback, according to its completion mode. Can be called from any thread.
+        void DeliverCompletion(FileIOCompletion &&completion);
+        void DeliverCompletion(FileIOTask &&task);
+
+        // Completion latency (submit to callback invocation) statistics, in microseconds.
+        NODISCARD uint64_t GetNumCompletions(EFileIOCompletionMode mode) const;
+        NODISCARD uint64_t GetAverageCompletionLatencyUs(EFileIOCompletionMode mode) const;
+        NODISCARD uint64_t GetMaxCompletionLatencyUs(EFileIOCompletionMode mode) const;
+        NODISCARD uint64_t GetNumCompletions(EFilePriority priority) const;
+        NODISCARD uint64_t GetAverageCompletionLatencyUs(EFilePriority priority) const;
+        NODISCARD uint64_t GetMaxCompletionLatencyUs(EFilePriority priority) const;
+        // Requests with a deadline, completed after it.
+        NODISCARD uint64_t GetNumDeadlineMisses(EFilePriority priority) const;
+        // Latency percentile (0 to 100) of all completions, or of one priority.
+        NODISCARD uint64_t GetCompletionLatencyPercentileUs(double percentile) const;
+        NODISCARD uint64_t GetCompletionLatencyPercentileUs(EFilePriority priority, double percentile) const;
+
+        // Log throughput per I/O thread, queue depth, seeks and latency percentiles since last ResetStats().
+        // Also done periodically if CVar fileio.stats.dumpinterval is set, and on shutdown.
+        void DumpStats();
+        void ResetStats();
+
+        // Register long-lived I/O buffers (e.g. streaming staging buffers) to all I/O threads.
+        // Backends supporting it (io_uring) will pin them, reads/writes fully inside those buffers become cheaper.
+        // Direct I/O staging buffers are always registered in addition to inBuffers.
+        void RegisterIOBuffers(const std::vector<FileIOBufferSpan> &inBuffers);
+
+        // Staging buffers for unaligned reads of files opened with EFileOpenMode::OpenFileUnbuffered.
+        NODISCARD DirectIOBufferPool& GetDirectIOBufferPool() { return directIOBufferPool; }
+
+        NODISCARD EFileIOBackend GetBackendType() const { return backendType; }
+
+        // Block until future of a request callback is ready. Requests are dispatched on tick, so main thread keeps
+        // ticking while waiting. Callbacks must not complete on main thread, use EFileIOCompletionMode::IOThread.
+        template <typename T>
+        T WaitForResult(std::future<T> &future)
+        {
+            WaitUntilReady(future);
+            return future.get();
+        }
+        template <typename T>
+        T WaitForResult(const std::shared_future<T> &future)
+        {
+            WaitUntilReady(future);
+            return future.get();
+        }
+        template <typename FutureType>
+        void WaitUntilReady(const FutureType &future)
+        {
+            if (IsInMainThread())
+            {
+                while (future.wait_for(std::chrono::microseconds(100)) != std::future_status::ready)
+                {
+                    Tick_MainThread(0);
+                }
+            }
+            future.wait();
+        }
     private:
-        void TickFileIOThread(IThread* threadHandle);
-        void TickRemainingIOTasks(std::queue<FileIOTask> &taskQueue, const std::vector<IThread*> &threadHandles);
+        void InvokeCompletion(FileIOCompletion &completion);
+        void TickRemainingIOTasks(std::queue<FileIOTask> &taskQueue, const std::vector<IThread*> &threadHandles, bool bPinFileToThread);
+
+        // Hand pending open/stat/close requests to read threads in batches.
+        void ProcessPendingMetadataRequests();
+        void ExecuteMetadataRequest(FileMetadataRequest &request);
+
+        // Sort pending reads by file and offset, merge nearby ones and apply readahead.
+        void ProcessPendingReads();
+        // Reads [runStart, runEnd) of one file, serving all requests in run.
+        void ProcessReadRun(int64_t runStart, int64_t runEnd, std::vector<PendingReadRequest> &&run);
+        // Reads of compressed pak entry: whole entry is read and decompressed, then requests are served from it.
+        void ProcessCompressedReads(std::vector<PendingReadRequest> &&run);
+        FileReadState& FindFileReadState(const FileHandle &handle);
+        // Turn request into I/O tasks, large reads are split across read threads.
+        void IssueReadTask(PendingReadRequest &&request);
+        // Queue task to read scheduler and wake up an idle read thread. Thread-safe.
+        void ScheduleReadTask(FileIOTask &&task);
 
         uint32_t numReadThreads{4};
         uint32_t numWriteThreads{2};
+        // Maximum in-flight requests per I/O thread.
+        uint32_t ioQueueDepth{64};
+        EFileIOBackend backendType{EFileIOBackend::Synchronous};
+        // Reads of one file closer than this are merged into one read.
+        int64_t coalesceGap{4096};
+        size_t writeBehindFlushSize{256 * 1024};
+        FileIOClock::duration writeBehindFlushInterval{std::chrono::milliseconds(100)};
+        // Upper bound of merged read size and readahead window. 0 disables readahead.
+        int64_t maxCoalescedReadSize{1024 * 1024};
+        int64_t maxReadAheadWindow{1024 * 1024};
+
+        DirectIOBufferPool directIOBufferPool;
+        // Read tasks of all read threads are ordered here.
+        FileIOScheduler readScheduler;
 
         std::vector<IThread*> writeThreadHandles;
         std::vector<IThread*> readThreadHandles;
@@ -53,7 +284,44 @@ namespace Koala::FileIO
         // std::unordered_map<StringHash, IThread*> readingFileMap_ThreadHandle;
         // std::unordered_map<StringHash, IThread*> writingFileMap_ThreadHandle;
         
-        std::queue<FileIOTask> remainingReadTasks;
+        // Requests may come from any thread, guarded by mutexPendingRequests.
+        std::mutex mutexPendingRequests;
+        std::vector<PendingReadRequest> pendingReads;
         std::queue<FileIOTask> remainingWriteTasks;
+        std::vector<FileMetadataRequest> pendingMetadataRequests;
+
+        std::mutex mutexWriteBehindBuffers;
+        std::vector<std::weak_ptr<WriteBehindBuffer>> writeBehindBuffers;
+
+        std::mutex mutexMainThreadCompletions;
+        std::vector<FileIOCompletion> mainThreadCompletions;
+
+        struct CompletionLatencyStats
+        {
+            std::atomic<uint64_t> numCompletions{0};
+            std::atomic<uint64_t> totalLatencyUs{0};
+            std::atomic<uint64_t> maxLatencyUs{0};
+            std::atomic<uint64_t> numDeadlineMisses{0};
+            FileIOLatencyHistogram histogram;
+
+            void Add(uint64_t latencyUs, bool bDeadlineMissed);
+            void Reset();
+        };
+        static constexpr size_t NumFilePriorities = static_cast<size_t>(EFilePriority::Highest);
+        CompletionLatencyStats completionStats[static_cast<size_t>(EFileIOCompletionMode::Num)];
+        // Indexed by priority - 1.
+        CompletionLatencyStats priorityStats[NumFilePriorities];
+        FileIOLatencyHistogram allCompletionLatencies;
+
+        // Sampled on main thread tick: requests queued but not yet picked by an I/O thread.
+        FileIOClock::time_point statsStartTime;
+        FileIOClock::time_point lastStatsDumpTime;
+        uint64_t numQueueDepthSamples{0};
+        uint64_t totalQueueDepth{0};
+        uint64_t maxQueueDepth{0};
+
+        // Only touched on main thread.
+        uint32_t nextMetadataThread{0};
+        std::unordered_map<HashedString, FileReadState> fileReadStates;
     };
 }
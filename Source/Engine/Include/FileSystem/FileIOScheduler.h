@@ -0,0 +1,109 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "FileIOTask.h"
+
+namespace Koala::FileIO
+{
+    // Global queue of read tasks, shared by all read threads.
+    // Tasks are handed out by deadline and priority across whole queue, instead of per thread submission order:
+    // 1. Tasks whose deadline is missed or closer than deadline slack, earliest deadline first.
+    // 2. Higher priority first, then earlier deadline, then submission order.
+    // Background (Low and Lowest priority) tasks are limited by a token bucket, so they cannot take
+    // bandwidth needed by gameplay-critical loads. Background tasks getting urgent are not limited.
+    // Tasks are kept in heaps, one by deadline and one per priority, so a pop costs O(log n) per task taken.
+    class FileIOScheduler
+    {
+    public:
+        // backgroundBytesPerSecond of 0 disables background bandwidth limit.
+        void Initialize(uint64_t backgroundBytesPerSecond, uint64_t backgroundBurstBytes, FileIOClock::duration inDeadlineSlack);
+
+        // Thread-safe.
+        void Push(FileIOTask &&task);
+
+        // Take up to maxCount tasks in schedule order. Thread-safe.
+        // Return how long to wait if only throttled background tasks are left, zero otherwise.
+        FileIOClock::duration Pop(std::vector<FileIOTask> &outTasks, size_t maxCount);
+
+        NODISCARD FORCEINLINE size_t GetNumPendingTasks() const
+        {
+            return numPendingTasks.load();
+        }
+
+        NODISCARD static FORCEINLINE bool IsBackgroundPriority(EFilePriority priority)
+        {
+            return priority <= EFilePriority::Low;
+        }
+    private:
+        static constexpr size_t NumPriorities = static_cast<size_t>(EFilePriority::Highest);
+
+        // Queued task, pushId is 0 for free slots.
+        struct Slot
+        {
+            FileIOTask task;
+            uint64_t   pushId{0};
+        };
+
+        // Entry of a queue heap, refers to slot. Stale once its slot is taken or reused (pushId differs).
+        struct QueueEntry
+        {
+            FileIOClock::time_point deadline;
+            uint64_t                sequence;
+            uint64_t                pushId;
+            uint32_t                slot;
+
+            // Heaps are max-heaps, earliest deadline then earliest submission goes on top.
+            bool operator<(const QueueEntry &rhs) const;
+        };
+
+        // Requires mutex held.
+        void RefillBackgroundTokens(FileIOClock::time_point now);
+        void AddQueueEntries(uint32_t slot);
+        // Rebuild heaps from slots: drops stale entries, and moves tasks whose priority was changed. Requires mutex held.
+        void RebuildQueues();
+        // Remove top entry of heap and move its task out. Requires mutex held.
+        void TakeTop(std::vector<QueueEntry> &queue, std::vector<FileIOTask> &outTasks);
+        NODISCARD FORCEINLINE bool IsStale(const QueueEntry &entry) const { return slots[entry.slot].pushId != entry.pushId; }
+
+        std::mutex              mutex;
+        std::vector<Slot>       slots;
+        std::vector<uint32_t>   freeSlots;
+        // Tasks with deadline, to find urgent ones.
+        std::vector<QueueEntry> deadlineQueue;
+        // Indexed by priority - 1, ordered by deadline then submission order.
+        std::vector<QueueEntry> priorityQueues[NumPriorities];
+        size_t                  numQueueEntries{0};
+        uint64_t                nextSequence{1};
+        uint64_t                nextPushId{1};
+        uint64_t                priorityChangeSerial{0};
+        std::atomic<size_t>     numPendingTasks{0};
+
+        FileIOClock::duration   deadlineSlack{};
+
+        // Token bucket of background reads, in bytes. Allowed to go negative by one task, large reads are not split for it.
+        double                  backgroundRate{0};
+        double                  backgroundBurst{0};
+        double                  backgroundTokens{0};
+        FileIOClock::time_point lastRefillTime;
+    };
+}
@@ -0,0 +1,74 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+#include "Definations.h"
+
+namespace Koala::FileIO
+{
+    // Lock-free latency histogram. Buckets are a quarter of power of two wide (about 19% error),
+    // covering 1us to 2^32us.
+    class FileIOLatencyHistogram
+    {
+    public:
+        void Add(uint64_t latencyUs);
+        void Reset();
+
+        NODISCARD uint64_t GetCount() const;
+        // Upper bound of bucket containing given percentile (0 to 100). Return 0 if empty.
+        NODISCARD uint64_t GetPercentileUs(double percentile) const;
+    private:
+        static constexpr uint32_t BucketsPerPowerOfTwo = 4;
+        static constexpr uint32_t NumBuckets = 32 * BucketsPerPowerOfTwo;
+
+        static uint32_t GetBucketIndex(uint64_t latencyUs);
+        static uint64_t GetBucketUpperBoundUs(uint32_t index);
+
+        std::atomic<uint64_t> buckets[NumBuckets]{};
+    };
+
+    // Counters of one I/O thread. Written by that thread, read by anyone.
+    struct FileIOThreadStats
+    {
+        std::atomic<uint64_t> bytesTransferred{0};
+        std::atomic<uint64_t> numRequests{0};
+        // Requests not continuing where previous request of this thread ended (another file, or another offset).
+        // On rotational disks each one is a head seek.
+        std::atomic<uint64_t> numSeeks{0};
+        std::atomic<uint64_t> numBatches{0};
+        // Sum and maximum of requests in flight per batch, i.e. queue depth seen by device.
+        std::atomic<uint64_t> totalBatchDepth{0};
+        std::atomic<uint64_t> maxBatchDepth{0};
+        // Time spent inside backend.
+        std::atomic<uint64_t> busyTimeUs{0};
+
+        void Reset()
+        {
+            bytesTransferred = 0;
+            numRequests = 0;
+            numSeeks = 0;
+            numBatches = 0;
+            totalBatchDepth = 0;
+            maxBatchDepth = 0;
+            busyTimeUs = 0;
+        }
+    };
+}
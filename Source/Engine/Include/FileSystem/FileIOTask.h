@@ -17,13 +17,71 @@
 //CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <optional>
 #include <queue>
 
 #include "File.h"
+#include "FileIOBackend.h"
 
 namespace Koala::FileIO
 {
     typedef std::function<void(bool bOk, int64_t size, const void *buffer)> FileIOCallback;
+    typedef std::chrono::steady_clock FileIOClock;
+
+    // Where the callback of a request is invoked once it is finished.
+    enum class EFileIOCompletionMode: uint8_t
+    {
+        // Deferred to FileIOManager::Tick_MainThread.
+        MainThread = 0,
+        // Invoked directly on the I/O thread which finished the request.
+        // Callback must be short and thread-safe, it blocks further I/O of that thread.
+        IOThread,
+        // Enqueued as AsyncWorker task, suitable for decompression and parsing.
+        WorkerTask,
+        Num
+    };
+
+    // I/O is issued in blocks of this size, priority decides how many blocks a task gets before it is requeued.
+    constexpr int64_t FileIOBlockSize = 16384;
+    int64_t FilePriorityToBlockNum(EFilePriority inPriority);
+
+    // Shared by caller and FileIOManager, changes a request after it is submitted.
+    // Canceled requests still get their callback, with bOk == false. Part being read at that moment is finished first.
+    class FileIORequestControl
+    {
+    public:
+        explicit FileIORequestControl(EFilePriority inPriority): priority(inPriority) {}
+
+        FORCEINLINE void Cancel() { bCancelRequested.store(true, std::memory_order_relaxed); }
+        NODISCARD FORCEINLINE bool IsCancelRequested() const { return bCancelRequested.load(std::memory_order_relaxed); }
+
+        // Takes effect the next time scheduler picks the request, including remaining part of a partially read one.
+        FORCEINLINE void SetPriority(EFilePriority inPriority)
+        {
+            priority.store(inPriority, std::memory_order_relaxed);
+            priorityChangeSerial.fetch_add(1, std::memory_order_release);
+        }
+        NODISCARD FORCEINLINE EFilePriority GetPriority() const { return priority.load(std::memory_order_relaxed); }
+
+        // Bumped by every SetPriority(), scheduler reorders its queue when it changed.
+        NODISCARD static FORCEINLINE uint64_t GetPriorityChangeSerial() { return priorityChangeSerial.load(std::memory_order_acquire); }
+    private:
+        std::atomic<bool>          bCancelRequested{false};
+        std::atomic<EFilePriority> priority;
+        static inline std::atomic<uint64_t> priorityChangeSerial{0};
+    };
+    typedef std::shared_ptr<FileIORequestControl> FileIORequestRef;
+
+    struct FileIORequestOptions
+    {
+        // Defaults to priority of file handle.
+        std::optional<EFilePriority> priority;
+        // Request should be completed by then. Late or nearly late requests are served before any other.
+        FileIOClock::time_point deadline{FileIOClock::time_point::max()};
+    };
+
     struct FileIOTask
     {
         int64_t offset{0};
@@ -32,6 +90,29 @@ namespace Koala::FileIO
         void   *bufferStart;
         FileIOCallback callback;
         FileHandle handle;
+        EFileIOCompletionMode completionMode{EFileIOCompletionMode::MainThread};
+        // When request was submitted by caller, used to measure completion latency.
+        FileIOClock::time_point submitTime;
+        EFilePriority priority{EFilePriority::Normal};
+        FileIOClock::time_point deadline{FileIOClock::time_point::max()};
+        // Set for caller requests, internal tasks (e.g. merged reads) have none.
+        FileIORequestRef control;
+        // Submission order, breaks ties in scheduler. Assigned on first push.
+        uint64_t sequence{0};
+        // Gather write: spans are written back to back from offset, bufferStart is unused.
+        std::vector<FileIOBufferSpan> gatherSpans;
+        // Sync barrier: flushes file once all writes queued before are done, writes queued after wait for it.
+        EFileSyncMode syncMode{EFileSyncMode::None};
+
+        NODISCARD FORCEINLINE EFilePriority GetPriority() const
+        {
+            return control ? control->GetPriority() : priority;
+        }
+
+        NODISCARD FORCEINLINE bool IsCancelRequested() const
+        {
+            return control && control->IsCancelRequested();
+        }
 
         // Indicates status is good (no error)
         uint8_t  bOK             :  1{true};
@@ -39,6 +120,5 @@ namespace Koala::FileIO
         uint8_t  bFinished       :  1{false};
         uint8_t  bCanceled       :  1{false};
         uint8_t  bCompleted      :  1{false};
-        uint8_t  bCancelRequested:  1{false};
     };
 }
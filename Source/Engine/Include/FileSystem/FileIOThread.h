@@ -20,8 +20,15 @@
 
 #include "Core/ThreadInterface.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <memory>
 
+#include "FileIOBackend.h"
+#include "FileIOScheduler.h"
+#include "FileIOStats.h"
 #include "FileIOTask.h"
 #include "TSContainer/QueueTS.h"
 
@@ -31,7 +38,10 @@ namespace Koala::FileIO
     {
     public:
         FileIOThread() = default;
-        explicit FileIOThread(bool bInIsReadThread): bIsReadThread(bInIsReadThread) {}
+        // Threads given a scheduler pull their tasks from it, instead of own queue.
+        explicit FileIOThread(bool bInIsReadThread, EFileIOBackend inBackendType = EFileIOBackend::Synchronous, uint32_t inQueueDepth = 1,
+            FileIOScheduler *inScheduler = nullptr):
+            bIsReadThread(bInIsReadThread), backendType(inBackendType), queueDepth(inQueueDepth), scheduler(inScheduler) {}
 
         void Run() override;
         NODISCARD size_t GetQueueLength() const
@@ -39,16 +49,27 @@ namespace Koala::FileIO
             return atomicTQLength.load();
         }
 
-        void GetFinishedTasks(std::list<FileIOTask> &v)
-        {
-            std::lock_guard lock(mutexFinishedTaskList);
-            v.swap(finishedTasks);
-        }
-        
         void PushTask(FileIOTask &&);
+        // Run work on this thread before its next I/O batch, e.g. a batch of file open/stat requests.
+        void PushWork(std::function<void()> &&work);
+        // Wake thread up if it is sleeping, return false if it was already awake.
+        bool WakeUp();
         void ShutdownIOThread();
         void DoWork();
 
+        // Replace the buffers registered to backend. Will be applied on I/O thread before next batch.
+        void SetRegisteredBuffers(const std::vector<FileIOBufferSpan> &inBuffers);
+
+        NODISCARD const FileIOThreadStats& GetStats() const
+        {
+            return stats;
+        }
+
+        NODISCARD FileIOThreadStats& GetStats()
+        {
+            return stats;
+        }
+
         NODISCARD bool IsIOReadThread() const
         {
             return bIsReadThread;
@@ -59,19 +80,79 @@ namespace Koala::FileIO
             return !IsIOReadThread();
         }
     protected:
-        std::queue<FileIOTask> taskQueue;
-        std::mutex             mutexTQ;
+        // Aligned bounce buffer of an unaligned direct I/O read.
+        struct DirectIOStaging
+        {
+            void   *buffer{nullptr};
+            bool    bPooled{false};
+            // Bytes before requested offset, read only to meet alignment.
+            int64_t headSize{0};
+            // Bytes to copy out into task buffer.
+            int64_t copySize{0};
+        };
 
-        std::list<FileIOTask> finishedTasks;
-        std::mutex            mutexFinishedTaskList;
+        void ApplyRegisteredBuffers();
+        // Append spans of task not written yet to batchGatherSpans, fill request with them.
+        void PrepareGatherWrite(const FileIOTask &task, FileIORequest &request);
+        NODISCARD bool IsWriteUnfinished(NativeFileHandle nativeHandle) const
+        {
+            return std::find(batchUnfinishedWriteHandles.begin(), batchUnfinishedWriteHandles.end(), nativeHandle) != batchUnfinishedWriteHandles.end();
+        }
+        void RunPendingWork();
+        // Fill batchTasks, return false if thread should go to sleep.
+        bool TakeBatchFromQueue();
+        bool TakeBatchFromScheduler();
+        // Set awake signal and wake thread from sleep or throttle wait.
+        void SignalAwake();
+        // Redirect unaligned direct I/O read into an aligned staging buffer (head/tail fix-up).
+        void PrepareDirectIORead(FileIORequest &request, DirectIOStaging &staging);
+        // Copy staged data out to task buffer, return number of requested bytes got.
+        int64_t FinishDirectIORead(const FileIORequest &request, DirectIOStaging &staging, void *taskBuffer);
+
+        // Unfinished tasks go back to front, so that writes and sync barriers keep their order.
+        std::deque<FileIOTask> taskQueue;
+        std::mutex             mutexTQ;
 
         std::atomic<size_t>     atomicTQLength;
 
+        std::vector<std::function<void()>> pendingWork;
+        std::mutex                         mutexPendingWork;
+        std::atomic<size_t>                numPendingWork{0};
+
         bool bIsReadThread{true};
 
+        // Backend is created on I/O thread itself (io_uring rings are per-thread).
+        std::unique_ptr<IFileIOBackend> backend;
+        EFileIOBackend backendType{EFileIOBackend::Synchronous};
+        uint32_t       queueDepth{1};
+        FileIOScheduler *scheduler{nullptr};
+
+        // Storage reused across batches.
+        std::vector<FileIOTask>    batchTasks;
+        std::vector<FileIORequest> batchRequests;
+        std::vector<size_t>        batchRequestTaskIndices;
+        std::vector<DirectIOStaging> batchStagings;
+        // Spans of gather write requests, batchGatherSpanStarts[i] is first span of batchRequests[i].
+        std::vector<FileIOBufferSpan> batchGatherSpans;
+        std::vector<size_t>        batchGatherSpanStarts;
+        // Files with a write not completed by this batch. Their later writes and syncs wait for the next one.
+        std::vector<NativeFileHandle> batchUnfinishedWriteHandles;
+
+        std::vector<FileIOBufferSpan> pendingRegisteredBuffers;
+        bool                          bRegisteredBuffersDirty{false};
+        std::mutex                    mutexRegisteredBuffers;
+
+        FileIOThreadStats stats;
+        // End of last request, to tell whether next one needs a seek.
+        NativeFileHandle  lastRequestHandle{InvalidNativeFileHandle};
+        int64_t           lastRequestEnd{-1};
+
         std::atomic<bool> atomicShouldShutdown{false};
 
         std::atomic<bool> atomicAwakeSignal{false};
+        // Timed wait of a thread throttled by scheduler, woken by SignalAwake().
+        std::mutex              mutexThrottle;
+        std::condition_variable cvThrottle;
     };
 
 }
@@ -18,7 +18,9 @@
 
 #pragma once
 
+#include <cstring>
 #include <fstream>
+#include <future>
 #include <utility>
 
 #include "Definations.h"
@@ -47,7 +49,12 @@ namespace Koala::FileIO
 
         NODISCARD FORCEINLINE bool IsValid() const
         {
-            return handle != nullptr && handle->IsValid();
+            return (handle != nullptr && handle->IsValid()) || mappedView != nullptr;
+        }
+
+        NODISCARD FORCEINLINE bool IsMapped() const
+        {
+            return mappedView != nullptr;
         }
 
         FORCEINLINE void Seek(size_t num)
@@ -66,7 +73,7 @@ namespace Koala::FileIO
         FORCEINLINE size_t GetFileSize() const
         {
             ensure(IsValid());
-            return handle->fileSize;
+            return mappedView ? mappedView->GetSize() : handle->fileSize;
         }
         
         template <typename T>
@@ -76,10 +83,12 @@ namespace Koala::FileIO
         }
 
         // This function is only intend to serialize small memory fields.
-        virtual void Serialize(void* buf, size_t size) = 0;
+        // Blocks until done, then moves offset forward. Return number of bytes transferred.
+        virtual size_t Serialize(void* buf, size_t size) = 0;
     
     protected:
         FileHandle              handle{nullptr};
+        MappedFileRef           mappedView{nullptr};
         size_t                  offset{0};
     };
 
@@ -101,16 +110,59 @@ namespace Koala::FileIO
             handle = FileManager::Get().OpenFileForRead(filePath, bOpenAsText ? EFileOpenMode::OpenFileAsText : EFileOpenMode::OpenFileAsBinary);
         }
 
+        // Read from a memory mapped view. ReadAsync() will be completed immediately by copying from the view,
+        // or use GetMappedRange() to parse data in place.
+        ReadFileStream(MappedFileRef inMappedView)
+        {
+            mappedView = std::move(inMappedView);
+        }
+
         inline void Initialize() override
         {}
         
-        FORCEINLINE ReadFileStream& ReadAsync(void* inBuffer, size_t inSize, FileIOCallback callback = nullptr)
+        FORCEINLINE ReadFileStream& ReadAsync(void* inBuffer, size_t inSize, FileIOCallback callback = nullptr,
+            EFileIOCompletionMode completionMode = EFileIOCompletionMode::MainThread)
         {
             ensure(IsValid());
-            FileIOManager::Get().RequestReadFileAsync(handle, offset, inSize, inBuffer, std::move(callback));
+            if (mappedView)
+            {
+                const size_t copySize = offset < mappedView->GetSize() ? std::min(inSize, mappedView->GetSize() - offset) : 0;
+                if (copySize > 0)
+                    std::memcpy(inBuffer, mappedView->GetData() + offset, copySize);
+                if (callback)
+                    callback(copySize == inSize, static_cast<int64_t>(copySize), inBuffer);
+                return *this;
+            }
+            FileIOManager::Get().RequestReadFileAsync(handle, offset, inSize, inBuffer, std::move(callback), completionMode);
             return *this;
         }
 
+        // Pointer to [Tell(), Tell() + inSize) of mapped view, without any copy.
+        // Return nullptr if stream is not mapped, or range is out of file.
+        NODISCARD FORCEINLINE const uint8_t* GetMappedRange(size_t inSize) const
+        {
+            return mappedView ? mappedView->GetRange(offset, inSize) : nullptr;
+        }
+
+        // Hint OS to load the range which will be read soon.
+        FORCEINLINE void Prefetch(size_t inOffset, size_t inSize) const
+        {
+            if (mappedView)
+                mappedView->Prefetch(inOffset, inSize);
+        }
+
+        size_t Serialize(void* buf, size_t size) override
+        {
+            std::promise<size_t> promise;
+            std::future<size_t> future = promise.get_future();
+            ReadAsync(buf, size, [&promise](bool bOk, int64_t readSize, const void*)
+            {
+                promise.set_value(bOk && readSize > 0 ? static_cast<size_t>(readSize) : 0);
+            }, EFileIOCompletionMode::IOThread);
+            const size_t readSize = FileIOManager::Get().WaitForResult(future);
+            offset += readSize;
+            return readSize;
+        }
 
     };
 
@@ -123,11 +175,34 @@ namespace Koala::FileIO
         {
             handle = FileManager::Get().OpenFileForWrite(filePath, bOpenAsText ? EFileOpenMode::OpenFileAsText : EFileOpenMode::OpenFileAsBinary);
         }
-        FORCEINLINE WriteFileStream& WriteAsync(const void* inBuffer, size_t inSize, FileIOCallback callback = nullptr)
+        FORCEINLINE WriteFileStream& WriteAsync(const void* inBuffer, size_t inSize, FileIOCallback callback = nullptr,
+            EFileIOCompletionMode completionMode = EFileIOCompletionMode::MainThread)
         {
             ensure(IsValid());
-            FileIOManager::Get().RequestWriteFileAsync(handle, offset, inSize, inBuffer, callback);
+            FileIOManager::Get().RequestWriteFileAsync(handle, offset, inSize, inBuffer, callback, completionMode);
             return *this;
         }
+
+        // Write all spans back to back from Tell() in one request.
+        FORCEINLINE WriteFileStream& WriteGatherAsync(std::vector<FileIOBufferSpan> spans, FileIOCallback callback = nullptr,
+            EFileIOCompletionMode completionMode = EFileIOCompletionMode::MainThread)
+        {
+            ensure(IsValid());
+            FileIOManager::Get().RequestWriteGatherAsync(handle, offset, std::move(spans), std::move(callback), completionMode);
+            return *this;
+        }
+
+        size_t Serialize(void* buf, size_t size) override
+        {
+            std::promise<size_t> promise;
+            std::future<size_t> future = promise.get_future();
+            WriteAsync(buf, size, [&promise](bool bOk, int64_t writtenSize, const void*)
+            {
+                promise.set_value(bOk && writtenSize > 0 ? static_cast<size_t>(writtenSize) : 0);
+            }, EFileIOCompletionMode::IOThread);
+            const size_t writtenSize = FileIOManager::Get().WaitForResult(future);
+            offset += writtenSize;
+            return writtenSize;
+        }
     };
 }
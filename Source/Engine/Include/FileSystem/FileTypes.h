@@ -0,0 +1,87 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <cstdint>
+
+namespace Koala::FileIO
+{
+    enum EFileOpenMode
+    {
+        OpenFileAsBinary = 1 << 0,
+        OpenFileAsText   = 1 << 1,
+        OpenFileAtAppend = 1 << 2,
+        OpenFileForRead   = 1 << 3,
+        OpenFileForWrite  = 1 << 4,
+        // Bypass OS page cache (O_DIRECT). Only for reading, I/O threads take care of alignment.
+        OpenFileUnbuffered = 1 << 5,
+    };
+    typedef uint32_t EOpenFileModes;
+
+    // Offset, size and buffer alignment required by unbuffered I/O.
+    constexpr int64_t DirectIOAlignment = 4096;
+
+    enum class EFilePriority
+    {
+        Highest = 5,
+        High    = 4,
+        Normal  = 3,
+        Low     = 2,
+        Lowest  = 1
+    };
+
+    // Access pattern hints for memory-mapped files (madvise).
+    enum class EMappedFileAccessHint: uint8_t
+    {
+        Normal,
+        Sequential,
+        Random,
+        // Start reading the whole mapping into page cache in background.
+        WillNeed,
+    };
+
+    // Durability barrier of written data.
+    enum class EFileSyncMode: uint8_t
+    {
+        None,
+        // File data and metadata needed to read it back (fdatasync).
+        Data,
+        // File data and all metadata (fsync).
+        Full,
+    };
+
+    // File system metadata of a path.
+    struct FileStat
+    {
+        bool    bExists{false};
+        bool    bIsDirectory{false};
+        int64_t size{0};
+        // Last modification time, in seconds since epoch.
+        int64_t modifiedTime{0};
+    };
+
+#ifdef _WIN32
+    // HANDLE of Win32 file. INVALID_HANDLE_VALUE is translated to nullptr by PlatformFile::Open.
+    typedef void* NativeFileHandle;
+    constexpr NativeFileHandle InvalidNativeFileHandle = nullptr;
+#else
+    // POSIX file descriptor.
+    typedef int NativeFileHandle;
+    constexpr NativeFileHandle InvalidNativeFileHandle = -1;
+#endif
+}
@@ -0,0 +1,64 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <memory>
+
+#include "Definations.h"
+#include "FileTypes.h"
+#include "Core/HashedString.h"
+
+namespace Koala::FileIO
+{
+    // Read-only memory mapped view of a whole file. Created by FileManager::MapFileForRead.
+    // The view is shared by all users mapping the same file, and unmapped when last reference released.
+    // Data can be parsed in place, no copy into intermediate buffers is needed.
+    class MappedFileView
+    {
+    public:
+        MappedFileView(HashedString inFileName, const void *inData, size_t inSize):
+            fileName(inFileName), data(static_cast<const uint8_t*>(inData)), size(inSize) {}
+        ~MappedFileView();
+
+        MappedFileView(const MappedFileView&) = delete;
+        MappedFileView& operator=(const MappedFileView&) = delete;
+
+        NODISCARD FORCEINLINE const uint8_t* GetData() const { return data; }
+        NODISCARD FORCEINLINE size_t GetSize() const { return size; }
+        NODISCARD FORCEINLINE HashedString GetFileName() const { return fileName; }
+
+        // Return pointer to [offset, offset + inSize), or nullptr if out of range.
+        NODISCARD FORCEINLINE const uint8_t* GetRange(size_t offset, size_t inSize) const
+        {
+            if (offset > size || inSize > size - offset)
+                return nullptr;
+            return data + offset;
+        }
+
+        // Apply access pattern hint to whole view.
+        void Advise(EMappedFileAccessHint hint);
+        // Ask OS to start reading given range into memory, before it is touched.
+        void Prefetch(size_t offset, size_t inSize);
+    private:
+        HashedString   fileName;
+        const uint8_t *data{nullptr};
+        size_t         size{0};
+    };
+
+    typedef std::shared_ptr<MappedFileView> MappedFileRef;
+}
@@ -0,0 +1,118 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Definations.h"
+#include "FileTypes.h"
+#include "Compression/BlockCompression.h"
+#include "Core/HashedString.h"
+
+namespace Koala::FileIO
+{
+    // Pak layout:
+    //   PakFileHeader
+    //   Entry data, each entry aligned to its own alignment
+    //   TOC: PakEntry[numEntries], then entry paths (uint32 length + chars) in the same order
+    // Compressed entries are stored as block compressed streams (see BlockCompression.h).
+    constexpr uint32_t PakFileMagic = 0x4B41504B; // "KPAK"
+    constexpr uint32_t PakFileVersion = 2;
+    constexpr uint32_t DefaultPakEntryAlignment = 16;
+
+    struct PakFileHeader
+    {
+        uint32_t magic{PakFileMagic};
+        uint32_t version{PakFileVersion};
+        uint32_t numEntries{0};
+        uint32_t reserved{0};
+        uint64_t tocOffset{0};
+        uint64_t tocSize{0};
+    };
+    static_assert(sizeof(PakFileHeader) == 32);
+
+    struct PakEntry
+    {
+        // HashedString hash of entry path.
+        uint64_t pathHash{0};
+        // Offset from start of pak.
+        uint64_t offset{0};
+        // Bytes stored in pak, differs from size if entry is compressed.
+        uint64_t storedSize{0};
+        uint64_t size{0};
+        uint32_t alignment{DefaultPakEntryAlignment};
+        ECompressionMethod compression{ECompressionMethod::None};
+        uint8_t  padding[3]{};
+    };
+    static_assert(sizeof(PakEntry) == 40);
+
+    // Read-only, opened pak. The native handle is opened once and shared by all entries.
+    // Entries are normally accessed through FileManager::MountPak() and OpenFileForRead().
+    class PakFile
+    {
+    public:
+        ~PakFile();
+
+        // Open pak and load its TOC. Return nullptr if file is not a valid pak.
+        static std::shared_ptr<PakFile> Open(const std::string &path);
+
+        NODISCARD const PakEntry* FindEntry(HashedString entryPath) const;
+
+        NODISCARD FORCEINLINE HashedString GetPakPath() const { return pakPath; }
+        NODISCARD FORCEINLINE NativeFileHandle GetNativeHandle() const { return nativeHandle; }
+        NODISCARD FORCEINLINE size_t GetNumEntries() const { return entries.size(); }
+    private:
+        PakFile() = default;
+
+        HashedString     pakPath;
+        NativeFileHandle nativeHandle{InvalidNativeFileHandle};
+        std::unordered_map<HashedString, PakEntry> entries;
+    };
+
+    typedef std::shared_ptr<PakFile> PakFileRef;
+
+    // Builds a pak file. Used by cooking tools, entries are kept in memory until Write().
+    class PakWriter
+    {
+    public:
+        // Add entry from memory, replacing any entry of the same path.
+        // If compression does not make entry smaller, it is stored uncompressed.
+        void AddEntry(const std::string &entryPath, const void *data, size_t size,
+            uint32_t alignment = DefaultPakEntryAlignment, ECompressionMethod compression = ECompressionMethod::None,
+            uint32_t compressionBlockSize = DefaultCompressionBlockSize);
+        // Add entry from a file on disk.
+        bool AddFile(const std::string &entryPath, const std::string &diskPath,
+            uint32_t alignment = DefaultPakEntryAlignment, ECompressionMethod compression = ECompressionMethod::None,
+            uint32_t compressionBlockSize = DefaultCompressionBlockSize);
+
+        bool Write(const std::string &pakPath) const;
+    private:
+        struct PendingEntry
+        {
+            std::string path;
+            std::vector<uint8_t> data;
+            uint64_t size{0};
+            uint32_t alignment{DefaultPakEntryAlignment};
+            ECompressionMethod compression{ECompressionMethod::None};
+        };
+        std::vector<PendingEntry> entries;
+    };
+}
@@ -0,0 +1,55 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <string>
+
+#include "FileIOBackend.h"
+#include "FileTypes.h"
+
+namespace Koala::FileIO::PlatformFile
+{
+    // Thin wrapper of OS file APIs. All read/write functions are positional (pread/pwrite like),
+    // they don't touch any shared file cursor, so they can be called from multiple threads on the same handle.
+
+    // Open file by given mode. Return InvalidNativeFileHandle if failed.
+    // OpenFileForWrite will truncate the file unless OpenFileAtAppend is set.
+    NativeFileHandle Open(const std::string &path, EOpenFileModes openMode);
+    void Close(NativeFileHandle handle);
+
+    // Return -1 if failed.
+    int64_t GetFileSize(NativeFileHandle handle);
+    // Query metadata by path without opening the file. Return false if path does not exist or cannot be queried.
+    bool Stat(const std::string &path, FileStat &outStat);
+
+    // Return transferred bytes, 0 on EOF, or -1 on error.
+    int64_t ReadAt(NativeFileHandle handle, void *buffer, int64_t size, int64_t offset);
+    int64_t WriteAt(NativeFileHandle handle, const void *buffer, int64_t size, int64_t offset);
+    // Write spans back to back starting at offset. Same return value as WriteAt.
+    int64_t WriteGatherAt(NativeFileHandle handle, const FileIOBufferSpan *spans, uint32_t numSpans, int64_t offset);
+    // Flush written data to storage. Return false on error.
+    bool Sync(NativeFileHandle handle, EFileSyncMode syncMode);
+
+    // Map whole file as read-only memory. The native handle can be closed after mapping.
+    // Return nullptr if failed.
+    const void* MapReadOnly(NativeFileHandle handle, size_t size);
+    void Unmap(const void *mappedPtr, size_t size);
+    // Apply hint to [offset, offset + size) of a mapping. Range is expanded to page boundary.
+    void AdviseMapped(const void *mappedPtr, size_t offset, size_t size, EMappedFileAccessHint hint);
+    size_t GetPageSize();
+}
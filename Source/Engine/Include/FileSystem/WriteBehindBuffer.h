@@ -0,0 +1,73 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <mutex>
+#include <vector>
+
+#include "File.h"
+#include "FileIOTask.h"
+
+namespace Koala::FileIO
+{
+    // Collects small sequential writes of one file (logs, save games) and writes them out as one gather write,
+    // once pending bytes reach flush size, or oldest pending byte is older than flush interval.
+    // Created by FileIOManager::CreateWriteBehindBuffer(), which checks flush interval on every tick.
+    // Remaining data is flushed when buffer is destroyed. Thread-safe.
+    class WriteBehindBuffer
+    {
+    public:
+        WriteBehindBuffer(FileHandle inHandle, size_t startOffset, size_t inFlushSize, FileIOClock::duration inFlushInterval):
+            handle(std::move(inHandle)), offset(startOffset), flushSize(inFlushSize), flushInterval(inFlushInterval) {}
+        ~WriteBehindBuffer();
+
+        WriteBehindBuffer(const WriteBehindBuffer&) = delete;
+        WriteBehindBuffer& operator=(const WriteBehindBuffer&) = delete;
+
+        // Data is copied, caller's buffer can be reused right away.
+        void Append(const void *data, size_t size);
+        // Data is taken over without copy.
+        void Append(std::vector<uint8_t> &&data);
+
+        // Write out pending data now. Callback is invoked once it is written (to OS cache, not storage).
+        void Flush(FileIOCallback callback = nullptr, EFileIOCompletionMode completionMode = EFileIOCompletionMode::MainThread);
+        // Write out pending data, then make it durable. Callback is invoked after sync.
+        void FlushAndSync(EFileSyncMode syncMode = EFileSyncMode::Data, FileIOCallback callback = nullptr,
+            EFileIOCompletionMode completionMode = EFileIOCompletionMode::MainThread);
+        void FlushIfDue(FileIOClock::time_point now);
+
+        NODISCARD size_t GetPendingSize() const;
+        // Offset next appended byte will be written at.
+        NODISCARD size_t GetOffset() const;
+        NODISCARD const FileHandle& GetFileHandle() const { return handle; }
+    private:
+        // Requires mutex held. Does nothing if no data is pending, callback is only for the issued write.
+        void FlushLocked(FileIOCallback callback, EFileIOCompletionMode completionMode);
+
+        FileHandle            handle;
+        size_t                offset{0};
+        size_t                flushSize{0};
+        FileIOClock::duration flushInterval{};
+
+        // Small appends are packed into chunks, large ones are kept as they are.
+        std::vector<std::vector<uint8_t>> chunks;
+        size_t                  pendingSize{0};
+        FileIOClock::time_point firstPendingTime;
+        mutable std::mutex      mutex;
+    };
+}
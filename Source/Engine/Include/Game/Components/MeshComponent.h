@@ -15,20 +15,25 @@
 //OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
 //WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
 //CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
 #pragma once
-#include "Component.h"
+#include <vector>
+
+#include "Asset/AssetManager.h"
 #include "Asset/MeshAsset.h"
 
 namespace Koala
 {
-    class MeshComponent: Component
-    {
-    public:
-        void PreLoad() override {}
-        void DoLoad() override;
-        void PostLoad() override {}
+    class EntityWorld;
 
-    protected:
-        std::vector<std::shared_ptr<MeshAsset>> meshes;
+    // Meshes of entity, loaded from paths set by game code.
+    struct MeshComponent
+    {
+        std::vector<HashedString>            meshPaths;
+        // Requested by LoadMeshComponents(), filled in asynchronously.
+        std::vector<TAssetHandle<MeshAsset>> meshes;
     };
+
+    // Request meshes of mesh components that have paths but no meshes requested yet.
+    void LoadMeshComponents(EntityWorld &world);
 }
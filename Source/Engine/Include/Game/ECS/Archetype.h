@@ -0,0 +1,112 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+#include "ComponentType.h"
+#include "Entity.h"
+
+namespace Koala
+{
+    // Chunks are small enough to stay in L1/L2 while iterated and large enough for a few hundred entities.
+    constexpr uint32_t ArchetypeChunkSize = 16 * 1024;
+    // Chunks start on cache line, component arrays are aligned to their type, at most this.
+    constexpr uint32_t ArchetypeChunkAlignment = 64;
+
+    class Archetype;
+
+    struct EntityLocation
+    {
+        Archetype *archetype{nullptr};
+        uint32_t   chunk{0};
+        uint32_t   row{0};
+    };
+
+    // All entities with the same set of component types. They are stored in chunks of ArchetypeChunkSize bytes,
+    // each holding up to GetChunkCapacity() entities as arrays: entity handles, then one array per component type.
+    // Entities are kept packed, removing one moves the last entity of the last chunk into its place.
+    class Archetype
+    {
+    public:
+        explicit Archetype(const ComponentMask &inMask);
+        ~Archetype();
+        Archetype(const Archetype&) = delete;
+        Archetype& operator=(const Archetype&) = delete;
+
+        NODISCARD FORCEINLINE const ComponentMask& GetMask() const { return mask; }
+        NODISCARD FORCEINLINE bool HasComponent(ComponentTypeId typeId) const { return mask.test(typeId); }
+        // Component type ids in ascending order.
+        NODISCARD FORCEINLINE const std::vector<ComponentTypeId>& GetComponentTypes() const { return componentTypes; }
+        NODISCARD FORCEINLINE uint32_t GetChunkCapacity() const { return chunkCapacity; }
+        NODISCARD FORCEINLINE uint32_t GetNumChunks() const { return static_cast<uint32_t>(chunks.size()); }
+        NODISCARD FORCEINLINE uint32_t GetNumEntitiesInChunk(uint32_t chunk) const { return chunks[chunk].numEntities; }
+        NODISCARD FORCEINLINE size_t GetNumEntities() const { return numEntities; }
+
+        NODISCARD FORCEINLINE Entity* GetEntityArray(uint32_t chunk) const
+        {
+            return reinterpret_cast<Entity*>(chunks[chunk].data);
+        }
+        // Array of components of type in chunk, GetNumEntitiesInChunk() long. Type must be in archetype.
+        NODISCARD FORCEINLINE void* GetComponentArray(uint32_t chunk, ComponentTypeId typeId) const
+        {
+            return chunks[chunk].data + componentOffsets[componentColumns[typeId]];
+        }
+        template <typename T>
+        NODISCARD FORCEINLINE T* GetComponentArray(uint32_t chunk) const
+        {
+            return static_cast<T*>(GetComponentArray(chunk, GetComponentTypeId<T>()));
+        }
+        NODISCARD FORCEINLINE void* GetComponent(const EntityLocation &location, ComponentTypeId typeId) const
+        {
+            return static_cast<uint8_t*>(GetComponentArray(location.chunk, typeId)) +
+                static_cast<size_t>(location.row) * ComponentTypeRegistry::GetInfo(typeId).size;
+        }
+
+        // Append entity with its components left uninitialized, return where it went.
+        EntityLocation Allocate(Entity entity);
+        // Destruct components of entity at location and move last entity into its place. Return moved entity,
+        // invalid if the removed one was last.
+        Entity Remove(const EntityLocation &location);
+
+    private:
+        friend class EntityWorld;
+
+        struct Chunk
+        {
+            uint8_t *data{nullptr};
+            uint32_t numEntities{0};
+        };
+
+        ComponentMask                mask;
+        std::vector<ComponentTypeId> componentTypes;
+        // Offset of array of each of componentTypes in chunk.
+        std::vector<uint32_t>        componentOffsets;
+        // Index into componentTypes by type id, only valid for types in mask.
+        std::array<uint16_t, MaxComponentTypes> componentColumns{};
+        std::vector<Chunk>           chunks;
+        uint32_t                     chunkCapacity{0};
+        size_t                       numEntities{0};
+
+        // Archetypes with one component type added or removed, filled in by EntityWorld as entities change.
+        std::unordered_map<ComponentTypeId, Archetype*> addEdges;
+        std::unordered_map<ComponentTypeId, Archetype*> removeEdges;
+    };
+}
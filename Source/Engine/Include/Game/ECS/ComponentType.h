@@ -0,0 +1,104 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <bitset>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+#include "Definations.h"
+
+namespace Koala
+{
+    using ComponentTypeId = uint32_t;
+    constexpr uint32_t MaxComponentTypes = 256;
+    // Set of component types, one bit per type id. Each archetype has its own.
+    using ComponentMask = std::bitset<MaxComponentTypes>;
+
+    // How components of a type are laid out and moved around in chunks, without knowing the type.
+    struct ComponentTypeInfo
+    {
+        const char *name{nullptr};
+        // 0 for empty (tag) types, which take no space in chunks.
+        uint32_t    size{0};
+        uint32_t    alignment{1};
+        // Trivially copyable and destructible, moved with memcpy and never destructed.
+        bool        bTrivial{false};
+        void      (*defaultConstruct)(void *dest){nullptr};
+        // Move construct dest from source, source is left to be destructed.
+        void      (*moveConstruct)(void *dest, void *source){nullptr};
+        void      (*destruct)(void *component){nullptr};
+    };
+
+    class ComponentTypeRegistry
+    {
+    public:
+        // Assign next type id, aborts beyond MaxComponentTypes. Thread safe.
+        static ComponentTypeId Register(const ComponentTypeInfo &info);
+        NODISCARD static const ComponentTypeInfo& GetInfo(ComponentTypeId typeId);
+        NODISCARD static uint32_t GetNumTypes();
+    };
+
+    template <typename T>
+    ComponentTypeInfo MakeComponentTypeInfo()
+    {
+        static_assert(std::is_default_constructible_v<T> && std::is_move_constructible_v<T>,
+            "Components must be default and move constructible");
+        ComponentTypeInfo info;
+#if defined(__GNUC__) || defined(__clang__)
+        info.name = __PRETTY_FUNCTION__;
+#else
+        info.name = __FUNCSIG__;
+#endif
+        if constexpr (!std::is_empty_v<T>)
+        {
+            info.size = sizeof(T);
+            info.alignment = alignof(T);
+            info.bTrivial = std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>;
+            info.defaultConstruct = [](void *dest) { new (dest) T(); };
+            info.moveConstruct = [](void *dest, void *source) { new (dest) T(std::move(*static_cast<T*>(source))); };
+            info.destruct = [](void *component) { static_cast<T*>(component)->~T(); };
+        }
+        return info;
+    }
+
+    // Id of component type, assigned on first use. Const qualified types share id with the plain type.
+    template <typename T>
+    ComponentTypeId GetComponentTypeId()
+    {
+        using ComponentType = std::remove_cvref_t<T>;
+        if constexpr (!std::is_same_v<T, ComponentType>)
+        {
+            return GetComponentTypeId<ComponentType>();
+        }
+        else
+        {
+            static const ComponentTypeId typeId = ComponentTypeRegistry::Register(MakeComponentTypeInfo<ComponentType>());
+            return typeId;
+        }
+    }
+
+    template <typename... Ts>
+    ComponentMask MakeComponentMask()
+    {
+        ComponentMask mask;
+        (mask.set(GetComponentTypeId<Ts>()), ...);
+        return mask;
+    }
+}
@@ -1,4 +1,4 @@
-﻿//Copyright 2024 Li Xingru
+//Copyright 2024 Li Xingru
 //
 //Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
 //associated documentation files (the “Software”), to deal in the Software without restriction,
@@ -15,28 +15,22 @@
 //OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
 //WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
 //CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
 #pragma once
-#include <forward_list>
+#include <cstdint>
 
-#include "Event.h"
-#include "Asset/Asset.h"
-#include "Asset/MeshAsset.h"
+#include "Definations.h"
 
 namespace Koala
 {
-    class Actor
+    // Handle of entity in EntityWorld. Index slots are reused, generation tells handles of destroyed entities apart.
+    struct Entity
     {
-    public:
-        virtual ~Actor() {}
-        
-        virtual void PreLoad() {}
-        virtual void DuringLoad() {}
-        virtual void PostLoad() {}
-        
-        virtual void OnPlay() {}
-        virtual void OnEvent(Event event) {}
+        uint32_t index{0};
+        // 0 never belongs to a live entity, so default constructed handle is invalid.
+        uint32_t generation{0};
 
-    private:
-        std::shared_ptr<MeshAsset> mesh;
+        NODISCARD FORCEINLINE bool IsValid() const { return generation != 0; }
+        bool operator==(const Entity &other) const = default;
     };
 }
@@ -0,0 +1,311 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "Archetype.h"
+#include "Core/Check.h"
+
+namespace Koala
+{
+    template <typename... Ts>
+    class TQuery;
+
+    // Entities and their components, stored by archetype (set of component types) in chunks, see Archetype.
+    // Adding or removing components moves entity to another archetype. Structural changes (creating and destroying
+    // entities, adding and removing components) must not happen while a query iterates. Not thread safe, apart from
+    // parallel iteration of queries.
+    class EntityWorld
+    {
+    public:
+        EntityWorld() = default;
+        EntityWorld(const EntityWorld&) = delete;
+        EntityWorld& operator=(const EntityWorld&) = delete;
+
+        // Create entity with given components, each type at most once.
+        template <typename... Ts>
+        Entity CreateEntity(Ts&&... components);
+        void DestroyEntity(Entity entity);
+        // Destroy all entities, archetypes stay.
+        void Clear();
+        NODISCARD bool IsAlive(Entity entity) const;
+        NODISCARD FORCEINLINE size_t GetNumEntities() const { return numEntities; }
+
+        // Add component to entity, or assign it if entity already has one of its type.
+        // Tags (empty types) have no storage, for them a shared instance is returned.
+        template <typename T>
+        std::decay_t<T>& AddComponent(Entity entity, T &&component);
+        template <typename T>
+        void RemoveComponent(Entity entity);
+        // Component of entity, nullptr if entity has none of type or is not alive. Valid until next structural change.
+        template <typename T>
+        NODISCARD T* GetComponent(Entity entity) const;
+        template <typename T>
+        NODISCARD bool HasComponent(Entity entity) const;
+
+        // Archetypes are never removed, new ones are appended.
+        NODISCARD FORCEINLINE const std::vector<std::unique_ptr<Archetype>>& GetArchetypes() const { return archetypes; }
+
+        // Query of entities having all of Ts, const types are only read.
+        template <typename... Ts>
+        NODISCARD TQuery<Ts...> Query();
+        // Call fn(Ts&...) or fn(Entity, Ts&...) for each entity having all of Ts.
+        template <typename... Ts, typename Lambda>
+        void ForEach(Lambda &&fn);
+        // As ForEach(), chunks are split across worker threads.
+        template <typename... Ts, typename Lambda>
+        void ParallelForEach(Lambda &&fn);
+
+        // ParallelForRanges() over [0, numChunks), on worker threads if there are enough entities.
+        static void ForEachChunkRange(size_t numChunks, size_t numEntities, const std::function<void(size_t, size_t)> &rangeFunction);
+
+    private:
+        struct EntityRecord
+        {
+            EntityLocation location;
+            uint32_t       generation{1};
+        };
+
+        Archetype* GetOrCreateArchetype(const ComponentMask &mask);
+        Archetype* GetArchetypeWith(Archetype *archetype, ComponentTypeId typeId);
+        Archetype* GetArchetypeWithout(Archetype *archetype, ComponentTypeId typeId);
+        Entity AllocateEntity(Archetype *archetype);
+        // Move entity into archetype. Components both archetypes have are moved over, ones only in target are left
+        // uninitialized, the rest are destructed.
+        EntityLocation MoveEntity(Entity entity, Archetype *target);
+        void RemoveFromArchetype(const EntityLocation &location);
+
+        std::vector<EntityRecord>                       records;
+        std::vector<uint32_t>                           freeIndices;
+        std::vector<std::unique_ptr<Archetype>>         archetypes;
+        std::unordered_map<ComponentMask, Archetype*>   archetypeMap;
+        size_t                                          numEntities{0};
+    };
+
+    // Entities of one chunk matching query: entity handles and one array per queried type, numEntities long.
+    template <typename... Ts>
+    struct TQueryChunk
+    {
+        uint32_t          numEntities{0};
+        const Entity     *entities{nullptr};
+        std::tuple<Ts*...> components;
+
+        template <typename T>
+        NODISCARD FORCEINLINE T* Get() const { return std::get<T*>(components); }
+    };
+
+    // Entities having all of Ts, maybe more. Matching archetypes are cached, archetypes created since the query last
+    // ran are checked on next iteration, so long lived queries cost nothing to match.
+    template <typename... Ts>
+    class TQuery
+    {
+    public:
+        explicit TQuery(EntityWorld &inWorld)
+            : world(inWorld)
+            , mask(MakeComponentMask<Ts...>())
+        {}
+
+        NODISCARD FORCEINLINE EntityWorld& GetWorld() const { return world; }
+
+        // Match archetypes created since last update.
+        void Update()
+        {
+            const auto &archetypes = world.GetArchetypes();
+            for (; numArchetypesChecked < archetypes.size(); ++numArchetypesChecked)
+            {
+                Archetype *archetype = archetypes[numArchetypesChecked].get();
+                if ((archetype->GetMask() & mask) == mask)
+                    matches.push_back(archetype);
+            }
+        }
+
+        NODISCARD size_t GetNumEntities()
+        {
+            Update();
+            size_t numEntities = 0;
+            for (const Archetype *archetype : matches)
+                numEntities += archetype->GetNumEntities();
+            return numEntities;
+        }
+
+        // Call fn(const TQueryChunk<Ts...>&) for each chunk.
+        template <typename Lambda>
+        void ForEachChunk(Lambda &&fn)
+        {
+            Update();
+            for (Archetype *archetype : matches)
+            {
+                for (uint32_t chunk = 0; chunk < archetype->GetNumChunks(); ++chunk)
+                    fn(MakeChunk(archetype, chunk));
+            }
+        }
+
+        // Call fn(Ts&...) or fn(Entity, Ts&...) for each entity.
+        template <typename Lambda>
+        void ForEach(Lambda &&fn)
+        {
+            ForEachChunk([&fn](const TQueryChunk<Ts...> &chunk) { ForEachInChunk(chunk, fn); });
+        }
+
+        // As ForEachChunk(), chunks are split across worker threads. fn must only touch its chunk.
+        template <typename Lambda>
+        void ParallelForEachChunk(Lambda &&fn)
+        {
+            Update();
+            std::vector<std::pair<Archetype*, uint32_t>> chunks;
+            size_t numEntities = 0;
+            for (Archetype *archetype : matches)
+            {
+                for (uint32_t chunk = 0; chunk < archetype->GetNumChunks(); ++chunk)
+                    chunks.emplace_back(archetype, chunk);
+                numEntities += archetype->GetNumEntities();
+            }
+            EntityWorld::ForEachChunkRange(chunks.size(), numEntities, [&chunks, &fn](size_t first, size_t end)
+            {
+                for (size_t index = first; index < end; ++index)
+                    fn(MakeChunk(chunks[index].first, chunks[index].second));
+            });
+        }
+
+        // As ForEach(), chunks are split across worker threads. fn must only touch its entity.
+        template <typename Lambda>
+        void ParallelForEach(Lambda &&fn)
+        {
+            ParallelForEachChunk([&fn](const TQueryChunk<Ts...> &chunk) { ForEachInChunk(chunk, fn); });
+        }
+
+    private:
+        static TQueryChunk<Ts...> MakeChunk(Archetype *archetype, uint32_t chunk)
+        {
+            return {archetype->GetNumEntitiesInChunk(chunk), archetype->GetEntityArray(chunk),
+                std::tuple<Ts*...>(static_cast<Ts*>(archetype->GetComponentArray(chunk, GetComponentTypeId<Ts>()))...)};
+        }
+
+        template <typename Lambda>
+        static FORCEINLINE void ForEachInChunk(const TQueryChunk<Ts...> &chunk, Lambda &fn)
+        {
+            for (uint32_t row = 0; row < chunk.numEntities; ++row)
+            {
+                if constexpr (std::is_invocable_v<Lambda&, Entity, Ts&...>)
+                    fn(chunk.entities[row], std::get<Ts*>(chunk.components)[row]...);
+                else
+                    fn(std::get<Ts*>(chunk.components)[row]...);
+            }
+        }
+
+        EntityWorld            &world;
+        ComponentMask           mask;
+        std::vector<Archetype*> matches;
+        size_t                  numArchetypesChecked{0};
+    };
+
+    template <typename... Ts>
+    Entity EntityWorld::CreateEntity(Ts&&... components)
+    {
+        const ComponentMask mask = MakeComponentMask<std::decay_t<Ts>...>();
+        check(mask.count() == sizeof...(Ts), "Entity can not have two components of same type");
+        Archetype *archetype = GetOrCreateArchetype(mask);
+        const Entity entity = AllocateEntity(archetype);
+        const EntityLocation &location = records[entity.index].location;
+        ([&]()
+        {
+            using ComponentType = std::decay_t<Ts>;
+            if constexpr (!std::is_empty_v<ComponentType>)
+                new (archetype->GetComponent(location, GetComponentTypeId<ComponentType>())) ComponentType(std::forward<Ts>(components));
+        }(), ...);
+        return entity;
+    }
+
+    template <typename T>
+    std::decay_t<T>& EntityWorld::AddComponent(Entity entity, T &&component)
+    {
+        using ComponentType = std::decay_t<T>;
+        check(IsAlive(entity));
+        const ComponentTypeId typeId = GetComponentTypeId<ComponentType>();
+        EntityLocation location = records[entity.index].location;
+        if constexpr (std::is_empty_v<ComponentType>)
+        {
+            // Tags take no space in chunks, there is nothing to construct or assign.
+            static ComponentType tag;
+            if (!location.archetype->HasComponent(typeId))
+                MoveEntity(entity, GetArchetypeWith(location.archetype, typeId));
+            return tag;
+        }
+        else
+        {
+            if (location.archetype->HasComponent(typeId))
+            {
+                ComponentType *existing = static_cast<ComponentType*>(location.archetype->GetComponent(location, typeId));
+                *existing = std::forward<T>(component);
+                return *existing;
+            }
+            location = MoveEntity(entity, GetArchetypeWith(location.archetype, typeId));
+            return *new (location.archetype->GetComponent(location, typeId)) ComponentType(std::forward<T>(component));
+        }
+    }
+
+    template <typename T>
+    void EntityWorld::RemoveComponent(Entity entity)
+    {
+        const ComponentTypeId typeId = GetComponentTypeId<T>();
+        if (!IsAlive(entity) || !records[entity.index].location.archetype->HasComponent(typeId))
+            return;
+        MoveEntity(entity, GetArchetypeWithout(records[entity.index].location.archetype, typeId));
+    }
+
+    template <typename T>
+    T* EntityWorld::GetComponent(Entity entity) const
+    {
+        const ComponentTypeId typeId = GetComponentTypeId<T>();
+        if (!IsAlive(entity))
+            return nullptr;
+        const EntityLocation &location = records[entity.index].location;
+        if (!location.archetype->HasComponent(typeId))
+            return nullptr;
+        return static_cast<T*>(location.archetype->GetComponent(location, typeId));
+    }
+
+    template <typename T>
+    bool EntityWorld::HasComponent(Entity entity) const
+    {
+        return IsAlive(entity) && records[entity.index].location.archetype->HasComponent(GetComponentTypeId<T>());
+    }
+
+    template <typename... Ts>
+    TQuery<Ts...> EntityWorld::Query()
+    {
+        return TQuery<Ts...>(*this);
+    }
+
+    template <typename... Ts, typename Lambda>
+    void EntityWorld::ForEach(Lambda &&fn)
+    {
+        Query<Ts...>().ForEach(std::forward<Lambda>(fn));
+    }
+
+    template <typename... Ts, typename Lambda>
+    void EntityWorld::ParallelForEach(Lambda &&fn)
+    {
+        Query<Ts...>().ParallelForEach(std::forward<Lambda>(fn));
+    }
+}
@@ -0,0 +1,136 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "EntityWorld.h"
+
+namespace Koala
+{
+    // Component types a system reads and writes. Two systems conflict when one writes a type the other reads or
+    // writes, conflicting systems run in the order they were added.
+    struct SystemAccess
+    {
+        ComponentMask reads;
+        ComponentMask writes;
+        // Creates or destroys entities or adds or removes components, conflicts with every other system.
+        bool          bStructural{false};
+
+        template <typename... Ts>
+        SystemAccess& Read() { reads |= MakeComponentMask<Ts...>(); return *this; }
+        template <typename... Ts>
+        SystemAccess& Write() { writes |= MakeComponentMask<Ts...>(); return *this; }
+        // Access of TQuery<Ts...>: const types are read, others written.
+        template <typename... Ts>
+        SystemAccess& Query()
+        {
+            ([this]()
+            {
+                if constexpr (std::is_const_v<Ts>)
+                    Read<Ts>();
+                else
+                    Write<Ts>();
+            }(), ...);
+            return *this;
+        }
+
+        NODISCARD bool ConflictsWith(const SystemAccess &other) const
+        {
+            return bStructural || other.bStructural || (writes & (other.reads | other.writes)).any() || (reads & other.writes).any();
+        }
+    };
+
+    using SystemId = uint32_t;
+
+    struct SystemDesc
+    {
+        std::string  name;
+        SystemAccess access;
+        std::function<void(EntityWorld &world, float deltaTime)> update;
+        // Run on thread calling SystemScheduler::Run(), e.g. for systems touching engine state that is not thread safe.
+        bool         bCallingThread{false};
+    };
+
+    // Runs systems of a world each frame. Systems declare which component types they read and write, each Run()
+    // builds a dependency graph of enabled systems from that: a system waits for systems added before it that it
+    // conflicts with. Systems without dependencies between them run concurrently on worker threads, so the outcome
+    // is that of running them one by one in the order they were added. Calling thread runs systems too, when it
+    // has nothing else to do, so queries of a system running alone still spread over workers. Systems must only
+    // touch components they declared, and only structural systems may make structural changes to world.
+    class SystemScheduler
+    {
+    public:
+        SystemId AddSystem(SystemDesc desc);
+        // System calling fn(TQuery<Ts...> &query, float deltaTime), access follows from Ts. Query is kept between runs.
+        template <typename... Ts, typename Lambda>
+        SystemId AddQuerySystem(std::string name, Lambda &&fn);
+        void SetSystemEnabled(SystemId system, bool bEnabled);
+        NODISCARD bool IsSystemEnabled(SystemId system) const { return systems[system].bEnabled; }
+        NODISCARD uint32_t GetNumSystems() const { return static_cast<uint32_t>(systems.size()); }
+        NODISCARD const std::string& GetSystemName(SystemId system) const { return systems[system].desc.name; }
+        // Time last Run() spent in system, in milliseconds.
+        NODISCARD double GetLastSystemTime(SystemId system) const { return systems[system].lastTime; }
+
+        // Update enabled systems and wait for all of them. Runs them one by one when called from worker thread or
+        // without worker threads.
+        void Run(EntityWorld &world, float deltaTime);
+
+    private:
+        struct SystemState
+        {
+            SystemDesc            desc;
+            bool                  bEnabled{true};
+            double                lastTime{0.0};
+            // Per Run(): systems waiting for this one, and how many systems this one still waits for.
+            std::vector<uint32_t> dependents;
+            uint32_t              numPendingDependencies{0};
+        };
+
+        void RunSystem(SystemState &system, EntityWorld &world, float deltaTime);
+        // Mark system done and make systems waiting only for it ready. Under mutex.
+        void FinishSystem(uint32_t system);
+
+        std::vector<SystemState> systems;
+
+        std::mutex               mutex;
+        std::condition_variable  systemFinished;
+        std::vector<uint32_t>    readySystems;
+        uint32_t                 numUnfinishedSystems{0};
+    };
+
+    template <typename... Ts, typename Lambda>
+    SystemId SystemScheduler::AddQuerySystem(std::string name, Lambda &&fn)
+    {
+        SystemDesc desc;
+        desc.name = std::move(name);
+        desc.access.Query<Ts...>();
+        desc.update = [fn = std::forward<Lambda>(fn), query = std::optional<TQuery<Ts...>>()](EntityWorld &world, float deltaTime) mutable
+        {
+            if (!query || &query->GetWorld() != &world)
+                query.emplace(world);
+            fn(*query, deltaTime);
+        };
+        return AddSystem(std::move(desc));
+    }
+}
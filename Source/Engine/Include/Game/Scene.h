@@ -17,18 +17,22 @@
 //CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #pragma once
-#include <list>
-#include <memory>
-
-#include "Actor.h"
+#include "ECS/EntityWorld.h"
+#include "ECS/SystemScheduler.h"
 
 namespace Koala
 {
     class Scene {
     public:
-        void Load() {}
-        void Update(float deltaTime) {}
+        // Request assets of components.
+        void Load();
+        // Run systems on world.
+        void Update(float deltaTime);
+
+        NODISCARD FORCEINLINE EntityWorld& GetWorld() { return world; }
+        NODISCARD FORCEINLINE SystemScheduler& GetScheduler() { return scheduler; }
     protected:
-        std::list<std::shared_ptr<Actor>> actors;
+        EntityWorld     world;
+        SystemScheduler scheduler;
     };
 }
@@ -18,6 +18,7 @@
 
 #pragma once
 #include "AllocatorBase.h"
+#include <cstdlib>
 #include <unordered_map>
 #include <set>
 
@@ -39,6 +40,22 @@ namespace Koala {
         inline void Free(void *inPtr) override {
             ::free(inPtr);
         }
+        // Allocate memory aligned to inAlignment (power of two). Must be freed by FreeAligned().
+        inline void * MallocAligned(size_t inSize, size_t inAlignment) {
+#ifdef _WIN32
+            return ::_aligned_malloc(inSize, inAlignment);
+#else
+            // aligned_alloc requires size to be multiple of alignment.
+            return std::aligned_alloc(inAlignment, (inSize + inAlignment - 1) / inAlignment * inAlignment);
+#endif
+        }
+        inline void FreeAligned(void *inPtr) {
+#ifdef _WIN32
+            ::_aligned_free(inPtr);
+#else
+            ::free(inPtr);
+#endif
+        }
         void CreatePool(size_t inElementSize, size_t inMaxElementNumInPool);
 
         // This function will try to match the input size ('inSize') to some pool.
@@ -69,6 +86,12 @@ namespace Koala {
         inline void Free(void *inPtr) {
             MemoryAllocator::Get().Free(inPtr);
         }
+        inline void * MallocAligned(size_t inSize, size_t inAlignment) {
+            return MemoryAllocator::Get().MallocAligned(inSize, inAlignment);
+        }
+        inline void FreeAligned(void *inPtr) {
+            MemoryAllocator::Get().FreeAligned(inPtr);
+        }
         template<typename Type, typename... Args> Type* New(Args... args)
         {
             Type* memory = static_cast<Type*>(Malloc(sizeof(Type)));
@@ -0,0 +1,34 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include "Asset/MeshAsset.h"
+#include "Camera.h"
+
+namespace Koala::Renderer
+{
+    // Fraction of view height covered by diameter of a bounding sphere, 1 or more when it fills the view.
+    NODISCARD float ComputeScreenSize(const Camera &camera, const Vec3f &center, float radius);
+
+    // Coarsest LOD whose screen size threshold still covers given screen size.
+    // r.meshlod.bias shifts the choice by whole LODs, positive toward coarser ones; r.meshlod.force pins it when not negative.
+    NODISCARD uint32_t SelectMeshLOD(const MeshAsset &mesh, float screenSize);
+
+    // Bounds of mesh moved by translation and uniformly scaled, projected with camera.
+    NODISCARD uint32_t SelectMeshLOD(const MeshAsset &mesh, const Camera &camera, const Vec3f &translation, float scale = 1.0f);
+}
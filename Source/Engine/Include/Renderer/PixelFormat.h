@@ -19,6 +19,8 @@
 #pragma once
 #include <cstdint>
 
+#include "Definations.h"
+
 namespace Koala {
     enum EPixelFormat {
         PF_R8, // Single channel
@@ -33,11 +35,55 @@ namespace Koala {
         PF_R32G32,
         PF_R32G32B32,
         PF_R32G32B32A32,
-        // Compressed format, currectly not supported
+        // Block compressed formats, see Asset/TextureCompression.h. DXT1 is BC1, DXT3 BC2, DXT5 BC3.
         PF_DXT1,
         PF_DXT3,
         PF_DXT5,
         PF_BC5,
         PF_MAX
     };
+
+    // Compressed formats are stored in blocks of 4x4 pixels.
+    constexpr uint32_t PixelFormatCompressedBlockDim = 4;
+
+    NODISCARD constexpr bool IsBlockCompressedFormat(EPixelFormat format)
+    {
+        return format >= PF_DXT1 && format <= PF_BC5;
+    }
+
+    // Bytes of one pixel, or of one block of compressed format. 0 for invalid format.
+    NODISCARD constexpr uint32_t GetPixelFormatBlockBytes(EPixelFormat format)
+    {
+        switch (format)
+        {
+        case PF_R8: return 1;
+        case PF_R8G8: return 2;
+        case PF_R8G8B8: return 3;
+        case PF_R8G8B8A8: return 4;
+        case PF_R16: return 2;
+        case PF_R16G16: return 4;
+        case PF_R16G16B16: return 6;
+        case PF_R16G16B16A16: return 8;
+        case PF_R32: return 4;
+        case PF_R32G32: return 8;
+        case PF_R32G32B32: return 12;
+        case PF_R32G32B32A32: return 16;
+        case PF_DXT1: return 8;
+        case PF_DXT3: return 16;
+        case PF_DXT5: return 16;
+        case PF_BC5: return 16;
+        default: return 0;
+        }
+    }
+
+    // Bytes of width x height image, compressed formats are rounded up to whole blocks.
+    NODISCARD constexpr uint64_t ComputeImageSize(EPixelFormat format, uint32_t width, uint32_t height)
+    {
+        if (IsBlockCompressedFormat(format))
+        {
+            width = (width + PixelFormatCompressedBlockDim - 1) / PixelFormatCompressedBlockDim;
+            height = (height + PixelFormatCompressedBlockDim - 1) / PixelFormatCompressedBlockDim;
+        }
+        return static_cast<uint64_t>(width) * height * GetPixelFormatBlockBytes(format);
+    }
 }
@@ -0,0 +1,222 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Asset/AssetManager.h"
+
+#include <algorithm>
+
+#include "Config.h"
+#include "Asset/TextureResidencyManager.h"
+#include "AsyncWorker/AsyncTask.h"
+
+namespace Koala
+{
+    static Logger logger("AssetManager");
+
+    bool AssetManager::Initialize_MainThread()
+    {
+        memoryBudget = Config::Get().GetUIntSettingAndWriteDefault("asset.memorybudgetmb", 512, true) << 20;
+        return true;
+    }
+
+    bool AssetManager::Shutdown_MainThread()
+    {
+        // Loads in flight refer to entries and need I/O ticks to finish.
+        std::vector<std::shared_future<bool>> pendingLoads;
+        {
+            std::lock_guard lock(mutex);
+            for (const auto &[path, entry]: entries)
+            {
+                if (entry->state == EAssetLoadState::Loading)
+                    pendingLoads.push_back(entry->loadFuture);
+            }
+        }
+        for (const std::shared_future<bool> &future: pendingLoads)
+        {
+            FileIO::FileIOManager::Get().WaitForResult(future);
+        }
+
+        std::lock_guard lock(mutex);
+        size_t numReferenced = 0;
+        for (const auto &[path, entry]: entries)
+        {
+            numReferenced += entry.use_count() > 1;
+        }
+        if (numReferenced > 0)
+            logger.warning("{} assets are still referenced on shutdown", numReferenced);
+        entries.clear();
+        loadedMemory = 0;
+        return true;
+    }
+
+    void AssetManager::Tick_MainThread(float)
+    {
+        ++tickNumber;
+        {
+            std::lock_guard lock(mutex);
+            for (const auto &[path, entry]: entries)
+            {
+                if (entry->state != EAssetLoadState::Loaded)
+                    continue;
+                const size_t memorySize = entry->asset->GetMemorySize();
+                loadedMemory += memorySize;
+                loadedMemory -= entry->memorySize;
+                entry->memorySize = memorySize;
+            }
+        }
+        if (loadedMemory.load() > memoryBudget)
+            Evict(memoryBudget);
+    }
+
+    size_t AssetManager::GetNumAssets() const
+    {
+        std::lock_guard lock(mutex);
+        return entries.size();
+    }
+
+    std::shared_ptr<AssetEntry> AssetManager::FindOrAddEntry(HashedString path, std::type_index type,
+        const std::function<std::shared_ptr<IAsset>()> &createAsset, bool &bOutNewEntry)
+    {
+        bOutNewEntry = false;
+        std::lock_guard lock(mutex);
+        if (auto it = entries.find(path); it != entries.end())
+        {
+            const std::shared_ptr<AssetEntry> &entry = it->second;
+            if (entry->type != type)
+            {
+                logger.error("Asset {} is requested as {}, but it is already {}", path.GetString(), type.name(), entry->type.name());
+                return nullptr;
+            }
+            // Failed asset nobody holds is tried again, it may have been fixed on disk.
+            if (entry->state != EAssetLoadState::Failed || entry.use_count() > 1)
+            {
+                entry->lastRequestTick = tickNumber.load();
+                return entry;
+            }
+        }
+
+        auto entry = std::make_shared<AssetEntry>();
+        entry->path = path;
+        entry->type = type;
+        entry->asset = createAsset();
+        entry->asset->SetAssetFilePath(path);
+        entry->loadFuture = entry->loadPromise.get_future().share();
+        entry->lastRequestTick = tickNumber.load();
+        entries[path] = entry;
+        bOutNewEntry = true;
+        return entry;
+    }
+
+    void AssetManager::StartLoad(const std::shared_ptr<AssetEntry> &entry)
+    {
+        ++numLoading;
+        if (entry->asset->IsHardcodedAsset())
+        {
+            AsyncTask([this, entry](void*)
+            {
+                FinishLoad(entry, entry->asset->Initialize());
+            });
+            return;
+        }
+
+        FileIO::FileIOManager::Get().RequestOpenFileAsync(entry->path, FileIO::EFileOpenMode::OpenFileForRead | FileIO::EFileOpenMode::OpenFileAsBinary,
+            [this, entry](FileIO::FileHandle handle)
+            {
+                if (!handle || !handle->IsValid())
+                {
+                    logger.error("Failed to open asset {}", entry->path.GetString());
+                    FinishLoad(entry, false);
+                    return;
+                }
+                // Parsing waits for its reads, it is done on worker threads rather than holding an I/O thread.
+                AsyncTask([this, entry, handle](void*)
+                {
+                    ParseAsset(entry, handle);
+                });
+            }, FileIO::EFileIOCompletionMode::IOThread);
+    }
+
+    void AssetManager::ParseAsset(const std::shared_ptr<AssetEntry> &entry, FileIO::FileHandle handle)
+    {
+        bool bOk;
+        {
+            FileIO::ReadFileStream stream(handle);
+            bOk = entry->asset->LoadAsset(stream);
+        }
+        if (!bOk)
+            logger.error("Failed to load asset {}", entry->path.GetString());
+        FileIO::FileIOManager::Get().RequestCloseFileAsync(handle, nullptr, FileIO::EFileIOCompletionMode::IOThread);
+        FinishLoad(entry, bOk);
+    }
+
+    void AssetManager::FinishLoad(const std::shared_ptr<AssetEntry> &entry, bool bOk)
+    {
+        if (bOk)
+        {
+            entry->memorySize = entry->asset->GetMemorySize();
+            loadedMemory += entry->memorySize;
+            if (auto texture = std::dynamic_pointer_cast<TextureAsset>(entry->asset))
+                TextureResidencyManager::Get().Register(texture);
+        }
+        entry->state = bOk ? EAssetLoadState::Loaded : EAssetLoadState::Failed;
+        --numLoading;
+        entry->loadPromise.set_value(bOk);
+    }
+
+    size_t AssetManager::Evict(size_t targetBytes)
+    {
+        // Entries are released after unlocking, destroying assets may take a while.
+        std::vector<std::shared_ptr<AssetEntry>> evicted;
+        size_t freedBytes = 0;
+        {
+            std::lock_guard lock(mutex);
+            if (loadedMemory.load() <= targetBytes)
+                return 0;
+
+            // A handle can only be made under lock, so an entry held by map alone stays unreferenced while locked.
+            std::vector<std::shared_ptr<AssetEntry>> candidates;
+            for (const auto &[path, entry]: entries)
+            {
+                if (entry.use_count() == 1 && entry->state != EAssetLoadState::Loading)
+                    candidates.push_back(entry);
+            }
+            std::sort(candidates.begin(), candidates.end(), [](const std::shared_ptr<AssetEntry> &lhs, const std::shared_ptr<AssetEntry> &rhs)
+            {
+                return lhs->lastRequestTick < rhs->lastRequestTick;
+            });
+
+            for (std::shared_ptr<AssetEntry> &entry: candidates)
+            {
+                if (loadedMemory.load() <= targetBytes)
+                    break;
+                loadedMemory -= entry->memorySize;
+                freedBytes += entry->memorySize;
+                entries.erase(entry->path);
+                evicted.push_back(std::move(entry));
+            }
+        }
+        for (const std::shared_ptr<AssetEntry> &entry: evicted)
+        {
+            if (auto texture = dynamic_cast<const TextureAsset*>(entry->asset.get()))
+                TextureResidencyManager::Get().Unregister(texture);
+        }
+        if (!evicted.empty())
+            logger.debug("Evicted {} assets, {} KB", evicted.size(), freedBytes >> 10);
+        return freedBytes;
+    }
+}
@@ -0,0 +1,445 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Asset/DerivedDataCache.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <typeinfo>
+
+#include "Config.h"
+#include "Core/ContentHash.h"
+#include "Core/KoalaLogger.h"
+#include "FileSystem/File.h"
+#include "FileSystem/FileStream.h"
+
+constexpr const char *DerivedDataEntryExtension = ".ddc";
+constexpr const char *DerivedDataTemporaryExtension = ".tmp";
+
+namespace Koala
+{
+    static Logger logger("DerivedDataCache");
+
+    static bool ParseEntryFileName(const std::filesystem::path &filePath, uint64_t &outKey)
+    {
+        if (filePath.extension() != DerivedDataEntryExtension)
+            return false;
+        const std::string stem = filePath.stem().string();
+        if (stem.size() != 16)
+            return false;
+        const auto [end, error] = std::from_chars(stem.data(), stem.data() + stem.size(), outKey, 16);
+        return error == std::errc() && end == stem.data() + stem.size();
+    }
+
+    // Write file with build through FileIO, as bakes write assets.
+    static bool BuildFile(const std::filesystem::path &filePath, const std::function<bool(FileIO::WriteFileStream&)> &build)
+    {
+        FileIO::FileHandle handle = FileIO::FileManager::Get().OpenFileForWrite(HashedString(filePath.string()));
+        if (!handle)
+            return false;
+        FileIO::WriteFileStream stream(handle);
+        const bool bBuilt = build(stream);
+        FileIO::FileManager::Get().CloseFile(handle);
+        return bBuilt;
+    }
+
+    bool DerivedDataCache::Initialize_MainThread()
+    {
+        const std::string path = Config::Get().GetSettingAndWriteDefault("ddc.path", "Saved/DerivedDataCache", true);
+        const uint64_t maxSizeMB = Config::Get().GetUIntSettingAndWriteDefault("ddc.maxsizemb", 4096, true);
+        if (path.empty())
+        {
+            logger.info("Derived data cache is disabled");
+            return true;
+        }
+        // Bakes still work without cache, failing to open it is not fatal.
+        Open(path, maxSizeMB << 20);
+        return true;
+    }
+
+    bool DerivedDataCache::Shutdown_MainThread()
+    {
+        if (IsOpen())
+        {
+            const DerivedDataCacheStats stats = GetStats();
+            logger.info("Derived data cache: {} hits, {} misses, {} evicted, {} entries, {:.1f} MB",
+                stats.numHits, stats.numMisses, stats.numEvicted, stats.numEntries, stats.size / 1048576.0);
+        }
+        Close();
+        return true;
+    }
+
+    bool DerivedDataCache::Open(const std::filesystem::path &inDirectory, uint64_t inMaxSize)
+    {
+        std::error_code errorCode;
+        std::filesystem::create_directories(inDirectory, errorCode);
+        if (errorCode)
+        {
+            logger.error("Failed to create derived data cache directory {}: {}", inDirectory.string(), errorCode.message());
+            return false;
+        }
+
+        struct ScannedEntry
+        {
+            uint64_t key;
+            uint64_t size;
+            std::filesystem::file_time_type lastUse;
+        };
+        std::vector<ScannedEntry> scanned;
+        const auto now = std::filesystem::file_time_type::clock::now();
+        for (const auto &directoryEntry : std::filesystem::directory_iterator(inDirectory, errorCode))
+        {
+            std::error_code entryError;
+            if (!directoryEntry.is_regular_file(entryError))
+                continue;
+            const std::filesystem::path &filePath = directoryEntry.path();
+            const auto lastWrite = directoryEntry.last_write_time(entryError);
+            if (filePath.extension() == DerivedDataTemporaryExtension)
+            {
+                // Left by a writer which crashed. Recent ones may still be written by another process.
+                if (!entryError && now - lastWrite > std::chrono::hours(1))
+                    std::filesystem::remove(filePath, entryError);
+                continue;
+            }
+            uint64_t key;
+            const uint64_t entrySize = directoryEntry.file_size(entryError);
+            if (!entryError && ParseEntryFileName(filePath, key))
+                scanned.push_back({key, entrySize, lastWrite});
+        }
+        // Least recently used first, each one added goes in front of previous ones.
+        std::sort(scanned.begin(), scanned.end(), [](const ScannedEntry &a, const ScannedEntry &b) { return a.lastUse < b.lastUse; });
+
+        std::vector<uint64_t> victims;
+        uint64_t numEntries, openedSize;
+        {
+            std::scoped_lock lock(mutex);
+            directory = inDirectory;
+            maxSize = inMaxSize;
+            size = 0;
+            lruList.clear();
+            entries.clear();
+            std::random_device randomDevice;
+            instanceId = (static_cast<uint64_t>(randomDevice()) << 32) ^ randomDevice() ^
+                static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+            for (const ScannedEntry &entry : scanned)
+                AddEntry_Locked(entry.key, entry.size);
+            victims = Trim_Locked(maxSize);
+            numEntries = entries.size();
+            openedSize = size;
+        }
+        DeleteEntryFiles(victims);
+
+        logger.info("Opened derived data cache {}: {} entries, {:.1f} of {:.1f} MB",
+            inDirectory.string(), numEntries, openedSize / 1048576.0, inMaxSize / 1048576.0);
+        return true;
+    }
+
+    void DerivedDataCache::Close()
+    {
+        std::scoped_lock lock(mutex);
+        directory.clear();
+        lruList.clear();
+        entries.clear();
+        size = 0;
+    }
+
+    bool DerivedDataCache::IsOpen() const
+    {
+        std::scoped_lock lock(mutex);
+        return !directory.empty();
+    }
+
+    uint64_t DerivedDataCache::MakeKey(const IAsset &asset, uint64_t sourceHash)
+    {
+        // Type name differs between compilers, cache is local so that is fine.
+        const char *typeName = typeid(asset).name();
+        uint64_t key = HashMemory(typeName, strlen(typeName));
+        key = HashCombine(key, static_cast<uint64_t>(asset.GetBakeVersion()));
+        key = HashCombine(key, asset.GetBakeSettingsHash());
+        return HashCombine(key, sourceHash);
+    }
+
+    bool DerivedDataCache::Fetch(uint64_t key, const std::filesystem::path &destination)
+    {
+        std::filesystem::path entryPath;
+        if (!Touch(key, entryPath))
+        {
+            numMisses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        std::error_code errorCode;
+        std::filesystem::copy_file(entryPath, destination, std::filesystem::copy_options::overwrite_existing, errorCode);
+        if (errorCode)
+        {
+            std::error_code existsError;
+            if (std::filesystem::exists(entryPath, existsError))
+                logger.error("Failed to copy cached data to {}: {}", destination.string(), errorCode.message());
+            else
+                Forget(key);
+            numMisses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        FileIO::FileManager::Get().InvalidateFileStat(HashedString(destination.string()));
+        numHits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool DerivedDataCache::Get(uint64_t key, std::vector<uint8_t> &outData)
+    {
+        std::filesystem::path entryPath;
+        if (Touch(key, entryPath))
+        {
+            std::ifstream file(entryPath, std::ios::binary | std::ios::ate);
+            if (file.is_open())
+            {
+                outData.resize(static_cast<size_t>(file.tellg()));
+                file.seekg(0);
+                if (file.read(reinterpret_cast<char*>(outData.data()), static_cast<std::streamsize>(outData.size())))
+                {
+                    numHits.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+            Forget(key);
+        }
+        numMisses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    bool DerivedDataCache::Put(uint64_t key, const void *data, size_t dataSize)
+    {
+        if (!IsOpen())
+            return false;
+
+        const std::filesystem::path temporaryPath = MakeTemporaryPath(key);
+        bool bWritten;
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            bWritten = file.is_open() && file.write(static_cast<const char*>(data), static_cast<std::streamsize>(dataSize)).good();
+        }
+        if (!bWritten)
+        {
+            std::error_code errorCode;
+            std::filesystem::remove(temporaryPath, errorCode);
+            logger.error("Failed to write derived data {:016x}", key);
+            return false;
+        }
+        return Commit(key, temporaryPath);
+    }
+
+    bool DerivedDataCache::FetchOrBuild(uint64_t key, const std::filesystem::path &destination,
+        const std::function<bool(FileIO::WriteFileStream&)> &build, bool *bOutHit)
+    {
+        if (bOutHit)
+            *bOutHit = false;
+        if (!IsOpen())
+            return BuildFile(destination, build);
+
+        if (Fetch(key, destination))
+        {
+            if (bOutHit)
+                *bOutHit = true;
+            return true;
+        }
+
+        std::error_code errorCode;
+        const std::filesystem::path temporaryPath = MakeTemporaryPath(key);
+        if (!BuildFile(temporaryPath, build))
+        {
+            std::filesystem::remove(temporaryPath, errorCode);
+            return false;
+        }
+        // Copy out before commit, as the entry may be evicted right after it.
+        std::filesystem::copy_file(temporaryPath, destination, std::filesystem::copy_options::overwrite_existing, errorCode);
+        if (errorCode)
+        {
+            logger.error("Failed to copy built data to {}: {}", destination.string(), errorCode.message());
+            std::filesystem::remove(temporaryPath, errorCode);
+            return false;
+        }
+        FileIO::FileManager::Get().InvalidateFileStat(HashedString(destination.string()));
+        Commit(key, temporaryPath);
+        return true;
+    }
+
+    void DerivedDataCache::Trim(uint64_t targetSize)
+    {
+        std::vector<uint64_t> victims;
+        {
+            std::scoped_lock lock(mutex);
+            victims = Trim_Locked(targetSize);
+        }
+        DeleteEntryFiles(victims);
+    }
+
+    void DerivedDataCache::SetMaxSize(uint64_t inMaxSize)
+    {
+        std::vector<uint64_t> victims;
+        {
+            std::scoped_lock lock(mutex);
+            maxSize = inMaxSize;
+            victims = Trim_Locked(maxSize);
+        }
+        DeleteEntryFiles(victims);
+    }
+
+    DerivedDataCacheStats DerivedDataCache::GetStats() const
+    {
+        DerivedDataCacheStats stats;
+        stats.numHits = numHits.load(std::memory_order_relaxed);
+        stats.numMisses = numMisses.load(std::memory_order_relaxed);
+        stats.numEvicted = numEvicted.load(std::memory_order_relaxed);
+        std::scoped_lock lock(mutex);
+        stats.numEntries = entries.size();
+        stats.size = size;
+        return stats;
+    }
+
+    std::filesystem::path DerivedDataCache::GetDirectory() const
+    {
+        std::scoped_lock lock(mutex);
+        return directory;
+    }
+
+    std::filesystem::path DerivedDataCache::GetEntryPath(uint64_t key) const
+    {
+        return directory / fmt::format("{:016x}{}", key, DerivedDataEntryExtension);
+    }
+
+    std::filesystem::path DerivedDataCache::MakeTemporaryPath(uint64_t key)
+    {
+        const uint64_t counter = temporaryCounter.fetch_add(1, std::memory_order_relaxed);
+        std::scoped_lock lock(mutex);
+        return directory / fmt::format("{:016x}.{:016x}.{}{}", key, instanceId, counter, DerivedDataTemporaryExtension);
+    }
+
+    bool DerivedDataCache::Touch(uint64_t key, std::filesystem::path &outPath)
+    {
+        bool bIndexed;
+        {
+            std::scoped_lock lock(mutex);
+            if (directory.empty())
+                return false;
+            outPath = GetEntryPath(key);
+            auto it = entries.find(key);
+            bIndexed = it != entries.end();
+            if (bIndexed)
+                lruList.splice(lruList.begin(), lruList, it->second);
+        }
+
+        std::error_code errorCode;
+        if (!bIndexed)
+        {
+            // Another process sharing the directory may have added it. Found and indexed under lock, see DeleteEntryFiles().
+            std::scoped_lock lock(mutex);
+            const uint64_t entrySize = std::filesystem::file_size(outPath, errorCode);
+            if (errorCode)
+                return false;
+            AddEntry_Locked(key, entrySize);
+        }
+        std::filesystem::last_write_time(outPath, std::filesystem::file_time_type::clock::now(), errorCode);
+        return true;
+    }
+
+    void DerivedDataCache::Forget(uint64_t key)
+    {
+        std::scoped_lock lock(mutex);
+        if (auto it = entries.find(key); it != entries.end())
+        {
+            size -= it->second->size;
+            lruList.erase(it->second);
+            entries.erase(it);
+        }
+    }
+
+    bool DerivedDataCache::Commit(uint64_t key, const std::filesystem::path &temporaryPath)
+    {
+        std::error_code errorCode;
+        const uint64_t entrySize = std::filesystem::file_size(temporaryPath, errorCode);
+        std::vector<uint64_t> victims;
+        if (!errorCode)
+        {
+            // Replacing an entry is atomic, readers see either the old or the new file, both hold same data.
+            // Renamed and indexed under lock, so that deleting the file of an earlier evicted entry of key can not remove it.
+            std::scoped_lock lock(mutex);
+            std::filesystem::rename(temporaryPath, GetEntryPath(key), errorCode);
+            if (!errorCode)
+            {
+                AddEntry_Locked(key, entrySize);
+                victims = Trim_Locked(maxSize);
+            }
+        }
+        if (errorCode)
+        {
+            logger.error("Failed to store derived data {:016x}: {}", key, errorCode.message());
+            std::filesystem::remove(temporaryPath, errorCode);
+            return false;
+        }
+        DeleteEntryFiles(victims);
+        return true;
+    }
+
+    void DerivedDataCache::AddEntry_Locked(uint64_t key, uint64_t entrySize)
+    {
+        if (auto it = entries.find(key); it != entries.end())
+        {
+            size -= it->second->size;
+            it->second->size = entrySize;
+            lruList.splice(lruList.begin(), lruList, it->second);
+        }
+        else
+        {
+            lruList.push_front({key, entrySize});
+            entries.emplace(key, lruList.begin());
+        }
+        size += entrySize;
+    }
+
+    std::vector<uint64_t> DerivedDataCache::Trim_Locked(uint64_t targetSize)
+    {
+        std::vector<uint64_t> victims;
+        while (size > targetSize && !lruList.empty())
+        {
+            const Entry &victim = lruList.back();
+            size -= victim.size;
+            entries.erase(victim.key);
+            victims.push_back(victim.key);
+            lruList.pop_back();
+        }
+        numEvicted.fetch_add(victims.size(), std::memory_order_relaxed);
+        return victims;
+    }
+
+    void DerivedDataCache::DeleteEntryFiles(const std::vector<uint64_t> &keys) const
+    {
+        for (uint64_t key : keys)
+        {
+            // Key may have been stored or found on disk again since it was evicted, the file then belongs to the new entry.
+            std::scoped_lock lock(mutex);
+            if (directory.empty() || entries.contains(key))
+                continue;
+            std::error_code errorCode;
+            std::filesystem::remove(GetEntryPath(key), errorCode);
+        }
+    }
+}
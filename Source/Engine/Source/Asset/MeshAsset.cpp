@@ -18,28 +18,110 @@
 
 #include "Asset/MeshAsset.h"
 
+#include <future>
+#include <limits>
+
+#include "Asset/MeshOptimizer.h"
+#include "Asset/MeshSimplifier.h"
+#include "Core/ContentHash.h"
+
 constexpr uint32_t MeshFileMagicMask = 0x12341234;
-constexpr uint32_t MeshFileCurrentVersion = 0x1;
+// Version 1 files were never written with data, they are rejected.
+// Version 3 added vertex format and quantization bounds.
+// Version 4 added index stride, indices may be 16-bit.
+// Version 5 added LOD table and bounds.
+// Version 6 added meshlets.
+constexpr uint32_t MeshFileCurrentVersion = 0x6;
+constexpr uint32_t MeshFileMinSupportedVersion = 0x2;
+// Bump on changes of optimization, LOD or meshlet code that change baked data of same mesh and settings.
+constexpr uint32_t MeshBakeCodeVersion = 0x1;
+// Vertex and index blobs start at multiple of this from start of asset,
+// so that they can be used in place from a mapped view, or read into final buffers directly.
+constexpr uint64_t MeshBlobAlignment = 64;
+constexpr uint32_t MeshMaxLODs = 16;
 namespace Koala
 {
     static Logger logger("MeshAsset");
-    
+
+    // Layout: header, LOD table, vertex blob, index blob, meshlet blob. Offsets are relative to start of asset in the file.
     struct MeshAssetMetaData
     {
         uint32_t fileMagicMask {0};
         uint32_t fileVersion {0};
-        uint64_t numVertices;
-        uint64_t numIndices;
+        uint32_t headerSize {0};
+        uint32_t vertexStride {0};
+        uint64_t numVertices {0};
+        uint64_t numIndices {0};
+        uint64_t vertexDataOffset {0};
+        uint64_t indexDataOffset {0};
+        // Since version 3.
+        uint32_t vertexFormat {0};
+        // Since version 4, 0 in older files means 32-bit.
+        uint32_t indexStride {0};
+        VertexQuantizationBounds quantizationBounds {};
+        // Since version 5, 0 LODs in older files means one covering all indices.
+        uint32_t numLODs {0};
+        uint32_t lodTableOffset {0};
+        float    boundsCenter[3] {};
+        float    boundsRadius {0};
+        // Since version 6, no meshlets in older files.
+        uint32_t numMeshlets {0};
+        uint32_t numMeshletVertices {0};
+        uint32_t numMeshletTriangles {0};
+        uint32_t reserved {0};
+        uint64_t meshletDataOffset {0};
+    };
+    constexpr size_t MeshAssetMetaDataSizeV2 = offsetof(MeshAssetMetaData, vertexFormat);
+    constexpr size_t MeshAssetMetaDataSizeV4 = offsetof(MeshAssetMetaData, numLODs);
+    constexpr size_t MeshAssetMetaDataSizeV5 = offsetof(MeshAssetMetaData, numMeshlets);
+
+    // Meshlet blob: meshlet offsets of LODs (one more than LODs), meshlets, meshlet vertices, meshlet triangles.
+    struct MeshletBlobLayout
+    {
+        uint64_t meshletsOffset;
+        uint64_t verticesOffset;
+        uint64_t trianglesOffset;
+        uint64_t totalSize;
     };
-    
+
+    static MeshletBlobLayout GetMeshletBlobLayout(uint64_t numLODs, uint64_t numMeshlets, uint64_t numMeshletVertices,
+        uint64_t numMeshletTriangles)
+    {
+        MeshletBlobLayout layout;
+        layout.meshletsOffset = (std::max<uint64_t>(numLODs, 1) + 1) * sizeof(uint32_t);
+        layout.meshletsOffset = (layout.meshletsOffset + 15) & ~15ull;
+        layout.verticesOffset = layout.meshletsOffset + numMeshlets * sizeof(Meshlet);
+        layout.trianglesOffset = layout.verticesOffset + numMeshletVertices * sizeof(uint32_t);
+        layout.totalSize = layout.trianglesOffset + numMeshletTriangles * 3;
+        return layout;
+    }
+    static_assert(sizeof(MeshLOD) == 16, "MeshLOD is stored in baked mesh as it is in memory.");
+
+    // Vector is stored as it is in memory. Eigen fixed size vectors are plain floats, though not formally trivially copyable.
+    static_assert(sizeof(Vector) == 8 * sizeof(float), "Vector is stored in baked mesh as it is in memory.");
+
+    static FORCEINLINE uint64_t AlignBlobOffset(uint64_t offset)
+    {
+        return (offset + MeshBlobAlignment - 1) & ~(MeshBlobAlignment - 1);
+    }
+
     bool MeshAsset::LoadAsset(FileIO::ReadFileStream &file)
     {
-        size_t fileSize = file.GetFileSize();
-        if (fileSize < sizeof(MeshAssetMetaData))
+        const size_t assetStart = file.Tell();
+        const size_t fileSize = file.GetFileSize();
+        if (fileSize < assetStart || fileSize - assetStart < MeshAssetMetaDataSizeV2)
             return false;
-        
+        const size_t assetSize = fileSize - assetStart;
+
+        // Older headers are shorter, fields they lack keep their defaults.
         MeshAssetMetaData metaData;
-        // file.Read((char*)&metaData, sizeof(MeshAssetMetaData));
+        const size_t headerReadSize = std::min(assetSize, sizeof(MeshAssetMetaData));
+        const size_t headerSize = file.Serialize(&metaData, headerReadSize);
+        if (headerSize < MeshAssetMetaDataSizeV2)
+        {
+            logger.error("Failed to read mesh asset header");
+            return false;
+        }
 
         if (metaData.fileMagicMask != MeshFileMagicMask)
         {
@@ -51,67 +133,609 @@ namespace Koala
         {
             logger.error("The engine version used to create this asset file is too new, Koala didn't support!");
             return false;
+        } else if (metaData.fileVersion < MeshFileMinSupportedVersion)
+        {
+            logger.error("This asset file is too old, please rebake it!");
+            return false;
         } else if (metaData.fileVersion < MeshFileCurrentVersion)
         {
             logger.warning("This asset file is too old, may cause some problems!");
         }
-        size_t remainingFileSize = fileSize - sizeof(MeshAssetMetaData);
+        const size_t versionHeaderSize = metaData.fileVersion < 3 ? MeshAssetMetaDataSizeV2 :
+            metaData.fileVersion < 5 ? MeshAssetMetaDataSizeV4 :
+            metaData.fileVersion < 6 ? MeshAssetMetaDataSizeV5 : sizeof(MeshAssetMetaData);
+        if (headerSize < versionHeaderSize)
+        {
+            logger.error("File format error -- header truncated");
+            return false;
+        }
+        std::memset(reinterpret_cast<uint8_t*>(&metaData) + versionHeaderSize, 0, sizeof(MeshAssetMetaData) - versionHeaderSize);
+
+        const auto vertexFormat = static_cast<EVertexFormat>(metaData.vertexFormat);
+        if (vertexFormat != EVertexFormat::Float && vertexFormat != EVertexFormat::Packed16 && vertexFormat != EVertexFormat::Packed12)
+        {
+            logger.error("File format error -- unknown vertex format {}", metaData.vertexFormat);
+            return false;
+        }
+        const size_t vertexStride = Koala::GetVertexStride(vertexFormat);
+        if (metaData.vertexStride != vertexStride)
+        {
+            logger.error("File format error -- vertex stride {} mismatch, expected {}", metaData.vertexStride, vertexStride);
+            return false;
+        }
+        const size_t indexStride = metaData.indexStride == 0 ? sizeof(uint32_t) : metaData.indexStride;
+        if (indexStride != sizeof(uint32_t) && indexStride != sizeof(uint16_t))
+        {
+            logger.error("File format error -- unknown index stride {}", metaData.indexStride);
+            return false;
+        }
 
+        // Checked against asset size first, so that sizes below cannot overflow.
+        if (metaData.numVertices > assetSize / vertexStride || metaData.numIndices > assetSize / indexStride)
+        {
+            logger.error("File format error -- {} vertices and {} indices do not fit in file", metaData.numVertices, metaData.numIndices);
+            return false;
+        }
+        const size_t verticesAreaSize = metaData.numVertices * vertexStride;
+        const size_t indicesAreaSize = metaData.numIndices * indexStride;
+        if (metaData.vertexDataOffset < metaData.headerSize || metaData.vertexDataOffset > assetSize ||
+            assetSize - metaData.vertexDataOffset < verticesAreaSize)
         {
-            size_t verticesAreaSize = metaData.numVertices * sizeof(Vector);
+            logger.error("File format error -- unable to parse vector data area");
+            return false;
+        }
+        if (metaData.indexDataOffset < metaData.vertexDataOffset + verticesAreaSize || metaData.indexDataOffset > assetSize ||
+            assetSize - metaData.indexDataOffset < indicesAreaSize)
+        {
+            logger.error("File format error -- unable to parse index data area");
+            return false;
+        }
 
-            if (remainingFileSize < verticesAreaSize)
+        if (metaData.numLODs > 0 && (metaData.numLODs > MeshMaxLODs || metaData.lodTableOffset < versionHeaderSize ||
+            metaData.lodTableOffset + metaData.numLODs * sizeof(MeshLOD) > metaData.vertexDataOffset))
+        {
+            logger.error("File format error -- unable to parse LOD table");
+            return false;
+        }
+        std::vector<MeshLOD> loadedLODs(metaData.numLODs);
+        if (!loadedLODs.empty())
+        {
+            file.Seek(assetStart + metaData.lodTableOffset);
+            if (file.Serialize(loadedLODs.data(), loadedLODs.size() * sizeof(MeshLOD)) != loadedLODs.size() * sizeof(MeshLOD))
             {
-                logger.error("File format error -- unable to parse vector data area");
+                logger.error("Failed to read mesh LOD table");
                 return false;
             }
+            for (const MeshLOD &lod: loadedLODs)
+            {
+                if (lod.numIndices % 3 != 0 || static_cast<uint64_t>(lod.firstIndex) + lod.numIndices > metaData.numIndices)
+                {
+                    logger.error("File format error -- LOD indices {} + {} out of {}", lod.firstIndex, lod.numIndices, metaData.numIndices);
+                    return false;
+                }
+            }
+        }
 
-            vertices.resize(metaData.numVertices);
+        const MeshletBlobLayout meshletLayout = GetMeshletBlobLayout(metaData.numLODs, metaData.numMeshlets,
+            metaData.numMeshletVertices, metaData.numMeshletTriangles);
+        if (metaData.numMeshlets > 0 && (metaData.meshletDataOffset < metaData.indexDataOffset + indicesAreaSize ||
+            metaData.meshletDataOffset > assetSize || assetSize - metaData.meshletDataOffset < meshletLayout.totalSize))
+        {
+            logger.error("File format error -- unable to parse meshlet data area");
+            return false;
+        }
 
-            Vector* vecDataPtr = static_cast<Vector *>(vertices.data());
+        // Packed vertices stay packed, UnpackVertices() decodes them when needed on CPU side.
+        packedVertexFormat = vertexFormat;
+        quantizationBounds = metaData.quantizationBounds;
+        void *vertexBuffer;
+        if (vertexFormat == EVertexFormat::Float)
+        {
+            packedVertices.clear();
+            vertices.resize(metaData.numVertices);
+            vertexBuffer = vertices.data();
+        }
+        else
+        {
+            vertices.clear();
+            packedVertices.resize(verticesAreaSize);
+            vertexBuffer = packedVertices.data();
+        }
+        // 16-bit indices stay narrow as well, UnpackIndices() widens them.
+        void *indexBuffer;
+        if (indexStride == sizeof(uint32_t))
+        {
+            indices16.clear();
+            indices.resize(metaData.numIndices);
+            indexBuffer = indices.data();
+        }
+        else
+        {
+            indices.clear();
+            indices16.resize(metaData.numIndices);
+            indexBuffer = indices16.data();
+        }
 
-            for (uint64_t i = 0; i < metaData.numVertices; ++i)
+        bool bOK = true;
+        if (file.IsMapped())
+        {
+            // Whole blobs are copied at once, OS pages them in sequentially.
+            file.Prefetch(assetStart + metaData.vertexDataOffset, metaData.indexDataOffset + indicesAreaSize - metaData.vertexDataOffset);
+            file.Seek(assetStart + metaData.vertexDataOffset);
+            const uint8_t *vertexData = file.GetMappedRange(verticesAreaSize);
+            file.Seek(assetStart + metaData.indexDataOffset);
+            const uint8_t *indexData = file.GetMappedRange(indicesAreaSize);
+            bOK = vertexData != nullptr && indexData != nullptr;
+            if (bOK)
             {
-                // file.Read((char*)vecDataPtr, sizeof(Vector));
-                vecDataPtr++;
+                std::memcpy(vertexBuffer, vertexData, verticesAreaSize);
+                std::memcpy(indexBuffer, indexData, indicesAreaSize);
             }
-            remainingFileSize += verticesAreaSize;
+        }
+        else
+        {
+            // Both blobs are requested at once, read straight into final buffers.
+            std::promise<bool> vertexPromise, indexPromise;
+            std::future<bool> vertexFuture = vertexPromise.get_future(), indexFuture = indexPromise.get_future();
+            auto readBlob = [&file](size_t offset, size_t size, void *buffer, std::promise<bool> &promise)
+            {
+                if (size == 0)
+                {
+                    promise.set_value(true);
+                    return;
+                }
+                file.Seek(offset);
+                file.ReadAsync(buffer, size, [&promise, size](bool bOk, int64_t readSize, const void*)
+                {
+                    promise.set_value(bOk && readSize == static_cast<int64_t>(size));
+                }, FileIO::EFileIOCompletionMode::IOThread);
+            };
+            readBlob(assetStart + metaData.vertexDataOffset, verticesAreaSize, vertexBuffer, vertexPromise);
+            readBlob(assetStart + metaData.indexDataOffset, indicesAreaSize, indexBuffer, indexPromise);
+
+            FileIO::FileIOManager &fileIOManager = FileIO::FileIOManager::Get();
+            bOK = fileIOManager.WaitForResult(vertexFuture);
+            bOK = fileIOManager.WaitForResult(indexFuture) && bOK;
+        }
+
+        // Meshlet data is small next to vertices and indices, it is read after them in one piece.
+        std::vector<uint8_t> meshletData;
+        if (bOK && metaData.numMeshlets > 0)
+        {
+            meshletData.resize(meshletLayout.totalSize);
+            file.Seek(assetStart + metaData.meshletDataOffset);
+            bOK = file.Serialize(meshletData.data(), meshletData.size()) == meshletData.size();
         }
 
+        file.Seek(assetStart + (metaData.numMeshlets > 0 ? metaData.meshletDataOffset + meshletLayout.totalSize :
+            metaData.indexDataOffset + indicesAreaSize));
+        if (!bOK)
         {
-            size_t indicesAreaSize = metaData.numIndices * sizeof(uint32_t);
+            logger.error("Failed to read mesh data");
+            vertices.clear();
+            packedVertices.clear();
+            indices.clear();
+            indices16.clear();
+            packedVertexFormat = EVertexFormat::Float;
+            return false;
+        }
 
-            if (remainingFileSize < indicesAreaSize)
+        lods = std::move(loadedLODs);
+        ClearMeshlets();
+        if (!meshletData.empty())
+        {
+            lodMeshletOffsets.resize(std::max<uint32_t>(metaData.numLODs, 1) + 1);
+            meshlets.resize(metaData.numMeshlets);
+            meshletVertices.resize(metaData.numMeshletVertices);
+            meshletTriangles.resize(metaData.numMeshletTriangles * 3);
+            std::memcpy(lodMeshletOffsets.data(), meshletData.data(), lodMeshletOffsets.size() * sizeof(uint32_t));
+            std::memcpy(meshlets.data(), meshletData.data() + meshletLayout.meshletsOffset, meshlets.size() * sizeof(Meshlet));
+            std::memcpy(meshletVertices.data(), meshletData.data() + meshletLayout.verticesOffset, meshletVertices.size() * sizeof(uint32_t));
+            std::memcpy(meshletTriangles.data(), meshletData.data() + meshletLayout.trianglesOffset, meshletTriangles.size());
+            if (!ValidateMeshlets(metaData.numVertices))
             {
-                logger.error("File format error -- unable to parse vector data area");
+                logger.error("File format error -- meshlets out of range");
+                ClearMeshlets();
                 return false;
             }
-            indices.resize(metaData.numIndices);
-            uint32_t* indicesDataPtr = static_cast<uint32_t *>(indices.data());
+        }
+        bounds.center = Vec3f(metaData.boundsCenter[0], metaData.boundsCenter[1], metaData.boundsCenter[2]);
+        bounds.radius = metaData.boundsRadius;
+        if (metaData.fileVersion < 5)
+        {
+            // Bounds were not stored yet, packed vertices are decoded for them and dropped again.
+            const bool bUnpacked = vertices.empty() && UnpackVertices();
+            bounds = ComputeBoundingSphere(vertices);
+            if (bUnpacked)
+                ReleaseUnpackedVertices();
+        }
+
+        bBaked = true;
+        return true;
+    }
+
+    bool MeshAsset::SaveAssetUnbaked(FileIO::WriteFileStream &file)
+    {
+        if (vertices.empty() && !packedVertices.empty())
+        {
+            logger.error("Only packed vertices are loaded, unpack them before saving unbaked mesh");
+            return false;
+        }
+        return WriteMeshData(file, EVertexFormat::Float, sizeof(uint32_t));
+    }
+
+    bool MeshAsset::Bake(FileIO::WriteFileStream &file)
+    {
+        if (!bBakePrepared)
+            PrepareBake();
+        bBakePrepared = false;
+
+        // Largest index 0xFFFF is left out, it is primitive restart.
+        const size_t indexStride = bakeSettings.bAllow16BitIndices && GetNumVertices() <= 0xFFFF ? sizeof(uint16_t) : sizeof(uint32_t);
+        return WriteMeshData(file, packedVertexFormat, indexStride);
+    }
+
+    void MeshAsset::SetMeshData(std::vector<Vector> inVertices, std::vector<uint32_t> inIndices)
+    {
+        vertices = std::move(inVertices);
+        indices = std::move(inIndices);
+        packedVertexFormat = EVertexFormat::Float;
+        packedVertices = {};
+        indices16 = {};
+        lods.clear();
+        ClearMeshlets();
+        bounds = ComputeBoundingSphere(vertices);
+        bBaked = false;
+        bBakePrepared = false;
+    }
+
+    MeshOptimizationStats MeshAsset::PrepareBake()
+    {
+        MeshOptimizationStats stats;
+        if (bakeSettings.bOptimize)
+            stats = Optimize(bakeSettings.overdrawThreshold);
+        if (bakeSettings.maxLODs > 1)
+            GenerateLODs();
+        if (bakeSettings.bBuildMeshlets)
+            BuildMeshlets();
+        if (bakeSettings.vertexFormat != EVertexFormat::Float && bakeSettings.vertexFormat != packedVertexFormat)
+            PackVertices(bakeSettings.vertexFormat);
+        bBakePrepared = true;
+        return stats;
+    }
+
+    MeshOptimizationStats MeshAsset::Optimize(float overdrawThreshold)
+    {
+        MeshOptimizationStats stats;
+        const EVertexFormat format = packedVertexFormat;
+        if (vertices.empty() && !packedVertices.empty())
+            UnpackVertices();
+        UnpackIndices();
+        if (!lods.empty())
+        {
+            indices.resize(lods[0].numIndices);
+            lods.clear();
+        }
+        ClearMeshlets();
 
-            for (uint64_t i = 0; i < metaData.numIndices; ++i)
+        stats.numVerticesBefore = stats.numVerticesAfter = vertices.size();
+        if (indices.size() % 3 != 0)
+        {
+            logger.error("Mesh has {} indices, not a triangle list, skip optimization", indices.size());
+            return stats;
+        }
+        for (uint32_t index : indices)
+        {
+            if (index >= vertices.size())
             {
-                // file.Read((char*)indicesDataPtr, sizeof(Vector));
-                indicesDataPtr++;
+                logger.error("Mesh index {} out of {} vertices, skip optimization", index, vertices.size());
+                return stats;
             }
+        }
+        stats.acmrBefore = stats.acmrAfter = ComputeACMR(indices, vertices.size());
 
-            remainingFileSize += indicesAreaSize;
+        DeduplicateVertices(vertices, indices);
+
+        // Triangles collapsed to a line or point draw nothing, after merging vertices more of them show up.
+        size_t numKept = 0;
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            const uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+            if (a == b || b == c || c == a)
+                continue;
+            indices[numKept++] = a;
+            indices[numKept++] = b;
+            indices[numKept++] = c;
         }
+        indices.resize(numKept);
 
-        return true;
+        OptimizeVertexCache(indices, vertices.size());
+        OptimizeOverdraw(indices, vertices, overdrawThreshold);
+        OptimizeVertexFetch(vertices, indices);
+
+        stats.numVerticesAfter = vertices.size();
+        stats.acmrAfter = ComputeACMR(indices, vertices.size());
+        bounds = ComputeBoundingSphere(vertices);
+
+        // Packed data refers to old vertex order.
+        if (format != EVertexFormat::Float)
+            PackVertices(format);
+        return stats;
     }
 
-    bool MeshAsset::SaveAssetUnbaked(FileIO::WriteFileStream &file)
+    void MeshAsset::GenerateLODs()
+    {
+        if (vertices.empty() && !packedVertices.empty())
+            UnpackVertices();
+        UnpackIndices();
+        if (!lods.empty())
+            indices.resize(lods[0].numIndices);
+        lods.clear();
+        ClearMeshlets();
+        bounds = ComputeBoundingSphere(vertices);
+
+        // Every LOD is simplified from LOD0, so that its error is measured against the original surface.
+        const std::vector<uint32_t> baseIndices = indices;
+        lods.push_back({0, static_cast<uint32_t>(baseIndices.size()), std::numeric_limits<float>::max(), 0});
+        const uint32_t maxLODs = std::min(bakeSettings.maxLODs, MeshMaxLODs);
+        while (lods.size() < maxLODs)
+        {
+            const MeshLOD &previous = lods.back();
+            const size_t targetIndexCount = static_cast<size_t>(previous.numIndices * bakeSettings.lodReduction) / 3 * 3;
+            float error = 0;
+            std::vector<uint32_t> lodIndices = SimplifyMesh(vertices, baseIndices, targetIndexCount, bakeSettings.lodMaxError, &error);
+            // Seams, borders or error limit stop simplification, a LOD that hardly saves anything is not worth it.
+            if (lodIndices.empty() || lodIndices.size() > previous.numIndices * 9 / 10)
+                break;
+            OptimizeVertexCache(lodIndices, vertices.size());
+
+            // Error of e * radius covers e / 2 of bounds diameter, that is e / 2 * screenSize * height pixels.
+            error = std::max(error, previous.error);
+            const float screenSize = error > 0 ?
+                std::min(previous.screenSize, 2.0f * bakeSettings.lodPixelError / (error * bakeSettings.lodReferenceHeight)) :
+                previous.screenSize;
+            lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lodIndices.size()), screenSize, error});
+            indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+        }
+    }
+
+    void MeshAsset::BuildMeshlets()
+    {
+        if (vertices.empty() && !packedVertices.empty())
+            UnpackVertices();
+        UnpackIndices();
+        ClearMeshlets();
+
+        lodMeshletOffsets.push_back(0);
+        for (uint32_t lodIndex = 0; lodIndex < GetNumLODs(); ++lodIndex)
+        {
+            const MeshLOD lod = GetLOD(lodIndex);
+            Koala::BuildMeshlets(vertices, indices.data() + lod.firstIndex, lod.numIndices, meshlets, meshletVertices, meshletTriangles,
+                bakeSettings.meshletMaxVertices, bakeSettings.meshletMaxTriangles);
+            lodMeshletOffsets.push_back(static_cast<uint32_t>(meshlets.size()));
+        }
+    }
+
+    void MeshAsset::ClearMeshlets()
+    {
+        meshlets.clear();
+        meshletVertices.clear();
+        meshletTriangles.clear();
+        lodMeshletOffsets.clear();
+    }
+
+    bool MeshAsset::ValidateMeshlets(uint64_t numVertices) const
+    {
+        if (lodMeshletOffsets.size() != GetNumLODs() + 1 || lodMeshletOffsets.front() != 0 || lodMeshletOffsets.back() != meshlets.size() ||
+            !std::is_sorted(lodMeshletOffsets.begin(), lodMeshletOffsets.end()))
+        {
+            return false;
+        }
+        for (const Meshlet &meshlet: meshlets)
+        {
+            if (meshlet.numVertices > 256 || static_cast<uint64_t>(meshlet.firstVertex) + meshlet.numVertices > meshletVertices.size() ||
+                (static_cast<uint64_t>(meshlet.firstTriangle) + meshlet.numTriangles) * 3 > meshletTriangles.size())
+            {
+                return false;
+            }
+            for (uint32_t corner = 0; corner < meshlet.numTriangles * 3; ++corner)
+            {
+                if (meshletTriangles[meshlet.firstTriangle * 3 + corner] >= meshlet.numVertices)
+                    return false;
+            }
+        }
+        return std::all_of(meshletVertices.begin(), meshletVertices.end(), [numVertices](uint32_t vertex) { return vertex < numVertices; });
+    }
+
+    std::pair<uint32_t, uint32_t> MeshAsset::GetLODMeshletRange(uint32_t lodIndex) const
+    {
+        if (meshlets.empty())
+            return {0, 0};
+        lodIndex = std::min<uint32_t>(lodIndex, static_cast<uint32_t>(lodMeshletOffsets.size()) - 2);
+        return {lodMeshletOffsets[lodIndex], lodMeshletOffsets[lodIndex + 1] - lodMeshletOffsets[lodIndex]};
+    }
+
+    size_t MeshAsset::GetMemorySize() const
+    {
+        return vertices.capacity() * sizeof(Vector) + indices.capacity() * sizeof(uint32_t) + packedVertices.capacity() +
+            indices16.capacity() * sizeof(uint16_t) + lods.capacity() * sizeof(MeshLOD) + meshlets.capacity() * sizeof(Meshlet) +
+            meshletVertices.capacity() * sizeof(uint32_t) + meshletTriangles.capacity() + lodMeshletOffsets.capacity() * sizeof(uint32_t);
+    }
+
+    uint32_t MeshAsset::GetBakeVersion() const
+    {
+        return (MeshFileCurrentVersion << 16) | MeshBakeCodeVersion;
+    }
+
+    uint64_t MeshAsset::GetBakeSettingsHash() const
+    {
+        uint64_t hash = HashCombine(0, static_cast<uint64_t>(bakeSettings.bOptimize));
+        hash = HashCombine(hash, bakeSettings.overdrawThreshold);
+        hash = HashCombine(hash, static_cast<uint64_t>(bakeSettings.vertexFormat));
+        // Float format keeps format set by PackVertices().
+        if (bakeSettings.vertexFormat == EVertexFormat::Float)
+            hash = HashCombine(hash, static_cast<uint64_t>(packedVertexFormat));
+        hash = HashCombine(hash, static_cast<uint64_t>(bakeSettings.bAllow16BitIndices));
+        hash = HashCombine(hash, static_cast<uint64_t>(bakeSettings.maxLODs));
+        hash = HashCombine(hash, bakeSettings.lodReduction);
+        hash = HashCombine(hash, bakeSettings.lodMaxError);
+        hash = HashCombine(hash, bakeSettings.lodPixelError);
+        hash = HashCombine(hash, bakeSettings.lodReferenceHeight);
+        hash = HashCombine(hash, static_cast<uint64_t>(bakeSettings.bBuildMeshlets));
+        hash = HashCombine(hash, static_cast<uint64_t>(bakeSettings.meshletMaxVertices));
+        return HashCombine(hash, static_cast<uint64_t>(bakeSettings.meshletMaxTriangles));
+    }
+
+    MeshLOD MeshAsset::GetLOD(uint32_t lodIndex) const
+    {
+        if (lods.empty())
+            return {0, static_cast<uint32_t>(GetNumIndices()), std::numeric_limits<float>::max(), 0};
+        return lods[std::min<size_t>(lodIndex, lods.size() - 1)];
+    }
+
+    bool MeshAsset::WriteMeshData(FileIO::WriteFileStream &file, EVertexFormat format, size_t indexStride)
     {
+        const void *vertexData = format == EVertexFormat::Float ? static_cast<const void*>(vertices.data()) : packedVertices.data();
+        const size_t vertexStride = Koala::GetVertexStride(format);
+        const size_t numVertices = format == EVertexFormat::Float ? vertices.size() : packedVertices.size() / vertexStride;
+
         MeshAssetMetaData metaData;
         metaData.fileMagicMask = MeshFileMagicMask;
         metaData.fileVersion = MeshFileCurrentVersion;
-        metaData.numVertices = vertices.size();
-        metaData.numIndices = indices.size();
+        metaData.headerSize = sizeof(MeshAssetMetaData);
+        metaData.vertexStride = static_cast<uint32_t>(vertexStride);
+        metaData.numVertices = numVertices;
+        metaData.numIndices = GetNumIndices();
+        metaData.vertexFormat = static_cast<uint32_t>(format);
+        metaData.indexStride = static_cast<uint32_t>(indexStride);
+        if (!vertices.empty())
+            bounds = ComputeBoundingSphere(vertices);
+        metaData.numLODs = static_cast<uint32_t>(lods.size());
+        metaData.lodTableOffset = sizeof(MeshAssetMetaData);
+        metaData.boundsCenter[0] = bounds.center.x();
+        metaData.boundsCenter[1] = bounds.center.y();
+        metaData.boundsCenter[2] = bounds.center.z();
+        metaData.boundsRadius = bounds.radius;
+        metaData.numMeshlets = static_cast<uint32_t>(meshlets.size());
+        metaData.numMeshletVertices = static_cast<uint32_t>(meshletVertices.size());
+        metaData.numMeshletTriangles = static_cast<uint32_t>(meshletTriangles.size() / 3);
+        if (format != EVertexFormat::Float)
+            metaData.quantizationBounds = quantizationBounds;
+
+        const size_t verticesAreaSize = numVertices * vertexStride;
+        // Indices are converted only when stored width differs from requested one.
+        const void *indexData = GetIndexData();
+        std::vector<uint16_t> narrowIndices;
+        std::vector<uint32_t> wideIndices;
+        if (indexStride == sizeof(uint16_t) && indices16.empty())
+        {
+            narrowIndices.assign(indices.begin(), indices.end());
+            indexData = narrowIndices.data();
+        }
+        else if (indexStride == sizeof(uint32_t) && !indices16.empty())
+        {
+            wideIndices.assign(indices16.begin(), indices16.end());
+            indexData = wideIndices.data();
+        }
+        const size_t indicesAreaSize = metaData.numIndices * indexStride;
+        const size_t lodTableSize = lods.size() * sizeof(MeshLOD);
+        metaData.vertexDataOffset = AlignBlobOffset(metaData.lodTableOffset + lodTableSize);
+        metaData.indexDataOffset = AlignBlobOffset(metaData.vertexDataOffset + verticesAreaSize);
+        const MeshletBlobLayout meshletLayout = GetMeshletBlobLayout(metaData.numLODs, metaData.numMeshlets,
+            metaData.numMeshletVertices, metaData.numMeshletTriangles);
+        if (!meshlets.empty())
+            metaData.meshletDataOffset = AlignBlobOffset(metaData.indexDataOffset + indicesAreaSize);
+
+        // Header and padding go first, blobs are written from where they are, all in one request.
+        std::vector<uint8_t> headerArea(metaData.vertexDataOffset, 0);
+        std::memcpy(headerArea.data(), &metaData, sizeof(MeshAssetMetaData));
+        if (lodTableSize > 0)
+            std::memcpy(headerArea.data() + metaData.lodTableOffset, lods.data(), lodTableSize);
+        std::vector<uint8_t> padding(metaData.indexDataOffset - metaData.vertexDataOffset - verticesAreaSize, 0);
+
+        std::vector<FileIO::FileIOBufferSpan> spans;
+        spans.push_back({headerArea.data(), headerArea.size()});
+        if (verticesAreaSize > 0)
+            spans.push_back({const_cast<void*>(vertexData), verticesAreaSize});
+        if (!padding.empty())
+            spans.push_back({padding.data(), padding.size()});
+        if (indicesAreaSize > 0)
+            spans.push_back({const_cast<void*>(indexData), indicesAreaSize});
+
+        // Padding before meshlet blob and LOD meshlet offsets go in one buffer, meshlet arrays are written from where they are.
+        std::vector<uint8_t> meshletHeader;
+        if (!meshlets.empty())
+        {
+            const size_t paddingSize = metaData.meshletDataOffset - metaData.indexDataOffset - indicesAreaSize;
+            meshletHeader.resize(paddingSize + meshletLayout.meshletsOffset, 0);
+            std::memcpy(meshletHeader.data() + paddingSize, lodMeshletOffsets.data(), lodMeshletOffsets.size() * sizeof(uint32_t));
+            spans.push_back({meshletHeader.data(), meshletHeader.size()});
+            spans.push_back({meshlets.data(), meshlets.size() * sizeof(Meshlet)});
+            spans.push_back({meshletVertices.data(), meshletVertices.size() * sizeof(uint32_t)});
+            spans.push_back({meshletTriangles.data(), meshletTriangles.size()});
+        }
+
+        const size_t totalSize = meshlets.empty() ? metaData.indexDataOffset + indicesAreaSize :
+            metaData.meshletDataOffset + meshletLayout.totalSize;
+        std::promise<bool> promise;
+        std::future<bool> future = promise.get_future();
+        file.WriteGatherAsync(std::move(spans), [&promise, totalSize](bool bOk, int64_t writtenSize, const void*)
+        {
+            promise.set_value(bOk && writtenSize == static_cast<int64_t>(totalSize));
+        }, FileIO::EFileIOCompletionMode::IOThread);
 
-        // file.Write(vertices.data(), vertices.size() * sizeof(Vector));
-        // file.Write(indices.data(), indices.size() * sizeof(uint32_t));
+        if (!FileIO::FileIOManager::Get().WaitForResult(future))
+        {
+            logger.error("Failed to write mesh data");
+            return false;
+        }
+        file.Seek(file.Tell() + totalSize);
+        return true;
+    }
+
+    void MeshAsset::PackVertices(EVertexFormat format)
+    {
+        // Repacking a mesh loaded packed goes through full precision.
+        if (vertices.empty() && !packedVertices.empty())
+            UnpackVertices();
+
+        if (format == EVertexFormat::Float)
+        {
+            packedVertices.clear();
+            packedVertexFormat = format;
+            return;
+        }
+
+        quantizationBounds = ComputeQuantizationBounds(vertices.data(), vertices.size());
+        packedVertices.resize(vertices.size() * Koala::GetVertexStride(format));
+        EncodeVertices(vertices.data(), vertices.size(), quantizationBounds, format, packedVertices.data());
+        packedVertexFormat = format;
+    }
 
+    bool MeshAsset::UnpackVertices()
+    {
+        if (packedVertexFormat == EVertexFormat::Float)
+            return false;
+
+        const size_t numVertices = packedVertices.size() / Koala::GetVertexStride(packedVertexFormat);
+        vertices.resize(numVertices);
+        DecodeVertices(packedVertices.data(), numVertices, quantizationBounds, packedVertexFormat, vertices.data());
+        return true;
+    }
+
+    bool MeshAsset::UnpackIndices()
+    {
+        if (indices16.empty())
+            return false;
+
+        indices.assign(indices16.begin(), indices16.end());
+        indices16 = {};
         return true;
     }
+
+    void MeshAsset::ReleaseUnpackedVertices()
+    {
+        if (packedVertexFormat != EVertexFormat::Float)
+            vertices = {};
+    }
 }
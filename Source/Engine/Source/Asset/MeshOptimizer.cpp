@@ -0,0 +1,420 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Asset/MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace Koala
+{
+    constexpr uint32_t InvalidIndex = ~0u;
+
+    // FIFO cache model, vertex is in cache if it was added less than cacheSize additions ago.
+    class VertexCacheSimulator
+    {
+    public:
+        VertexCacheSimulator(size_t numVertices, uint32_t inCacheSize): timestamps(numVertices, 0), cacheSize(inCacheSize),
+            timestamp(inCacheSize + 1) {}
+
+        // Return number of cache misses.
+        FORCEINLINE uint32_t AddTriangle(const uint32_t *triangle)
+        {
+            uint32_t misses = 0;
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                uint32_t &vertexTimestamp = timestamps[triangle[corner]];
+                if (timestamp - vertexTimestamp > cacheSize)
+                {
+                    vertexTimestamp = timestamp++;
+                    ++misses;
+                }
+            }
+            return misses;
+        }
+
+        FORCEINLINE void Flush()
+        {
+            timestamp += cacheSize + 1;
+        }
+    private:
+        std::vector<uint32_t> timestamps;
+        uint32_t              cacheSize;
+        uint32_t              timestamp;
+    };
+
+    static FORCEINLINE uint32_t HashVertex(const Vector &vertex)
+    {
+        uint32_t words[sizeof(Vector) / sizeof(uint32_t)];
+        std::memcpy(words, static_cast<const void*>(&vertex), sizeof(Vector));
+        uint32_t hash = 0x811c9dc5u;
+        for (const uint32_t word: words)
+        {
+            hash = (hash ^ word) * 0x01000193u;
+            hash ^= hash >> 15;
+        }
+        return hash;
+    }
+
+    size_t DeduplicateVertices(std::vector<Vector> &vertices, std::vector<uint32_t> &indices)
+    {
+        // Open addressing, at most half full.
+        size_t tableSize = 16;
+        while (tableSize < vertices.size() * 2)
+            tableSize *= 2;
+        std::vector<uint32_t> table(tableSize, InvalidIndex);
+
+        std::vector<Vector> uniqueVertices;
+        uniqueVertices.reserve(vertices.size());
+        std::vector<uint32_t> remap(vertices.size());
+        for (size_t index = 0; index < vertices.size(); ++index)
+        {
+            const Vector &vertex = vertices[index];
+            size_t slot = HashVertex(vertex) & (tableSize - 1);
+            while (table[slot] != InvalidIndex &&
+                std::memcmp(static_cast<const void*>(&uniqueVertices[table[slot]]), static_cast<const void*>(&vertex), sizeof(Vector)) != 0)
+            {
+                slot = (slot + 1) & (tableSize - 1);
+            }
+            if (table[slot] == InvalidIndex)
+            {
+                table[slot] = static_cast<uint32_t>(uniqueVertices.size());
+                uniqueVertices.push_back(vertex);
+            }
+            remap[index] = table[slot];
+        }
+
+        for (uint32_t &index: indices)
+        {
+            index = remap[index];
+        }
+        vertices.swap(uniqueVertices);
+        return vertices.size();
+    }
+
+    // Scoring from Forsyth's article: recently used vertices score high, the 3 most recent a bit lower
+    // (they are likely to be reused by the next triangle anyway), vertices with few triangles left get a boost.
+    constexpr uint32_t ForsythCacheSize = MeshOptimizerCacheSize;
+    constexpr uint32_t ForsythMaxValence = 64;
+
+    struct ForsythScoreTable
+    {
+        float cacheScores[ForsythCacheSize];
+        float valenceScores[ForsythMaxValence];
+
+        ForsythScoreTable()
+        {
+            for (uint32_t position = 0; position < ForsythCacheSize; ++position)
+            {
+                cacheScores[position] = position < 3 ? 0.75f :
+                    std::pow(1.0f - static_cast<float>(position - 3) / (ForsythCacheSize - 3), 1.5f);
+            }
+            valenceScores[0] = 0;
+            for (uint32_t valence = 1; valence < ForsythMaxValence; ++valence)
+            {
+                valenceScores[valence] = 2.0f / std::sqrt(static_cast<float>(valence));
+            }
+        }
+
+        FORCEINLINE float GetScore(int32_t cachePosition, uint32_t numRemainingTriangles) const
+        {
+            if (numRemainingTriangles == 0)
+                return -1.0f;
+            const float valenceScore = numRemainingTriangles < ForsythMaxValence ? valenceScores[numRemainingTriangles] :
+                2.0f / std::sqrt(static_cast<float>(numRemainingTriangles));
+            return (cachePosition >= 0 ? cacheScores[cachePosition] : 0.0f) + valenceScore;
+        }
+    };
+
+    void OptimizeVertexCache(std::vector<uint32_t> &indices, size_t numVertices)
+    {
+        static const ForsythScoreTable scoreTable;
+        const size_t numTriangles = indices.size() / 3;
+        if (numTriangles <= 1)
+            return;
+
+        // Triangles of each vertex. Emitted ones are swapped to the end of the vertex's range.
+        std::vector<uint32_t> numRemainingTriangles(numVertices, 0);
+        for (const uint32_t index: indices)
+        {
+            ++numRemainingTriangles[index];
+        }
+        std::vector<uint32_t> adjacencyOffsets(numVertices + 1, 0);
+        std::inclusive_scan(numRemainingTriangles.begin(), numRemainingTriangles.end(), adjacencyOffsets.begin() + 1);
+        std::vector<uint32_t> adjacency(indices.size());
+        {
+            std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t triangle = 0; triangle < numTriangles; ++triangle)
+            {
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    adjacency[fill[indices[triangle * 3 + corner]]++] = static_cast<uint32_t>(triangle);
+                }
+            }
+        }
+
+        std::vector<int32_t> cachePositions(numVertices, -1);
+        std::vector<float> vertexScores(numVertices);
+        for (size_t vertex = 0; vertex < numVertices; ++vertex)
+        {
+            vertexScores[vertex] = scoreTable.GetScore(-1, numRemainingTriangles[vertex]);
+        }
+
+        std::vector<float> triangleScores(numTriangles);
+        uint32_t bestTriangle = InvalidIndex;
+        float bestScore = -1.0f;
+        for (size_t triangle = 0; triangle < numTriangles; ++triangle)
+        {
+            const uint32_t *corners = &indices[triangle * 3];
+            triangleScores[triangle] = vertexScores[corners[0]] + vertexScores[corners[1]] + vertexScores[corners[2]];
+            if (triangleScores[triangle] > bestScore)
+            {
+                bestScore = triangleScores[triangle];
+                bestTriangle = static_cast<uint32_t>(triangle);
+            }
+        }
+
+        std::vector<bool> emitted(numTriangles, false);
+        std::vector<uint32_t> output;
+        output.reserve(indices.size());
+        std::vector<uint32_t> cache, newCache;
+        cache.reserve(ForsythCacheSize + 3);
+        newCache.reserve(ForsythCacheSize + 3);
+        size_t nextUnemitted = 0;
+
+        for (size_t step = 0; step < numTriangles; ++step)
+        {
+            if (bestTriangle == InvalidIndex)
+            {
+                // Nothing in cache has triangles left, continue with next one in input order.
+                while (emitted[nextUnemitted])
+                    ++nextUnemitted;
+                bestTriangle = static_cast<uint32_t>(nextUnemitted);
+            }
+
+            const uint32_t *corners = &indices[bestTriangle * 3];
+            emitted[bestTriangle] = true;
+            output.insert(output.end(), corners, corners + 3);
+
+            newCache.assign(corners, corners + 3);
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                const uint32_t vertex = corners[corner];
+                uint32_t *triangles = &adjacency[adjacencyOffsets[vertex]];
+                uint32_t &numVertexTriangles = numRemainingTriangles[vertex];
+                for (uint32_t slot = 0; slot < numVertexTriangles;)
+                {
+                    if (triangles[slot] == bestTriangle)
+                        std::swap(triangles[slot], triangles[--numVertexTriangles]);
+                    else
+                        ++slot;
+                }
+            }
+            for (const uint32_t vertex: cache)
+            {
+                if (vertex != newCache[0] && vertex != newCache[1] && vertex != newCache[2])
+                    newCache.push_back(vertex);
+            }
+
+            // Rescore everything that was or is in cache, vertices pushed out included.
+            for (size_t position = 0; position < newCache.size(); ++position)
+            {
+                const uint32_t vertex = newCache[position];
+                cachePositions[vertex] = position < ForsythCacheSize ? static_cast<int32_t>(position) : -1;
+                const float score = scoreTable.GetScore(cachePositions[vertex], numRemainingTriangles[vertex]);
+                const float delta = score - vertexScores[vertex];
+                vertexScores[vertex] = score;
+                const uint32_t *triangles = &adjacency[adjacencyOffsets[vertex]];
+                for (uint32_t slot = 0; slot < numRemainingTriangles[vertex]; ++slot)
+                {
+                    triangleScores[triangles[slot]] += delta;
+                }
+            }
+            if (newCache.size() > ForsythCacheSize)
+                newCache.resize(ForsythCacheSize);
+            cache.swap(newCache);
+
+            bestTriangle = InvalidIndex;
+            bestScore = -1.0f;
+            for (const uint32_t vertex: cache)
+            {
+                const uint32_t *triangles = &adjacency[adjacencyOffsets[vertex]];
+                for (uint32_t slot = 0; slot < numRemainingTriangles[vertex]; ++slot)
+                {
+                    if (triangleScores[triangles[slot]] > bestScore && !emitted[triangles[slot]])
+                    {
+                        bestScore = triangleScores[triangles[slot]];
+                        bestTriangle = triangles[slot];
+                    }
+                }
+            }
+        }
+
+        indices.swap(output);
+    }
+
+    void OptimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<Vector> &vertices, float threshold)
+    {
+        const size_t numTriangles = indices.size() / 3;
+        if (numTriangles <= 1)
+            return;
+
+        // Hard boundaries: triangles missing cache with all corners, i.e. where vertex cache order restarts.
+        VertexCacheSimulator cache(vertices.size(), MeshOptimizerCacheSize);
+        std::vector<uint32_t> hardClusters;
+        for (size_t triangle = 0; triangle < numTriangles; ++triangle)
+        {
+            if (cache.AddTriangle(&indices[triangle * 3]) == 3 || triangle == 0)
+                hardClusters.push_back(static_cast<uint32_t>(triangle));
+        }
+        hardClusters.push_back(static_cast<uint32_t>(numTriangles));
+
+        // Soft boundaries: cut a cluster further once the part so far is within threshold of the cluster's ACMR.
+        // Each cut flushes cache, so this is where reordering costs vertex cache efficiency.
+        std::vector<uint32_t> clusters;
+        for (size_t hardCluster = 0; hardCluster + 1 < hardClusters.size(); ++hardCluster)
+        {
+            const uint32_t start = hardClusters[hardCluster];
+            const uint32_t end = hardClusters[hardCluster + 1];
+
+            cache.Flush();
+            uint32_t clusterMisses = 0;
+            for (uint32_t triangle = start; triangle < end; ++triangle)
+            {
+                clusterMisses += cache.AddTriangle(&indices[triangle * 3]);
+            }
+            const float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+            cache.Flush();
+            clusters.push_back(start);
+            uint32_t runStart = start;
+            uint32_t runMisses = 0;
+            for (uint32_t triangle = start; triangle < end; ++triangle)
+            {
+                runMisses += cache.AddTriangle(&indices[triangle * 3]);
+                if (triangle + 1 < end && static_cast<float>(runMisses) <= clusterThreshold * static_cast<float>(triangle + 1 - runStart))
+                {
+                    clusters.push_back(triangle + 1);
+                    cache.Flush();
+                    runStart = triangle + 1;
+                    runMisses = 0;
+                }
+            }
+        }
+        clusters.push_back(static_cast<uint32_t>(numTriangles));
+        const size_t numClusters = clusters.size() - 1;
+
+        Vec3f meshCentroid = Vec3f::Zero();
+        for (const Vector &vertex: vertices)
+        {
+            meshCentroid += vertex.position;
+        }
+        meshCentroid /= static_cast<float>(std::max<size_t>(vertices.size(), 1));
+
+        // Clusters facing away from mesh center are outer surfaces, which should be drawn first.
+        std::vector<float> sortKeys(numClusters);
+        for (size_t cluster = 0; cluster < numClusters; ++cluster)
+        {
+            Vec3f centroid = Vec3f::Zero();
+            Vec3f normal = Vec3f::Zero();
+            float totalArea = 0;
+            for (uint32_t triangle = clusters[cluster]; triangle < clusters[cluster + 1]; ++triangle)
+            {
+                const Vec3f &p0 = vertices[indices[triangle * 3]].position;
+                const Vec3f &p1 = vertices[indices[triangle * 3 + 1]].position;
+                const Vec3f &p2 = vertices[indices[triangle * 3 + 2]].position;
+                const Vec3f cross = (p1 - p0).cross(p2 - p0);
+                const float area = cross.norm();
+                centroid += (p0 + p1 + p2) * (area / 3.0f);
+                normal += cross;
+                totalArea += area;
+            }
+            const float normalLength = normal.norm();
+            sortKeys[cluster] = totalArea > 0 && normalLength > 0 ? (centroid / totalArea - meshCentroid).dot(normal / normalLength) : 0.0f;
+        }
+
+        std::vector<uint32_t> order(numClusters);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+        std::vector<uint32_t> output;
+        output.reserve(indices.size());
+        for (const uint32_t cluster: order)
+        {
+            output.insert(output.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + clusters[cluster + 1] * 3);
+        }
+        indices.swap(output);
+    }
+
+    void OptimizeVertexFetch(std::vector<Vector> &vertices, std::vector<uint32_t> &indices)
+    {
+        std::vector<uint32_t> remap(vertices.size(), InvalidIndex);
+        std::vector<Vector> orderedVertices;
+        orderedVertices.reserve(vertices.size());
+        for (uint32_t &index: indices)
+        {
+            if (remap[index] == InvalidIndex)
+            {
+                remap[index] = static_cast<uint32_t>(orderedVertices.size());
+                orderedVertices.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(orderedVertices);
+    }
+
+    float ComputeACMR(const std::vector<uint32_t> &indices, size_t numVertices, uint32_t cacheSize)
+    {
+        const size_t numTriangles = indices.size() / 3;
+        if (numTriangles == 0)
+            return 0;
+
+        VertexCacheSimulator cache(numVertices, cacheSize);
+        size_t misses = 0;
+        for (size_t triangle = 0; triangle < numTriangles; ++triangle)
+        {
+            misses += cache.AddTriangle(&indices[triangle * 3]);
+        }
+        return static_cast<float>(misses) / static_cast<float>(numTriangles);
+    }
+
+    BoundingSphere ComputeBoundingSphere(const std::vector<Vector> &vertices)
+    {
+        BoundingSphere sphere;
+        if (vertices.empty())
+            return sphere;
+
+        Vec3f minPosition = vertices[0].position, maxPosition = vertices[0].position;
+        for (const Vector &vertex: vertices)
+        {
+            minPosition = minPosition.cwiseMin(vertex.position);
+            maxPosition = maxPosition.cwiseMax(vertex.position);
+        }
+        sphere.center = (minPosition + maxPosition) * 0.5f;
+
+        float radiusSquared = 0;
+        for (const Vector &vertex: vertices)
+        {
+            radiusSquared = std::max(radiusSquared, (vertex.position - sphere.center).squaredNorm());
+        }
+        sphere.radius = std::sqrt(radiusSquared);
+        return sphere;
+    }
+}
@@ -0,0 +1,347 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Asset/MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#include "Asset/MeshOptimizer.h"
+
+namespace Koala
+{
+    // Sum of area weighted squared distances to planes, as symmetric matrix A, vector b and constant c:
+    // error(p) = p'Ap + 2b'p + c.
+    struct Quadric
+    {
+        double a00{0}, a01{0}, a02{0}, a11{0}, a12{0}, a22{0};
+        double b0{0}, b1{0}, b2{0};
+        double c{0};
+        double weight{0};
+
+        // Plane n.p + d = 0, n normalized.
+        void AddPlane(const Vec3d &normal, double distance, double planeWeight)
+        {
+            const double x = normal.x(), y = normal.y(), z = normal.z();
+            a00 += planeWeight * x * x;
+            a01 += planeWeight * x * y;
+            a02 += planeWeight * x * z;
+            a11 += planeWeight * y * y;
+            a12 += planeWeight * y * z;
+            a22 += planeWeight * z * z;
+            b0 += planeWeight * distance * x;
+            b1 += planeWeight * distance * y;
+            b2 += planeWeight * distance * z;
+            c += planeWeight * distance * distance;
+            weight += planeWeight;
+        }
+
+        Quadric& operator+=(const Quadric &other)
+        {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02;
+            a11 += other.a11; a12 += other.a12; a22 += other.a22;
+            b0 += other.b0; b1 += other.b1; b2 += other.b2;
+            c += other.c;
+            weight += other.weight;
+            return *this;
+        }
+
+        NODISCARD double Evaluate(const Vec3f &position) const
+        {
+            const double x = position.x(), y = position.y(), z = position.z();
+            const double error = a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                2 * (b0 * x + b1 * y + b2 * z) + c;
+            return std::max(error, 0.0);
+        }
+    };
+
+    struct EdgeCollapse
+    {
+        uint32_t from;
+        uint32_t to;
+        float    error;
+    };
+
+    // For each vertex, index of the first vertex with bitwise equal position.
+    static std::vector<uint32_t> BuildPositionRemap(const std::vector<Vector> &vertices)
+    {
+        constexpr uint32_t EmptySlot = ~0u;
+        size_t tableSize = 16;
+        while (tableSize < vertices.size() * 2)
+            tableSize *= 2;
+        std::vector<uint32_t> table(tableSize, EmptySlot);
+
+        std::vector<uint32_t> remap(vertices.size());
+        for (uint32_t index = 0; index < vertices.size(); ++index)
+        {
+            uint32_t words[3];
+            std::memcpy(words, vertices[index].position.data(), sizeof(words));
+            uint32_t hash = (words[0] * 73856093u) ^ (words[1] * 19349663u) ^ (words[2] * 83492791u);
+            hash ^= hash >> 16;
+
+            size_t slot = hash & (tableSize - 1);
+            while (table[slot] != EmptySlot &&
+                std::memcmp(vertices[table[slot]].position.data(), words, sizeof(words)) != 0)
+            {
+                slot = (slot + 1) & (tableSize - 1);
+            }
+            if (table[slot] == EmptySlot)
+                table[slot] = index;
+            remap[index] = table[slot];
+        }
+        return remap;
+    }
+
+    // Triangles around each vertex: triangles of vertex v are vertexTriangles[offsets[v], offsets[v + 1]).
+    static void BuildVertexTriangles(const std::vector<uint32_t> &indices, size_t numVertices,
+        std::vector<uint32_t> &offsets, std::vector<uint32_t> &vertexTriangles)
+    {
+        offsets.assign(numVertices + 1, 0);
+        for (const uint32_t index: indices)
+        {
+            ++offsets[index + 1];
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+        vertexTriangles.resize(indices.size());
+        std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+        for (size_t corner = 0; corner < indices.size(); ++corner)
+        {
+            vertexTriangles[cursors[indices[corner]]++] = static_cast<uint32_t>(corner / 3);
+        }
+    }
+
+    std::vector<uint32_t> SimplifyMesh(const std::vector<Vector> &vertices, const std::vector<uint32_t> &indices,
+        size_t targetIndexCount, float targetError, float *outError)
+    {
+        std::vector<uint32_t> result(indices);
+        float maxError = 0;
+        if (outError)
+            *outError = 0;
+        if (result.size() <= targetIndexCount || vertices.empty())
+            return result;
+
+        // Work in unit space, so that errors do not depend on mesh scale.
+        const size_t numVertices = vertices.size();
+        const BoundingSphere bounds = ComputeBoundingSphere(vertices);
+        const float positionScale = bounds.radius > 0 ? 1.0f / bounds.radius : 1.0f;
+        std::vector<Vec3f> positions(numVertices);
+        for (size_t index = 0; index < numVertices; ++index)
+        {
+            positions[index] = (vertices[index].position - bounds.center) * positionScale;
+        }
+
+        // Topology and quadrics are per position, seam vertices share them.
+        const std::vector<uint32_t> positionRemap = BuildPositionRemap(vertices);
+        std::vector<uint32_t> numWedges(numVertices, 0);
+        for (size_t index = 0; index < numVertices; ++index)
+        {
+            ++numWedges[positionRemap[index]];
+        }
+
+        // An edge without opposite edge is on border.
+        std::vector<uint64_t> edges;
+        edges.reserve(result.size());
+        for (size_t corner = 0; corner < result.size(); ++corner)
+        {
+            const size_t next = corner % 3 == 2 ? corner - 2 : corner + 1;
+            edges.push_back(static_cast<uint64_t>(positionRemap[result[corner]]) << 32 | positionRemap[result[next]]);
+        }
+        std::sort(edges.begin(), edges.end());
+        std::vector<uint8_t> bBorder(numVertices, 0);
+        for (const uint64_t edge: edges)
+        {
+            const uint64_t opposite = edge << 32 | edge >> 32;
+            if (!std::binary_search(edges.begin(), edges.end(), opposite))
+            {
+                bBorder[edge >> 32] = 1;
+                bBorder[edge & 0xFFFFFFFFu] = 1;
+            }
+        }
+        std::vector<uint8_t> bLocked(numVertices);
+        for (size_t index = 0; index < numVertices; ++index)
+        {
+            const uint32_t position = positionRemap[index];
+            bLocked[index] = numWedges[position] > 1 || bBorder[position];
+        }
+
+        std::vector<Quadric> quadrics(numVertices);
+        for (size_t corner = 0; corner < result.size(); corner += 3)
+        {
+            const Vec3f &p0 = positions[result[corner]], &p1 = positions[result[corner + 1]], &p2 = positions[result[corner + 2]];
+            Vec3d normal = (p1 - p0).cross(p2 - p0).cast<double>();
+            const double doubleArea = normal.norm();
+            if (doubleArea == 0)
+                continue;
+            normal /= doubleArea;
+
+            Quadric quadric;
+            quadric.AddPlane(normal, -normal.dot(p0.cast<double>()), doubleArea * 0.5);
+            for (int k = 0; k < 3; ++k)
+            {
+                quadrics[positionRemap[result[corner + k]]] += quadric;
+            }
+        }
+
+        std::vector<uint32_t> triangleOffsets, vertexTriangles;
+        std::vector<EdgeCollapse> candidates;
+        std::vector<uint32_t> collapseTargets(numVertices);
+        std::vector<uint8_t> bTouched(numVertices);
+        std::vector<uint32_t> neighboursFrom, neighboursTo;
+
+        auto collectNeighbours = [&](uint32_t vertex, std::vector<uint32_t> &neighbours)
+        {
+            neighbours.clear();
+            for (uint32_t slot = triangleOffsets[vertex]; slot < triangleOffsets[vertex + 1]; ++slot)
+            {
+                const uint32_t *triangle = &result[vertexTriangles[slot] * 3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    neighbours.push_back(positionRemap[triangle[k]]);
+                }
+            }
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        };
+
+        // Collapse must not flip any remaining triangle, and the edge must have at most two common neighbours,
+        // otherwise surface would pinch into non-manifold fins.
+        auto isCollapseValid = [&](uint32_t from, uint32_t to)
+        {
+            const uint32_t toPosition = positionRemap[to];
+            for (uint32_t slot = triangleOffsets[from]; slot < triangleOffsets[from + 1]; ++slot)
+            {
+                const uint32_t *triangle = &result[vertexTriangles[slot] * 3];
+                if (positionRemap[triangle[0]] == toPosition || positionRemap[triangle[1]] == toPosition ||
+                    positionRemap[triangle[2]] == toPosition)
+                {
+                    continue;
+                }
+
+                Vec3f corners[3] = {positions[triangle[0]], positions[triangle[1]], positions[triangle[2]]};
+                const Vec3f oldNormal = (corners[1] - corners[0]).cross(corners[2] - corners[0]);
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (triangle[k] == from)
+                        corners[k] = positions[to];
+                }
+                const Vec3f newNormal = (corners[1] - corners[0]).cross(corners[2] - corners[0]);
+                if (oldNormal.dot(newNormal) <= 0)
+                    return false;
+            }
+
+            collectNeighbours(from, neighboursFrom);
+            collectNeighbours(to, neighboursTo);
+            size_t numCommon = 0;
+            for (const uint32_t neighbour: neighboursFrom)
+            {
+                if (neighbour != positionRemap[from] && neighbour != toPosition &&
+                    std::binary_search(neighboursTo.begin(), neighboursTo.end(), neighbour))
+                {
+                    ++numCommon;
+                }
+            }
+            return numCommon <= 2;
+        };
+
+        // Each pass collapses an independent set of cheapest edges: a vertex and its neighbours take part in one collapse,
+        // so that validity checks hold while the pass goes on.
+        while (result.size() > targetIndexCount)
+        {
+            BuildVertexTriangles(result, numVertices, triangleOffsets, vertexTriangles);
+
+            candidates.clear();
+            auto addCandidate = [&](uint32_t from, uint32_t to)
+            {
+                if (bLocked[from] || positionRemap[from] == positionRemap[to])
+                    return;
+                Quadric quadric = quadrics[positionRemap[from]];
+                quadric += quadrics[positionRemap[to]];
+                const double meanError = quadric.Evaluate(positions[to]) / std::max(quadric.weight, 1e-20);
+                candidates.push_back({from, to, static_cast<float>(std::sqrt(meanError))});
+            };
+            for (size_t corner = 0; corner < result.size(); ++corner)
+            {
+                const uint32_t a = result[corner];
+                const uint32_t b = result[corner % 3 == 2 ? corner - 2 : corner + 1];
+                // Interior edges are seen from both triangles, take them once. Border edges have both ends locked.
+                if (a > b)
+                    continue;
+                addCandidate(a, b);
+                addCandidate(b, a);
+            }
+            std::sort(candidates.begin(), candidates.end(), [](const EdgeCollapse &lhs, const EdgeCollapse &rhs)
+            {
+                return lhs.error < rhs.error;
+            });
+
+            std::iota(collapseTargets.begin(), collapseTargets.end(), 0u);
+            std::fill(bTouched.begin(), bTouched.end(), 0);
+            const size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+            size_t numRemoved = 0;
+            size_t numCollapses = 0;
+            for (const EdgeCollapse &collapse: candidates)
+            {
+                if (collapse.error > targetError || numRemoved >= trianglesToRemove)
+                    break;
+                if (bTouched[collapse.from] || bTouched[collapse.to] || !isCollapseValid(collapse.from, collapse.to))
+                    continue;
+
+                collapseTargets[collapse.from] = collapse.to;
+                quadrics[positionRemap[collapse.to]] += quadrics[positionRemap[collapse.from]];
+                for (uint32_t slot = triangleOffsets[collapse.from]; slot < triangleOffsets[collapse.from + 1]; ++slot)
+                {
+                    const uint32_t *triangle = &result[vertexTriangles[slot] * 3];
+                    bool bRemoved = false;
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        bTouched[triangle[k]] = 1;
+                        bRemoved |= positionRemap[triangle[k]] == positionRemap[collapse.to];
+                    }
+                    numRemoved += bRemoved;
+                }
+                bTouched[collapse.to] = 1;
+                maxError = std::max(maxError, collapse.error);
+                ++numCollapses;
+            }
+            if (numCollapses == 0)
+                break;
+
+            size_t numKept = 0;
+            for (size_t corner = 0; corner < result.size(); corner += 3)
+            {
+                const uint32_t a = collapseTargets[result[corner]];
+                const uint32_t b = collapseTargets[result[corner + 1]];
+                const uint32_t c = collapseTargets[result[corner + 2]];
+                const uint32_t pa = positionRemap[a], pb = positionRemap[b], pc = positionRemap[c];
+                if (pa == pb || pb == pc || pc == pa)
+                    continue;
+                result[numKept++] = a;
+                result[numKept++] = b;
+                result[numKept++] = c;
+            }
+            result.resize(numKept);
+        }
+
+        if (outError)
+            *outError = maxError;
+        return result;
+    }
+}
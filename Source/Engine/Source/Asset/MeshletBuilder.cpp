@@ -0,0 +1,221 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Asset/MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace Koala
+{
+    constexpr int16_t NotInMeshlet = -1;
+
+    void ComputeMeshletBounds(Meshlet &meshlet, const std::vector<Vector> &vertices,
+        const uint32_t *meshletVertices, const uint8_t *meshletTriangles)
+    {
+        const uint32_t *localVertices = meshletVertices + meshlet.firstVertex;
+        const uint8_t *localTriangles = meshletTriangles + meshlet.firstTriangle * 3;
+        auto position = [&](uint8_t localIndex) -> const Vec3f& { return vertices[localVertices[localIndex]].position; };
+
+        // Sphere around box center, as for whole mesh bounds.
+        Vec3f minPosition = position(0), maxPosition = position(0);
+        for (uint32_t index = 1; index < meshlet.numVertices; ++index)
+        {
+            minPosition = minPosition.cwiseMin(position(index));
+            maxPosition = maxPosition.cwiseMax(position(index));
+        }
+        const Vec3f center = (minPosition + maxPosition) * 0.5f;
+        float radiusSquared = 0;
+        for (uint32_t index = 0; index < meshlet.numVertices; ++index)
+        {
+            radiusSquared = std::max(radiusSquared, (position(index) - center).squaredNorm());
+        }
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            meshlet.center[axis] = center[axis];
+        }
+        meshlet.radius = std::sqrt(radiusSquared);
+
+        // Cone axis is average normal, apex is moved back along it until it is behind all triangle planes,
+        // so that a view direction within the cone sees all triangles from behind.
+        std::vector<Vec3f> normals, planePoints;
+        normals.reserve(meshlet.numTriangles);
+        planePoints.reserve(meshlet.numTriangles);
+        Vec3f averageNormal(0, 0, 0);
+        for (uint32_t triangle = 0; triangle < meshlet.numTriangles; ++triangle)
+        {
+            const Vec3f &p0 = position(localTriangles[triangle * 3]);
+            const Vec3f normal = (position(localTriangles[triangle * 3 + 1]) - p0).cross(position(localTriangles[triangle * 3 + 2]) - p0);
+            const float length = normal.norm();
+            if (length == 0)
+                continue;
+            normals.push_back(normal / length);
+            planePoints.push_back(p0);
+            averageNormal += normals.back();
+        }
+
+        meshlet.coneCutoff = 1;
+        const float averageLength = averageNormal.norm();
+        Vec3f axis = averageLength > 0 ? Vec3f(averageNormal / averageLength) : Vec3f(1, 0, 0);
+        float minDot = 1;
+        for (const Vec3f &normal: normals)
+        {
+            minDot = std::min(minDot, normal.dot(axis));
+        }
+
+        float apexDistance = 0;
+        // Normals spreading over about 84 degrees from axis make the cone useless.
+        const bool bConeUsable = !normals.empty() && averageLength > 0 && minDot > 0.1f;
+        if (bConeUsable)
+        {
+            for (size_t index = 0; index < normals.size(); ++index)
+            {
+                apexDistance = std::max(apexDistance, (center - planePoints[index]).dot(normals[index]) / normals[index].dot(axis));
+            }
+            meshlet.coneCutoff = std::sqrt(std::max(0.0f, 1 - minDot * minDot));
+        }
+        const Vec3f apex = center - axis * apexDistance;
+        for (int component = 0; component < 3; ++component)
+        {
+            meshlet.coneApex[component] = apex[component];
+            meshlet.coneAxis[component] = axis[component];
+        }
+    }
+
+    void BuildMeshlets(const std::vector<Vector> &vertices, const uint32_t *indices, size_t numIndices,
+        std::vector<Meshlet> &meshlets, std::vector<uint32_t> &meshletVertices, std::vector<uint8_t> &meshletTriangles,
+        uint32_t maxVertices, uint32_t maxTriangles)
+    {
+        maxVertices = std::clamp(maxVertices, 3u, 256u);
+        maxTriangles = std::max(maxTriangles, 1u);
+        const size_t numVertices = vertices.size();
+        const uint32_t numTriangles = static_cast<uint32_t>(numIndices / 3);
+        if (numTriangles == 0)
+            return;
+
+        // Triangles of vertex v are vertexTriangles[offsets[v], offsets[v + 1]).
+        std::vector<uint32_t> offsets(numVertices + 1, 0);
+        for (size_t corner = 0; corner < numTriangles * 3; ++corner)
+        {
+            ++offsets[indices[corner] + 1];
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        std::vector<uint32_t> vertexTriangles(numTriangles * 3);
+        {
+            std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+            for (size_t corner = 0; corner < numTriangles * 3; ++corner)
+            {
+                vertexTriangles[cursors[indices[corner]]++] = static_cast<uint32_t>(corner / 3);
+            }
+        }
+
+        std::vector<uint8_t> bEmitted(numTriangles, 0);
+        std::vector<int16_t> localIndices(numVertices, NotInMeshlet);
+        uint32_t nextSeed = 0;
+
+        Meshlet meshlet;
+        meshlet.firstVertex = static_cast<uint32_t>(meshletVertices.size());
+        meshlet.firstTriangle = static_cast<uint32_t>(meshletTriangles.size() / 3);
+        Vec3f positionSum(0, 0, 0);
+
+        auto flush = [&]()
+        {
+            for (uint32_t index = 0; index < meshlet.numVertices; ++index)
+            {
+                localIndices[meshletVertices[meshlet.firstVertex + index]] = NotInMeshlet;
+            }
+            ComputeMeshletBounds(meshlet, vertices, meshletVertices.data(), meshletTriangles.data());
+            meshlets.push_back(meshlet);
+
+            meshlet = Meshlet();
+            meshlet.firstVertex = static_cast<uint32_t>(meshletVertices.size());
+            meshlet.firstTriangle = static_cast<uint32_t>(meshletTriangles.size() / 3);
+            positionSum = Vec3f(0, 0, 0);
+        };
+
+        // Distinct corners not in meshlet yet.
+        auto numNewVertices = [&](uint32_t triangle)
+        {
+            const uint32_t *corners = indices + triangle * 3;
+            return static_cast<int>(localIndices[corners[0]] == NotInMeshlet) +
+                (localIndices[corners[1]] == NotInMeshlet && corners[1] != corners[0]) +
+                (localIndices[corners[2]] == NotInMeshlet && corners[2] != corners[0] && corners[2] != corners[1]);
+        };
+
+        for (uint32_t numLeft = numTriangles; numLeft > 0; --numLeft)
+        {
+            // Best adjacent triangle: fewest new vertices, then closest centroid. Triangles are visited in a fixed order.
+            uint32_t best = ~0u;
+            int bestNewVertices = 4;
+            float bestDistance = 0;
+            const Vec3f meshletCenter = meshlet.numVertices > 0 ? Vec3f(positionSum / static_cast<float>(meshlet.numVertices)) : Vec3f(0, 0, 0);
+            for (uint32_t local = 0; local < meshlet.numVertices; ++local)
+            {
+                const uint32_t vertex = meshletVertices[meshlet.firstVertex + local];
+                for (uint32_t slot = offsets[vertex]; slot < offsets[vertex + 1]; ++slot)
+                {
+                    const uint32_t triangle = vertexTriangles[slot];
+                    if (bEmitted[triangle])
+                        continue;
+                    const int newVertices = numNewVertices(triangle);
+                    if (meshlet.numVertices + newVertices > maxVertices || newVertices > bestNewVertices)
+                        continue;
+                    const uint32_t *corners = indices + triangle * 3;
+                    const Vec3f centroid = (vertices[corners[0]].position + vertices[corners[1]].position + vertices[corners[2]].position) / 3.0f;
+                    const float distance = (centroid - meshletCenter).squaredNorm();
+                    if (newVertices < bestNewVertices || distance < bestDistance)
+                    {
+                        best = triangle;
+                        bestNewVertices = newVertices;
+                        bestDistance = distance;
+                    }
+                }
+            }
+
+            // Nothing adjacent fits, start next meshlet from first triangle left.
+            if (best == ~0u)
+            {
+                if (meshlet.numTriangles > 0)
+                    flush();
+                while (bEmitted[nextSeed])
+                    ++nextSeed;
+                best = nextSeed;
+            }
+
+            const uint32_t *corners = indices + best * 3;
+            for (int k = 0; k < 3; ++k)
+            {
+                if (localIndices[corners[k]] == NotInMeshlet)
+                {
+                    localIndices[corners[k]] = static_cast<int16_t>(meshlet.numVertices++);
+                    meshletVertices.push_back(corners[k]);
+                    positionSum += vertices[corners[k]].position;
+                }
+                meshletTriangles.push_back(static_cast<uint8_t>(localIndices[corners[k]]));
+            }
+            ++meshlet.numTriangles;
+            bEmitted[best] = 1;
+
+            if (meshlet.numTriangles == maxTriangles)
+                flush();
+        }
+        if (meshlet.numTriangles > 0)
+            flush();
+    }
+}
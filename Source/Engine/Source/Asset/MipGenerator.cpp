@@ -0,0 +1,407 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Asset/MipGenerator.h"
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+
+#include "AsyncWorker/AsyncTask.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KOALA_MIP_GENERATOR_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace Koala
+{
+    // Mips are filtered as 4 floats per pixel whatever channels format has, so one pixel fills one SSE register.
+    constexpr uint32_t MipFilterChannels = 4;
+    // Levels with fewer source pixels are filtered on calling thread.
+    constexpr size_t MinPixelsForParallelMips = 65536;
+    // Half width of windowed sinc filters, in pixels of the smaller mip.
+    constexpr float MipSincFilterRadius = 3.0f;
+    constexpr float MipKaiserAlpha = 4.0f;
+    // Weights smaller than this are dropped, e.g. sinc at whole pixels that is not exactly 0 in float.
+    constexpr float MipMinFilterWeight = 1e-6f;
+    // Segments of the linear to sRGB table over [0, 1].
+    constexpr uint32_t LinearToSRGBTableSize = 4096;
+
+    struct MipChannelLayout
+    {
+        uint32_t numChannels{0};
+        // 1 and 2 are unsigned normalized, 4 is float.
+        uint32_t channelBytes{0};
+    };
+
+    static MipChannelLayout GetMipChannelLayout(EPixelFormat format)
+    {
+        switch (format)
+        {
+        case PF_R8: return {1, 1};
+        case PF_R8G8: return {2, 1};
+        case PF_R8G8B8: return {3, 1};
+        case PF_R8G8B8A8: return {4, 1};
+        case PF_R16: return {1, 2};
+        case PF_R16G16: return {2, 2};
+        case PF_R16G16B16: return {3, 2};
+        case PF_R16G16B16A16: return {4, 2};
+        case PF_R32: return {1, 4};
+        case PF_R32G32: return {2, 4};
+        case PF_R32G32B32: return {3, 4};
+        case PF_R32G32B32A32: return {4, 4};
+        default: return {};
+        }
+    }
+
+    static float SRGBToLinear(float value)
+    {
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    static float LinearToSRGB(float value)
+    {
+        return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    }
+
+    struct ChannelTables
+    {
+        float unormToFloat[256];
+        float srgbToLinear[256];
+        // Encoded value at each segment boundary, interpolated in between.
+        float linearToSRGB[LinearToSRGBTableSize + 1];
+
+        ChannelTables()
+        {
+            for (uint32_t value = 0; value < 256; ++value)
+            {
+                unormToFloat[value] = static_cast<float>(value) / 255.0f;
+                srgbToLinear[value] = SRGBToLinear(unormToFloat[value]);
+            }
+            for (uint32_t index = 0; index <= LinearToSRGBTableSize; ++index)
+                linearToSRGB[index] = LinearToSRGB(static_cast<float>(index) / LinearToSRGBTableSize);
+        }
+
+        NODISCARD FORCEINLINE float EncodeSRGB(float linear) const
+        {
+            const float position = std::clamp(linear, 0.0f, 1.0f) * LinearToSRGBTableSize;
+            const uint32_t index = std::min(static_cast<uint32_t>(position), LinearToSRGBTableSize - 1);
+            const float fraction = position - static_cast<float>(index);
+            return linearToSRGB[index] + (linearToSRGB[index + 1] - linearToSRGB[index]) * fraction;
+        }
+    };
+
+    static const ChannelTables& GetChannelTables()
+    {
+        static const ChannelTables tables;
+        return tables;
+    }
+
+    // Decode row of pixels into 4 floats each, channels missing from format are 0.
+    static void DecodeRow(const uint8_t *source, float *dest, uint32_t numPixels, MipChannelLayout layout, uint32_t numSRGBChannels)
+    {
+        std::memset(dest, 0, sizeof(float) * MipFilterChannels * numPixels);
+        const ChannelTables &tables = GetChannelTables();
+        for (uint32_t pixel = 0; pixel < numPixels; ++pixel)
+        {
+            float *destPixel = dest + pixel * MipFilterChannels;
+            for (uint32_t channel = 0; channel < layout.numChannels; ++channel)
+            {
+                const uint8_t *sourceChannel = source + (pixel * layout.numChannels + channel) * layout.channelBytes;
+                if (layout.channelBytes == 1)
+                {
+                    destPixel[channel] = channel < numSRGBChannels ? tables.srgbToLinear[*sourceChannel] : tables.unormToFloat[*sourceChannel];
+                }
+                else if (layout.channelBytes == 2)
+                {
+                    uint16_t value;
+                    std::memcpy(&value, sourceChannel, sizeof(value));
+                    destPixel[channel] = static_cast<float>(value) / 65535.0f;
+                }
+                else
+                {
+                    std::memcpy(destPixel + channel, sourceChannel, sizeof(float));
+                }
+            }
+        }
+    }
+
+    // Encode row of 4 float pixels into format, unsigned normalized channels are clamped and rounded.
+    static void EncodeRow(const float *source, uint8_t *dest, uint32_t numPixels, MipChannelLayout layout, uint32_t numSRGBChannels)
+    {
+        const ChannelTables &tables = GetChannelTables();
+        for (uint32_t pixel = 0; pixel < numPixels; ++pixel)
+        {
+            const float *sourcePixel = source + pixel * MipFilterChannels;
+            for (uint32_t channel = 0; channel < layout.numChannels; ++channel)
+            {
+                uint8_t *destChannel = dest + (pixel * layout.numChannels + channel) * layout.channelBytes;
+                const float value = sourcePixel[channel];
+                if (layout.channelBytes == 1)
+                {
+                    const float encoded = channel < numSRGBChannels ? tables.EncodeSRGB(value) : std::clamp(value, 0.0f, 1.0f);
+                    *destChannel = static_cast<uint8_t>(encoded * 255.0f + 0.5f);
+                }
+                else if (layout.channelBytes == 2)
+                {
+                    const uint16_t encoded = static_cast<uint16_t>(std::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+                    std::memcpy(destChannel, &encoded, sizeof(encoded));
+                }
+                else
+                {
+                    std::memcpy(destChannel, &value, sizeof(float));
+                }
+            }
+        }
+    }
+
+    static float Sinc(float x)
+    {
+        if (std::abs(x) < 1e-5f)
+            return 1.0f;
+        const float angle = std::numbers::pi_v<float> * x;
+        return std::sin(angle) / angle;
+    }
+
+    // Modified Bessel function of the first kind, order 0.
+    static float BesselI0(float x)
+    {
+        const float halfSquared = x * x * 0.25f;
+        float sum = 1.0f, term = 1.0f;
+        for (uint32_t k = 1; k < 32 && term > sum * 1e-8f; ++k)
+        {
+            term *= halfSquared / static_cast<float>(k * k);
+            sum += term;
+        }
+        return sum;
+    }
+
+    // Weight of filter at distance in pixels of the smaller mip, sinc filters only.
+    static float EvaluateSincFilter(EMipFilter filter, float distance)
+    {
+        const float t = distance / MipSincFilterRadius;
+        if (t <= -1.0f || t >= 1.0f)
+            return 0.0f;
+        if (filter == EMipFilter::Lanczos)
+            return Sinc(distance) * Sinc(t);
+        return Sinc(distance) * BesselI0(MipKaiserAlpha * std::sqrt(1.0f - t * t)) / BesselI0(MipKaiserAlpha);
+    }
+
+    // Filter taps along one axis: for each destination pixel numTaps source pixels (clamped to edge) and their
+    // weights, which sum to 1.
+    struct MipFilterTaps
+    {
+        uint32_t              numTaps{0};
+        std::vector<uint32_t> indices;
+        std::vector<float>    weights;
+    };
+
+    static MipFilterTaps ComputeFilterTaps(EMipFilter filter, uint32_t sourceSize, uint32_t destSize)
+    {
+        // Pixel x of destination covers [x * scale, (x + 1) * scale) of source.
+        const float scale = static_cast<float>(sourceSize) / static_cast<float>(destSize);
+        const float radius = (filter == EMipFilter::Box ? 0.5f : MipSincFilterRadius) * scale;
+        const uint32_t maxTaps = static_cast<uint32_t>(std::ceil(2.0f * radius)) + 2;
+
+        std::vector<float> rawWeights(static_cast<size_t>(destSize) * maxTaps);
+        std::vector<int64_t> firstSources(destSize);
+        MipFilterTaps taps;
+        for (uint32_t x = 0; x < destSize; ++x)
+        {
+            const float center = (static_cast<float>(x) + 0.5f) * scale;
+            const int64_t firstSource = static_cast<int64_t>(std::floor(center - radius));
+            float *weights = rawWeights.data() + static_cast<size_t>(x) * maxTaps;
+            float sum = 0.0f;
+            for (uint32_t tap = 0; tap < maxTaps; ++tap)
+            {
+                const float sourceStart = static_cast<float>(firstSource + tap);
+                float weight;
+                if (filter == EMipFilter::Box)
+                    weight = std::max(0.0f, std::min(sourceStart + 1.0f, center + radius) - std::max(sourceStart, center - radius));
+                else
+                    weight = EvaluateSincFilter(filter, (sourceStart + 0.5f - center) / scale);
+                weights[tap] = weight;
+                sum += weight;
+            }
+            // Drop negligible weights at both ends, the widest remaining span decides number of taps.
+            uint32_t first = 0, last = maxTaps;
+            for (uint32_t tap = 0; tap < maxTaps; ++tap)
+            {
+                weights[tap] /= sum;
+                if (std::abs(weights[tap]) < MipMinFilterWeight)
+                    weights[tap] = 0.0f;
+            }
+            while (first < maxTaps - 1 && weights[first] == 0.0f)
+                ++first;
+            while (last > first + 1 && weights[last - 1] == 0.0f)
+                --last;
+            std::memmove(weights, weights + first, sizeof(float) * (last - first));
+            std::fill(weights + (last - first), weights + maxTaps, 0.0f);
+            firstSources[x] = firstSource + first;
+            taps.numTaps = std::max(taps.numTaps, last - first);
+        }
+
+        taps.indices.resize(static_cast<size_t>(destSize) * taps.numTaps);
+        taps.weights.resize(taps.indices.size());
+        for (uint32_t x = 0; x < destSize; ++x)
+        {
+            for (uint32_t tap = 0; tap < taps.numTaps; ++tap)
+            {
+                const size_t index = static_cast<size_t>(x) * taps.numTaps + tap;
+                taps.indices[index] = static_cast<uint32_t>(std::clamp<int64_t>(firstSources[x] + tap, 0, sourceSize - 1));
+                taps.weights[index] = rawWeights[static_cast<size_t>(x) * maxTaps + tap];
+            }
+        }
+        return taps;
+    }
+
+    // Filter row of 4 float pixels into destination pixels of taps.
+    static void FilterRowHorizontal(const float *source, float *dest, uint32_t destWidth, const MipFilterTaps &taps)
+    {
+        const uint32_t *indices = taps.indices.data();
+        const float *weights = taps.weights.data();
+        for (uint32_t x = 0; x < destWidth; ++x, indices += taps.numTaps, weights += taps.numTaps)
+        {
+#if KOALA_MIP_GENERATOR_SSE2
+            __m128 sum = _mm_setzero_ps();
+            for (uint32_t tap = 0; tap < taps.numTaps; ++tap)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[tap]), _mm_loadu_ps(source + indices[tap] * MipFilterChannels)));
+            _mm_storeu_ps(dest + x * MipFilterChannels, sum);
+#else
+            float sum[MipFilterChannels] = {};
+            for (uint32_t tap = 0; tap < taps.numTaps; ++tap)
+            {
+                const float *sourcePixel = source + indices[tap] * MipFilterChannels;
+                for (uint32_t channel = 0; channel < MipFilterChannels; ++channel)
+                    sum[channel] += weights[tap] * sourcePixel[channel];
+            }
+            std::memcpy(dest + x * MipFilterChannels, sum, sizeof(sum));
+#endif
+        }
+    }
+
+    // Weighted sum of rows, numFloats is a multiple of 4.
+    static void FilterRowVertical(const float *const *sourceRows, const float *weights, uint32_t numTaps, float *dest, size_t numFloats)
+    {
+#if KOALA_MIP_GENERATOR_SSE2
+        for (size_t index = 0; index < numFloats; index += 4)
+        {
+            __m128 sum = _mm_setzero_ps();
+            for (uint32_t tap = 0; tap < numTaps; ++tap)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[tap]), _mm_loadu_ps(sourceRows[tap] + index)));
+            _mm_storeu_ps(dest + index, sum);
+        }
+#else
+        for (size_t index = 0; index < numFloats; ++index)
+        {
+            float sum = 0.0f;
+            for (uint32_t tap = 0; tap < numTaps; ++tap)
+                sum += weights[tap] * sourceRows[tap][index];
+            dest[index] = sum;
+        }
+#endif
+    }
+
+    uint32_t GetNumMipsInChain(uint32_t width, uint32_t height)
+    {
+        return static_cast<uint32_t>(std::bit_width(std::max(width, height)));
+    }
+
+    std::vector<std::vector<uint8_t>> GenerateMips(EPixelFormat format, const uint8_t *data, uint32_t width, uint32_t height,
+        const MipGenerationSettings &settings)
+    {
+        const MipChannelLayout layout = GetMipChannelLayout(format);
+        if (layout.numChannels == 0 || width == 0 || height == 0)
+            return {};
+        // Alpha stays linear, other channels are color.
+        const uint32_t numSRGBChannels = settings.bSRGB && layout.channelBytes == 1 ? std::min(layout.numChannels, 3u) : 0;
+        uint32_t numMips = GetNumMipsInChain(width, height);
+        if (settings.maxMips != 0)
+            numMips = std::min(numMips, settings.maxMips);
+
+        std::vector<std::vector<uint8_t>> mips(numMips);
+        mips[0].assign(data, data + ComputeImageSize(format, width, height));
+        if (numMips == 1)
+            return mips;
+
+        // Previous mip as 4 floats per pixel, mip 0 is decoded row by row as it is filtered instead.
+        std::vector<float> sourcePixels, destPixels;
+        const size_t mip0RowBytes = static_cast<size_t>(width) * layout.numChannels * layout.channelBytes;
+        uint32_t sourceWidth = width, sourceHeight = height;
+        for (uint32_t mip = 1; mip < numMips; ++mip)
+        {
+            const uint32_t destWidth = std::max(sourceWidth >> 1, 1u);
+            const uint32_t destHeight = std::max(sourceHeight >> 1, 1u);
+            const size_t sourceRowFloats = static_cast<size_t>(sourceWidth) * MipFilterChannels;
+            const size_t destRowFloats = static_cast<size_t>(destWidth) * MipFilterChannels;
+            const size_t destRowBytes = static_cast<size_t>(destWidth) * layout.numChannels * layout.channelBytes;
+            const MipFilterTaps horizontalTaps = ComputeFilterTaps(settings.filter, sourceWidth, destWidth);
+            const MipFilterTaps verticalTaps = ComputeFilterTaps(settings.filter, sourceHeight, destHeight);
+            // Last mip is only encoded.
+            const bool bKeepPixels = mip + 1 < numMips;
+            destPixels.resize(bKeepPixels ? destRowFloats * destHeight : 0);
+            mips[mip].resize(ComputeImageSize(format, destWidth, destHeight));
+
+            ParallelForRanges(destHeight, static_cast<size_t>(sourceWidth) * sourceHeight >= MinPixelsForParallelMips, [&](uint32_t firstRow, uint32_t endRow)
+            {
+                // Source rows filtered horizontally, in a ring holding rows of one destination row's taps. Taps of
+                // a destination row are consecutive source rows, so none of them share a slot.
+                const uint32_t ringSize = verticalTaps.numTaps;
+                std::vector<float> ring(ringSize * destRowFloats);
+                std::vector<uint32_t> ringRows(ringSize, UINT32_MAX);
+                std::vector<float> decodedRow(mip == 1 ? sourceRowFloats : 0);
+                std::vector<float> encodedRow(bKeepPixels ? 0 : destRowFloats);
+                std::vector<const float*> rows(verticalTaps.numTaps);
+                for (uint32_t y = firstRow; y < endRow; ++y)
+                {
+                    const size_t firstTap = static_cast<size_t>(y) * verticalTaps.numTaps;
+                    for (uint32_t tap = 0; tap < verticalTaps.numTaps; ++tap)
+                    {
+                        const uint32_t sourceY = verticalTaps.indices[firstTap + tap];
+                        const uint32_t slot = sourceY % ringSize;
+                        float *filteredRow = ring.data() + slot * destRowFloats;
+                        if (ringRows[slot] != sourceY)
+                        {
+                            const float *sourceRow = sourcePixels.data() + sourceY * sourceRowFloats;
+                            if (mip == 1)
+                            {
+                                DecodeRow(data + sourceY * mip0RowBytes, decodedRow.data(), width, layout, numSRGBChannels);
+                                sourceRow = decodedRow.data();
+                            }
+                            FilterRowHorizontal(sourceRow, filteredRow, destWidth, horizontalTaps);
+                            ringRows[slot] = sourceY;
+                        }
+                        rows[tap] = filteredRow;
+                    }
+                    float *destRow = bKeepPixels ? destPixels.data() + y * destRowFloats : encodedRow.data();
+                    FilterRowVertical(rows.data(), verticalTaps.weights.data() + firstTap, verticalTaps.numTaps, destRow, destRowFloats);
+                    EncodeRow(destRow, mips[mip].data() + y * destRowBytes, destWidth, layout, numSRGBChannels);
+                }
+            });
+
+            std::swap(sourcePixels, destPixels);
+            sourceWidth = destWidth;
+            sourceHeight = destHeight;
+        }
+        return mips;
+    }
+}
@@ -0,0 +1,377 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Asset/TextureAsset.h"
+
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <future>
+
+#include "Core/ContentHash.h"
+
+constexpr uint32_t TextureFileMagicMask = 0x54455831;
+constexpr uint32_t TextureFileCurrentVersion = 0x1;
+// Bump on changes of compression code that change baked data of same texture and settings.
+constexpr uint32_t TextureBakeCodeVersion = 0x1;
+// Streamed mips start at multiple of this from start of asset, so that each is read with aligned, page sized requests.
+constexpr uint64_t TextureMipAlignment = 4096;
+namespace Koala
+{
+    static Logger logger("TextureAsset");
+
+    // Layout: header, mip tail from last mip to first tail mip, packed, then larger mips from smallest to mip 0, aligned.
+    // Offsets are relative to start of asset in the file.
+    struct TextureFileHeader
+    {
+        uint32_t fileMagicMask {0};
+        uint32_t fileVersion {0};
+        uint32_t pixelFormat {0};
+        uint32_t width {0};
+        uint32_t height {0};
+        uint32_t numMips {0};
+        uint32_t firstTailMip {0};
+        uint32_t reserved {0};
+        TextureMipRange mips[TextureMaxMips] {};
+    };
+    static_assert(sizeof(TextureFileHeader) == 32 + TextureMaxMips * sizeof(TextureMipRange));
+
+    static FORCEINLINE uint64_t AlignMipOffset(uint64_t offset)
+    {
+        return (offset + TextureMipAlignment - 1) & ~(TextureMipAlignment - 1);
+    }
+
+    static uint32_t GetMaxNumMips(uint32_t width, uint32_t height)
+    {
+        return std::min<uint32_t>(TextureMaxMips, std::bit_width(std::max(width, height)));
+    }
+
+    void TextureAsset::ComputeLayout()
+    {
+        // Tail takes smallest mips while it fits, at least the last one.
+        uint64_t tailSize = 0;
+        firstTailMip = numMips;
+        while (firstTailMip > 0)
+        {
+            const uint64_t mipSize = GetMipSize(firstTailMip - 1);
+            if (firstTailMip < numMips && tailSize + mipSize > TextureMipTailMaxSize)
+                break;
+            tailSize += mipSize;
+            --firstTailMip;
+        }
+
+        mipRanges.assign(numMips, {});
+        uint64_t offset = sizeof(TextureFileHeader);
+        for (uint32_t mip = numMips; mip-- > 0;)
+        {
+            if (mip < firstTailMip)
+                offset = AlignMipOffset(offset);
+            mipRanges[mip] = {offset, GetMipSize(mip)};
+            offset += mipRanges[mip].size;
+        }
+    }
+
+    bool TextureAsset::SetMips(EPixelFormat format, uint32_t inWidth, uint32_t inHeight, std::vector<std::vector<uint8_t>> inMips)
+    {
+        if (GetPixelFormatBlockBytes(format) == 0 || inWidth == 0 || inHeight == 0)
+        {
+            logger.error("Invalid texture format {} or size {}x{}", static_cast<uint32_t>(format), inWidth, inHeight);
+            return false;
+        }
+        if (inMips.empty() || inMips.size() > GetMaxNumMips(inWidth, inHeight))
+        {
+            logger.error("Texture {}x{} can not have {} mips", inWidth, inHeight, inMips.size());
+            return false;
+        }
+        for (uint32_t mip = 0; mip < inMips.size(); ++mip)
+        {
+            const uint64_t expectedSize = ComputeImageSize(format, std::max(inWidth >> mip, 1u), std::max(inHeight >> mip, 1u));
+            if (inMips[mip].size() != expectedSize)
+            {
+                logger.error("Mip {} has {} bytes, expected {}", mip, inMips[mip].size(), expectedSize);
+                return false;
+            }
+        }
+
+        std::lock_guard lock(residencyMutex);
+        pixelFormat = format;
+        width = inWidth;
+        height = inHeight;
+        numMips = static_cast<uint32_t>(inMips.size());
+        ComputeLayout();
+        fileOffset = 0;
+        mipData = std::move(inMips);
+        firstResidentMip = 0;
+        bStreamingIn = false;
+        bStreamInFailed = false;
+        bBaked = false;
+        return true;
+    }
+
+    bool TextureAsset::LoadAsset(FileIO::ReadFileStream &file)
+    {
+        const size_t assetStart = file.Tell();
+        const size_t fileSize = file.GetFileSize();
+        if (fileSize < assetStart || fileSize - assetStart < sizeof(TextureFileHeader))
+            return false;
+        const size_t assetSize = fileSize - assetStart;
+
+        TextureFileHeader header;
+        if (file.Serialize(&header, sizeof(TextureFileHeader)) != sizeof(TextureFileHeader))
+        {
+            logger.error("Failed to read texture asset header");
+            return false;
+        }
+        if (header.fileMagicMask != TextureFileMagicMask)
+        {
+            logger.error("This file is not a valid texture asset file -- MagicMask mismatch!  {} vs {}", TextureFileMagicMask, header.fileMagicMask);
+            return false;
+        }
+        if (header.fileVersion != TextureFileCurrentVersion)
+        {
+            logger.error("Texture asset file version {} is not supported, please rebake it!", header.fileVersion);
+            return false;
+        }
+        const auto format = static_cast<EPixelFormat>(header.pixelFormat);
+        if (header.pixelFormat >= PF_MAX || GetPixelFormatBlockBytes(format) == 0 || header.width == 0 || header.height == 0 ||
+            header.numMips == 0 || header.numMips > GetMaxNumMips(header.width, header.height) || header.firstTailMip >= header.numMips)
+        {
+            logger.error("File format error -- invalid texture {}x{}, format {}, {} mips", header.width, header.height,
+                header.pixelFormat, header.numMips);
+            return false;
+        }
+
+        std::lock_guard lock(residencyMutex);
+        pixelFormat = format;
+        width = header.width;
+        height = header.height;
+        numMips = header.numMips;
+        firstTailMip = header.firstTailMip;
+        mipRanges.assign(header.mips, header.mips + numMips);
+        for (uint32_t mip = 0; mip < numMips; ++mip)
+        {
+            const TextureMipRange &range = mipRanges[mip];
+            if (range.size != GetMipSize(mip) || range.offset < sizeof(TextureFileHeader) || range.offset > assetSize ||
+                range.size > assetSize - range.offset)
+            {
+                logger.error("File format error -- mip {} out of file", mip);
+                return false;
+            }
+            // Tail is read as one block.
+            if (mip >= firstTailMip && mip + 1 < numMips && range.offset != mipRanges[mip + 1].offset + mipRanges[mip + 1].size)
+            {
+                logger.error("File format error -- mip tail is not contiguous");
+                return false;
+            }
+        }
+
+        const TextureMipRange &lastMip = mipRanges[numMips - 1];
+        std::vector<uint8_t> tail(mipRanges[firstTailMip].offset + mipRanges[firstTailMip].size - lastMip.offset);
+        file.Seek(assetStart + lastMip.offset);
+        if (file.Serialize(tail.data(), tail.size()) != tail.size())
+        {
+            logger.error("Failed to read mip tail");
+            return false;
+        }
+
+        mipData.assign(numMips, {});
+        for (uint32_t mip = firstTailMip; mip < numMips; ++mip)
+        {
+            const uint8_t *begin = tail.data() + (mipRanges[mip].offset - lastMip.offset);
+            mipData[mip].assign(begin, begin + mipRanges[mip].size);
+        }
+        fileOffset = assetStart;
+        firstResidentMip = firstTailMip;
+        bStreamingIn = false;
+        bStreamInFailed = false;
+        bBaked = true;
+        return true;
+    }
+
+    bool TextureAsset::SaveAssetUnbaked(FileIO::WriteFileStream &file)
+    {
+        std::lock_guard lock(residencyMutex);
+        if (numMips == 0 || firstResidentMip != 0)
+        {
+            logger.error("Only textures with all mips resident can be saved");
+            return false;
+        }
+
+        TextureFileHeader header;
+        header.fileMagicMask = TextureFileMagicMask;
+        header.fileVersion = TextureFileCurrentVersion;
+        header.pixelFormat = pixelFormat;
+        header.width = width;
+        header.height = height;
+        header.numMips = numMips;
+        header.firstTailMip = firstTailMip;
+        std::copy(mipRanges.begin(), mipRanges.end(), header.mips);
+
+        // Header and padding are written from local buffers, mips from where they are, all in one request.
+        std::vector<uint8_t> padding(TextureMipAlignment, 0);
+        std::vector<FileIO::FileIOBufferSpan> spans;
+        spans.push_back({&header, sizeof(TextureFileHeader)});
+        uint64_t totalSize = sizeof(TextureFileHeader);
+        for (uint32_t mip = numMips; mip-- > 0;)
+        {
+            if (mipRanges[mip].offset > totalSize)
+                spans.push_back({padding.data(), mipRanges[mip].offset - totalSize});
+            spans.push_back({mipData[mip].data(), mipData[mip].size()});
+            totalSize = mipRanges[mip].offset + mipRanges[mip].size;
+        }
+
+        std::promise<bool> promise;
+        std::future<bool> future = promise.get_future();
+        file.WriteGatherAsync(std::move(spans), [&promise, totalSize](bool bOk, int64_t writtenSize, const void*)
+        {
+            promise.set_value(bOk && writtenSize == static_cast<int64_t>(totalSize));
+        }, FileIO::EFileIOCompletionMode::IOThread);
+
+        if (!FileIO::FileIOManager::Get().WaitForResult(future))
+        {
+            logger.error("Failed to write texture data");
+            return false;
+        }
+        file.Seek(file.Tell() + totalSize);
+        return true;
+    }
+
+    bool TextureAsset::Bake(FileIO::WriteFileStream &file)
+    {
+        if (bakeSettings.bGenerateMips && !GenerateMips(bakeSettings.mipSettings))
+            return false;
+        if (IsBlockCompressedFormat(bakeSettings.compressedFormat) && pixelFormat == PF_R8G8B8A8 &&
+            !Compress(bakeSettings.compressedFormat, bakeSettings.compressionQuality))
+            return false;
+        return SaveAssetUnbaked(file);
+    }
+
+    bool TextureAsset::GenerateMips(const MipGenerationSettings &settings)
+    {
+        if (IsBlockCompressedFormat(pixelFormat))
+        {
+            logger.error("Mips of block compressed textures can not be generated");
+            return false;
+        }
+        MipGenerationSettings clampedSettings = settings;
+        clampedSettings.maxMips = settings.maxMips == 0 ? TextureMaxMips : std::min(settings.maxMips, TextureMaxMips);
+        std::vector<std::vector<uint8_t>> generatedMips;
+        {
+            std::lock_guard lock(residencyMutex);
+            if (numMips == 0 || firstResidentMip != 0)
+            {
+                logger.error("Only textures with all mips resident can generate mips");
+                return false;
+            }
+            const auto startTime = std::chrono::steady_clock::now();
+            generatedMips = Koala::GenerateMips(pixelFormat, mipData[0].data(), width, height, clampedSettings);
+            const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+            logger.debug("Generated {} mips of {}x{} texture in {:.1f}ms, {:.1f} MP/s", generatedMips.size(), width, height,
+                elapsed * 1000.0, static_cast<double>(width) * height / std::max(elapsed, 1e-9) / 1e6);
+        }
+        return SetMips(pixelFormat, width, height, std::move(generatedMips));
+    }
+
+    bool TextureAsset::Compress(EPixelFormat format, ETextureCompressionQuality quality)
+    {
+        if (!IsBlockCompressedFormat(format) || pixelFormat != PF_R8G8B8A8)
+        {
+            logger.error("Only RGBA8 textures can be compressed into block compressed format");
+            return false;
+        }
+        std::vector<std::vector<uint8_t>> compressedMips(numMips);
+        {
+            std::lock_guard lock(residencyMutex);
+            if (numMips == 0 || firstResidentMip != 0)
+            {
+                logger.error("Only textures with all mips resident can be compressed");
+                return false;
+            }
+            const auto startTime = std::chrono::steady_clock::now();
+            uint64_t numPixels = 0;
+            for (uint32_t mip = 0; mip < numMips; ++mip)
+            {
+                compressedMips[mip] = CompressImage(format, mipData[mip], GetMipWidth(mip), GetMipHeight(mip), quality);
+                numPixels += static_cast<uint64_t>(GetMipWidth(mip)) * GetMipHeight(mip);
+            }
+            const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+            logger.debug("Compressed {}x{} texture with {} mips in {:.1f}ms, {:.1f} MP/s", width, height, numMips,
+                elapsed * 1000.0, numPixels / std::max(elapsed, 1e-9) / 1e6);
+        }
+        return SetMips(format, width, height, std::move(compressedMips));
+    }
+
+    uint32_t TextureAsset::GetBakeVersion() const
+    {
+        return (TextureFileCurrentVersion << 16) | TextureBakeCodeVersion;
+    }
+
+    uint64_t TextureAsset::GetBakeSettingsHash() const
+    {
+        uint64_t hash = HashCombine(0, static_cast<uint64_t>(bakeSettings.compressedFormat));
+        hash = HashCombine(hash, static_cast<uint64_t>(bakeSettings.compressionQuality));
+        // Settings of textures baked before mip generation hash as they did.
+        if (bakeSettings.bGenerateMips)
+        {
+            hash = HashCombine(hash, static_cast<uint64_t>(bakeSettings.mipSettings.filter));
+            hash = HashCombine(hash, static_cast<uint64_t>(bakeSettings.mipSettings.bSRGB));
+            hash = HashCombine(hash, static_cast<uint64_t>(bakeSettings.mipSettings.maxMips));
+        }
+        return hash;
+    }
+
+    uint32_t TextureAsset::GetFirstResidentMip() const
+    {
+        std::lock_guard lock(residencyMutex);
+        return firstResidentMip;
+    }
+
+    std::span<const uint8_t> TextureAsset::GetMipData(uint32_t mip) const
+    {
+        std::lock_guard lock(residencyMutex);
+        if (mip < firstResidentMip || mip >= numMips)
+            return {};
+        return mipData[mip];
+    }
+
+    uint64_t TextureAsset::GetResidentSize() const
+    {
+        std::lock_guard lock(residencyMutex);
+        uint64_t size = 0;
+        for (uint32_t mip = firstResidentMip; mip < numMips; ++mip)
+        {
+            size += mipData[mip].size();
+        }
+        return size;
+    }
+
+    size_t TextureAsset::GetMemorySize() const
+    {
+        return sizeof(TextureAsset) + GetResidentSize();
+    }
+
+    void TextureAsset::RequestScreenSize(float screenSize)
+    {
+        const auto size = static_cast<uint32_t>(std::ceil(std::clamp(screenSize, 0.0f, 65536.0f)));
+        uint32_t current = requestedScreenSize.load(std::memory_order_relaxed);
+        while (current < size && !requestedScreenSize.compare_exchange_weak(current, size, std::memory_order_relaxed))
+        {
+        }
+    }
+}
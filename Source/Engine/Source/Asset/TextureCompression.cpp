@@ -0,0 +1,724 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Asset/TextureCompression.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "AsyncWorker/AsyncTask.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KOALA_TEXTURE_COMPRESSION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace Koala
+{
+    constexpr uint32_t BlockNumPixels = PixelFormatCompressedBlockDim * PixelFormatCompressedBlockDim;
+    // Images with fewer blocks are compressed on calling thread.
+    constexpr size_t MinBlocksForParallelCompression = 256;
+
+    // Pixels of a block, channels kept apart so that 4 pixels are handled at a time.
+    struct alignas(16) ColorBlock
+    {
+        float r[BlockNumPixels];
+        float g[BlockNumPixels];
+        float b[BlockNumPixels];
+    };
+
+    struct Color3
+    {
+        float r{0};
+        float g{0};
+        float b{0};
+    };
+
+    // RGB565 endpoints with 2-bit index per pixel. color0 > color1 selects 4 color mode.
+    struct ColorCandidate
+    {
+        uint16_t color0{0};
+        uint16_t color1{0};
+        uint8_t  indices[BlockNumPixels]{};
+        float    error{std::numeric_limits<float>::max()};
+    };
+
+    static FORCEINLINE int32_t Expand5(int32_t value)
+    {
+        return (value << 3) | (value >> 2);
+    }
+
+    static FORCEINLINE int32_t Expand6(int32_t value)
+    {
+        return (value << 2) | (value >> 4);
+    }
+
+    static FORCEINLINE uint16_t Quantize565(const Color3 &color)
+    {
+        const auto quantize = [](float value, float maxValue)
+        {
+            return static_cast<uint16_t>(std::clamp(value * maxValue / 255.0f + 0.5f, 0.0f, maxValue));
+        };
+        return static_cast<uint16_t>(quantize(color.r, 31.0f) << 11 | quantize(color.g, 63.0f) << 5 | quantize(color.b, 31.0f));
+    }
+
+    // Palette in index order, 8-bit per channel. Decoders interpolate the same way.
+    static void BuildColorPalette(uint16_t color0, uint16_t color1, bool bFourColors, uint8_t outPalette[4][3])
+    {
+        const int32_t endpoints[2][3] = {
+            {Expand5(color0 >> 11), Expand6((color0 >> 5) & 63), Expand5(color0 & 31)},
+            {Expand5(color1 >> 11), Expand6((color1 >> 5) & 63), Expand5(color1 & 31)}};
+        for (uint32_t channel = 0; channel < 3; ++channel)
+        {
+            const int32_t a = endpoints[0][channel];
+            const int32_t b = endpoints[1][channel];
+            outPalette[0][channel] = static_cast<uint8_t>(a);
+            outPalette[1][channel] = static_cast<uint8_t>(b);
+            outPalette[2][channel] = static_cast<uint8_t>(bFourColors ? (2 * a + b + 1) / 3 : (a + b + 1) / 2);
+            outPalette[3][channel] = static_cast<uint8_t>(bFourColors ? (a + 2 * b + 1) / 3 : 0);
+        }
+    }
+
+    // Palette of single channel (BC4) block in index order. a0 > a1 selects 8 interpolated values,
+    // otherwise 6 interpolated values and 0 and 255.
+    static void BuildChannelPalette(uint8_t a0, uint8_t a1, uint8_t outPalette[8])
+    {
+        outPalette[0] = a0;
+        outPalette[1] = a1;
+        if (a0 > a1)
+        {
+            for (int32_t index = 2; index < 8; ++index)
+            {
+                outPalette[index] = static_cast<uint8_t>(((8 - index) * a0 + (index - 1) * a1 + 3) / 7);
+            }
+        }
+        else
+        {
+            for (int32_t index = 2; index < 6; ++index)
+            {
+                outPalette[index] = static_cast<uint8_t>(((6 - index) * a0 + (index - 1) * a1 + 2) / 5);
+            }
+            outPalette[6] = 0;
+            outPalette[7] = 255;
+        }
+    }
+
+#if KOALA_TEXTURE_COMPRESSION_SSE2
+    // Nearest palette entry of each pixel, return sum of squared errors.
+    static float FindColorIndices(const ColorBlock &block, const uint8_t palette[4][3], uint8_t outIndices[BlockNumPixels])
+    {
+        __m128 paletteR[4], paletteG[4], paletteB[4];
+        for (uint32_t entry = 0; entry < 4; ++entry)
+        {
+            paletteR[entry] = _mm_set1_ps(palette[entry][0]);
+            paletteG[entry] = _mm_set1_ps(palette[entry][1]);
+            paletteB[entry] = _mm_set1_ps(palette[entry][2]);
+        }
+
+        __m128 error = _mm_setzero_ps();
+        for (uint32_t pixel = 0; pixel < BlockNumPixels; pixel += 4)
+        {
+            const __m128 r = _mm_load_ps(block.r + pixel);
+            const __m128 g = _mm_load_ps(block.g + pixel);
+            const __m128 b = _mm_load_ps(block.b + pixel);
+            __m128 bestDistance = _mm_set1_ps(std::numeric_limits<float>::max());
+            __m128i bestIndex = _mm_setzero_si128();
+            for (uint32_t entry = 0; entry < 4; ++entry)
+            {
+                const __m128 dr = _mm_sub_ps(r, paletteR[entry]);
+                const __m128 dg = _mm_sub_ps(g, paletteG[entry]);
+                const __m128 db = _mm_sub_ps(b, paletteB[entry]);
+                const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+                const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, bestDistance));
+                bestDistance = _mm_min_ps(distance, bestDistance);
+                bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(static_cast<int32_t>(entry))), _mm_andnot_si128(closer, bestIndex));
+            }
+            error = _mm_add_ps(error, bestDistance);
+            alignas(16) int32_t indices[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(indices), bestIndex);
+            for (uint32_t lane = 0; lane < 4; ++lane)
+            {
+                outIndices[pixel + lane] = static_cast<uint8_t>(indices[lane]);
+            }
+        }
+        alignas(16) float errors[4];
+        _mm_store_ps(errors, error);
+        return errors[0] + errors[1] + errors[2] + errors[3];
+    }
+
+    // Nearest palette entry of each of 16 values, all at once. Return sum of squared errors.
+    static uint32_t FindChannelIndices(const uint8_t values[BlockNumPixels], const uint8_t palette[8], uint8_t outIndices[BlockNumPixels])
+    {
+        const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+        __m128i bestDifference = _mm_set1_epi8(-1);
+        __m128i bestIndex = _mm_setzero_si128();
+        for (uint32_t entry = 0; entry < 8; ++entry)
+        {
+            const __m128i paletteValue = _mm_set1_epi8(static_cast<char>(palette[entry]));
+            const __m128i difference = _mm_or_si128(_mm_subs_epu8(value, paletteValue), _mm_subs_epu8(paletteValue, value));
+            // Unsigned difference < best: saturating subtraction leaves zero and values differ.
+            const __m128i notGreater = _mm_cmpeq_epi8(_mm_subs_epu8(difference, bestDifference), _mm_setzero_si128());
+            const __m128i closer = _mm_andnot_si128(_mm_cmpeq_epi8(difference, bestDifference), notGreater);
+            bestDifference = _mm_min_epu8(difference, bestDifference);
+            bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi8(static_cast<char>(entry))), _mm_andnot_si128(closer, bestIndex));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(outIndices), bestIndex);
+
+        const __m128i low = _mm_unpacklo_epi8(bestDifference, _mm_setzero_si128());
+        const __m128i high = _mm_unpackhi_epi8(bestDifference, _mm_setzero_si128());
+        __m128i error = _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high));
+        error = _mm_add_epi32(error, _mm_shuffle_epi32(error, _MM_SHUFFLE(1, 0, 3, 2)));
+        error = _mm_add_epi32(error, _mm_shuffle_epi32(error, _MM_SHUFFLE(2, 3, 0, 1)));
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(error));
+    }
+#else
+    static float FindColorIndices(const ColorBlock &block, const uint8_t palette[4][3], uint8_t outIndices[BlockNumPixels])
+    {
+        float error = 0;
+        for (uint32_t pixel = 0; pixel < BlockNumPixels; ++pixel)
+        {
+            float bestDistance = std::numeric_limits<float>::max();
+            for (uint32_t entry = 0; entry < 4; ++entry)
+            {
+                const float dr = block.r[pixel] - palette[entry][0];
+                const float dg = block.g[pixel] - palette[entry][1];
+                const float db = block.b[pixel] - palette[entry][2];
+                const float distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    outIndices[pixel] = static_cast<uint8_t>(entry);
+                }
+            }
+            error += bestDistance;
+        }
+        return error;
+    }
+
+    static uint32_t FindChannelIndices(const uint8_t values[BlockNumPixels], const uint8_t palette[8], uint8_t outIndices[BlockNumPixels])
+    {
+        uint32_t error = 0;
+        for (uint32_t pixel = 0; pixel < BlockNumPixels; ++pixel)
+        {
+            int32_t bestDifference = INT_MAX;
+            for (uint32_t entry = 0; entry < 8; ++entry)
+            {
+                const int32_t difference = std::abs(values[pixel] - palette[entry]);
+                if (difference < bestDifference)
+                {
+                    bestDifference = difference;
+                    outIndices[pixel] = static_cast<uint8_t>(entry);
+                }
+            }
+            error += static_cast<uint32_t>(bestDifference * bestDifference);
+        }
+        return error;
+    }
+#endif
+
+    // Endpoints reproducing a single 8-bit value best through the 2/3 interpolated palette entry,
+    // closest pairs preferred, so that decoders rounding differently still land near it.
+    struct SingleColorTable
+    {
+        uint8_t match5[256][2];
+        uint8_t match6[256][2];
+    };
+
+    static const SingleColorTable& GetSingleColorTable()
+    {
+        static const SingleColorTable table = []
+        {
+            SingleColorTable result{};
+            const auto build = [](uint8_t (*match)[2], int32_t maxValue, auto expand)
+            {
+                for (int32_t value = 0; value < 256; ++value)
+                {
+                    int32_t bestScore = INT_MAX;
+                    for (int32_t a = 0; a <= maxValue; ++a)
+                    {
+                        for (int32_t b = 0; b <= maxValue; ++b)
+                        {
+                            const int32_t expandedA = expand(a);
+                            const int32_t expandedB = expand(b);
+                            const int32_t score = std::abs((2 * expandedA + expandedB + 1) / 3 - value) * 1024 + std::abs(expandedA - expandedB);
+                            if (score < bestScore)
+                            {
+                                bestScore = score;
+                                match[value][0] = static_cast<uint8_t>(a);
+                                match[value][1] = static_cast<uint8_t>(b);
+                            }
+                        }
+                    }
+                }
+            };
+            build(result.match5, 31, [](int32_t value) { return Expand5(value); });
+            build(result.match6, 63, [](int32_t value) { return Expand6(value); });
+            return result;
+        }();
+        return table;
+    }
+
+    static void EvaluateColorEndpoints(const ColorBlock &block, uint16_t color0, uint16_t color1, ColorCandidate &outCandidate)
+    {
+        // Only color0 > color1 gives 4 colors. Equal endpoints decode as 3 colors, all pixels take index 0 then.
+        if (color0 < color1)
+            std::swap(color0, color1);
+        uint8_t palette[4][3];
+        BuildColorPalette(color0, color1, true, palette);
+        outCandidate.color0 = color0;
+        outCandidate.color1 = color1;
+        outCandidate.error = FindColorIndices(block, palette, outCandidate.indices);
+    }
+
+    // Principal axis of pixel colors, endpoints at the extreme projections on it.
+    static void ComputePrincipalEndpoints(const ColorBlock &block, uint32_t numIterations, Color3 &outStart, Color3 &outEnd)
+    {
+        Color3 mean;
+        for (uint32_t pixel = 0; pixel < BlockNumPixels; ++pixel)
+        {
+            mean.r += block.r[pixel];
+            mean.g += block.g[pixel];
+            mean.b += block.b[pixel];
+        }
+        mean = {mean.r / BlockNumPixels, mean.g / BlockNumPixels, mean.b / BlockNumPixels};
+
+        float covariance[6] = {};
+        for (uint32_t pixel = 0; pixel < BlockNumPixels; ++pixel)
+        {
+            const float r = block.r[pixel] - mean.r;
+            const float g = block.g[pixel] - mean.g;
+            const float b = block.b[pixel] - mean.b;
+            covariance[0] += r * r;
+            covariance[1] += r * g;
+            covariance[2] += r * b;
+            covariance[3] += g * g;
+            covariance[4] += g * b;
+            covariance[5] += b * b;
+        }
+
+        // Power iteration from the covariance row of the largest variance, which is never orthogonal to the axis.
+        Color3 axis = {covariance[0], covariance[1], covariance[2]};
+        if (covariance[3] > covariance[0] && covariance[3] >= covariance[5])
+            axis = {covariance[1], covariance[3], covariance[4]};
+        else if (covariance[5] > covariance[0])
+            axis = {covariance[2], covariance[4], covariance[5]};
+        for (uint32_t iteration = 0; iteration < numIterations; ++iteration)
+        {
+            const Color3 next = {
+                covariance[0] * axis.r + covariance[1] * axis.g + covariance[2] * axis.b,
+                covariance[1] * axis.r + covariance[3] * axis.g + covariance[4] * axis.b,
+                covariance[2] * axis.r + covariance[4] * axis.g + covariance[5] * axis.b};
+            const float length = std::max({std::abs(next.r), std::abs(next.g), std::abs(next.b)});
+            if (length <= 0.0f)
+                break;
+            axis = {next.r / length, next.g / length, next.b / length};
+        }
+        const float axisLengthSquared = axis.r * axis.r + axis.g * axis.g + axis.b * axis.b;
+        if (axisLengthSquared <= 0.0f)
+        {
+            outStart = outEnd = mean;
+            return;
+        }
+
+        float minProjection = std::numeric_limits<float>::max();
+        float maxProjection = std::numeric_limits<float>::lowest();
+        for (uint32_t pixel = 0; pixel < BlockNumPixels; ++pixel)
+        {
+            const float projection = (block.r[pixel] - mean.r) * axis.r + (block.g[pixel] - mean.g) * axis.g +
+                (block.b[pixel] - mean.b) * axis.b;
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+        minProjection /= axisLengthSquared;
+        maxProjection /= axisLengthSquared;
+        const auto clampColor = [](float value) { return std::clamp(value, 0.0f, 255.0f); };
+        outStart = {clampColor(mean.r + axis.r * maxProjection), clampColor(mean.g + axis.g * maxProjection),
+            clampColor(mean.b + axis.b * maxProjection)};
+        outEnd = {clampColor(mean.r + axis.r * minProjection), clampColor(mean.g + axis.g * minProjection),
+            clampColor(mean.b + axis.b * minProjection)};
+    }
+
+    // Least squares endpoints for indices of candidate. Return false if indices do not determine them.
+    static bool RefineColorEndpoints(const ColorBlock &block, const ColorCandidate &candidate, Color3 &outStart, Color3 &outEnd)
+    {
+        // Weight of color1 in palette entry of each index.
+        constexpr float IndexWeights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+        float aa = 0, ab = 0, bb = 0;
+        Color3 ax, bx;
+        for (uint32_t pixel = 0; pixel < BlockNumPixels; ++pixel)
+        {
+            const float weight = IndexWeights[candidate.indices[pixel]];
+            const float inverse = 1.0f - weight;
+            aa += inverse * inverse;
+            ab += inverse * weight;
+            bb += weight * weight;
+            ax = {ax.r + inverse * block.r[pixel], ax.g + inverse * block.g[pixel], ax.b + inverse * block.b[pixel]};
+            bx = {bx.r + weight * block.r[pixel], bx.g + weight * block.g[pixel], bx.b + weight * block.b[pixel]};
+        }
+        const float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f)
+            return false;
+        const float scale = 1.0f / determinant;
+        const auto solve = [&](float a, float b, float &outA, float &outB)
+        {
+            outA = std::clamp((bb * a - ab * b) * scale, 0.0f, 255.0f);
+            outB = std::clamp((aa * b - ab * a) * scale, 0.0f, 255.0f);
+        };
+        solve(ax.r, bx.r, outStart.r, outEnd.r);
+        solve(ax.g, bx.g, outStart.g, outEnd.g);
+        solve(ax.b, bx.b, outStart.b, outEnd.b);
+        return true;
+    }
+
+    static void WriteColorBlock(const ColorCandidate &candidate, uint8_t *outBlock)
+    {
+        uint32_t indices = 0;
+        if (candidate.color0 != candidate.color1)
+        {
+            for (uint32_t pixel = 0; pixel < BlockNumPixels; ++pixel)
+            {
+                indices |= static_cast<uint32_t>(candidate.indices[pixel]) << (pixel * 2);
+            }
+        }
+        outBlock[0] = static_cast<uint8_t>(candidate.color0);
+        outBlock[1] = static_cast<uint8_t>(candidate.color0 >> 8);
+        outBlock[2] = static_cast<uint8_t>(candidate.color1);
+        outBlock[3] = static_cast<uint8_t>(candidate.color1 >> 8);
+        std::memcpy(outBlock + 4, &indices, sizeof(uint32_t));
+    }
+
+    static void EncodeColorBlock(const uint8_t *rgba, uint8_t *outBlock, ETextureCompressionQuality quality)
+    {
+        ColorBlock block;
+        bool bSolid = true;
+        for (uint32_t pixel = 0; pixel < BlockNumPixels; ++pixel)
+        {
+            block.r[pixel] = rgba[pixel * 4 + 0];
+            block.g[pixel] = rgba[pixel * 4 + 1];
+            block.b[pixel] = rgba[pixel * 4 + 2];
+            bSolid = bSolid && std::memcmp(rgba + pixel * 4, rgba, 3) == 0;
+        }
+
+        ColorCandidate best;
+        if (bSolid)
+        {
+            const SingleColorTable &table = GetSingleColorTable();
+            const uint8_t *r = table.match5[rgba[0]];
+            const uint8_t *g = table.match6[rgba[1]];
+            const uint8_t *b = table.match5[rgba[2]];
+            EvaluateColorEndpoints(block, static_cast<uint16_t>(r[0] << 11 | g[0] << 5 | b[0]),
+                static_cast<uint16_t>(r[1] << 11 | g[1] << 5 | b[1]), best);
+            WriteColorBlock(best, outBlock);
+            return;
+        }
+
+        Color3 start, end;
+        ComputePrincipalEndpoints(block, quality == ETextureCompressionQuality::Fast ? 2 : 8, start, end);
+        EvaluateColorEndpoints(block, Quantize565(start), Quantize565(end), best);
+
+        const uint32_t numPasses = quality == ETextureCompressionQuality::Fast ? 0 : quality == ETextureCompressionQuality::Normal ? 1 : 4;
+        ColorCandidate candidate;
+        for (uint32_t pass = 0; pass < numPasses && best.error > 0.0f; ++pass)
+        {
+            if (!RefineColorEndpoints(block, best, start, end))
+                break;
+            EvaluateColorEndpoints(block, Quantize565(start), Quantize565(end), candidate);
+            if (candidate.error >= best.error)
+                break;
+            best = candidate;
+        }
+        WriteColorBlock(best, outBlock);
+    }
+
+    // Single channel block as used by BC3 alpha and BC4/BC5: two 8-bit endpoints and 3-bit index per pixel.
+    static void EncodeChannelBlock(const uint8_t values[BlockNumPixels], uint8_t *outBlock, ETextureCompressionQuality quality)
+    {
+        uint8_t minValue = 255, maxValue = 0;
+        // Range of values apart from 0 and 255, which 6 value mode has exactly.
+        uint8_t innerMin = 255, innerMax = 0;
+        for (uint32_t pixel = 0; pixel < BlockNumPixels; ++pixel)
+        {
+            minValue = std::min(minValue, values[pixel]);
+            maxValue = std::max(maxValue, values[pixel]);
+            if (values[pixel] != 0 && values[pixel] != 255)
+            {
+                innerMin = std::min(innerMin, values[pixel]);
+                innerMax = std::max(innerMax, values[pixel]);
+            }
+        }
+
+        uint8_t palette[8];
+        uint8_t indices[BlockNumPixels];
+        uint8_t bestIndices[BlockNumPixels] = {};
+        uint8_t bestA0 = maxValue, bestA1 = minValue;
+        uint32_t bestError = UINT32_MAX;
+        const auto evaluate = [&](uint8_t a0, uint8_t a1)
+        {
+            BuildChannelPalette(a0, a1, palette);
+            const uint32_t error = FindChannelIndices(values, palette, indices);
+            if (error < bestError)
+            {
+                bestError = error;
+                bestA0 = a0;
+                bestA1 = a1;
+                std::memcpy(bestIndices, indices, BlockNumPixels);
+            }
+        };
+
+        if (minValue == maxValue)
+        {
+            bestError = 0;
+        }
+        else
+        {
+            evaluate(maxValue, minValue);
+            if (quality != ETextureCompressionQuality::Fast && bestError > 0 && (minValue == 0 || maxValue == 255))
+            {
+                if (innerMin > innerMax)
+                    innerMin = innerMax = minValue;
+                evaluate(innerMin, innerMax);
+            }
+            if (quality == ETextureCompressionQuality::High && bestError > 0)
+            {
+                // Pulling endpoints into range moves interpolated values onto clusters of values.
+                const int32_t searchRadius = std::min(3, (maxValue - minValue) / 4);
+                for (int32_t high = 0; high <= searchRadius; ++high)
+                {
+                    for (int32_t low = 0; low <= searchRadius; ++low)
+                    {
+                        if (high != 0 || low != 0)
+                            evaluate(static_cast<uint8_t>(maxValue - high), static_cast<uint8_t>(minValue + low));
+                    }
+                }
+            }
+        }
+
+        uint64_t packedIndices = 0;
+        for (uint32_t pixel = 0; pixel < BlockNumPixels; ++pixel)
+        {
+            packedIndices |= static_cast<uint64_t>(bestIndices[pixel]) << (pixel * 3);
+        }
+        outBlock[0] = bestA0;
+        outBlock[1] = bestA1;
+        for (uint32_t byte = 0; byte < 6; ++byte)
+        {
+            outBlock[2 + byte] = static_cast<uint8_t>(packedIndices >> (byte * 8));
+        }
+    }
+
+    static void GatherChannel(const uint8_t *rgba, uint32_t channel, uint8_t outValues[BlockNumPixels])
+    {
+        for (uint32_t pixel = 0; pixel < BlockNumPixels; ++pixel)
+        {
+            outValues[pixel] = rgba[pixel * 4 + channel];
+        }
+    }
+
+    void EncodeBlock(EPixelFormat format, const uint8_t *rgba, uint8_t *outBlock, ETextureCompressionQuality quality)
+    {
+        uint8_t values[BlockNumPixels];
+        switch (format)
+        {
+        case PF_DXT1:
+            EncodeColorBlock(rgba, outBlock, quality);
+            break;
+        case PF_DXT3:
+            for (uint32_t pixel = 0; pixel < BlockNumPixels; pixel += 2)
+            {
+                const auto quantize = [](uint8_t alpha) { return static_cast<uint8_t>((alpha * 15 + 127) / 255); };
+                outBlock[pixel / 2] = static_cast<uint8_t>(quantize(rgba[pixel * 4 + 3]) | quantize(rgba[pixel * 4 + 7]) << 4);
+            }
+            EncodeColorBlock(rgba, outBlock + 8, quality);
+            break;
+        case PF_DXT5:
+            GatherChannel(rgba, 3, values);
+            EncodeChannelBlock(values, outBlock, quality);
+            EncodeColorBlock(rgba, outBlock + 8, quality);
+            break;
+        case PF_BC5:
+            GatherChannel(rgba, 0, values);
+            EncodeChannelBlock(values, outBlock, quality);
+            GatherChannel(rgba, 1, values);
+            EncodeChannelBlock(values, outBlock + 8, quality);
+            break;
+        default:
+            break;
+        }
+    }
+
+    static void DecodeColorBlock(const uint8_t *block, bool bAlwaysFourColors, uint8_t *outRgba)
+    {
+        const uint16_t color0 = static_cast<uint16_t>(block[0] | block[1] << 8);
+        const uint16_t color1 = static_cast<uint16_t>(block[2] | block[3] << 8);
+        const bool bFourColors = bAlwaysFourColors || color0 > color1;
+        uint8_t palette[4][3];
+        BuildColorPalette(color0, color1, bFourColors, palette);
+        uint32_t indices;
+        std::memcpy(&indices, block + 4, sizeof(uint32_t));
+        for (uint32_t pixel = 0; pixel < BlockNumPixels; ++pixel)
+        {
+            const uint32_t index = (indices >> (pixel * 2)) & 3;
+            std::memcpy(outRgba + pixel * 4, palette[index], 3);
+            // Last entry of 3 color blocks is transparent black.
+            outRgba[pixel * 4 + 3] = !bFourColors && index == 3 ? 0 : 255;
+        }
+    }
+
+    static void DecodeChannelBlock(const uint8_t *block, uint8_t *outRgba, uint32_t channel)
+    {
+        uint8_t palette[8];
+        BuildChannelPalette(block[0], block[1], palette);
+        uint64_t indices = 0;
+        for (uint32_t byte = 0; byte < 6; ++byte)
+        {
+            indices |= static_cast<uint64_t>(block[2 + byte]) << (byte * 8);
+        }
+        for (uint32_t pixel = 0; pixel < BlockNumPixels; ++pixel)
+        {
+            outRgba[pixel * 4 + channel] = palette[(indices >> (pixel * 3)) & 7];
+        }
+    }
+
+    void DecodeBlock(EPixelFormat format, const uint8_t *block, uint8_t *outRgba)
+    {
+        switch (format)
+        {
+        case PF_DXT1:
+            DecodeColorBlock(block, false, outRgba);
+            break;
+        case PF_DXT3:
+            DecodeColorBlock(block + 8, true, outRgba);
+            for (uint32_t pixel = 0; pixel < BlockNumPixels; ++pixel)
+            {
+                outRgba[pixel * 4 + 3] = static_cast<uint8_t>(((block[pixel / 2] >> ((pixel & 1) * 4)) & 15) * 17);
+            }
+            break;
+        case PF_DXT5:
+            DecodeColorBlock(block + 8, true, outRgba);
+            DecodeChannelBlock(block, outRgba, 3);
+            break;
+        case PF_BC5:
+            for (uint32_t pixel = 0; pixel < BlockNumPixels; ++pixel)
+            {
+                outRgba[pixel * 4 + 2] = 0;
+                outRgba[pixel * 4 + 3] = 255;
+            }
+            DecodeChannelBlock(block, outRgba, 0);
+            DecodeChannelBlock(block + 8, outRgba, 1);
+            break;
+        default:
+            break;
+        }
+    }
+
+    bool CompressImage(EPixelFormat format, const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *outData,
+        ETextureCompressionQuality quality)
+    {
+        if (!IsBlockCompressedFormat(format) || width == 0 || height == 0)
+            return false;
+        const uint32_t blockBytes = GetPixelFormatBlockBytes(format);
+        const uint32_t numBlocksX = (width + PixelFormatCompressedBlockDim - 1) / PixelFormatCompressedBlockDim;
+        const uint32_t numBlocksY = (height + PixelFormatCompressedBlockDim - 1) / PixelFormatCompressedBlockDim;
+        ParallelForRanges(numBlocksY, static_cast<size_t>(numBlocksX) * numBlocksY >= MinBlocksForParallelCompression, [&](uint32_t firstRow, uint32_t endRow)
+        {
+            alignas(16) uint8_t blockPixels[BlockNumPixels * 4];
+            for (uint32_t blockY = firstRow; blockY < endRow; ++blockY)
+            {
+                for (uint32_t blockX = 0; blockX < numBlocksX; ++blockX)
+                {
+                    for (uint32_t y = 0; y < PixelFormatCompressedBlockDim; ++y)
+                    {
+                        const uint32_t sourceY = std::min(blockY * PixelFormatCompressedBlockDim + y, height - 1);
+                        for (uint32_t x = 0; x < PixelFormatCompressedBlockDim; ++x)
+                        {
+                            const uint32_t sourceX = std::min(blockX * PixelFormatCompressedBlockDim + x, width - 1);
+                            std::memcpy(blockPixels + (y * PixelFormatCompressedBlockDim + x) * 4,
+                                rgba + (static_cast<size_t>(sourceY) * width + sourceX) * 4, 4);
+                        }
+                    }
+                    EncodeBlock(format, blockPixels, outData + (static_cast<size_t>(blockY) * numBlocksX + blockX) * blockBytes, quality);
+                }
+            }
+        });
+        return true;
+    }
+
+    std::vector<uint8_t> CompressImage(EPixelFormat format, const std::vector<uint8_t> &rgba, uint32_t width, uint32_t height,
+        ETextureCompressionQuality quality)
+    {
+        if (rgba.size() < static_cast<size_t>(width) * height * 4)
+            return {};
+        std::vector<uint8_t> data(ComputeImageSize(format, width, height));
+        if (!CompressImage(format, rgba.data(), width, height, data.data(), quality))
+            return {};
+        return data;
+    }
+
+    bool DecompressImage(EPixelFormat format, const uint8_t *data, uint32_t width, uint32_t height, uint8_t *outRgba)
+    {
+        if (!IsBlockCompressedFormat(format))
+            return false;
+        const uint32_t blockBytes = GetPixelFormatBlockBytes(format);
+        const uint32_t numBlocksX = (width + PixelFormatCompressedBlockDim - 1) / PixelFormatCompressedBlockDim;
+        const uint32_t numBlocksY = (height + PixelFormatCompressedBlockDim - 1) / PixelFormatCompressedBlockDim;
+        ParallelForRanges(numBlocksY, static_cast<size_t>(numBlocksX) * numBlocksY >= MinBlocksForParallelCompression, [&](uint32_t firstRow, uint32_t endRow)
+        {
+            uint8_t blockPixels[BlockNumPixels * 4];
+            for (uint32_t blockY = firstRow; blockY < endRow; ++blockY)
+            {
+                for (uint32_t blockX = 0; blockX < numBlocksX; ++blockX)
+                {
+                    DecodeBlock(format, data + (static_cast<size_t>(blockY) * numBlocksX + blockX) * blockBytes, blockPixels);
+                    // Pixels over the image edge are dropped.
+                    for (uint32_t y = 0; y < PixelFormatCompressedBlockDim && blockY * PixelFormatCompressedBlockDim + y < height; ++y)
+                    {
+                        const uint32_t firstX = blockX * PixelFormatCompressedBlockDim;
+                        const uint32_t numPixels = std::min(PixelFormatCompressedBlockDim, width - firstX);
+                        std::memcpy(outRgba + ((static_cast<size_t>(blockY) * PixelFormatCompressedBlockDim + y) * width + firstX) * 4,
+                            blockPixels + y * PixelFormatCompressedBlockDim * 4, numPixels * 4);
+                    }
+                }
+            }
+        });
+        return true;
+    }
+
+    double ComputeImagePSNR(const uint8_t *rgba, const uint8_t *otherRgba, size_t numPixels, uint32_t channelMask)
+    {
+        uint64_t squaredError = 0;
+        uint64_t numSamples = 0;
+        for (uint32_t channel = 0; channel < 4; ++channel)
+        {
+            if (!(channelMask & (1u << channel)))
+                continue;
+            for (size_t pixel = 0; pixel < numPixels; ++pixel)
+            {
+                const int32_t difference = rgba[pixel * 4 + channel] - otherRgba[pixel * 4 + channel];
+                squaredError += static_cast<uint64_t>(difference * difference);
+            }
+            numSamples += numPixels;
+        }
+        if (squaredError == 0 || numSamples == 0)
+            return std::numeric_limits<double>::infinity();
+        const double meanSquaredError = static_cast<double>(squaredError) / static_cast<double>(numSamples);
+        return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+    }
+}
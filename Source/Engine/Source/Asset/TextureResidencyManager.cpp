@@ -0,0 +1,321 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Asset/TextureResidencyManager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+#include "Config.h"
+#include "ConsoleVariable.h"
+
+namespace Koala
+{
+    static Logger logger("TextureResidency");
+
+    static TConsoleVariable<float> CVarTextureMipBias("r.texturestreaming.mipbias", 0.0f,
+        "Shift wanted mips of streamed textures by this many mips, positive values keep less detail.");
+
+    // Bytes of mips [firstMip, endMip) of texture.
+    static uint64_t GetMipChainSize(const TextureAsset &texture, uint32_t firstMip, uint32_t endMip)
+    {
+        uint64_t size = 0;
+        for (uint32_t mip = firstMip; mip < endMip; ++mip)
+        {
+            size += texture.GetMipSize(mip);
+        }
+        return size;
+    }
+
+    bool TextureResidencyManager::Initialize_MainThread()
+    {
+        budget = Config::Get().GetUIntSettingAndWriteDefault("texture.residency.budgetmb", 1024, true) << 20;
+        maxInFlightSize = Config::Get().GetUIntSettingAndWriteDefault("texture.residency.maxinflightmb", 64, true) << 20;
+        keepTicks = Config::Get().GetUIntSettingAndWriteDefault("texture.residency.keepticks", 60, true);
+        return true;
+    }
+
+    bool TextureResidencyManager::Shutdown_MainThread()
+    {
+        Flush();
+        std::lock_guard lock(mutex);
+        textures.clear();
+        pendingStreamIns.clear();
+        return true;
+    }
+
+    void TextureResidencyManager::Register(const std::shared_ptr<TextureAsset> &texture)
+    {
+        if (!texture)
+            return;
+        std::lock_guard lock(mutex);
+        textures.push_back(texture);
+    }
+
+    void TextureResidencyManager::Unregister(const TextureAsset *texture)
+    {
+        std::lock_guard lock(mutex);
+        std::erase_if(textures, [texture](const std::weak_ptr<TextureAsset> &weakTexture)
+        {
+            return weakTexture.expired() || weakTexture.lock().get() == texture;
+        });
+    }
+
+    TextureResidencyStats TextureResidencyManager::GetStats() const
+    {
+        std::lock_guard lock(mutex);
+        TextureResidencyStats stats = lastStats;
+        stats.numMipsStreamedIn = numMipsStreamedIn.load();
+        stats.numMipsStreamedOut = numMipsStreamedOut.load();
+        return stats;
+    }
+
+    void TextureResidencyManager::Flush()
+    {
+        std::vector<std::shared_future<void>> pending;
+        {
+            std::lock_guard lock(mutex);
+            pending = pendingStreamIns;
+        }
+        for (const std::shared_future<void> &future: pending)
+        {
+            FileIO::FileIOManager::Get().WaitUntilReady(future);
+        }
+    }
+
+    uint32_t TextureResidencyManager::ComputeWantedMip(const TextureAsset &texture, float screenSize, float mipBias)
+    {
+        const uint32_t maxDimension = std::max(texture.GetWidth(), texture.GetHeight());
+        if (screenSize <= 0.0f || maxDimension == 0)
+            return texture.GetFirstTailMip();
+        // Mip whose size matches screen size, so that one texel lands on about one pixel.
+        const float mip = std::floor(std::log2(static_cast<float>(maxDimension) / screenSize) + mipBias);
+        return static_cast<uint32_t>(std::clamp(mip, 0.0f, static_cast<float>(texture.GetFirstTailMip())));
+    }
+
+    void TextureResidencyManager::Tick_MainThread(float)
+    {
+        ++tickNumber;
+        std::vector<TextureState> states;
+        {
+            std::lock_guard lock(mutex);
+            std::erase_if(pendingStreamIns, [](const std::shared_future<void> &future)
+            {
+                return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            });
+            std::erase_if(textures, [](const std::weak_ptr<TextureAsset> &texture) { return texture.expired(); });
+            states.reserve(textures.size());
+            for (const std::weak_ptr<TextureAsset> &weakTexture: textures)
+            {
+                if (std::shared_ptr<TextureAsset> texture = weakTexture.lock())
+                    states.push_back({std::move(texture)});
+            }
+        }
+
+        const float mipBias = CVarTextureMipBias.Get();
+        TextureResidencyStats stats;
+        uint64_t wantedSize = 0;
+        std::erase_if(states, [&](TextureState &state)
+        {
+            TextureAsset &texture = *state.texture;
+            bool bStreamable;
+            bool bStreamingIn;
+            {
+                std::lock_guard lock(texture.residencyMutex);
+                if (texture.numMips == 0)
+                    return true;
+                state.firstResidentMip = texture.firstResidentMip;
+                bStreamingIn = texture.bStreamingIn;
+                // Textures not loaded from file can not get mips back once dropped, they stay as they are.
+                bStreamable = texture.IsBakedData() && !texture.bStreamInFailed;
+            }
+            stats.residentSize += GetMipChainSize(texture, state.firstResidentMip, texture.numMips);
+
+            if (const uint32_t requested = texture.requestedScreenSize.exchange(0); requested > 0)
+            {
+                texture.lastScreenSize = requested;
+                texture.lastRequestTick = tickNumber;
+            }
+            else if (tickNumber - texture.lastRequestTick > keepTicks)
+            {
+                texture.lastScreenSize = 0;
+            }
+            state.screenSize = texture.lastScreenSize;
+            state.wantedMip = bStreamable ? ComputeWantedMip(texture, static_cast<float>(state.screenSize), mipBias) : state.firstResidentMip;
+            wantedSize += GetMipChainSize(texture, state.wantedMip, texture.numMips);
+            // Mips being streamed in are waited for, residency is changed once they are there.
+            return bStreamingIn;
+        });
+
+        stats.numOverBudget = FitToBudget(states, wantedSize);
+
+        std::vector<TextureState*> streamIns;
+        for (TextureState &state: states)
+        {
+            if (state.wantedMip > state.firstResidentMip)
+                StreamOut(state);
+            else if (state.wantedMip < state.firstResidentMip)
+                streamIns.push_back(&state);
+        }
+        std::sort(streamIns.begin(), streamIns.end(), [](const TextureState *lhs, const TextureState *rhs)
+        {
+            return lhs->screenSize > rhs->screenSize;
+        });
+        for (TextureState *state: streamIns)
+        {
+            // Something is always let through, even if larger than limit.
+            const uint64_t size = GetMipChainSize(*state->texture, state->wantedMip, state->firstResidentMip);
+            if (inFlightSize.load() > 0 && inFlightSize.load() + size > maxInFlightSize)
+                break;
+            StartStreamIn(*state);
+        }
+
+        std::lock_guard lock(mutex);
+        stats.numTextures = static_cast<uint32_t>(textures.size());
+        stats.numStreamingIn = static_cast<uint32_t>(pendingStreamIns.size());
+        stats.wantedSize = wantedSize;
+        stats.budget = budget;
+        lastStats = stats;
+    }
+
+    uint32_t TextureResidencyManager::FitToBudget(std::vector<TextureState> &states, uint64_t &inOutWantedSize) const
+    {
+        if (inOutWantedSize <= budget)
+            return 0;
+
+        // Most texels per screen pixel first, dropping its top mip costs least detail.
+        auto texelsPerPixel = [&states](size_t index)
+        {
+            const TextureState &state = states[index];
+            const double screenSize = std::max<double>(state.screenSize, 1.0);
+            return static_cast<double>(state.texture->GetMipSize(state.wantedMip)) / (screenSize * screenSize);
+        };
+        auto compare = [&texelsPerPixel](size_t lhs, size_t rhs) { return texelsPerPixel(lhs) < texelsPerPixel(rhs); };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(compare)> candidates(compare);
+        for (size_t index = 0; index < states.size(); ++index)
+        {
+            const TextureState &state = states[index];
+            if (state.wantedMip < state.texture->GetFirstTailMip() && state.texture->IsBakedData())
+                candidates.push(index);
+        }
+
+        std::vector<bool> bCut(states.size(), false);
+        uint32_t numCut = 0;
+        while (inOutWantedSize > budget && !candidates.empty())
+        {
+            const size_t index = candidates.top();
+            candidates.pop();
+            TextureState &state = states[index];
+            inOutWantedSize -= state.texture->GetMipSize(state.wantedMip);
+            ++state.wantedMip;
+            numCut += !bCut[index];
+            bCut[index] = true;
+            if (state.wantedMip < state.texture->GetFirstTailMip())
+                candidates.push(index);
+        }
+        return numCut;
+    }
+
+    void TextureResidencyManager::StreamOut(TextureState &state)
+    {
+        TextureAsset &texture = *state.texture;
+        std::lock_guard lock(texture.residencyMutex);
+        for (uint32_t mip = texture.firstResidentMip; mip < state.wantedMip; ++mip)
+        {
+            std::vector<uint8_t>().swap(texture.mipData[mip]);
+        }
+        numMipsStreamedOut += state.wantedMip - texture.firstResidentMip;
+        texture.firstResidentMip = state.wantedMip;
+    }
+
+    void TextureResidencyManager::StartStreamIn(TextureState &state)
+    {
+        std::shared_ptr<TextureAsset> texture = state.texture;
+        const uint32_t firstMip = state.wantedMip;
+        const uint32_t endMip = state.firstResidentMip;
+        const uint64_t size = GetMipChainSize(*texture, firstMip, endMip);
+        {
+            std::lock_guard lock(texture->residencyMutex);
+            texture->bStreamingIn = true;
+        }
+        inFlightSize += size;
+
+        auto promise = std::make_shared<std::promise<void>>();
+        {
+            std::lock_guard lock(mutex);
+            pendingStreamIns.push_back(promise->get_future().share());
+        }
+
+        // Mips are read straight into their final buffers, installed together once all are read.
+        auto mips = std::make_shared<std::vector<std::vector<uint8_t>>>(endMip - firstMip);
+        auto finish = [this, texture, firstMip, endMip, size, mips, promise](bool bOk)
+        {
+            {
+                std::lock_guard lock(texture->residencyMutex);
+                if (bOk)
+                {
+                    for (uint32_t mip = firstMip; mip < endMip; ++mip)
+                    {
+                        texture->mipData[mip] = std::move((*mips)[mip - firstMip]);
+                    }
+                    texture->firstResidentMip = firstMip;
+                }
+                else
+                {
+                    texture->bStreamInFailed = true;
+                }
+                texture->bStreamingIn = false;
+            }
+            if (bOk)
+                numMipsStreamedIn += endMip - firstMip;
+            else
+                logger.error("Failed to stream in mips {}-{} of {}", firstMip, endMip - 1, texture->GetAssetFilePath().GetString());
+            inFlightSize -= size;
+            promise->set_value();
+        };
+
+        FileIO::FileIOManager::Get().RequestOpenFileAsync(texture->GetAssetFilePath(), FileIO::EFileOpenMode::OpenFileForRead | FileIO::EFileOpenMode::OpenFileAsBinary,
+            [texture, firstMip, endMip, mips, finish](FileIO::FileHandle handle)
+            {
+                if (!handle || !handle->IsValid())
+                {
+                    finish(false);
+                    return;
+                }
+                auto numRemaining = std::make_shared<std::atomic<uint32_t>>(endMip - firstMip);
+                auto bFailed = std::make_shared<std::atomic<bool>>(false);
+                for (uint32_t mip = firstMip; mip < endMip; ++mip)
+                {
+                    const TextureMipRange &range = texture->GetMipRange(mip);
+                    std::vector<uint8_t> &buffer = (*mips)[mip - firstMip];
+                    buffer.resize(range.size);
+                    FileIO::FileIOManager::Get().RequestReadFileAsync(handle, texture->fileOffset + range.offset, range.size, buffer.data(),
+                        [handle, expectedSize = range.size, numRemaining, bFailed, finish](bool bOk, int64_t readSize, const void*)
+                        {
+                            if (!bOk || readSize != static_cast<int64_t>(expectedSize))
+                                *bFailed = true;
+                            if (--*numRemaining > 0)
+                                return;
+                            FileIO::FileIOManager::Get().RequestCloseFileAsync(handle, nullptr, FileIO::EFileIOCompletionMode::IOThread);
+                            finish(!bFailed->load());
+                        }, FileIO::EFileIOCompletionMode::IOThread);
+                }
+            }, FileIO::EFileIOCompletionMode::IOThread);
+    }
+}
@@ -0,0 +1,426 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Asset/VertexFormat.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KOALA_VERTEX_FORMAT_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace Koala
+{
+    constexpr float PositionQuantizationMax = 65535.0f;
+
+    // Vertices are converted 4 at a time, fields of each lane kept apart (structure of arrays).
+    constexpr size_t VertexLaneWidth = 4;
+    struct alignas(16) VertexLanes
+    {
+        int32_t position[3][VertexLaneWidth];
+        int32_t normal[2][VertexLaneWidth];
+        // Half floats in low 16 bits.
+        int32_t uv[2][VertexLaneWidth];
+    };
+
+    static FORCEINLINE float GetNormalQuantizationMax(EVertexFormat format)
+    {
+        return format == EVertexFormat::Packed12 ? 127.0f : 32767.0f;
+    }
+
+    size_t GetVertexStride(EVertexFormat format)
+    {
+        switch (format)
+        {
+        case EVertexFormat::Packed16: return sizeof(PackedVertex16);
+        case EVertexFormat::Packed12: return sizeof(PackedVertex12);
+        default:                      return sizeof(Vector);
+        }
+    }
+
+    VertexQuantizationBounds ComputeQuantizationBounds(const Vector *vertices, size_t numVertices)
+    {
+        VertexQuantizationBounds bounds;
+        if (numVertices == 0)
+            return bounds;
+
+        Vec3f minPosition = vertices[0].position;
+        Vec3f maxPosition = vertices[0].position;
+        for (size_t index = 1; index < numVertices; ++index)
+        {
+            minPosition = minPosition.cwiseMin(vertices[index].position);
+            maxPosition = maxPosition.cwiseMax(vertices[index].position);
+        }
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            bounds.min[axis] = minPosition[axis];
+            bounds.scale[axis] = (maxPosition[axis] - minPosition[axis]) / PositionQuantizationMax;
+        }
+        return bounds;
+    }
+
+    uint16_t FloatToHalf(float value)
+    {
+        uint32_t bits = std::bit_cast<uint32_t>(value);
+        const uint32_t sign = bits & 0x80000000u;
+        bits ^= sign;
+
+        uint32_t result;
+        if (bits >= 0x47800000u)
+        {
+            // Too large for half (infinity), or NaN.
+            result = bits > 0x7f800000u ? 0x7e00 : 0x7c00;
+        }
+        else if (bits < 0x38800000u)
+        {
+            // Subnormal half. Adding magic number aligns mantissa, and float addition rounds to nearest even.
+            const float subnormal = std::bit_cast<float>(bits) + std::bit_cast<float>(0x3f000000u);
+            result = std::bit_cast<uint32_t>(subnormal) - 0x3f000000u;
+        }
+        else
+        {
+            const uint32_t mantissaOdd = (bits >> 13) & 1;
+            bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xfff + mantissaOdd;
+            result = bits >> 13;
+        }
+        return static_cast<uint16_t>(result | (sign >> 16));
+    }
+
+    float HalfToFloat(uint16_t value)
+    {
+        // Shifted half is float with exponent biased by 15 instead of 127, scaling by 2^112 fixes it (subnormals included).
+        const float magic = std::bit_cast<float>(static_cast<uint32_t>(254 - 15) << 23);
+        const float infinity = std::bit_cast<float>(static_cast<uint32_t>(127 + 16) << 23);
+        const float scaled = std::bit_cast<float>(static_cast<uint32_t>(value & 0x7fff) << 13) * magic;
+        uint32_t bits = std::bit_cast<uint32_t>(scaled);
+        if (scaled >= infinity)
+            bits |= 255u << 23;
+        bits |= static_cast<uint32_t>(value & 0x8000) << 16;
+        return std::bit_cast<float>(bits);
+    }
+
+    Vec2f OctahedralEncode(const Vec3f &normal)
+    {
+        const float sum = std::abs(normal.x()) + std::abs(normal.y()) + std::abs(normal.z());
+        const float invSum = sum > 0 ? 1.0f / sum : 0.0f;
+        const float x = normal.x() * invSum;
+        const float y = normal.y() * invSum;
+        if (normal.z() >= 0)
+            return {x, y};
+        // Lower hemisphere is folded over the diagonals.
+        return {(1.0f - std::abs(y)) * std::copysign(1.0f, x), (1.0f - std::abs(x)) * std::copysign(1.0f, y)};
+    }
+
+    Vec3f OctahedralDecode(const Vec2f &encoded)
+    {
+        Vec3f normal(encoded.x(), encoded.y(), 1.0f - std::abs(encoded.x()) - std::abs(encoded.y()));
+        const float fold = std::max(-normal.z(), 0.0f);
+        normal.x() -= std::copysign(fold, normal.x());
+        normal.y() -= std::copysign(fold, normal.y());
+        return normal.normalized();
+    }
+
+#if KOALA_VERTEX_FORMAT_SSE2
+    static FORCEINLINE __m128 Abs4(__m128 value)
+    {
+        return _mm_andnot_ps(_mm_set1_ps(-0.0f), value);
+    }
+
+    // 1 or -1, following sign bit.
+    static FORCEINLINE __m128 Sign4(__m128 value)
+    {
+        return _mm_or_ps(_mm_and_ps(_mm_set1_ps(-0.0f), value), _mm_set1_ps(1.0f));
+    }
+
+    static FORCEINLINE __m128 Select4(__m128 mask, __m128 a, __m128 b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    static FORCEINLINE __m128i Select4(__m128i mask, __m128i a, __m128i b)
+    {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    }
+
+    // Same as FloatToHalf() on 4 lanes. Result is sign extended, so that it also fits in int16.
+    static FORCEINLINE __m128i FloatToHalf4(__m128 value)
+    {
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128 sign = _mm_and_ps(signMask, value);
+        const __m128 absValue = _mm_xor_ps(value, sign);
+        const __m128i absBits = _mm_castps_si128(absValue);
+
+        const __m128 isNaN = _mm_cmpunord_ps(absValue, absValue);
+        const __m128i isRegular = _mm_cmpgt_epi32(_mm_set1_epi32(0x47800000), absBits);
+        const __m128i special = _mm_or_si128(_mm_and_si128(_mm_castps_si128(isNaN), _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+
+        const __m128i isSubnormal = _mm_cmpgt_epi32(_mm_set1_epi32(0x38800000), absBits);
+        const __m128i subnormalMagic = _mm_set1_epi32(0x3f000000);
+        const __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absValue, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+
+        const __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absBits, 31 - 13), 31);
+        const __m128i rounded = _mm_sub_epi32(_mm_add_epi32(absBits, _mm_set1_epi32(0xfff + ((15 - 127) << 23))), mantissaOdd);
+        const __m128i normal = _mm_srli_epi32(rounded, 13);
+
+        const __m128i finite = Select4(isSubnormal, subnormal, normal);
+        const __m128i result = Select4(isRegular, finite, special);
+        return _mm_or_si128(result, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+    }
+
+    // Same as HalfToFloat() on 4 lanes, half in low 16 bits.
+    static FORCEINLINE __m128 HalfToFloat4(__m128i value)
+    {
+        value = _mm_and_si128(value, _mm_set1_epi32(0xffff));
+        const __m128i exponentMantissa = _mm_and_si128(value, _mm_set1_epi32(0x7fff));
+        const __m128i sign = _mm_slli_epi32(_mm_xor_si128(value, exponentMantissa), 16);
+        const __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exponentMantissa, 13)),
+            _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+        const __m128i wasInfinityOrNaN = _mm_cmpgt_epi32(exponentMantissa, _mm_set1_epi32(0x7bff));
+        const __m128 infinityExponent = _mm_and_ps(_mm_castsi128_ps(wasInfinityOrNaN), _mm_castsi128_ps(_mm_set1_epi32(255 << 23)));
+        return _mm_or_ps(scaled, _mm_or_ps(_mm_castsi128_ps(sign), infinityExponent));
+    }
+
+    static FORCEINLINE void EncodeLanes(const Vector *vertices, const VertexQuantizationBounds &bounds, float normalMax, VertexLanes &lanes)
+    {
+        // Each vertex is 8 floats: position, normal, uv. Transposed into one register per field.
+        const float *data = reinterpret_cast<const float*>(vertices);
+        __m128 px = _mm_loadu_ps(data), py = _mm_loadu_ps(data + 8), pz = _mm_loadu_ps(data + 16), nx = _mm_loadu_ps(data + 24);
+        __m128 ny = _mm_loadu_ps(data + 4), nz = _mm_loadu_ps(data + 12), u = _mm_loadu_ps(data + 20), v = _mm_loadu_ps(data + 28);
+        _MM_TRANSPOSE4_PS(px, py, pz, nx);
+        _MM_TRANSPOSE4_PS(ny, nz, u, v);
+
+        const __m128 positions[3] = {px, py, pz};
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const __m128 invScale = _mm_set1_ps(bounds.scale[axis] > 0 ? 1.0f / bounds.scale[axis] : 0.0f);
+            __m128 quantized = _mm_mul_ps(_mm_sub_ps(positions[axis], _mm_set1_ps(bounds.min[axis])), invScale);
+            quantized = _mm_min_ps(_mm_max_ps(quantized, _mm_setzero_ps()), _mm_set1_ps(PositionQuantizationMax));
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes.position[axis]), _mm_cvtps_epi32(quantized));
+        }
+
+        const __m128 sum = _mm_add_ps(_mm_add_ps(Abs4(nx), Abs4(ny)), Abs4(nz));
+        const __m128 invSum = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(sum, _mm_set1_ps(std::numeric_limits<float>::min())));
+        const __m128 x = _mm_mul_ps(nx, invSum);
+        const __m128 y = _mm_mul_ps(ny, invSum);
+        const __m128 lowerHemisphere = _mm_cmplt_ps(nz, _mm_setzero_ps());
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 encodedX = Select4(lowerHemisphere, _mm_mul_ps(_mm_sub_ps(one, Abs4(y)), Sign4(x)), x);
+        const __m128 encodedY = Select4(lowerHemisphere, _mm_mul_ps(_mm_sub_ps(one, Abs4(x)), Sign4(y)), y);
+        const __m128 scale = _mm_set1_ps(normalMax);
+        const __m128 minusOne = _mm_set1_ps(-1.0f);
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes.normal[0]), _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(encodedX, minusOne), one), scale)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes.normal[1]), _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(encodedY, minusOne), one), scale)));
+
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes.uv[0]), FloatToHalf4(u));
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes.uv[1]), FloatToHalf4(v));
+    }
+
+    static FORCEINLINE void DecodeLanes(const VertexLanes &lanes, const VertexQuantizationBounds &bounds, float normalMax, Vector *vertices)
+    {
+        __m128 positions[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const __m128 quantized = _mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(lanes.position[axis])));
+            positions[axis] = _mm_add_ps(_mm_set1_ps(bounds.min[axis]), _mm_mul_ps(quantized, _mm_set1_ps(bounds.scale[axis])));
+        }
+
+        const __m128 invScale = _mm_set1_ps(1.0f / normalMax);
+        const __m128 minusOne = _mm_set1_ps(-1.0f);
+        __m128 x = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(lanes.normal[0]))), invScale), minusOne);
+        __m128 y = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(lanes.normal[1]))), invScale), minusOne);
+        __m128 z = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), Abs4(x)), Abs4(y));
+        const __m128 fold = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps());
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        x = _mm_sub_ps(x, _mm_or_ps(fold, _mm_and_ps(signMask, x)));
+        y = _mm_sub_ps(y, _mm_or_ps(fold, _mm_and_ps(signMask, y)));
+        const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        const __m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), length);
+        __m128 nx = _mm_mul_ps(x, invLength), ny = _mm_mul_ps(y, invLength), nz = _mm_mul_ps(z, invLength);
+
+        __m128 px = positions[0], py = positions[1], pz = positions[2];
+        __m128 u = HalfToFloat4(_mm_load_si128(reinterpret_cast<const __m128i*>(lanes.uv[0])));
+        __m128 v = HalfToFloat4(_mm_load_si128(reinterpret_cast<const __m128i*>(lanes.uv[1])));
+        _MM_TRANSPOSE4_PS(px, py, pz, nx);
+        _MM_TRANSPOSE4_PS(ny, nz, u, v);
+
+        float *data = reinterpret_cast<float*>(vertices);
+        _mm_storeu_ps(data, px);
+        _mm_storeu_ps(data + 4, ny);
+        _mm_storeu_ps(data + 8, py);
+        _mm_storeu_ps(data + 12, nz);
+        _mm_storeu_ps(data + 16, pz);
+        _mm_storeu_ps(data + 20, u);
+        _mm_storeu_ps(data + 24, nx);
+        _mm_storeu_ps(data + 28, v);
+    }
+#else
+    static FORCEINLINE void EncodeLanes(const Vector *vertices, const VertexQuantizationBounds &bounds, float normalMax, VertexLanes &lanes)
+    {
+        for (size_t lane = 0; lane < VertexLaneWidth; ++lane)
+        {
+            const Vector &vertex = vertices[lane];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const float invScale = bounds.scale[axis] > 0 ? 1.0f / bounds.scale[axis] : 0.0f;
+                const float quantized = std::clamp((vertex.position[axis] - bounds.min[axis]) * invScale, 0.0f, PositionQuantizationMax);
+                lanes.position[axis][lane] = static_cast<int32_t>(std::nearbyint(quantized));
+            }
+            const Vec2f encoded = OctahedralEncode(vertex.normal);
+            lanes.normal[0][lane] = static_cast<int32_t>(std::nearbyint(std::clamp(encoded.x(), -1.0f, 1.0f) * normalMax));
+            lanes.normal[1][lane] = static_cast<int32_t>(std::nearbyint(std::clamp(encoded.y(), -1.0f, 1.0f) * normalMax));
+            lanes.uv[0][lane] = FloatToHalf(vertex.uv.x());
+            lanes.uv[1][lane] = FloatToHalf(vertex.uv.y());
+        }
+    }
+
+    static FORCEINLINE void DecodeLanes(const VertexLanes &lanes, const VertexQuantizationBounds &bounds, float normalMax, Vector *vertices)
+    {
+        for (size_t lane = 0; lane < VertexLaneWidth; ++lane)
+        {
+            Vector &vertex = vertices[lane];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                vertex.position[axis] = bounds.min[axis] + static_cast<float>(lanes.position[axis][lane]) * bounds.scale[axis];
+            }
+            vertex.normal = OctahedralDecode({std::max(lanes.normal[0][lane] / normalMax, -1.0f), std::max(lanes.normal[1][lane] / normalMax, -1.0f)});
+            vertex.uv = {HalfToFloat(static_cast<uint16_t>(lanes.uv[0][lane])), HalfToFloat(static_cast<uint16_t>(lanes.uv[1][lane]))};
+        }
+    }
+#endif
+
+    template <typename PackedVertexType>
+    static FORCEINLINE void PackLanes(const VertexLanes &lanes, size_t numLanes, PackedVertexType *packed)
+    {
+        using NormalType = std::remove_extent_t<decltype(PackedVertexType::normal)>;
+        for (size_t lane = 0; lane < numLanes; ++lane)
+        {
+            PackedVertexType &vertex = packed[lane];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                vertex.position[axis] = static_cast<uint16_t>(lanes.position[axis][lane]);
+            }
+            if constexpr (requires { vertex.reserved; })
+                vertex.reserved = 0;
+            vertex.normal[0] = static_cast<NormalType>(lanes.normal[0][lane]);
+            vertex.normal[1] = static_cast<NormalType>(lanes.normal[1][lane]);
+            vertex.uv[0] = static_cast<uint16_t>(lanes.uv[0][lane]);
+            vertex.uv[1] = static_cast<uint16_t>(lanes.uv[1][lane]);
+        }
+    }
+
+    template <typename PackedVertexType>
+    static FORCEINLINE void UnpackLanes(const PackedVertexType *packed, size_t numLanes, VertexLanes &lanes)
+    {
+        for (size_t lane = 0; lane < numLanes; ++lane)
+        {
+            const PackedVertexType &vertex = packed[lane];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                lanes.position[axis][lane] = vertex.position[axis];
+            }
+            lanes.normal[0][lane] = vertex.normal[0];
+            lanes.normal[1][lane] = vertex.normal[1];
+            lanes.uv[0][lane] = vertex.uv[0];
+            lanes.uv[1][lane] = vertex.uv[1];
+        }
+    }
+
+    template <typename PackedVertexType>
+    static void EncodeVerticesTyped(const Vector *vertices, size_t numVertices, const VertexQuantizationBounds &bounds,
+        float normalMax, PackedVertexType *packed)
+    {
+        VertexLanes lanes;
+        size_t index = 0;
+        for (; index + VertexLaneWidth <= numVertices; index += VertexLaneWidth)
+        {
+            EncodeLanes(vertices + index, bounds, normalMax, lanes);
+            PackLanes(lanes, VertexLaneWidth, packed + index);
+        }
+        if (index < numVertices)
+        {
+            // Tail goes through the same path, padded with copies of the last vertex.
+            Vector tail[VertexLaneWidth];
+            for (size_t lane = 0; lane < VertexLaneWidth; ++lane)
+            {
+                tail[lane] = vertices[std::min(index + lane, numVertices - 1)];
+            }
+            EncodeLanes(tail, bounds, normalMax, lanes);
+            PackLanes(lanes, numVertices - index, packed + index);
+        }
+    }
+
+    template <typename PackedVertexType>
+    static void DecodeVerticesTyped(const PackedVertexType *packed, size_t numVertices, const VertexQuantizationBounds &bounds,
+        float normalMax, Vector *vertices)
+    {
+        VertexLanes lanes{};
+        size_t index = 0;
+        for (; index + VertexLaneWidth <= numVertices; index += VertexLaneWidth)
+        {
+            UnpackLanes(packed + index, VertexLaneWidth, lanes);
+            DecodeLanes(lanes, bounds, normalMax, vertices + index);
+        }
+        if (index < numVertices)
+        {
+            Vector tail[VertexLaneWidth];
+            lanes = {};
+            UnpackLanes(packed + index, numVertices - index, lanes);
+            DecodeLanes(lanes, bounds, normalMax, tail);
+            std::copy(tail, tail + (numVertices - index), vertices + index);
+        }
+    }
+
+    void EncodeVertices(const Vector *vertices, size_t numVertices, const VertexQuantizationBounds &bounds,
+        EVertexFormat format, void *outPacked)
+    {
+        switch (format)
+        {
+        case EVertexFormat::Packed16:
+            EncodeVerticesTyped(vertices, numVertices, bounds, GetNormalQuantizationMax(format), static_cast<PackedVertex16*>(outPacked));
+            break;
+        case EVertexFormat::Packed12:
+            EncodeVerticesTyped(vertices, numVertices, bounds, GetNormalQuantizationMax(format), static_cast<PackedVertex12*>(outPacked));
+            break;
+        default:
+            std::memcpy(outPacked, static_cast<const void*>(vertices), numVertices * sizeof(Vector));
+            break;
+        }
+    }
+
+    void DecodeVertices(const void *packed, size_t numVertices, const VertexQuantizationBounds &bounds,
+        EVertexFormat format, Vector *outVertices)
+    {
+        switch (format)
+        {
+        case EVertexFormat::Packed16:
+            DecodeVerticesTyped(static_cast<const PackedVertex16*>(packed), numVertices, bounds, GetNormalQuantizationMax(format), outVertices);
+            break;
+        case EVertexFormat::Packed12:
+            DecodeVerticesTyped(static_cast<const PackedVertex12*>(packed), numVertices, bounds, GetNormalQuantizationMax(format), outVertices);
+            break;
+        default:
+            std::memcpy(static_cast<void*>(outVertices), packed, numVertices * sizeof(Vector));
+            break;
+        }
+    }
+}
@@ -17,6 +17,11 @@
 
 #include "AsyncWorker/TaskSet.h"
 
+#include <algorithm>
+
+#include "AsyncWorker/AsyncTask.h"
+#include "Core/ThreadManager.h"
+
 namespace Koala::AsyncWorker
 {
     void TaskSet::WaitAllFinished()
@@ -37,3 +42,22 @@ namespace Koala::AsyncWorker
         }
     }
 }
+
+namespace Koala
+{
+    void ParallelForRanges(size_t numItems, bool bParallel, const std::function<void(size_t, size_t)> &rangeFunction)
+    {
+        const size_t numWorkers = AsyncWorker::WorkDispatcher::Get().GetNumWorkerThreads();
+        if (!bParallel || numWorkers == 0 || numItems < 2 || ThreadTLS::threadType == EThreadType::WorkerThread)
+        {
+            rangeFunction(0, numItems);
+            return;
+        }
+        // A few tasks per worker evens out ranges of different cost.
+        const size_t numTasks = std::min(numItems, numWorkers * 4);
+        Async([&rangeFunction, numItems, numTasks](void*, size_t task)
+        {
+            rangeFunction(numItems * task / numTasks, numItems * (task + 1) / numTasks);
+        }, numTasks)->WaitAllFinished();
+    }
+}
@@ -18,6 +18,7 @@
 
 #include "AsyncWorker/WorkDispatcher.h"
 
+#include <forward_list>
 #include <iostream>
 
 #include "CPUProfiler.h"
@@ -0,0 +1,140 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Compression/BlockCompression.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Koala
+{
+    size_t CompressedBlockTable::GetMaxTableSize(uint64_t uncompressedSize)
+    {
+        const uint64_t maxBlocks = (uncompressedSize + MinCompressionBlockSize - 1) / MinCompressionBlockSize;
+        return sizeof(CompressedBlockHeader) + maxBlocks * sizeof(uint32_t);
+    }
+
+    bool CompressedBlockTable::Parse(const void *data, size_t size)
+    {
+        if (size < sizeof(CompressedBlockHeader))
+            return false;
+        std::memcpy(&header, data, sizeof(header));
+
+        if (header.magic != CompressedBlockMagic ||
+            header.blockSize < MinCompressionBlockSize || header.blockSize > MaxCompressionBlockSize ||
+            header.numBlocks != (header.uncompressedSize + header.blockSize - 1) / header.blockSize)
+            return false;
+
+        const size_t tableSize = static_cast<size_t>(header.numBlocks) * sizeof(uint32_t);
+        if (size - sizeof(header) < tableSize)
+            return false;
+
+        blockSizes.resize(header.numBlocks);
+        blockOffsets.resize(header.numBlocks);
+        if (tableSize > 0)
+            std::memcpy(blockSizes.data(), static_cast<const uint8_t*>(data) + sizeof(header), tableSize);
+
+        uint64_t offset = sizeof(header) + tableSize;
+        for (uint32_t i = 0; i < header.numBlocks; ++i)
+        {
+            blockOffsets[i] = offset;
+            offset += GetBlockStoredSize(i);
+        }
+        return true;
+    }
+
+    uint32_t CompressedBlockTable::GetBlockUncompressedSize(uint32_t index) const
+    {
+        const uint64_t start = static_cast<uint64_t>(index) * header.blockSize;
+        return static_cast<uint32_t>(std::min<uint64_t>(header.blockSize, header.uncompressedSize - start));
+    }
+
+    uint64_t CompressedBlockTable::GetStreamSize() const
+    {
+        if (header.numBlocks == 0)
+            return sizeof(header);
+        return blockOffsets.back() + GetBlockStoredSize(header.numBlocks - 1);
+    }
+
+    bool CompressedBlockTable::DecodeBlock(uint32_t index, const void *blockData, void *dst) const
+    {
+        const ECompressionMethod method = (blockSizes[index] & UncompressedBlockFlag) ? ECompressionMethod::None : header.method;
+        return Compression::Decompress(method, blockData, GetBlockStoredSize(index), dst, GetBlockUncompressedSize(index));
+    }
+
+    namespace Compression
+    {
+        std::vector<uint8_t> CompressBlocks(ECompressionMethod method, const void *src, size_t srcSize, uint32_t blockSize)
+        {
+            CompressedBlockHeader header;
+            header.blockSize = std::clamp(blockSize, MinCompressionBlockSize, MaxCompressionBlockSize);
+            header.uncompressedSize = srcSize;
+            header.numBlocks = static_cast<uint32_t>((srcSize + header.blockSize - 1) / header.blockSize);
+            header.method = method;
+
+            const size_t tableSize = static_cast<size_t>(header.numBlocks) * sizeof(uint32_t);
+            std::vector<uint8_t> out(sizeof(header) + tableSize);
+            std::vector<uint32_t> blockSizes(header.numBlocks);
+            std::vector<uint8_t> scratch(GetCompressBound(method, header.blockSize));
+
+            const uint8_t *input = static_cast<const uint8_t*>(src);
+            for (uint32_t i = 0; i < header.numBlocks; ++i)
+            {
+                const size_t offset = static_cast<size_t>(i) * header.blockSize;
+                const size_t size = std::min<size_t>(header.blockSize, srcSize - offset);
+
+                size_t compressedSize = method == ECompressionMethod::None ? 0 :
+                    Compress(method, input + offset, size, scratch.data(), scratch.size());
+                const uint8_t *blockData = scratch.data();
+                // Incompressible block is stored raw, decoding it is a plain copy.
+                if (compressedSize == 0 || compressedSize >= size)
+                {
+                    compressedSize = size;
+                    blockData = input + offset;
+                    blockSizes[i] = static_cast<uint32_t>(size) | UncompressedBlockFlag;
+                }
+                else
+                {
+                    blockSizes[i] = static_cast<uint32_t>(compressedSize);
+                }
+                out.insert(out.end(), blockData, blockData + compressedSize);
+            }
+
+            std::memcpy(out.data(), &header, sizeof(header));
+            if (tableSize > 0)
+                std::memcpy(out.data() + sizeof(header), blockSizes.data(), tableSize);
+            return out;
+        }
+
+        bool DecompressBlocks(const void *src, size_t srcSize, void *dst, size_t dstSize)
+        {
+            CompressedBlockTable table;
+            if (!table.Parse(src, srcSize) || table.GetHeader().uncompressedSize != dstSize || table.GetStreamSize() > srcSize)
+                return false;
+
+            for (uint32_t i = 0; i < table.GetNumBlocks(); ++i)
+            {
+                const uint8_t *blockData = static_cast<const uint8_t*>(src) + table.GetBlockOffset(i);
+                uint8_t *output = static_cast<uint8_t*>(dst) + static_cast<size_t>(i) * table.GetHeader().blockSize;
+                if (!table.DecodeBlock(i, blockData, output))
+                    return false;
+            }
+            return true;
+        }
+    }
+}
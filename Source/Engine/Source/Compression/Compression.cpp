@@ -0,0 +1,78 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Compression/Compression.h"
+
+#include <cstring>
+
+#include "LZ4.h"
+
+namespace Koala::Compression
+{
+    const char* GetCompressionMethodName(ECompressionMethod method)
+    {
+        switch (method)
+        {
+        case ECompressionMethod::None:
+            return "none";
+        case ECompressionMethod::LZ4:
+            return "lz4";
+        default: return "unknown";
+        }
+    }
+
+    size_t GetCompressBound(ECompressionMethod method, size_t inSize)
+    {
+        switch (method)
+        {
+        case ECompressionMethod::LZ4:
+            return LZ4CompressBound(inSize);
+        default: return inSize;
+        }
+    }
+
+    size_t Compress(ECompressionMethod method, const void *src, size_t srcSize, void *dst, size_t dstCapacity)
+    {
+        switch (method)
+        {
+        case ECompressionMethod::None:
+            if (srcSize > dstCapacity)
+                return 0;
+            std::memcpy(dst, src, srcSize);
+            return srcSize;
+        case ECompressionMethod::LZ4:
+            return LZ4CompressBlock(static_cast<const uint8_t*>(src), srcSize, static_cast<uint8_t*>(dst), dstCapacity);
+        default: return 0;
+        }
+    }
+
+    bool Decompress(ECompressionMethod method, const void *src, size_t srcSize, void *dst, size_t dstSize)
+    {
+        switch (method)
+        {
+        case ECompressionMethod::None:
+            if (srcSize != dstSize)
+                return false;
+            std::memcpy(dst, src, srcSize);
+            return true;
+        case ECompressionMethod::LZ4:
+            return LZ4DecompressBlock(static_cast<const uint8_t*>(src), srcSize, static_cast<uint8_t*>(dst), dstSize);
+        default: return false;
+        }
+    }
+}
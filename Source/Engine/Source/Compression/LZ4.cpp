@@ -0,0 +1,236 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "LZ4.h"
+
+#include <cstring>
+#include <memory>
+
+namespace Koala::Compression
+{
+    constexpr size_t MinMatch = 4;
+    // The last 5 bytes are always literals, and last match must start 12 bytes before the end.
+    constexpr size_t LastLiterals = 5;
+    constexpr size_t MatchFindLimit = 12;
+    constexpr size_t MaxDistance = 65535;
+    constexpr uint32_t HashLog = 14;
+
+    static inline uint32_t Read32(const uint8_t *p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static inline uint32_t HashSequence(uint32_t sequence)
+    {
+        return (sequence * 2654435761U) >> (32 - HashLog);
+    }
+
+    // Write length extension bytes (255, 255, ..., rest).
+    static inline uint8_t* WriteLength(uint8_t *op, size_t length)
+    {
+        while (length >= 255)
+        {
+            *op++ = 255;
+            length -= 255;
+        }
+        *op++ = static_cast<uint8_t>(length);
+        return op;
+    }
+
+    size_t LZ4CompressBound(size_t inSize)
+    {
+        return inSize + inSize / 255 + 16;
+    }
+
+    size_t LZ4CompressBlock(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity)
+    {
+        const uint8_t *ip = src;
+        const uint8_t *anchor = src;
+        const uint8_t *const end = src + srcSize;
+        uint8_t *op = dst;
+        uint8_t *const opEnd = dst + dstCapacity;
+
+        if (srcSize > MatchFindLimit)
+        {
+            const uint8_t *const matchFindLimit = end - MatchFindLimit;
+            const uint8_t *const matchLimit = end - LastLiterals;
+            auto table = std::make_unique<uint32_t[]>(1 << HashLog);
+
+            ++ip;
+            while (ip < matchFindLimit)
+            {
+                const uint32_t sequence = Read32(ip);
+                const uint32_t hash = HashSequence(sequence);
+                const uint8_t *ref = src + table[hash];
+                table[hash] = static_cast<uint32_t>(ip - src);
+
+                if (ref >= ip || static_cast<size_t>(ip - ref) > MaxDistance || Read32(ref) != sequence)
+                {
+                    ++ip;
+                    continue;
+                }
+
+                // Extend match backwards into pending literals.
+                while (ip > anchor && ref > src && ip[-1] == ref[-1])
+                {
+                    --ip;
+                    --ref;
+                }
+
+                const uint8_t *matchEnd = ip + MinMatch;
+                const uint8_t *refEnd = ref + MinMatch;
+                while (matchEnd < matchLimit && *matchEnd == *refEnd)
+                {
+                    ++matchEnd;
+                    ++refEnd;
+                }
+
+                const size_t literalLength = ip - anchor;
+                const size_t matchLength = matchEnd - ip - MinMatch;
+                if (static_cast<size_t>(opEnd - op) < 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1)
+                    return 0;
+
+                uint8_t *token = op++;
+                if (literalLength >= 15)
+                {
+                    *token = 15 << 4;
+                    op = WriteLength(op, literalLength - 15);
+                }
+                else
+                {
+                    *token = static_cast<uint8_t>(literalLength << 4);
+                }
+                std::memcpy(op, anchor, literalLength);
+                op += literalLength;
+
+                const size_t offset = ip - ref;
+                *op++ = static_cast<uint8_t>(offset);
+                *op++ = static_cast<uint8_t>(offset >> 8);
+
+                if (matchLength >= 15)
+                {
+                    *token |= 15;
+                    op = WriteLength(op, matchLength - 15);
+                }
+                else
+                {
+                    *token |= static_cast<uint8_t>(matchLength);
+                }
+
+                ip = matchEnd;
+                anchor = ip;
+                if (ip - 2 > src && ip < matchFindLimit)
+                    table[HashSequence(Read32(ip - 2))] = static_cast<uint32_t>(ip - 2 - src);
+            }
+        }
+
+        const size_t literalLength = end - anchor;
+        if (static_cast<size_t>(opEnd - op) < 1 + literalLength / 255 + 1 + literalLength)
+            return 0;
+
+        uint8_t *token = op++;
+        if (literalLength >= 15)
+        {
+            *token = 15 << 4;
+            op = WriteLength(op, literalLength - 15);
+        }
+        else
+        {
+            *token = static_cast<uint8_t>(literalLength << 4);
+        }
+        if (literalLength > 0)
+            std::memcpy(op, anchor, literalLength);
+        op += literalLength;
+
+        return op - dst;
+    }
+
+    // Read length extension bytes. Return false if input runs out.
+    static inline bool ReadLength(const uint8_t *&ip, const uint8_t *ipEnd, size_t &length)
+    {
+        uint8_t value;
+        do
+        {
+            if (ip >= ipEnd)
+                return false;
+            value = *ip++;
+            length += value;
+        } while (value == 255);
+        return true;
+    }
+
+    bool LZ4DecompressBlock(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize)
+    {
+        const uint8_t *ip = src;
+        const uint8_t *const ipEnd = src + srcSize;
+        uint8_t *op = dst;
+        uint8_t *const opEnd = dst + dstSize;
+
+        while (true)
+        {
+            if (ip >= ipEnd)
+                return false;
+            const uint8_t token = *ip++;
+
+            size_t literalLength = token >> 4;
+            if (literalLength == 15 && !ReadLength(ip, ipEnd, literalLength))
+                return false;
+            if (literalLength > static_cast<size_t>(ipEnd - ip) || literalLength > static_cast<size_t>(opEnd - op))
+                return false;
+            if (literalLength > 0)
+                std::memcpy(op, ip, literalLength);
+            op += literalLength;
+            ip += literalLength;
+
+            // Last sequence has literals only.
+            if (ip == ipEnd)
+                break;
+
+            if (ipEnd - ip < 2)
+                return false;
+            const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+            ip += 2;
+            if (offset == 0 || offset > static_cast<size_t>(op - dst))
+                return false;
+
+            size_t matchLength = token & 15;
+            if (matchLength == 15 && !ReadLength(ip, ipEnd, matchLength))
+                return false;
+            matchLength += MinMatch;
+            if (matchLength > static_cast<size_t>(opEnd - op))
+                return false;
+
+            const uint8_t *match = op - offset;
+            if (offset >= matchLength)
+            {
+                std::memcpy(op, match, matchLength);
+                op += matchLength;
+            }
+            else
+            {
+                // Overlapping copy repeats the pattern, must go byte by byte.
+                for (size_t i = 0; i < matchLength; ++i)
+                    *op++ = *match++;
+            }
+        }
+
+        return op == opEnd;
+    }
+}
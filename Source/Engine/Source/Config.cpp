@@ -17,6 +17,7 @@
 //CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "Config.h"
 
+#include <charconv>
 #include <filesystem>
 
 #include "FileSystem/SystemPath.h"
@@ -87,6 +88,19 @@ namespace Koala
         }
     }
 
+    uint64_t Config::GetUIntSettingAndWriteDefault(std::string key, uint64_t defaultValue, bool bWriteIntoEngineConfig)
+    {
+        const std::string value = GetSettingAndWriteDefault(key, std::to_string(defaultValue), bWriteIntoEngineConfig);
+        uint64_t result = 0;
+        const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), result);
+        if (error != std::errc() || end != value.data() + value.size())
+        {
+            loggerConfig.warning("Setting {} = '{}' is not an unsigned integer, using {}", key, value, defaultValue);
+            return defaultValue;
+        }
+        return result;
+    }
+
     void Config::SetSetting(std::string key, std::string value, bool bWriteIntoEngineConfig)
     {
         std::unique_lock lock_guard(globalConfigLock);
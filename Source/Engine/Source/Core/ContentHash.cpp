@@ -0,0 +1,89 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Core/ContentHash.h"
+
+#include <cstring>
+
+namespace Koala
+{
+    static constexpr uint64_t Prime1 = 0x9e3779b185ebca87ull;
+    static constexpr uint64_t Prime2 = 0xc2b2ae3d27d4eb4full;
+    static constexpr uint64_t Prime3 = 0x165667b19e3779f9ull;
+
+    static FORCEINLINE uint64_t Load64(const uint8_t *data)
+    {
+        uint64_t value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    static FORCEINLINE uint64_t Round(uint64_t accumulator, uint64_t input)
+    {
+        accumulator += input * Prime2;
+        accumulator = std::rotl(accumulator, 31);
+        return accumulator * Prime1;
+    }
+
+    static FORCEINLINE uint64_t Avalanche(uint64_t hash)
+    {
+        hash ^= hash >> 33;
+        hash *= Prime2;
+        hash ^= hash >> 29;
+        hash *= Prime3;
+        return hash ^ (hash >> 32);
+    }
+
+    uint64_t HashMemory(const void *data, size_t size, uint64_t seed)
+    {
+        const auto *bytes = static_cast<const uint8_t*>(data);
+        const uint8_t *end = bytes + size;
+        uint64_t hash;
+
+        if (size >= 32)
+        {
+            // Four independent lanes keep multipliers busy, bulk of a file hashes at several GB/s.
+            uint64_t lanes[4] = {seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1};
+            for (; end - bytes >= 32; bytes += 32)
+            {
+                lanes[0] = Round(lanes[0], Load64(bytes));
+                lanes[1] = Round(lanes[1], Load64(bytes + 8));
+                lanes[2] = Round(lanes[2], Load64(bytes + 16));
+                lanes[3] = Round(lanes[3], Load64(bytes + 24));
+            }
+            hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+            for (uint64_t lane : lanes)
+                hash = (hash ^ Round(0, lane)) * Prime1 + Prime3;
+        }
+        else
+        {
+            hash = seed + Prime3;
+        }
+
+        hash += static_cast<uint64_t>(size);
+        for (; end - bytes >= 8; bytes += 8)
+            hash = std::rotl(hash ^ Round(0, Load64(bytes)), 27) * Prime1 + Prime3;
+        if (bytes != end)
+        {
+            uint64_t tail = 0;
+            memcpy(&tail, bytes, static_cast<size_t>(end - bytes));
+            hash = std::rotl(hash ^ Round(0, tail), 23) * Prime2 + Prime1;
+        }
+        return Avalanche(hash);
+    }
+}
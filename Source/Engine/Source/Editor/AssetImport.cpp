@@ -0,0 +1,455 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Editor/AssetImport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <limits>
+#include <string_view>
+#include <unordered_set>
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include "AsyncWorker/AsyncTask.h"
+#include "Core/ContentHash.h"
+#include "Core/KoalaLogger.h"
+#include "FileSystem/File.h"
+#include "FileSystem/FileIOManager.h"
+
+// Bump when imported data changes for same source, every output is imported again then.
+constexpr uint64_t AssetImporterVersion = 1;
+constexpr const char *AssetImportManifestFileName = "AssetImportManifest.txt";
+constexpr const char *MeshOutputExtension = ".mesh";
+
+namespace Koala
+{
+    static Logger logger("AssetImport");
+
+    static std::string DecodeURI(std::string_view uri)
+    {
+        std::string decoded;
+        decoded.reserve(uri.size());
+        for (size_t i = 0; i < uri.size(); i++)
+        {
+            if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(static_cast<unsigned char>(uri[i + 1])) &&
+                std::isxdigit(static_cast<unsigned char>(uri[i + 2])))
+            {
+                decoded.push_back(static_cast<char>(std::stoi(std::string(uri.substr(i + 1, 2)), nullptr, 16)));
+                i += 2;
+            }
+            else if (uri[i] == '\\' && i + 1 < uri.size())
+            {
+                // JSON escape, e.g. "\/".
+                decoded.push_back(uri[++i]);
+            }
+            else
+            {
+                decoded.push_back(uri[i]);
+            }
+        }
+        return decoded;
+    }
+
+    // External files glTF refers to by "uri" (buffers, images), embedded data URIs excluded.
+    // Images do not change imported mesh, but telling them apart needs a JSON parser, and a few extra hashes are cheap.
+    // Scanning raw bytes also covers JSON chunk of .glb.
+    static std::vector<std::filesystem::path> FindGLTFDependencies(const std::filesystem::path &source,
+        const uint8_t *data, size_t size)
+    {
+        std::vector<std::filesystem::path> dependencies;
+        const std::string_view text(reinterpret_cast<const char*>(data), size);
+        constexpr std::string_view key = "\"uri\"";
+        for (size_t pos = text.find(key); pos != std::string_view::npos; pos = text.find(key, pos))
+        {
+            pos += key.size();
+            while (pos < text.size() && (std::isspace(static_cast<unsigned char>(text[pos])) || text[pos] == ':'))
+                pos++;
+            if (pos >= text.size() || text[pos] != '"')
+                continue;
+            size_t end = ++pos;
+            while (end < text.size() && text[end] != '"')
+                end += text[end] == '\\' ? 2 : 1;
+            if (end >= text.size())
+                break;
+
+            const std::string_view uri = text.substr(pos, end - pos);
+            pos = end + 1;
+            if (uri.empty() || uri.starts_with("data:"))
+                continue;
+            dependencies.push_back(source.parent_path() / std::filesystem::path(DecodeURI(uri)));
+        }
+        return dependencies;
+    }
+
+    // Hash of source content and files it refers to. OBJ material libraries are not followed,
+    // only geometry is imported. Return false if source cannot be read.
+    static bool HashSourceFile(const std::filesystem::path &source, uint64_t settingsHash, uint64_t &outHash)
+    {
+        FileIO::MappedFileRef file = FileIO::FileManager::Get().MapFileForRead(HashedString(source.string()), FileIO::EMappedFileAccessHint::Sequential);
+        if (!file)
+            return false;
+
+        uint64_t hash = HashMemory(file->GetData(), file->GetSize(), settingsHash);
+        std::string extension = source.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension == ".gltf" || extension == ".glb")
+        {
+            for (const std::filesystem::path &dependency : FindGLTFDependencies(source, file->GetData(), file->GetSize()))
+            {
+                // Missing dependency hashes differently from any content, import reports the error.
+                FileIO::MappedFileRef dependencyFile = FileIO::FileManager::Get().MapFileForRead(HashedString(dependency.string()),
+                    FileIO::EMappedFileAccessHint::Sequential);
+                hash = HashCombine(hash, dependencyFile ? HashMemory(dependencyFile->GetData(), dependencyFile->GetSize()) :
+                    std::numeric_limits<uint64_t>::max());
+            }
+        }
+        outHash = hash;
+        return true;
+    }
+
+    static bool WriteOutputFile(const std::filesystem::path &output, const std::function<bool(FileIO::WriteFileStream&)> &write)
+    {
+        FileIO::FileHandle handle = FileIO::FileManager::Get().OpenFileForWrite(HashedString(output.string()));
+        if (!handle)
+            return false;
+        FileIO::WriteFileStream file(handle);
+        const bool bWritten = write(file);
+        FileIO::FileManager::Get().CloseFile(handle);
+        return bWritten;
+    }
+
+    bool ImportMesh(const std::filesystem::path &source, MeshAsset &mesh, std::string &error)
+    {
+        Assimp::Importer importer;
+        // Only triangles are kept, points and lines are split off by SortByPType and dropped.
+        importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+        // Vulkan samples textures with origin at top left.
+        const aiScene *scene = importer.ReadFile(source.string(),
+            aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_GenSmoothNormals |
+            aiProcess_PreTransformVertices | aiProcess_FlipUVs);
+        if (!scene || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE))
+        {
+            error = importer.GetErrorString();
+            return false;
+        }
+
+        size_t numVertices = 0, numIndices = 0;
+        for (uint32_t meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++)
+        {
+            const aiMesh *sourceMesh = scene->mMeshes[meshIndex];
+            if (sourceMesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE)
+            {
+                numVertices += sourceMesh->mNumVertices;
+                numIndices += static_cast<size_t>(sourceMesh->mNumFaces) * 3;
+            }
+        }
+        if (numIndices == 0)
+        {
+            error = "No triangles in file";
+            return false;
+        }
+        if (numVertices > std::numeric_limits<uint32_t>::max())
+        {
+            error = "Too many vertices";
+            return false;
+        }
+
+        std::vector<Vector> vertices;
+        std::vector<uint32_t> indices;
+        vertices.reserve(numVertices);
+        indices.reserve(numIndices);
+        for (uint32_t meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++)
+        {
+            const aiMesh *sourceMesh = scene->mMeshes[meshIndex];
+            if (!(sourceMesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE))
+                continue;
+
+            const auto baseVertex = static_cast<uint32_t>(vertices.size());
+            const bool bHasNormals = sourceMesh->HasNormals();
+            const bool bHasUVs = sourceMesh->HasTextureCoords(0);
+            for (uint32_t vertexIndex = 0; vertexIndex < sourceMesh->mNumVertices; vertexIndex++)
+            {
+                Vector &vertex = vertices.emplace_back();
+                const aiVector3D &position = sourceMesh->mVertices[vertexIndex];
+                vertex.position = Vec3f(position.x, position.y, position.z);
+                if (bHasNormals)
+                {
+                    const aiVector3D &normal = sourceMesh->mNormals[vertexIndex];
+                    vertex.normal = Vec3f(normal.x, normal.y, normal.z);
+                }
+                if (bHasUVs)
+                {
+                    const aiVector3D &uv = sourceMesh->mTextureCoords[0][vertexIndex];
+                    vertex.uv = Vec2f(uv.x, uv.y);
+                }
+            }
+            for (uint32_t faceIndex = 0; faceIndex < sourceMesh->mNumFaces; faceIndex++)
+            {
+                const aiFace &face = sourceMesh->mFaces[faceIndex];
+                if (face.mNumIndices != 3)
+                    continue;
+                for (uint32_t corner = 0; corner < 3; corner++)
+                    indices.push_back(baseVertex + face.mIndices[corner]);
+            }
+        }
+
+        mesh.SetMeshData(std::move(vertices), std::move(indices));
+        mesh.SetAssetFilePath(HashedString(source.string()));
+        return true;
+    }
+
+    AssetImporter::AssetImporter(std::filesystem::path inOutputDirectory, const MeshBakeSettings &inSettings):
+        outputDirectory(std::move(inOutputDirectory)), settings(inSettings)
+    {
+        MeshAsset mesh;
+        mesh.SetBakeSettings(settings);
+        settingsHash = HashCombine(AssetImporterVersion, static_cast<uint64_t>(mesh.GetBakeVersion()));
+        settingsHash = HashCombine(settingsHash, mesh.GetBakeSettingsHash());
+    }
+
+    bool AssetImporter::IsSupportedSourceFile(const std::filesystem::path &path)
+    {
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return extension == ".obj" || extension == ".gltf" || extension == ".glb";
+    }
+
+    std::filesystem::path AssetImporter::GetOutputPath(const std::filesystem::path &source,
+        const std::filesystem::path &sourceRoot) const
+    {
+        std::filesystem::path relativePath = source.filename();
+        if (!sourceRoot.empty())
+        {
+            std::filesystem::path relativeToRoot = source.lexically_relative(sourceRoot);
+            // Sources outside of root fall back to file name.
+            if (!relativeToRoot.empty() && *relativeToRoot.begin() != "..")
+                relativePath = std::move(relativeToRoot);
+        }
+        relativePath.replace_extension(MeshOutputExtension);
+        return outputDirectory / relativePath;
+    }
+
+    std::string AssetImporter::GetManifestKey(const std::filesystem::path &output) const
+    {
+        return output.lexically_relative(outputDirectory).generic_string();
+    }
+
+    std::vector<AssetImportResult> AssetImporter::Import(const std::vector<std::filesystem::path> &sources,
+        const std::filesystem::path &sourceRoot)
+    {
+        std::vector<AssetImportResult> results(sources.size());
+        if (sources.empty())
+            return results;
+        if (!bManifestLoaded)
+            LoadManifest();
+
+        const auto startTime = std::chrono::steady_clock::now();
+
+        // Two sources differing only in extension would bake into same output, only first one is imported.
+        std::vector<std::filesystem::path> outputs(sources.size());
+        std::vector<size_t> pending;
+        std::vector<bool> bPending(sources.size(), false);
+        std::unordered_set<std::string> usedOutputs;
+        for (size_t index = 0; index < sources.size(); index++)
+        {
+            outputs[index] = GetOutputPath(sources[index], sourceRoot);
+            results[index].source = sources[index];
+            results[index].output = outputs[index];
+            if (usedOutputs.insert(GetManifestKey(outputs[index])).second)
+            {
+                pending.push_back(index);
+                bPending[index] = true;
+            }
+            else
+                results[index].error = "Output collides with another source";
+        }
+
+        // Bakes write through FileIO, so main thread waits on a future and keeps ticking it,
+        // instead of blocking in WaitAllFinished().
+        std::vector<uint64_t> inputHashes(sources.size(), 0);
+        std::promise<void> allFinished;
+        std::future<void> allFinishedFuture = allFinished.get_future();
+        std::atomic<size_t> numRemaining = pending.size();
+        TaskSetPtr tasks = Koala::Async([&](void*, size_t taskIndex)
+        {
+            const size_t index = pending[taskIndex];
+            results[index] = ImportSource(sources[index], outputs[index], inputHashes[index]);
+            if (numRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                allFinished.set_value();
+        }, pending.size());
+        FileIO::FileIOManager::Get().WaitForResult(allFinishedFuture);
+        tasks->WaitAllFinished();
+
+        size_t numImported = 0, numFromCache = 0, numUpToDate = 0, numFailed = 0;
+        for (size_t index = 0; index < sources.size(); index++)
+        {
+            const AssetImportResult &result = results[index];
+            switch (result.status)
+            {
+            case EAssetImportStatus::Imported:
+                manifest[GetManifestKey(result.output)] = inputHashes[index];
+                numImported++;
+                numFromCache += result.bFromCache ? 1 : 0;
+                break;
+            case EAssetImportStatus::UpToDate:
+                numUpToDate++;
+                break;
+            case EAssetImportStatus::Failed:
+                // Output may be partially written, it must not be taken as up to date.
+                if (bPending[index])
+                    manifest.erase(GetManifestKey(result.output));
+                logger.error("Failed to import {}: {}", result.source.string(), result.error);
+                numFailed++;
+                break;
+            }
+        }
+        if (numImported > 0 || numFailed > 0)
+            SaveManifest();
+
+        const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        logger.info("Imported {} of {} sources in {:.1f}ms ({} from derived data cache), {} up to date, {} failed",
+            numImported, sources.size(), elapsed, numFromCache, numUpToDate, numFailed);
+        return results;
+    }
+
+    std::vector<AssetImportResult> AssetImporter::ImportDirectory(const std::filesystem::path &directory)
+    {
+        std::vector<std::filesystem::path> sources;
+        std::error_code errorCode;
+        for (auto it = std::filesystem::recursive_directory_iterator(directory, errorCode);
+             it != std::filesystem::recursive_directory_iterator(); it.increment(errorCode))
+        {
+            if (errorCode)
+                break;
+            if (it->is_regular_file() && IsSupportedSourceFile(it->path()))
+                sources.push_back(it->path());
+        }
+        if (errorCode)
+            logger.error("Failed to list directory {}: {}", directory.string(), errorCode.message());
+
+        // Same order on every run, so output collisions resolve the same way.
+        std::sort(sources.begin(), sources.end());
+        return Import(sources, directory);
+    }
+
+    AssetImportResult AssetImporter::ImportSource(const std::filesystem::path &source, const std::filesystem::path &output,
+        uint64_t &outInputHash) const
+    {
+        AssetImportResult result;
+        result.source = source;
+        result.output = output;
+
+        if (!HashSourceFile(source, settingsHash, outInputHash))
+        {
+            result.error = "Cannot read source file";
+            return result;
+        }
+
+        if (!bForceReimport)
+        {
+            auto it = manifest.find(GetManifestKey(output));
+            std::error_code errorCode;
+            if (it != manifest.end() && it->second == outInputHash && std::filesystem::is_regular_file(output, errorCode))
+            {
+                result.status = EAssetImportStatus::UpToDate;
+                return result;
+            }
+        }
+
+        MeshAsset mesh;
+        mesh.SetBakeSettings(settings);
+        auto build = [&](FileIO::WriteFileStream &file)
+        {
+            if (!ImportMesh(source, mesh, result.error))
+                return false;
+            if (!mesh.Bake(file))
+            {
+                result.error = "Bake failed";
+                return false;
+            }
+            return true;
+        };
+
+        std::error_code errorCode;
+        std::filesystem::create_directories(output.parent_path(), errorCode);
+        bool bWritten;
+        if (derivedDataCache)
+            bWritten = derivedDataCache->FetchOrBuild(DerivedDataCache::MakeKey(mesh, outInputHash), output, build, &result.bFromCache);
+        else
+            bWritten = WriteOutputFile(output, build);
+        if (!bWritten)
+        {
+            if (result.error.empty())
+                result.error = "Cannot write output file";
+            return result;
+        }
+
+        result.status = EAssetImportStatus::Imported;
+        return result;
+    }
+
+    void AssetImporter::LoadManifest()
+    {
+        bManifestLoaded = true;
+        manifest.clear();
+        std::ifstream file(outputDirectory / AssetImportManifestFileName);
+        if (!file.is_open())
+            return;
+
+        // Each line is hash in hex, tab, output path relative to output directory.
+        std::string line;
+        while (std::getline(file, line))
+        {
+            const size_t separator = line.find('\t');
+            if (separator == std::string::npos || separator == 0)
+                continue;
+            try
+            {
+                manifest[line.substr(separator + 1)] = std::stoull(line.substr(0, separator), nullptr, 16);
+            }
+            catch (const std::exception &)
+            {
+                logger.warning("Ignored malformed line in import manifest: {}", line);
+            }
+        }
+    }
+
+    bool AssetImporter::SaveManifest() const
+    {
+        std::error_code errorCode;
+        std::filesystem::create_directories(outputDirectory, errorCode);
+        std::ofstream file(outputDirectory / AssetImportManifestFileName, std::ios::trunc);
+        if (!file.is_open())
+        {
+            logger.error("Failed to save import manifest in {}", outputDirectory.string());
+            return false;
+        }
+
+        for (const auto &[output, hash] : manifest)
+            file << fmt::format("{:016x}\t{}\n", hash, output);
+        return true;
+    }
+}
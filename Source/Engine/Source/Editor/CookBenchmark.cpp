@@ -0,0 +1,129 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Editor/CookBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+
+#include "Config.h"
+#include "Asset/DerivedDataCache.h"
+#include "Core/KoalaLogger.h"
+#include "Editor/AssetImport.h"
+
+namespace Koala
+{
+    static Logger logger("CookBenchmark");
+
+    // Wavy heightfield of gridSize x gridSize quads, shape differs per seed.
+    static bool WriteGridSource(const std::filesystem::path &path, uint32_t gridSize, uint32_t seed)
+    {
+        std::ofstream file(path, std::ios::trunc);
+        if (!file.is_open())
+            return false;
+
+        const float frequency = 0.05f + 0.01f * static_cast<float>(seed % 7);
+        const float phase = 0.37f * static_cast<float>(seed);
+        for (uint32_t y = 0; y <= gridSize; y++)
+        {
+            for (uint32_t x = 0; x <= gridSize; x++)
+            {
+                const float height = std::sin(x * frequency + phase) * std::cos(y * frequency - phase) * 4.0f;
+                file << fmt::format("v {} {} {:.4f}\n", x, y, height);
+            }
+        }
+        // OBJ indices start at 1.
+        for (uint32_t y = 0; y < gridSize; y++)
+        {
+            for (uint32_t x = 0; x < gridSize; x++)
+            {
+                const uint32_t corner = y * (gridSize + 1) + x + 1;
+                file << fmt::format("f {} {} {} {}\n", corner, corner + 1, corner + gridSize + 2, corner + gridSize + 1);
+            }
+        }
+        return file.good();
+    }
+
+    void RunCookBenchmark(const std::filesystem::path &directory, uint32_t numSources, uint32_t gridSize)
+    {
+        const std::filesystem::path benchmarkPath = directory / "KoalaCookBenchmark";
+        const std::filesystem::path sourcePath = benchmarkPath / "Source";
+        std::error_code error;
+        std::filesystem::remove_all(benchmarkPath, error);
+        std::filesystem::create_directories(sourcePath, error);
+
+        for (uint32_t index = 0; index < numSources; index++)
+        {
+            if (!WriteGridSource(sourcePath / ("Grid" + std::to_string(index) + ".obj"), gridSize, index))
+            {
+                logger.error("Failed to write benchmark sources to {}", sourcePath.string());
+                std::filesystem::remove_all(benchmarkPath, error);
+                return;
+            }
+        }
+
+        // Large enough that nothing is evicted between passes.
+        DerivedDataCache cache;
+        if (!cache.Open(benchmarkPath / "DerivedDataCache", uint64_t(1) << 40))
+        {
+            std::filesystem::remove_all(benchmarkPath, error);
+            return;
+        }
+
+        auto runPass = [&](const char *label, const std::filesystem::path &outputPath)
+        {
+            AssetImporter importer(outputPath);
+            importer.SetDerivedDataCache(&cache);
+            const auto startTime = std::chrono::steady_clock::now();
+            const std::vector<AssetImportResult> results = importer.ImportDirectory(sourcePath);
+            const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+            size_t numBaked = 0, numFromCache = 0, numUpToDate = 0, numFailed = 0;
+            for (const AssetImportResult &result : results)
+            {
+                numBaked += result.status == EAssetImportStatus::Imported && !result.bFromCache ? 1 : 0;
+                numFromCache += result.status == EAssetImportStatus::Imported && result.bFromCache ? 1 : 0;
+                numUpToDate += result.status == EAssetImportStatus::UpToDate ? 1 : 0;
+                numFailed += result.status == EAssetImportStatus::Failed ? 1 : 0;
+            }
+            logger.info("[{}] {} sources in {:.1f}ms, {:.2f}ms per source: {} baked, {} from cache, {} up to date, {} failed",
+                label, results.size(), elapsed, elapsed / std::max<size_t>(results.size(), 1),
+                numBaked, numFromCache, numUpToDate, numFailed);
+        };
+
+        logger.info("Cooking {} sources of {} triangles", numSources, 2 * gridSize * gridSize);
+        runPass("cold", benchmarkPath / "ColdOutput");
+        runPass("warm cache", benchmarkPath / "WarmOutput");
+        runPass("up to date", benchmarkPath / "WarmOutput");
+
+        const DerivedDataCacheStats stats = cache.GetStats();
+        logger.info("Derived data cache: {} entries, {:.1f} MB", stats.numEntries, stats.size / 1048576.0);
+        cache.Close();
+        std::filesystem::remove_all(benchmarkPath, error);
+    }
+
+    void RunCookBenchmarks()
+    {
+        const std::string directory = Config::Get().GetSettingAndWriteDefault("cook.benchmark.dir", "Saved", true);
+        const uint32_t numSources = static_cast<uint32_t>(Config::Get().GetUIntSettingAndWriteDefault("cook.benchmark.numsources", 64, true));
+        const uint32_t gridSize = static_cast<uint32_t>(Config::Get().GetUIntSettingAndWriteDefault("cook.benchmark.gridsize", 128, true));
+        RunCookBenchmark(directory, numSources, gridSize);
+    }
+}
@@ -0,0 +1,161 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Editor/TextureBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Config.h"
+#include "Asset/MipGenerator.h"
+#include "Asset/TextureCompression.h"
+#include "Core/KoalaLogger.h"
+
+namespace Koala
+{
+    static Logger logger("TextureBenchmark");
+
+    // Each benchmark is repeated until it ran at least this long.
+    constexpr double TextureBenchmarkMinSeconds = 1.0;
+
+    // Smooth gradients with sharp rings, alpha a soft mask. Format has 4 channels.
+    static std::vector<uint8_t> MakeBenchmarkImage(EPixelFormat format, uint32_t width, uint32_t height)
+    {
+        const uint32_t pixelBytes = GetPixelFormatBlockBytes(format);
+        constexpr uint32_t numChannels = 4;
+        const uint32_t channelBytes = pixelBytes / numChannels;
+        std::vector<uint8_t> image(static_cast<size_t>(width) * height * pixelBytes);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                const float u = static_cast<float>(x) / width, v = static_cast<float>(y) / height;
+                const float ring = std::sin((u * u + v * v) * 400.0f) * 0.5f + 0.5f;
+                const float values[4] = {u, v, ring, std::clamp(2.0f - 4.0f * std::abs(u - 0.5f), 0.0f, 1.0f)};
+                uint8_t *pixel = image.data() + (static_cast<size_t>(y) * width + x) * pixelBytes;
+                for (uint32_t channel = 0; channel < numChannels; channel++)
+                {
+                    if (channelBytes == 1)
+                    {
+                        pixel[channel] = static_cast<uint8_t>(values[channel] * 255.0f + 0.5f);
+                    }
+                    else if (channelBytes == 2)
+                    {
+                        const uint16_t value = static_cast<uint16_t>(values[channel] * 65535.0f + 0.5f);
+                        std::memcpy(pixel + channel * 2, &value, sizeof(value));
+                    }
+                    else
+                    {
+                        std::memcpy(pixel + channel * 4, &values[channel], sizeof(float));
+                    }
+                }
+            }
+        }
+        return image;
+    }
+
+    // Run function until it took TextureBenchmarkMinSeconds, return seconds per run.
+    template <typename Function>
+    static double TimeRuns(const Function &function)
+    {
+        uint32_t numRuns = 0;
+        const auto startTime = std::chrono::steady_clock::now();
+        double elapsed = 0.0;
+        do
+        {
+            function();
+            numRuns++;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        } while (elapsed < TextureBenchmarkMinSeconds);
+        return elapsed / numRuns;
+    }
+
+    void RunTextureBenchmark(uint32_t width, uint32_t height)
+    {
+        const double megapixels = static_cast<double>(width) * height / 1e6;
+        logger.info("Texture benchmark on {}x{} image", width, height);
+
+        struct FormatCase
+        {
+            EPixelFormat format;
+            bool         bSRGB;
+            const char  *label;
+        };
+        const FormatCase formats[] = {
+            {PF_R8G8B8A8, false, "RGBA8"},
+            {PF_R8G8B8A8, true, "RGBA8 sRGB"},
+            {PF_R16G16B16A16, false, "RGBA16"},
+            {PF_R32G32B32A32, false, "RGBA32F"},
+        };
+        const std::pair<EMipFilter, const char*> filters[] = {
+            {EMipFilter::Box, "box"},
+            {EMipFilter::Kaiser, "kaiser"},
+            {EMipFilter::Lanczos, "lanczos"},
+        };
+
+        std::vector<std::vector<uint8_t>> rgbaMips;
+        for (const FormatCase &formatCase : formats)
+        {
+            const std::vector<uint8_t> image = MakeBenchmarkImage(formatCase.format, width, height);
+            for (const auto &[filter, filterLabel] : filters)
+            {
+                MipGenerationSettings settings;
+                settings.filter = filter;
+                settings.bSRGB = formatCase.bSRGB;
+                std::vector<std::vector<uint8_t>> mips;
+                const double seconds = TimeRuns([&]() { mips = GenerateMips(formatCase.format, image.data(), width, height, settings); });
+                logger.info("[mips] {} {}: {:.2f}ms, {:.1f} MP/s", formatCase.label, filterLabel, seconds * 1000.0, megapixels / seconds);
+                if (formatCase.format == PF_R8G8B8A8 && formatCase.bSRGB && filter == EMipFilter::Kaiser)
+                    rgbaMips = std::move(mips);
+            }
+        }
+
+        double chainMegapixels = 0.0;
+        for (uint32_t mip = 0; mip < rgbaMips.size(); mip++)
+            chainMegapixels += static_cast<double>(std::max(width >> mip, 1u)) * std::max(height >> mip, 1u) / 1e6;
+        const std::pair<EPixelFormat, const char*> compressedFormats[] = {{PF_DXT1, "BC1"}, {PF_DXT5, "BC3"}, {PF_BC5, "BC5"}};
+        const std::pair<ETextureCompressionQuality, const char*> qualities[] = {
+            {ETextureCompressionQuality::Fast, "fast"},
+            {ETextureCompressionQuality::Normal, "normal"},
+            {ETextureCompressionQuality::High, "high"},
+        };
+        for (const auto &[format, formatLabel] : compressedFormats)
+        {
+            for (const auto &[quality, qualityLabel] : qualities)
+            {
+                const double seconds = TimeRuns([&]()
+                {
+                    for (uint32_t mip = 0; mip < rgbaMips.size(); mip++)
+                        (void)CompressImage(format, rgbaMips[mip], std::max(width >> mip, 1u), std::max(height >> mip, 1u), quality);
+                });
+                logger.info("[compress] {} {}: {:.2f}ms, {:.1f} MP/s", formatLabel, qualityLabel, seconds * 1000.0, chainMegapixels / seconds);
+            }
+        }
+    }
+
+    void RunTextureBenchmarks()
+    {
+        const uint32_t width = static_cast<uint32_t>(Config::Get().GetUIntSettingAndWriteDefault("texture.benchmark.width", 2048, true));
+        const uint32_t height = static_cast<uint32_t>(Config::Get().GetUIntSettingAndWriteDefault("texture.benchmark.height", 2048, true));
+        RunTextureBenchmark(width, height);
+    }
+}
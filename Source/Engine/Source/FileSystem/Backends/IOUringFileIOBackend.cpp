@@ -0,0 +1,447 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "IOUringFileIOBackend.h"
+
+#ifdef FILEIO_ENABLE_IO_URING
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <thread>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace Koala::FileIO
+{
+    // Marks request as not completed yet.
+    constexpr int64_t PendingRequestResult = INT64_MIN;
+    // Request index in user_data of cancel requests, their completions are not counted.
+    constexpr uint32_t CancelRequestIndex = UINT32_MAX;
+
+    static int IOUringSetup(uint32_t entries, io_uring_params *params)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    static int IOUringEnter(int ringFd, uint32_t toSubmit, uint32_t minComplete, uint32_t flags)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+    }
+
+    static int IOUringRegister(int ringFd, uint32_t opcode, const void *arg, uint32_t numArgs)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_register, ringFd, opcode, arg, numArgs));
+    }
+
+    template <typename T>
+    static T* RingOffset(void *ringPtr, uint32_t offset)
+    {
+        return reinterpret_cast<T*>(static_cast<uint8_t*>(ringPtr) + offset);
+    }
+
+    IOUringFileIOBackend::~IOUringFileIOBackend()
+    {
+        Shutdown();
+    }
+
+    bool IOUringFileIOBackend::Initialize(uint32_t inQueueDepth)
+    {
+        io_uring_params params{};
+        ringFd = IOUringSetup(std::max(inQueueDepth, 1u), &params);
+        if (ringFd < 0)
+            return false;
+
+        sqEntries = params.sq_entries;
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+        const bool bSingleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (bSingleMmap)
+        {
+            sqRingSize = std::max(sqRingSize, cqRingSize);
+            cqRingSize = sqRingSize;
+        }
+
+        sqRingPtr = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (sqRingPtr == MAP_FAILED)
+        {
+            sqRingPtr = nullptr;
+            Shutdown();
+            return false;
+        }
+
+        if (bSingleMmap)
+        {
+            cqRingPtr = sqRingPtr;
+        }
+        else
+        {
+            cqRingPtr = ::mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+            if (cqRingPtr == MAP_FAILED)
+            {
+                cqRingPtr = nullptr;
+                Shutdown();
+                return false;
+            }
+        }
+
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqesPtr = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (sqesPtr == MAP_FAILED)
+        {
+            Shutdown();
+            return false;
+        }
+        sqes = static_cast<io_uring_sqe*>(sqesPtr);
+
+        sqHead = RingOffset<uint32_t>(sqRingPtr, params.sq_off.head);
+        sqTail = RingOffset<uint32_t>(sqRingPtr, params.sq_off.tail);
+        sqMask = RingOffset<uint32_t>(sqRingPtr, params.sq_off.ring_mask);
+        sqArray = RingOffset<uint32_t>(sqRingPtr, params.sq_off.array);
+
+        cqHead = RingOffset<uint32_t>(cqRingPtr, params.cq_off.head);
+        cqTail = RingOffset<uint32_t>(cqRingPtr, params.cq_off.tail);
+        cqMask = RingOffset<uint32_t>(cqRingPtr, params.cq_off.ring_mask);
+        cqes = RingOffset<io_uring_cqe>(cqRingPtr, params.cq_off.cqes);
+
+        if (!ProbeSupportedOps())
+        {
+            Shutdown();
+            return false;
+        }
+        return true;
+    }
+
+    void IOUringFileIOBackend::Shutdown()
+    {
+        if (sqes)
+            ::munmap(sqes, sqesSize);
+        if (cqRingPtr && cqRingPtr != sqRingPtr)
+            ::munmap(cqRingPtr, cqRingSize);
+        if (sqRingPtr)
+            ::munmap(sqRingPtr, sqRingSize);
+        if (ringFd >= 0)
+            ::close(ringFd);
+
+        sqes = nullptr;
+        cqRingPtr = nullptr;
+        sqRingPtr = nullptr;
+        ringFd = -1;
+        registeredBuffers.clear();
+    }
+
+    bool IOUringFileIOBackend::ProbeSupportedOps()
+    {
+        constexpr uint32_t NumProbeOps = 256;
+        std::vector<uint8_t> storage(sizeof(io_uring_probe) + NumProbeOps * sizeof(io_uring_probe_op));
+        auto probe = reinterpret_cast<io_uring_probe*>(storage.data());
+
+        // IORING_REGISTER_PROBE itself requires 5.6+, which is also the first version has IORING_OP_READ/WRITE.
+        if (IOUringRegister(ringFd, IORING_REGISTER_PROBE, probe, NumProbeOps) < 0)
+            return false;
+
+        auto isSupported = [probe](uint8_t op)
+        {
+            return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+        };
+
+        return isSupported(IORING_OP_READ) && isSupported(IORING_OP_WRITE) &&
+            isSupported(IORING_OP_READ_FIXED) && isSupported(IORING_OP_WRITE_FIXED) &&
+            isSupported(IORING_OP_WRITEV) && isSupported(IORING_OP_FSYNC);
+    }
+
+    int IOUringFileIOBackend::FindRegisteredBuffer(const void *buffer, int64_t size) const
+    {
+        auto begin = static_cast<const uint8_t*>(buffer);
+        for (size_t i = 0; i < registeredBuffers.size(); ++i)
+        {
+            auto regBegin = static_cast<const uint8_t*>(registeredBuffers[i].buffer);
+            if (begin >= regBegin && begin + size <= regBegin + registeredBuffers[i].size)
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    void IOUringFileIOBackend::PrepareRequest(io_uring_sqe *sqe, const FileIORequest &request, uint64_t userData) const
+    {
+        std::memset(sqe, 0, sizeof(io_uring_sqe));
+        sqe->fd = request.nativeHandle;
+        sqe->user_data = userData;
+
+        if (request.opType == EFileIOOpType::Sync)
+        {
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fsync_flags = request.syncMode == EFileSyncMode::Data ? IORING_FSYNC_DATASYNC : 0;
+            return;
+        }
+
+        if (request.opType == EFileIOOpType::WriteGather)
+        {
+            // FileIOBufferSpan has iovec layout.
+            sqe->opcode = IORING_OP_WRITEV;
+            sqe->off = static_cast<uint64_t>(request.offset);
+            sqe->addr = reinterpret_cast<uint64_t>(request.spans);
+            sqe->len = std::min(request.numSpans, MaxGatherSpansPerRequest);
+            return;
+        }
+
+        const bool bRead = request.opType == EFileIOOpType::Read;
+        const int bufferIndex = FindRegisteredBuffer(request.buffer, request.size);
+        if (bufferIndex >= 0)
+        {
+            sqe->opcode = bRead ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+            sqe->buf_index = static_cast<uint16_t>(bufferIndex);
+        }
+        else
+        {
+            sqe->opcode = bRead ? IORING_OP_READ : IORING_OP_WRITE;
+        }
+        sqe->off = static_cast<uint64_t>(request.offset);
+        sqe->addr = reinterpret_cast<uint64_t>(request.buffer);
+        sqe->len = static_cast<uint32_t>(request.size);
+    }
+
+    uint32_t IOUringFileIOBackend::ReapCompletions(FileIORequest *requests)
+    {
+        uint32_t head = *cqHead;
+        const uint32_t tail = std::atomic_ref(*cqTail).load(std::memory_order::acquire);
+        uint32_t numReaped = 0;
+        while (head != tail)
+        {
+            const io_uring_cqe &cqe = cqes[head & *cqMask];
+            // Cancel requests complete on their own, a late one may come after its batch is done.
+            const uint32_t index = cqe.user_data & 0xFFFFFFFF;
+            if ((cqe.user_data >> 32) == batchSerial && index != CancelRequestIndex)
+            {
+                requests[index].result = cqe.res;
+                ++numReaped;
+            }
+            ++head;
+        }
+        std::atomic_ref(*cqHead).store(head, std::memory_order::release);
+        return numReaped;
+    }
+
+    void IOUringFileIOBackend::OrderBatch(const FileIORequest *batch, uint32_t batchSize)
+    {
+        submitOrder.clear();
+        writeGroups.clear();
+        for (uint32_t i = 0; i < batchSize; ++i)
+        {
+            const FileIORequest &request = batch[i];
+            if (request.opType == EFileIOOpType::Read)
+            {
+                submitOrder.push_back({i, false});
+                continue;
+            }
+            auto group = std::find_if(writeGroups.begin(), writeGroups.end(),
+                [&request](const WriteGroup &group) { return group.nativeHandle == request.nativeHandle; });
+            if (group == writeGroups.end())
+                group = writeGroups.insert(writeGroups.end(), {request.nativeHandle, {}});
+            group->requests.push_back(i);
+        }
+
+        // Linked SQEs must be adjacent, each one starts after the one before it completed.
+        for (const WriteGroup &group: writeGroups)
+        {
+            for (size_t i = 0; i < group.requests.size(); ++i)
+                submitOrder.push_back({group.requests[i], i + 1 < group.requests.size()});
+        }
+    }
+
+    void IOUringFileIOBackend::CancelSubmitted(uint32_t numSubmitted)
+    {
+        uint32_t tail = *sqTail;
+        for (uint32_t i = 0; i < numSubmitted; ++i)
+        {
+            const uint32_t index = tail & *sqMask;
+            io_uring_sqe *sqe = &sqes[index];
+            std::memset(sqe, 0, sizeof(io_uring_sqe));
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = (static_cast<uint64_t>(batchSerial) << 32) | submitOrder[i].requestIndex;
+            sqe->user_data = (static_cast<uint64_t>(batchSerial) << 32) | CancelRequestIndex;
+            sqArray[index] = index;
+            ++tail;
+        }
+        std::atomic_ref(*sqTail).store(tail, std::memory_order::release);
+
+        // Completed ones are not found, that is fine. If ring can not take cancels, requests just run to completion.
+        uint32_t numToSubmit = numSubmitted;
+        while (numToSubmit > 0)
+        {
+            const int ret = IOUringEnter(ringFd, numToSubmit, 0, 0);
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret <= 0)
+            {
+                std::atomic_ref(*sqTail).store(tail - numToSubmit, std::memory_order::release);
+                break;
+            }
+            numToSubmit -= ret;
+        }
+    }
+
+    void IOUringFileIOBackend::SubmitAndWait(FileIORequest *requests, uint32_t numRequests)
+    {
+        // Links keep order inside one ring sized batch, writes after a broken chain must not run in the next one either.
+        brokenWriteHandles.clear();
+        uint32_t base = 0;
+        while (base < numRequests)
+        {
+            const uint32_t batchSize = std::min(numRequests - base, sqEntries);
+            FileIORequest *batch = requests + base;
+            ++batchSerial;
+
+            OrderBatch(batch, batchSize);
+
+            // Only this thread produces SQEs, so we can read tail without synchronization.
+            uint32_t tail = *sqTail;
+            uint32_t numPrepared = 0;
+            for (const SubmitEntry &entry: submitOrder)
+            {
+                FileIORequest &request = batch[entry.requestIndex];
+                if (request.opType != EFileIOOpType::Read &&
+                    std::find(brokenWriteHandles.begin(), brokenWriteHandles.end(), request.nativeHandle) != brokenWriteHandles.end())
+                {
+                    request.result = -ECANCELED;
+                    continue;
+                }
+                // SQE length is 32 bits, do not let a truncated request run.
+                if (request.opType != EFileIOOpType::WriteGather && request.size > UINT32_MAX)
+                {
+                    request.result = -EINVAL;
+                    continue;
+                }
+                const uint32_t index = tail & *sqMask;
+                request.result = PendingRequestResult;
+                PrepareRequest(&sqes[index], request, (static_cast<uint64_t>(batchSerial) << 32) | entry.requestIndex);
+                if (entry.bLinkNext)
+                    sqes[index].flags |= IOSQE_IO_LINK;
+                sqArray[index] = index;
+                submitOrder[numPrepared++] = entry;
+                ++tail;
+            }
+            std::atomic_ref(*sqTail).store(tail, std::memory_order::release);
+
+            uint32_t numToSubmit = numPrepared;
+            uint32_t numCompleted = 0;
+            int fatalError = 0;
+
+            // Submit all SQEs with one syscall in common case.
+            while (numToSubmit > 0)
+            {
+                const int ret = IOUringEnter(ringFd, numToSubmit, 0, 0);
+                if (ret < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    if (errno == EAGAIN || errno == EBUSY)
+                    {
+                        // Kernel is short of resources, drain some completions and try again.
+                        numCompleted += ReapCompletions(batch);
+                        continue;
+                    }
+                    fatalError = errno;
+                    break;
+                }
+                numToSubmit -= ret;
+            }
+
+            if (numToSubmit > 0)
+            {
+                // Withdraw SQEs which are not consumed by kernel, they must not leak into next batch.
+                std::atomic_ref(*sqTail).store(tail - numToSubmit, std::memory_order::release);
+            }
+
+            numCompleted += ReapCompletions(batch);
+            const uint32_t numSubmitted = numPrepared - numToSubmit;
+            if (fatalError != 0 && numCompleted < numSubmitted)
+                CancelSubmitted(numSubmitted);
+
+            // Buffers of submitted requests belong to kernel until they complete, never return before that.
+            while (numCompleted < numSubmitted)
+            {
+                const int ret = IOUringEnter(ringFd, 0, numSubmitted - numCompleted, IORING_ENTER_GETEVENTS);
+                if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                {
+                    if (fatalError == 0)
+                    {
+                        fatalError = errno;
+                        CancelSubmitted(numSubmitted);
+                    }
+                    // Completions are still posted to CQ without waiting in kernel.
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                numCompleted += ReapCompletions(batch);
+            }
+
+            if (fatalError != 0)
+            {
+                for (uint32_t i = 0; i < batchSize; ++i)
+                {
+                    if (batch[i].result == PendingRequestResult)
+                        batch[i].result = -fatalError;
+                }
+            }
+
+            for (uint32_t i = 0; i < batchSize; ++i)
+            {
+                const FileIORequest &request = batch[i];
+                const bool bWriteFailed = request.opType == EFileIOOpType::Sync ? request.result != 0 : request.result < request.size;
+                if (request.opType != EFileIOOpType::Read && bWriteFailed &&
+                    std::find(brokenWriteHandles.begin(), brokenWriteHandles.end(), request.nativeHandle) == brokenWriteHandles.end())
+                    brokenWriteHandles.push_back(request.nativeHandle);
+            }
+            base += batchSize;
+        }
+    }
+
+    bool IOUringFileIOBackend::RegisterBuffers(const std::vector<FileIOBufferSpan> &buffers)
+    {
+        if (!registeredBuffers.empty())
+        {
+            IOUringRegister(ringFd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+            registeredBuffers.clear();
+        }
+
+        if (buffers.empty())
+            return true;
+
+        std::vector<iovec> iovecs;
+        iovecs.reserve(buffers.size());
+        for (auto &span: buffers)
+        {
+            iovecs.push_back({span.buffer, span.size});
+        }
+
+        if (IOUringRegister(ringFd, IORING_REGISTER_BUFFERS, iovecs.data(), static_cast<uint32_t>(iovecs.size())) < 0)
+            return false;
+
+        registeredBuffers = buffers;
+        return true;
+    }
+}
+#endif
@@ -0,0 +1,100 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include "FileSystem/FileIOBackend.h"
+
+#ifdef FILEIO_ENABLE_IO_URING
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace Koala::FileIO
+{
+    // io_uring backend implemented on raw syscalls (no liburing dependency).
+    // One ring per I/O thread. Requests of one batch are pushed into SQ and submitted by a single io_uring_enter.
+    // Buffers registered by RegisterBuffers() are read/written with IORING_OP_READ_FIXED/WRITE_FIXED.
+    // Gather writes use IORING_OP_WRITEV, sync barriers IORING_OP_FSYNC.
+    // Writes and syncs of one file in a batch are linked (IOSQE_IO_LINK), so they run in submission order.
+    class IOUringFileIOBackend final: public IFileIOBackend
+    {
+    public:
+        ~IOUringFileIOBackend() override;
+
+        bool Initialize(uint32_t inQueueDepth) override;
+        void Shutdown() override;
+
+        NODISCARD EFileIOBackend GetType() const override { return EFileIOBackend::IOUring; }
+        NODISCARD uint32_t GetQueueDepth() const override { return sqEntries; }
+
+        void SubmitAndWait(FileIORequest *requests, uint32_t numRequests) override;
+        bool RegisterBuffers(const std::vector<FileIOBufferSpan> &buffers) override;
+    private:
+        bool ProbeSupportedOps();
+        void PrepareRequest(io_uring_sqe *sqe, const FileIORequest &request, uint64_t userData) const;
+        // Return index of registered buffer containing given range, or -1.
+        int FindRegisteredBuffer(const void *buffer, int64_t size) const;
+        uint32_t ReapCompletions(FileIORequest *requests);
+        // Fill submitOrder: reads first, then writes and syncs grouped by file, in submission order per file.
+        void OrderBatch(const FileIORequest *batch, uint32_t batchSize);
+        // Ask kernel to cancel first numSubmitted entries of submitOrder, after a failed submission.
+        void CancelSubmitted(uint32_t numSubmitted);
+
+        int ringFd{-1};
+
+        void    *sqRingPtr{nullptr};
+        size_t   sqRingSize{0};
+        void    *cqRingPtr{nullptr};
+        size_t   cqRingSize{0};
+        io_uring_sqe *sqes{nullptr};
+        size_t   sqesSize{0};
+
+        uint32_t *sqHead{nullptr};
+        uint32_t *sqTail{nullptr};
+        uint32_t *sqMask{nullptr};
+        uint32_t *sqArray{nullptr};
+        uint32_t  sqEntries{0};
+
+        uint32_t *cqHead{nullptr};
+        uint32_t *cqTail{nullptr};
+        uint32_t *cqMask{nullptr};
+        io_uring_cqe *cqes{nullptr};
+
+        // Stored in high 32 bits of user_data, to identify which batch a completion belongs to.
+        uint32_t  batchSerial{0};
+
+        std::vector<FileIOBufferSpan> registeredBuffers;
+
+        struct SubmitEntry
+        {
+            uint32_t requestIndex{0};
+            // Next entry starts after this one completed.
+            bool     bLinkNext{false};
+        };
+        struct WriteGroup
+        {
+            NativeFileHandle      nativeHandle{InvalidNativeFileHandle};
+            std::vector<uint32_t> requests;
+        };
+        // Scratch space of SubmitAndWait(), kept to avoid allocating per batch.
+        std::vector<SubmitEntry> submitOrder;
+        std::vector<WriteGroup>  writeGroups;
+        // Files whose write fell short or failed in an earlier ring sized part of current batch.
+        std::vector<NativeFileHandle> brokenWriteHandles;
+    };
+}
+#endif
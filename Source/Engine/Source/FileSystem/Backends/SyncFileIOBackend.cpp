@@ -0,0 +1,68 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "SyncFileIOBackend.h"
+
+#include <algorithm>
+#include <cerrno>
+
+#include "FileSystem/PlatformFile.h"
+
+namespace Koala::FileIO
+{
+    bool SyncFileIOBackend::Initialize(uint32_t inQueueDepth)
+    {
+        queueDepth = inQueueDepth == 0 ? 1 : inQueueDepth;
+        return true;
+    }
+
+    void SyncFileIOBackend::SubmitAndWait(FileIORequest *requests, uint32_t numRequests)
+    {
+        brokenWriteHandles.clear();
+        for (uint32_t i = 0; i < numRequests; ++i)
+        {
+            FileIORequest &request = requests[i];
+            if (request.opType != EFileIOOpType::Read &&
+                std::find(brokenWriteHandles.begin(), brokenWriteHandles.end(), request.nativeHandle) != brokenWriteHandles.end())
+            {
+                request.result = -ECANCELED;
+                continue;
+            }
+
+            switch (request.opType)
+            {
+            case EFileIOOpType::Read:
+                request.result = PlatformFile::ReadAt(request.nativeHandle, request.buffer, request.size, request.offset);
+                break;
+            case EFileIOOpType::Write:
+                request.result = PlatformFile::WriteAt(request.nativeHandle, request.buffer, request.size, request.offset);
+                break;
+            case EFileIOOpType::WriteGather:
+                request.result = PlatformFile::WriteGatherAt(request.nativeHandle, request.spans, request.numSpans, request.offset);
+                break;
+            case EFileIOOpType::Sync:
+                request.result = PlatformFile::Sync(request.nativeHandle, request.syncMode) ? 0 : -1;
+                break;
+            }
+
+            const bool bWriteFailed = request.opType == EFileIOOpType::Sync ? request.result != 0 : request.result < request.size;
+            if (request.opType != EFileIOOpType::Read && bWriteFailed)
+                brokenWriteHandles.push_back(request.nativeHandle);
+        }
+    }
+}
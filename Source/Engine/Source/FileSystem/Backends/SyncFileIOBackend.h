@@ -0,0 +1,42 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+#include "FileSystem/FileIOBackend.h"
+
+namespace Koala::FileIO
+{
+    // Fallback backend. Requests are executed one by one via pread/pwrite on calling I/O thread.
+    // The concurrency comes from the number of I/O threads.
+    class SyncFileIOBackend final: public IFileIOBackend
+    {
+    public:
+        bool Initialize(uint32_t inQueueDepth) override;
+        void Shutdown() override {}
+
+        NODISCARD EFileIOBackend GetType() const override { return EFileIOBackend::Synchronous; }
+        NODISCARD uint32_t GetQueueDepth() const override { return queueDepth; }
+
+        void SubmitAndWait(FileIORequest *requests, uint32_t numRequests) override;
+        bool RegisterBuffers(const std::vector<FileIOBufferSpan> &) override { return true; }
+    private:
+        uint32_t queueDepth{1};
+        // Files whose write fell short or failed in current batch. Scratch space of SubmitAndWait().
+        std::vector<NativeFileHandle> brokenWriteHandles;
+    };
+}
@@ -0,0 +1,91 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "FileSystem/DirectIOBufferPool.h"
+
+#include "Memory/Allocator.h"
+
+namespace Koala::FileIO
+{
+    DirectIOBufferPool::~DirectIOBufferPool()
+    {
+        Shutdown();
+    }
+
+    void DirectIOBufferPool::Initialize(size_t inBufferSize, uint32_t inNumBuffers)
+    {
+        Shutdown();
+        if (inBufferSize == 0 || inNumBuffers == 0)
+            return;
+
+        bufferSize = (inBufferSize + DirectIOAlignment - 1) / DirectIOAlignment * DirectIOAlignment;
+        numBuffers = inNumBuffers;
+        memory = static_cast<uint8_t*>(Memory::MallocAligned(bufferSize * numBuffers, DirectIOAlignment));
+        if (!memory)
+        {
+            numBuffers = 0;
+            return;
+        }
+
+        std::lock_guard lock(mutex);
+        freeBuffers.reserve(numBuffers);
+        for (uint32_t i = 0; i < numBuffers; ++i)
+        {
+            freeBuffers.push_back(memory + i * bufferSize);
+        }
+    }
+
+    void DirectIOBufferPool::Shutdown()
+    {
+        std::lock_guard lock(mutex);
+        freeBuffers.clear();
+        if (memory)
+            Memory::FreeAligned(memory);
+        memory = nullptr;
+        numBuffers = 0;
+    }
+
+    void* DirectIOBufferPool::Acquire()
+    {
+        std::lock_guard lock(mutex);
+        if (freeBuffers.empty())
+            return nullptr;
+        void *buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+        return buffer;
+    }
+
+    void DirectIOBufferPool::Release(void *buffer)
+    {
+        std::lock_guard lock(mutex);
+        freeBuffers.push_back(buffer);
+    }
+
+    bool DirectIOBufferPool::IsPooledBuffer(const void *buffer) const
+    {
+        auto ptr = static_cast<const uint8_t*>(buffer);
+        return memory && ptr >= memory && ptr < memory + bufferSize * numBuffers;
+    }
+
+    std::vector<FileIOBufferSpan> DirectIOBufferPool::GetBufferSpans() const
+    {
+        if (!memory)
+            return {};
+        return {FileIOBufferSpan{memory, bufferSize * numBuffers}};
+    }
+}
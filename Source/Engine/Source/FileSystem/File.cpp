@@ -19,55 +19,76 @@
 #include "FileSystem/File.h"
 
 #include "Core/Check.h"
+#include "FileSystem/PakFile.h"
+#include "FileSystem/PlatformFile.h"
 
 namespace Koala::FileIO
 {
     static Logger logger("FileIO");
     FileHandle FileManager::OpenFileForRead(HashedString path, EOpenFileModes openMode)
     {
-        std::scoped_lock lock(mutex);
-        if (openedFilesForWrite.contains(path))
-        {
-            logger.error("Failed to open file {} for read because this file is already opened for write", path.GetString());
-            return nullptr;
-        }
-        if (openedFilesForRead.contains(path))
-            return openedFilesForRead[path];
-        else
         {
-            std::fstream stream;
-            std::ios::openmode mode{};
-            if (!(openMode & (uint32_t)EFileOpenMode::OpenFileAsText))
+            std::scoped_lock lock(mutex);
+            if (openedFilesForWrite.contains(path))
             {
-                mode = std::ios::binary;
+                logger.error("Failed to open file {} for read because this file is already opened for write", path.GetString());
+                return nullptr;
             }
+            if (auto it = openedFilesForRead.find(path); it != openedFilesForRead.end())
+                return it->second;
+            if (FileHandle entryHandle = OpenPakEntryForRead(path, openMode))
+                return entryHandle;
+        }
 
-            if (openMode & (uint32_t)EFileOpenMode::OpenFileAtAppend)
-            {
-                // Ignore.
-            }
+        // Append flag is meaningless for reading.
+        openMode &= ~(uint32_t)EFileOpenMode::OpenFileAtAppend;
+        openMode |= (uint32_t)EFileOpenMode::OpenFileForRead;
 
-            mode |= std::ios::in;
+        // Opening can stall on cold file system caches, other files can be opened meanwhile.
+        NativeFileHandle nativeHandle = PlatformFile::Open(path.GetString(), openMode);
 
-            stream.open(path.GetString(), mode);
+        // Not every file system supports direct I/O (e.g. tmpfs), fallback to buffered read.
+        if (nativeHandle == InvalidNativeFileHandle && (openMode & EFileOpenMode::OpenFileUnbuffered))
+        {
+            openMode &= ~(uint32_t)EFileOpenMode::OpenFileUnbuffered;
+            nativeHandle = PlatformFile::Open(path.GetString(), openMode);
+            if (nativeHandle != InvalidNativeFileHandle)
+                logger.warning("Direct I/O is not supported for file {}, fallback to buffered I/O", path.GetString());
+        }
 
-            if (!stream.is_open())
-            {
-                logger.error("Failed to open file {} for read because this file cannot be opened for read (file not exist or I/O error)", path.GetString());
-                return nullptr;
-            }
-            
-            auto handle = std::make_shared<FileHandleData>();
-            handle->fileName = path;
-            handle->fileSize = 0;
-            handle->fileStream = std::move(stream);
-            handle->openMode = openMode | (uint32_t)EFileOpenMode::OpenFileForRead;
-            CalcFileSize(handle);
-            
-            openedFilesForRead.emplace(path, handle) ;
+        if (nativeHandle == InvalidNativeFileHandle)
+        {
+            logger.error("Failed to open file {} for read because this file cannot be opened for read (file not exist or I/O error)", path.GetString());
+            return nullptr;
+        }
 
-            return handle;
+        // Negative stat entry may be outdated (file created by others), open always asks the OS and corrects it.
+        if (FileStat stat; FindCachedFileStat(path, stat) && !stat.bExists)
+            InvalidateFileStat(path);
+
+        auto handle = std::make_shared<FileHandleData>();
+        handle->fileName = path;
+        handle->fileSize = 0;
+        handle->nativeHandle = nativeHandle;
+        handle->openMode = openMode;
+        CalcFileSize(handle);
+
+        std::scoped_lock lock(mutex);
+        // Opened by another thread meanwhile, share its handle.
+        if (auto it = openedFilesForRead.find(path); it != openedFilesForRead.end())
+        {
+            PlatformFile::Close(nativeHandle);
+            return it->second;
+        }
+        if (openedFilesForWrite.contains(path))
+        {
+            PlatformFile::Close(nativeHandle);
+            logger.error("Failed to open file {} for read because this file is already opened for write", path.GetString());
+            return nullptr;
         }
+
+        openedFilesForRead.emplace(path, handle);
+        return handle;
     }
 
     FileHandle FileManager::OpenFileForWrite(HashedString path, EOpenFileModes openMode)
@@ -78,27 +99,24 @@ namespace Koala::FileIO
             logger.error("Failed to open file {} for write because this file is already opened for reac", path.GetString());
             return nullptr;
         }
+        if (auto it = mappedFiles.find(path); it != mappedFiles.end() && !it->second.expired())
+        {
+            logger.error("Failed to open file {} for write because this file is mapped for read", path.GetString());
+            return nullptr;
+        }
         if (openedFilesForWrite.contains(path))
             return openedFilesForWrite[path];
         else
         {
-            std::fstream stream;
-            std::ios::openmode mode{};
-            if (!(openMode & (uint32_t)EFileOpenMode::OpenFileAsText))
-            {
-                mode = std::ios::binary;
-            }
+            openMode |= (uint32_t)EFileOpenMode::OpenFileForWrite;
+            // Direct I/O is only used for streaming reads.
+            openMode &= ~(uint32_t)EFileOpenMode::OpenFileUnbuffered;
+            // File is created or truncated.
+            InvalidateFileStat(path);
 
-            if (openMode & (uint32_t)EFileOpenMode::OpenFileAtAppend)
-            {
-                mode |= std::ios::app;
-            }
+            NativeFileHandle nativeHandle = PlatformFile::Open(path.GetString(), openMode);
 
-            mode |= std::ios::out;
-
-            stream.open(path.GetString(), mode);
-
-            if (!stream.is_open())
+            if (nativeHandle == InvalidNativeFileHandle)
             {
                 logger.error("Failed to open file {} for write because this file cannot be opened for write (file not exist or I/O error)", path.GetString());
                 return nullptr;
@@ -107,8 +125,8 @@ namespace Koala::FileIO
             auto handle = std::make_shared<FileHandleData>();
             handle->fileName = path;
             handle->fileSize = 0;
-            handle->fileStream = std::move(stream);
-            handle->openMode = openMode | (uint32_t)EFileOpenMode::OpenFileForWrite;
+            handle->nativeHandle = nativeHandle;
+            handle->openMode = openMode;
             
             openedFilesForWrite.emplace(path, handle) ;
 
@@ -116,10 +134,66 @@ namespace Koala::FileIO
         }
     }
 
+    FileHandle FileManager::OpenPakEntryForRead(HashedString path, EOpenFileModes openMode)
+    {
+        for (auto it = mountedPaks.rbegin(); it != mountedPaks.rend(); ++it)
+        {
+            const PakEntry *entry = (*it)->FindEntry(path);
+            if (!entry)
+                continue;
+
+            auto handle = std::make_shared<FileHandleData>();
+            handle->fileName = path;
+            handle->fileSize = entry->size;
+            handle->nativeHandle = (*it)->GetNativeHandle();
+            // Pak is opened buffered, entries are read-only.
+            handle->openMode = (openMode | EFileOpenMode::OpenFileForRead) &
+                ~(uint32_t)(EFileOpenMode::OpenFileAtAppend | EFileOpenMode::OpenFileUnbuffered);
+            handle->pak = *it;
+            handle->baseOffset = entry->offset;
+            handle->storedSize = entry->storedSize;
+            handle->compression = entry->compression;
+
+            openedFilesForRead.emplace(path, handle);
+            return handle;
+        }
+        return nullptr;
+    }
+
+    bool FileManager::MountPak(HashedString pakPath)
+    {
+        auto pak = PakFile::Open(pakPath.GetString());
+        if (!pak)
+        {
+            logger.error("Failed to mount pak {}", pakPath.GetString());
+            return false;
+        }
+
+        std::scoped_lock lock(mutex);
+        logger.info("Mounted pak {} with {} entries", pakPath.GetString(), pak->GetNumEntries());
+        mountedPaks.push_back(std::move(pak));
+        return true;
+    }
+
+    void FileManager::UnmountPak(HashedString pakPath)
+    {
+        // Entries still opened keep their pak alive until closed.
+        std::scoped_lock lock(mutex);
+        std::erase_if(mountedPaks, [&](const std::shared_ptr<PakFile> &pak) { return pak->GetPakPath() == pakPath; });
+    }
+
     void FileManager::CloseFile(FileHandle &handle)
     {
-        if (handle->fileStream.is_open())
-            handle->fileStream.close();
+        // Native handle of pak entry belongs to pak, which is released with the handle.
+        if (handle->IsPakEntry())
+        {
+            handle->nativeHandle = InvalidNativeFileHandle;
+        }
+        else if (handle->IsOpened())
+        {
+            PlatformFile::Close(handle->nativeHandle);
+            handle->nativeHandle = InvalidNativeFileHandle;
+        }
         {
             std::scoped_lock lock(mutex);
             if (handle->IsOpenedForReadOnly())
@@ -137,22 +211,108 @@ namespace Koala::FileIO
                 }
             }
         }
+        if (!handle->IsOpenedForReadOnly())
+            InvalidateFileStat(handle->fileName);
+    }
+
+    FileStat FileManager::StatFile(HashedString path)
+    {
+        FileStat stat;
+        {
+            std::scoped_lock lock(mutex);
+            for (auto it = mountedPaks.rbegin(); it != mountedPaks.rend(); ++it)
+            {
+                if (const PakEntry *entry = (*it)->FindEntry(path))
+                {
+                    stat.bExists = true;
+                    stat.size = static_cast<int64_t>(entry->size);
+                    return stat;
+                }
+            }
+        }
+
+        if (FindCachedFileStat(path, stat))
+            return stat;
+
+        PlatformFile::Stat(path.GetString(), stat);
+
+        std::scoped_lock lock(mutexFileStatCache);
+        fileStatCache[path] = stat;
+        return stat;
+    }
+
+    bool FileManager::FindCachedFileStat(HashedString path, FileStat &outStat)
+    {
+        std::scoped_lock lock(mutexFileStatCache);
+        auto it = fileStatCache.find(path);
+        if (it == fileStatCache.end())
+            return false;
+        outStat = it->second;
+        return true;
+    }
+
+    void FileManager::InvalidateFileStat(HashedString path)
+    {
+        std::scoped_lock lock(mutexFileStatCache);
+        fileStatCache.erase(path);
+    }
+
+    void FileManager::ClearFileStatCache()
+    {
+        std::scoped_lock lock(mutexFileStatCache);
+        fileStatCache.clear();
     }
 
     void FileManager::CalcFileSize(FileHandle &inHandle)
     {
         if (!inHandle)
             return;
-        auto currOffset = inHandle->fileStream.tellg();
-        std::streampos fsize = 0;
-        
-        inHandle->fileStream.seekg(0, std::ios::beg);
-        fsize = inHandle->fileStream.tellg();
-        inHandle->fileStream.seekg(0, std::ios::end);
-        fsize = inHandle->fileStream.tellg() - fsize;
+        int64_t fsize = PlatformFile::GetFileSize(inHandle->nativeHandle);
+
+        inHandle->fileSize = fsize < 0 ? 0 : fsize;
+    }
+
+    MappedFileRef FileManager::MapFileForRead(HashedString path, EMappedFileAccessHint hint)
+    {
+        std::scoped_lock lock(mutex);
+        if (openedFilesForWrite.contains(path))
+        {
+            logger.error("Failed to map file {} because this file is already opened for write", path.GetString());
+            return nullptr;
+        }
+
+        if (auto it = mappedFiles.find(path); it != mappedFiles.end())
+        {
+            if (MappedFileRef view = it->second.lock())
+            {
+                view->Advise(hint);
+                return view;
+            }
+        }
+
+        NativeFileHandle nativeHandle = PlatformFile::Open(path.GetString(), EFileOpenMode::OpenFileForRead);
+        if (nativeHandle == InvalidNativeFileHandle)
+        {
+            logger.error("Failed to map file {} because this file cannot be opened for read (file not exist or I/O error)", path.GetString());
+            return nullptr;
+        }
+
+        int64_t fileSize = PlatformFile::GetFileSize(nativeHandle);
+        const void *data = nullptr;
+        // Empty file can not be mapped, but it is still a valid (empty) view.
+        if (fileSize > 0)
+            data = PlatformFile::MapReadOnly(nativeHandle, fileSize);
+        PlatformFile::Close(nativeHandle);
 
-        inHandle->fileStream.seekg(currOffset, std::ios::beg);
+        if (fileSize < 0 || (fileSize > 0 && !data))
+        {
+            logger.error("Failed to map file {}", path.GetString());
+            return nullptr;
+        }
 
-        inHandle->fileSize = fsize;
+        auto view = std::make_shared<MappedFileView>(path, data, fileSize);
+        view->Advise(hint);
+        mappedFiles[path] = view;
+        return view;
     }
 }
@@ -0,0 +1,88 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "FileSystem/FileIOBackend.h"
+
+#include "Backends/IOUringFileIOBackend.h"
+#include "Backends/SyncFileIOBackend.h"
+
+namespace Koala::FileIO
+{
+    static Logger logger("FileIOBackend");
+
+    const char* GetFileIOBackendName(EFileIOBackend inBackend)
+    {
+        switch (inBackend)
+        {
+        case EFileIOBackend::Synchronous:
+            return "sync";
+        case EFileIOBackend::IOUring:
+            return "iouring";
+        default: return "unknown";
+        }
+    }
+
+    EFileIOBackend ParseFileIOBackendName(const std::string &inName)
+    {
+        if (inName == "iouring")
+            return EFileIOBackend::IOUring;
+        return EFileIOBackend::Synchronous;
+    }
+
+    static std::unique_ptr<IFileIOBackend> CreateFileIOBackendInternal(EFileIOBackend inBackend, uint32_t inQueueDepth)
+    {
+        std::unique_ptr<IFileIOBackend> backend;
+        switch (inBackend)
+        {
+#ifdef FILEIO_ENABLE_IO_URING
+        case EFileIOBackend::IOUring:
+            backend = std::make_unique<IOUringFileIOBackend>();
+            break;
+#endif
+        case EFileIOBackend::Synchronous:
+            backend = std::make_unique<SyncFileIOBackend>();
+            break;
+        default: return nullptr;
+        }
+
+        if (!backend->Initialize(inQueueDepth))
+            return nullptr;
+        return backend;
+    }
+
+    bool IsFileIOBackendSupported(EFileIOBackend inBackend)
+    {
+        auto backend = CreateFileIOBackendInternal(inBackend, 1);
+        if (!backend)
+            return false;
+        backend->Shutdown();
+        return true;
+    }
+
+    std::unique_ptr<IFileIOBackend> CreateFileIOBackend(EFileIOBackend inBackend, uint32_t inQueueDepth)
+    {
+        auto backend = CreateFileIOBackendInternal(inBackend, inQueueDepth);
+        if (!backend && inBackend != EFileIOBackend::Synchronous)
+        {
+            logger.warning("Failed to create FileIO backend {}, fallback to {}",
+                GetFileIOBackendName(inBackend), GetFileIOBackendName(EFileIOBackend::Synchronous));
+            backend = CreateFileIOBackendInternal(EFileIOBackend::Synchronous, inQueueDepth);
+        }
+        return backend;
+    }
+}
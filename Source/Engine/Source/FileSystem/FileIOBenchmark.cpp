@@ -0,0 +1,301 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "FileSystem/FileIOBenchmark.h"
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Config.h"
+#include "Core.h"
+#include "FileSystem/File.h"
+#include "FileSystem/FileIOManager.h"
+
+namespace Koala::FileIO
+{
+    Logger loggerFileIOBenchmark("FileIOBenchmark");
+
+    namespace
+    {
+        constexpr size_t LargeFileSize      = 32 * 1024 * 1024;
+        constexpr size_t NumLargeFiles      = 4;
+        constexpr size_t SequentialBlock    = 1024 * 1024;
+        constexpr size_t RandomReadSize     = 4096;
+        constexpr size_t NumRandomReads     = 16384;
+        constexpr size_t SmallFileSize      = 16 * 1024;
+        constexpr size_t NumSmallFiles      = 2000;
+        constexpr size_t NumBackgroundReads = 128;
+        constexpr size_t NumUrgentReads     = 512;
+
+        // Wait for all requests of a workload, ticking FileIOManager as main loop would.
+        void WaitForCompletions(const std::atomic<size_t> &numCompleted, size_t numRequests)
+        {
+            while (numCompleted.load() < numRequests)
+            {
+                FileIOManager::Get().Tick_MainThread(0);
+                std::this_thread::yield();
+            }
+            FileIOManager::Get().Tick_MainThread(0);
+        }
+
+        class WorkloadTimer
+        {
+        public:
+            WorkloadTimer(std::string inLabel, const char *inName): label(std::move(inLabel)), name(inName)
+            {
+                FileIOManager::Get().ResetStats();
+                startTime = std::chrono::steady_clock::now();
+            }
+
+            void Finish(size_t numRequests, size_t numBytes, size_t numFailed) const
+            {
+                const double seconds = std::max(std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count(), 1e-6);
+                FileIOManager &manager = FileIOManager::Get();
+                loggerFileIOBenchmark.info("[{}] {}: {} requests, {:.1f} MB in {:.1f}ms, {:.1f} MB/s, {:.0f} IOPS, "
+                    "latency p50 {}us p99 {}us p99.9 {}us, {} failed",
+                    label, name, numRequests, numBytes / (1024.0 * 1024.0), seconds * 1000.0, numBytes / (1024.0 * 1024.0) / seconds,
+                    numRequests / seconds, manager.GetCompletionLatencyPercentileUs(50), manager.GetCompletionLatencyPercentileUs(99),
+                    manager.GetCompletionLatencyPercentileUs(99.9), numFailed);
+                manager.DumpStats();
+            }
+        private:
+            std::string label;
+            const char *name;
+            std::chrono::steady_clock::time_point startTime;
+        };
+    }
+
+    void RunFileIOBenchmark(const std::filesystem::path &directory, const std::string &label, bool bUnbuffered)
+    {
+        const std::filesystem::path benchmarkPath = directory / "KoalaFileIOBenchmark";
+        std::error_code error;
+        std::filesystem::create_directories(benchmarkPath, error);
+        if (error)
+        {
+            loggerFileIOBenchmark.warning("[{}] Skipped, cannot create {}: {}", label, benchmarkPath.string(), error.message());
+            return;
+        }
+
+        FileManager &fileManager = FileManager::Get();
+        FileIOManager &manager = FileIOManager::Get();
+        std::atomic<size_t> numCompleted{0};
+        std::atomic<size_t> numFailed{0};
+        auto onComplete = [&numCompleted, &numFailed](bool bOk, int64_t, const void*)
+        {
+            if (!bOk)
+                numFailed.fetch_add(1);
+            numCompleted.fetch_add(1);
+        };
+
+        std::vector<uint8_t> writeData(SequentialBlock);
+        std::mt19937 random(1234);
+        for (auto &byte: writeData)
+        {
+            byte = static_cast<uint8_t>(random());
+        }
+
+        std::vector<std::string> largeFilePaths;
+        for (size_t index = 0; index < NumLargeFiles; ++index)
+        {
+            largeFilePaths.push_back((benchmarkPath / ("Large" + std::to_string(index) + ".bin")).string());
+        }
+
+        // Sequential write, made durable so disk numbers are not just page cache.
+        {
+            WorkloadTimer timer(label, "sequential write");
+            numCompleted = 0;
+            numFailed = 0;
+            std::vector<FileHandle> handles;
+            size_t numRequests = 0;
+            for (const std::string &path: largeFilePaths)
+            {
+                FileHandle handle = fileManager.OpenFileForWrite(path);
+                for (size_t offset = 0; offset < LargeFileSize; offset += SequentialBlock)
+                {
+                    manager.RequestWriteFileAsync(handle, offset, SequentialBlock, writeData.data(), onComplete, EFileIOCompletionMode::IOThread);
+                    ++numRequests;
+                }
+                manager.RequestSyncFileAsync(handle, EFileSyncMode::Data, onComplete, EFileIOCompletionMode::IOThread);
+                ++numRequests;
+                handles.push_back(std::move(handle));
+            }
+            WaitForCompletions(numCompleted, numRequests);
+            timer.Finish(numRequests, NumLargeFiles * LargeFileSize, numFailed);
+            for (auto &handle: handles)
+            {
+                fileManager.CloseFile(handle);
+            }
+        }
+
+        const EOpenFileModes readMode = EFileOpenMode::OpenFileAsBinary | (bUnbuffered ? EFileOpenMode::OpenFileUnbuffered : 0);
+        std::vector<FileHandle> readHandles;
+        for (const std::string &path: largeFilePaths)
+        {
+            FileHandle handle = fileManager.OpenFileForRead(path, readMode);
+            if (!handle || !handle->IsValid())
+                handle = fileManager.OpenFileForRead(path);
+            readHandles.push_back(std::move(handle));
+        }
+        std::vector<uint8_t> readBuffer(NumLargeFiles * LargeFileSize);
+
+        {
+            WorkloadTimer timer(label, "sequential read");
+            numCompleted = 0;
+            numFailed = 0;
+            size_t numRequests = 0;
+            for (size_t file = 0; file < NumLargeFiles; ++file)
+            {
+                for (size_t offset = 0; offset < LargeFileSize; offset += SequentialBlock)
+                {
+                    manager.RequestReadFileAsync(readHandles[file], offset, SequentialBlock, readBuffer.data() + file * LargeFileSize + offset,
+                        onComplete, EFileIOCompletionMode::IOThread);
+                    ++numRequests;
+                }
+            }
+            WaitForCompletions(numCompleted, numRequests);
+            timer.Finish(numRequests, NumLargeFiles * LargeFileSize, numFailed);
+        }
+
+        {
+            WorkloadTimer timer(label, "random 4KB read");
+            numCompleted = 0;
+            numFailed = 0;
+            std::uniform_int_distribution<size_t> fileDistribution(0, NumLargeFiles - 1);
+            std::uniform_int_distribution<size_t> blockDistribution(0, LargeFileSize / RandomReadSize - 1);
+            for (size_t index = 0; index < NumRandomReads; ++index)
+            {
+                const size_t offset = blockDistribution(random) * RandomReadSize;
+                // Each read gets its own destination, so that requests are not merged into larger reads.
+                manager.RequestReadFileAsync(readHandles[fileDistribution(random)], offset, RandomReadSize,
+                    readBuffer.data() + index * RandomReadSize, onComplete, EFileIOCompletionMode::IOThread);
+            }
+            WaitForCompletions(numCompleted, NumRandomReads);
+            timer.Finish(NumRandomReads, NumRandomReads * RandomReadSize, numFailed);
+        }
+
+        // Bulk background streaming, with high priority small reads arriving meanwhile.
+        {
+            WorkloadTimer timer(label, "mixed priority read");
+            numCompleted = 0;
+            numFailed = 0;
+            FileIORequestOptions backgroundOptions;
+            backgroundOptions.priority = EFilePriority::Lowest;
+            for (size_t index = 0; index < NumBackgroundReads; ++index)
+            {
+                const size_t offset = (index * SequentialBlock) % (NumLargeFiles * LargeFileSize);
+                manager.RequestReadFileAsync(readHandles[offset / LargeFileSize], offset % LargeFileSize, SequentialBlock,
+                    readBuffer.data() + offset, onComplete, EFileIOCompletionMode::IOThread, backgroundOptions);
+            }
+
+            FileIORequestOptions urgentOptions;
+            urgentOptions.priority = EFilePriority::Highest;
+            std::uniform_int_distribution<size_t> blockDistribution(0, NumLargeFiles * LargeFileSize / RandomReadSize - 1);
+            std::vector<uint8_t> urgentBuffer(NumUrgentReads * RandomReadSize);
+            for (size_t index = 0; index < NumUrgentReads; ++index)
+            {
+                const size_t offset = blockDistribution(random) * RandomReadSize;
+                manager.RequestReadFileAsync(readHandles[offset / LargeFileSize], offset % LargeFileSize, RandomReadSize,
+                    urgentBuffer.data() + index * RandomReadSize, onComplete, EFileIOCompletionMode::IOThread, urgentOptions);
+                if (index % 16 == 15)
+                {
+                    manager.Tick_MainThread(0);
+                    std::this_thread::sleep_for(std::chrono::microseconds(500));
+                }
+            }
+            WaitForCompletions(numCompleted, NumBackgroundReads + NumUrgentReads);
+            timer.Finish(NumBackgroundReads + NumUrgentReads, NumBackgroundReads * SequentialBlock + NumUrgentReads * RandomReadSize, numFailed);
+            loggerFileIOBenchmark.info("[{}] mixed priority read: highest priority p50 {}us p99 {}us, lowest priority p50 {}us p99 {}us",
+                label, manager.GetCompletionLatencyPercentileUs(EFilePriority::Highest, 50),
+                manager.GetCompletionLatencyPercentileUs(EFilePriority::Highest, 99),
+                manager.GetCompletionLatencyPercentileUs(EFilePriority::Lowest, 50),
+                manager.GetCompletionLatencyPercentileUs(EFilePriority::Lowest, 99));
+        }
+
+        for (auto &handle: readHandles)
+        {
+            fileManager.CloseFile(handle);
+        }
+        readHandles.clear();
+
+        std::vector<std::string> smallFilePaths;
+        {
+            numCompleted = 0;
+            std::vector<FileHandle> handles;
+            for (size_t index = 0; index < NumSmallFiles; ++index)
+            {
+                smallFilePaths.push_back((benchmarkPath / ("Small" + std::to_string(index) + ".bin")).string());
+                FileHandle handle = fileManager.OpenFileForWrite(smallFilePaths.back());
+                manager.RequestWriteFileAsync(handle, 0, SmallFileSize, writeData.data(), onComplete, EFileIOCompletionMode::IOThread);
+                handles.push_back(std::move(handle));
+            }
+            WaitForCompletions(numCompleted, NumSmallFiles);
+            for (auto &handle: handles)
+            {
+                fileManager.CloseFile(handle);
+            }
+        }
+
+        // Whole lifetime of each file: open, read, close, all asynchronous.
+        {
+            fileManager.ClearFileStatCache();
+            WorkloadTimer timer(label, "many small files");
+            numCompleted = 0;
+            numFailed = 0;
+            std::atomic<size_t> numClosed{0};
+            for (size_t index = 0; index < NumSmallFiles; ++index)
+            {
+                uint8_t *destination = readBuffer.data() + index * SmallFileSize;
+                manager.RequestOpenFileAsync(smallFilePaths[index], readMode, [&, destination](FileHandle handle)
+                {
+                    if (!handle || !handle->IsValid())
+                    {
+                        numFailed.fetch_add(1);
+                        numClosed.fetch_add(1);
+                        return;
+                    }
+                    manager.RequestReadFileAsync(handle, 0, SmallFileSize, destination,
+                        [&, handle](bool bOk, int64_t, const void*)
+                        {
+                            if (!bOk)
+                                numFailed.fetch_add(1);
+                            manager.RequestCloseFileAsync(handle, [&numClosed]() { numClosed.fetch_add(1); }, EFileIOCompletionMode::IOThread);
+                        }, EFileIOCompletionMode::IOThread);
+                }, EFileIOCompletionMode::IOThread);
+            }
+            WaitForCompletions(numClosed, NumSmallFiles);
+            timer.Finish(NumSmallFiles, NumSmallFiles * SmallFileSize, numFailed);
+        }
+
+        fileManager.ClearFileStatCache();
+        std::filesystem::remove_all(benchmarkPath, error);
+    }
+
+    void RunFileIOBenchmarks()
+    {
+        const std::string tmpfsDirectory = Config::Get().GetSettingAndWriteDefault("fileio.benchmark.tmpfsdir", "/dev/shm", true);
+        const std::string diskDirectory = Config::Get().GetSettingAndWriteDefault("fileio.benchmark.diskdir", "Saved", true);
+
+        loggerFileIOBenchmark.info("Benchmarking FileIO on tmpfs ({}) and disk ({})", tmpfsDirectory, diskDirectory);
+        RunFileIOBenchmark(tmpfsDirectory, "tmpfs", false);
+        RunFileIOBenchmark(diskDirectory, "disk", true);
+        FileIOManager::Get().ResetStats();
+    }
+}
@@ -17,34 +17,84 @@
 //CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "FileSystem/FileIOManager.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "AsyncWorker/AsyncTask.h"
+#include "Config.h"
+#include "ConsoleVariable.h"
+#include "Compression/BlockCompression.h"
 #include "Core/ThreadManager.h"
 #include "FileSystem/FileIOThread.h"
 
 namespace Koala::FileIO
 {
     constexpr uint32_t IOThreadMaxQueueLength = 500;
+    // Reads larger than this are split across read threads.
+    constexpr size_t ParallelReadSplitSize = 1024 * 1024;
+    constexpr size_t ParallelReadSplitAlignment = 16384;
+    // Readahead window starts here after the second sequential read, and doubles on each following one.
+    constexpr int64_t MinReadAheadWindow = 64 * 1024;
+    // Open/stat/close requests run together on one read thread.
+    constexpr size_t MaxMetadataBatchSize = 16;
+#ifdef FILEIO_ENABLE_IO_URING
+    constexpr const char* DefaultFileIOBackend = "iouring";
+#else
+    constexpr const char* DefaultFileIOBackend = "sync";
+#endif
     Logger logger("FileIOManager");
+    static TConsoleVariable<uint32_t> CVarFileIOStatsDumpInterval("fileio.stats.dumpinterval", 0,
+        "Dump FileIO statistics (throughput, queue depth, seeks, latency percentiles) to log every N seconds. 0 disables.");
     bool FileIOManager::Initialize_MainThread()
     {
         auto numCPUCores = std::thread::hardware_concurrency();
 
+        statsStartTime = lastStatsDumpTime = FileIOClock::now();
         numReadThreads = std::min(numCPUCores, numReadThreads);
         numWriteThreads = std::min(numCPUCores, numWriteThreads);
 
-        logger.info("Creating IO Threads: {} readThreads, {} writeThreads", numReadThreads, numWriteThreads);
+        Config &config = Config::Get();
+        backendType = ParseFileIOBackendName(config.GetSettingAndWriteDefault("fileio.backend", DefaultFileIOBackend, true));
+        ioQueueDepth = static_cast<uint32_t>(config.GetUIntSettingAndWriteDefault("fileio.queuedepth", 64, true));
+        coalesceGap = static_cast<int64_t>(config.GetUIntSettingAndWriteDefault("fileio.coalescegap", 4096, true));
+        maxCoalescedReadSize = static_cast<int64_t>(config.GetUIntSettingAndWriteDefault("fileio.maxcoalescedsize", 1048576, true));
+        maxReadAheadWindow = static_cast<int64_t>(config.GetUIntSettingAndWriteDefault("fileio.maxreadahead", 1048576, true));
+        if (!IsFileIOBackendSupported(backendType))
+        {
+            logger.warning("FileIO backend {} is not supported on this system, fallback to {}",
+                GetFileIOBackendName(backendType), GetFileIOBackendName(EFileIOBackend::Synchronous));
+            backendType = EFileIOBackend::Synchronous;
+        }
+
+        writeBehindFlushSize = config.GetUIntSettingAndWriteDefault("fileio.writebehind.flushsize", 262144, true);
+        writeBehindFlushInterval = std::chrono::milliseconds(config.GetUIntSettingAndWriteDefault("fileio.writebehind.flushintervalms", 100, true));
+
+        readScheduler.Initialize(
+            config.GetUIntSettingAndWriteDefault("fileio.scheduler.backgroundbandwidth", 67108864, true),
+            config.GetUIntSettingAndWriteDefault("fileio.scheduler.backgroundburst", 1048576, true),
+            std::chrono::milliseconds(config.GetUIntSettingAndWriteDefault("fileio.scheduler.deadlineslackms", 2, true)));
+
+        directIOBufferPool.Initialize(
+            config.GetUIntSettingAndWriteDefault("fileio.directio.buffersize", 262144, true),
+            static_cast<uint32_t>(config.GetUIntSettingAndWriteDefault("fileio.directio.numbuffers", 32, true)));
+
+        logger.info("Creating IO Threads: {} readThreads, {} writeThreads, backend {}, queue depth {}",
+            numReadThreads, numWriteThreads, GetFileIOBackendName(backendType), ioQueueDepth);
         for (uint32_t i = 0; i < numReadThreads; i++)
         {
-            auto handle = new FileIOThread(true);
+            auto handle = new FileIOThread(true, backendType, ioQueueDepth, &readScheduler);
             readThreadHandles.push_back(handle);
             ThreadManager::Get().CreateThreadManaged(handle);
         }
 
         for (uint32_t i = 0; i < numWriteThreads; i++)
         {
-            auto handle = new FileIOThread(false);
+            auto handle = new FileIOThread(false, backendType, ioQueueDepth);
             writeThreadHandles.push_back(handle);
             ThreadManager::Get().CreateThreadManaged(handle);
         }
+
+        RegisterIOBuffers({});
         return true;
     }
 
@@ -63,54 +113,665 @@ namespace Koala::FileIO
             t->ShutdownIOThread();
         }
 
+        DumpStats();
         return true;
     }
 
+    void FileIOManager::DumpStats()
+    {
+        const double elapsedSeconds = std::max(std::chrono::duration<double>(FileIOClock::now() - statsStartTime).count(), 1e-6);
+        logger.info("FileIO statistics of last {:.1f}s:", elapsedSeconds);
+
+        auto dumpThreadStats = [elapsedSeconds](const std::vector<IThread*> &threadHandles, const char *type)
+        {
+            for (size_t index = 0; index < threadHandles.size(); ++index)
+            {
+                const FileIOThreadStats &stats = dynamic_cast<FileIOThread*>(threadHandles[index])->GetStats();
+                const uint64_t numBatches = stats.numBatches.load(std::memory_order_relaxed);
+                if (numBatches == 0)
+                    continue;
+                const double megabytes = stats.bytesTransferred.load(std::memory_order_relaxed) / (1024.0 * 1024.0);
+                const double busySeconds = stats.busyTimeUs.load(std::memory_order_relaxed) / 1e6;
+                logger.info("  {} thread {}: {:.1f} MB/s ({:.1f} MB/s while busy, busy {:.0f}%), {} requests, {} seeks, depth avg {:.1f} max {}",
+                    type, index, megabytes / elapsedSeconds, busySeconds > 0 ? megabytes / busySeconds : 0.0,
+                    std::min(100.0, busySeconds / elapsedSeconds * 100.0), stats.numRequests.load(std::memory_order_relaxed),
+                    stats.numSeeks.load(std::memory_order_relaxed),
+                    static_cast<double>(stats.totalBatchDepth.load(std::memory_order_relaxed)) / numBatches,
+                    stats.maxBatchDepth.load(std::memory_order_relaxed));
+            }
+        };
+        dumpThreadStats(readThreadHandles, "read");
+        dumpThreadStats(writeThreadHandles, "write");
+
+        logger.info("  queued requests: now {}, avg {:.1f}, max {}", readScheduler.GetNumPendingTasks(),
+            numQueueDepthSamples == 0 ? 0.0 : static_cast<double>(totalQueueDepth) / numQueueDepthSamples, maxQueueDepth);
+
+        if (allCompletionLatencies.GetCount() > 0)
+        {
+            logger.info("  latency: p50 {}us, p90 {}us, p99 {}us, p99.9 {}us", GetCompletionLatencyPercentileUs(50),
+                GetCompletionLatencyPercentileUs(90), GetCompletionLatencyPercentileUs(99), GetCompletionLatencyPercentileUs(99.9));
+        }
+
+        constexpr const char* CompletionModeNames[] = {"main thread", "I/O thread", "worker task"};
+        for (size_t mode = 0; mode < static_cast<size_t>(EFileIOCompletionMode::Num); ++mode)
+        {
+            const auto completionMode = static_cast<EFileIOCompletionMode>(mode);
+            if (GetNumCompletions(completionMode) == 0)
+                continue;
+            logger.info("  completions on {}: {}, latency avg {}us, max {}us", CompletionModeNames[mode],
+                GetNumCompletions(completionMode), GetAverageCompletionLatencyUs(completionMode), GetMaxCompletionLatencyUs(completionMode));
+        }
+
+        constexpr const char* PriorityNames[] = {"lowest", "low", "normal", "high", "highest"};
+        for (size_t index = 0; index < NumFilePriorities; ++index)
+        {
+            const auto priority = static_cast<EFilePriority>(index + 1);
+            if (GetNumCompletions(priority) == 0)
+                continue;
+            logger.info("  completions of {} priority: {}, latency avg {}us, p99 {}us, max {}us, {} missed deadline", PriorityNames[index],
+                GetNumCompletions(priority), GetAverageCompletionLatencyUs(priority), GetCompletionLatencyPercentileUs(priority, 99),
+                GetMaxCompletionLatencyUs(priority), GetNumDeadlineMisses(priority));
+        }
+    }
+
+    void FileIOManager::ResetStats()
+    {
+        for (auto handle: readThreadHandles)
+        {
+            dynamic_cast<FileIOThread*>(handle)->GetStats().Reset();
+        }
+        for (auto handle: writeThreadHandles)
+        {
+            dynamic_cast<FileIOThread*>(handle)->GetStats().Reset();
+        }
+        for (auto &stats: completionStats)
+        {
+            stats.Reset();
+        }
+        for (auto &stats: priorityStats)
+        {
+            stats.Reset();
+        }
+        allCompletionLatencies.Reset();
+
+        statsStartTime = FileIOClock::now();
+        numQueueDepthSamples = 0;
+        totalQueueDepth = 0;
+        maxQueueDepth = 0;
+    }
+
     void FileIOManager::Tick_MainThread(float /*deltaTime*/)
     {
-        // Process finished tasks
-        for (auto threadHandle: readThreadHandles)
+        // Process finished tasks waiting for main thread
+        std::vector<FileIOCompletion> completions;
+        {
+            std::lock_guard lock(mutexMainThreadCompletions);
+            completions.swap(mainThreadCompletions);
+        }
+        for (auto &completion: completions)
+        {
+            InvokeCompletion(completion);
+        }
+
+        const FileIOClock::time_point now = FileIOClock::now();
+        if (const uint32_t dumpInterval = CVarFileIOStatsDumpInterval.Get(); dumpInterval > 0 && now - lastStatsDumpTime >= std::chrono::seconds(dumpInterval))
         {
-            TickFileIOThread(threadHandle);
+            DumpStats();
+            lastStatsDumpTime = now;
         }
 
-        for (auto threadHandle: writeThreadHandles)
+        // Write out buffered writes waiting too long
         {
-            TickFileIOThread(threadHandle);
+            std::lock_guard lock(mutexWriteBehindBuffers);
+            std::erase_if(writeBehindBuffers, [now](const std::weak_ptr<WriteBehindBuffer> &weakBuffer)
+            {
+                auto buffer = weakBuffer.lock();
+                if (!buffer)
+                    return true;
+                buffer->FlushIfDue(now);
+                return false;
+            });
         }
 
         // Process new tasks
-        if (remainingReadTasks.empty() && remainingWriteTasks.empty())
-            return;
+        ProcessPendingMetadataRequests();
+        ProcessPendingReads();
 
         // Consider remaining tasks
-        TickRemainingIOTasks(remainingReadTasks, readThreadHandles);
-        TickRemainingIOTasks(remainingWriteTasks, writeThreadHandles);
+        // Reads are already queued to scheduler, read threads pull them from it.
+        // Writes of one file stay on one thread to keep them in submission order.
+        std::lock_guard lock(mutexPendingRequests);
+        TickRemainingIOTasks(remainingWriteTasks, writeThreadHandles, true);
+
+        uint64_t queueDepth = readScheduler.GetNumPendingTasks() + remainingWriteTasks.size();
+        for (auto handle: writeThreadHandles)
+        {
+            queueDepth += dynamic_cast<FileIOThread*>(handle)->GetQueueLength();
+        }
+        ++numQueueDepthSamples;
+        totalQueueDepth += queueDepth;
+        maxQueueDepth = std::max(maxQueueDepth, queueDepth);
+    }
+
+    void FileIOManager::RequestOpenFileAsync(HashedString path, EOpenFileModes openMode, FileOpenCallback callback,
+        EFileIOCompletionMode completionMode)
+    {
+        FileMetadataRequest request;
+        request.op = EFileMetadataOp::Open;
+        request.path = path;
+        request.openMode = openMode;
+        request.openCallback = std::move(callback);
+        request.completionMode = completionMode;
+        request.submitTime = FileIOClock::now();
+
+        std::lock_guard lock(mutexPendingRequests);
+        pendingMetadataRequests.push_back(std::move(request));
     }
 
-    void FileIOManager::TickFileIOThread(IThread* threadHandle)
+    void FileIOManager::RequestStatFileAsync(HashedString path, FileStatCallback callback, EFileIOCompletionMode completionMode)
     {
-        FileIOThread* thread = dynamic_cast<FileIOThread*> (threadHandle);
-        std::list<FileIOTask> finishedTasks;
+        FileMetadataRequest request;
+        request.op = EFileMetadataOp::Stat;
+        request.path = path;
+        request.statCallback = std::move(callback);
+        request.completionMode = completionMode;
+        request.submitTime = FileIOClock::now();
 
-        thread->GetFinishedTasks(finishedTasks);
+        std::lock_guard lock(mutexPendingRequests);
+        pendingMetadataRequests.push_back(std::move(request));
+    }
 
-        for (auto &task: finishedTasks)
+    void FileIOManager::RequestCloseFileAsync(FileHandle inHandle, std::function<void()> callback, EFileIOCompletionMode completionMode)
+    {
+        FileMetadataRequest request;
+        request.op = EFileMetadataOp::Close;
+        request.handle = std::move(inHandle);
+        request.path = request.handle->fileName;
+        request.closeCallback = std::move(callback);
+        request.completionMode = completionMode;
+        request.submitTime = FileIOClock::now();
+
+        std::lock_guard lock(mutexPendingRequests);
+        pendingMetadataRequests.push_back(std::move(request));
+    }
+
+    void FileIOManager::ProcessPendingMetadataRequests()
+    {
+        std::vector<FileMetadataRequest> requests;
+        {
+            std::lock_guard lock(mutexPendingRequests);
+            requests.swap(pendingMetadataRequests);
+        }
+
+        for (size_t batchStart = 0; batchStart < requests.size(); batchStart += MaxMetadataBatchSize)
         {
-            if (task.callback)
+            const size_t batchEnd = std::min(requests.size(), batchStart + MaxMetadataBatchSize);
+            auto batch = std::make_shared<std::vector<FileMetadataRequest>>(
+                std::make_move_iterator(requests.begin() + batchStart), std::make_move_iterator(requests.begin() + batchEnd));
+
+            auto thread = dynamic_cast<FileIOThread*>(readThreadHandles[nextMetadataThread++ % readThreadHandles.size()]);
+            thread->PushWork([this, batch]()
             {
-                task.callback(task.bOK, task.performedSize, task.bufferStart);
+                for (auto &request: *batch)
+                {
+                    ExecuteMetadataRequest(request);
+                }
+            });
+        }
+    }
+
+    void FileIOManager::ExecuteMetadataRequest(FileMetadataRequest &request)
+    {
+        FileIOCompletion completion;
+        completion.completionMode = request.completionMode;
+        completion.submitTime = request.submitTime;
+        completion.bOK = true;
+
+        switch (request.op)
+        {
+        case EFileMetadataOp::Open:
+        {
+            FileHandle handle = request.openMode & EFileOpenMode::OpenFileForWrite ?
+                FileManager::Get().OpenFileForWrite(request.path, request.openMode) :
+                FileManager::Get().OpenFileForRead(request.path, request.openMode);
+            completion.bOK = handle != nullptr;
+            if (request.openCallback)
+                completion.callback = [callback = std::move(request.openCallback), handle](bool, int64_t, const void*) { callback(handle); };
+            break;
+        }
+        case EFileMetadataOp::Stat:
+        {
+            const FileStat stat = FileManager::Get().StatFile(request.path);
+            completion.bOK = stat.bExists;
+            if (request.statCallback)
+                completion.callback = [callback = std::move(request.statCallback), stat](bool, int64_t, const void*) { callback(stat); };
+            break;
+        }
+        case EFileMetadataOp::Close:
+            FileManager::Get().CloseFile(request.handle);
+            request.handle = nullptr;
+            if (request.closeCallback)
+                completion.callback = [callback = std::move(request.closeCallback)](bool, int64_t, const void*) { callback(); };
+            break;
+        }
+
+        DeliverCompletion(std::move(completion));
+    }
+
+    void StagedRead::Serve(PendingReadRequest &request) const
+    {
+        // Canceled request may have its buffer released already.
+        const bool bCanceled = request.control && request.control->IsCancelRequested();
+        const int64_t relativeOffset = request.offset - offset;
+        const int64_t available = bCanceled ? 0 : std::clamp<int64_t>(performedSize - relativeOffset, 0, request.size);
+        if (available > 0)
+            std::memcpy(request.buffer, data.data() + relativeOffset, available);
+
+        FileIOCompletion completion;
+        completion.callback = std::move(request.callback);
+        completion.completionMode = request.completionMode;
+        completion.submitTime = request.submitTime;
+        completion.priority = request.GetPriority();
+        completion.deadline = request.deadline;
+        // Merged read may fail past EOF, while requests inside the file still got all their data.
+        completion.bOK = available == request.size;
+        completion.performedSize = available;
+        completion.buffer = request.buffer;
+        FileIOManager::Get().DeliverCompletion(std::move(completion));
+    }
+
+    void FileIOManager::DeliverCompletion(FileIOTask &&task)
+    {
+        FileIOCompletion completion;
+        completion.callback = std::move(task.callback);
+        completion.completionMode = task.completionMode;
+        completion.submitTime = task.submitTime;
+        completion.priority = task.GetPriority();
+        completion.deadline = task.deadline;
+        completion.bOK = task.bOK;
+        completion.performedSize = task.performedSize;
+        completion.buffer = task.bufferStart;
+        DeliverCompletion(std::move(completion));
+    }
+
+    void FileIOManager::DeliverCompletion(FileIOCompletion &&completion)
+    {
+        switch (completion.completionMode)
+        {
+        case EFileIOCompletionMode::IOThread:
+            InvokeCompletion(completion);
+            break;
+        case EFileIOCompletionMode::WorkerTask:
+            AsyncTask([this, completion = std::move(completion)](void*) mutable
+            {
+                InvokeCompletion(completion);
+            });
+            break;
+        default:
+            // Already on main thread (e.g. served from readahead buffer during tick), no need to wait another tick.
+            if (IsInMainThread())
+            {
+                InvokeCompletion(completion);
+            }
+            else
+            {
+                std::lock_guard lock(mutexMainThreadCompletions);
+                mainThreadCompletions.push_back(std::move(completion));
             }
+            break;
         }
     }
 
-    void FileIOManager::TickRemainingIOTasks(std::queue<FileIOTask> &taskQueue, const std::vector<IThread*> &threadHandles)
+    void FileIOManager::CompletionLatencyStats::Add(uint64_t latencyUs, bool bDeadlineMissed)
+    {
+        numCompletions.fetch_add(1, std::memory_order_relaxed);
+        totalLatencyUs.fetch_add(latencyUs, std::memory_order_relaxed);
+        if (bDeadlineMissed)
+            numDeadlineMisses.fetch_add(1, std::memory_order_relaxed);
+        uint64_t currMax = maxLatencyUs.load(std::memory_order_relaxed);
+        while (latencyUs > currMax && !maxLatencyUs.compare_exchange_weak(currMax, latencyUs, std::memory_order_relaxed)) {}
+        histogram.Add(latencyUs);
+    }
+
+    void FileIOManager::CompletionLatencyStats::Reset()
+    {
+        numCompletions = 0;
+        totalLatencyUs = 0;
+        maxLatencyUs = 0;
+        numDeadlineMisses = 0;
+        histogram.Reset();
+    }
+
+    void FileIOManager::InvokeCompletion(FileIOCompletion &completion)
+    {
+        if (completion.submitTime != FileIOClock::time_point{})
+        {
+            const FileIOClock::time_point now = FileIOClock::now();
+            const uint64_t latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(now - completion.submitTime).count();
+            const bool bDeadlineMissed = now > completion.deadline;
+            completionStats[static_cast<size_t>(completion.completionMode)].Add(latencyUs, bDeadlineMissed);
+            priorityStats[static_cast<size_t>(completion.priority) - 1].Add(latencyUs, bDeadlineMissed);
+            allCompletionLatencies.Add(latencyUs);
+        }
+
+        if (completion.callback)
+            completion.callback(completion.bOK, completion.performedSize, completion.buffer);
+    }
+
+    uint64_t FileIOManager::GetNumCompletions(EFileIOCompletionMode mode) const
+    {
+        return completionStats[static_cast<size_t>(mode)].numCompletions.load(std::memory_order_relaxed);
+    }
+
+    uint64_t FileIOManager::GetAverageCompletionLatencyUs(EFileIOCompletionMode mode) const
+    {
+        const auto &stats = completionStats[static_cast<size_t>(mode)];
+        const uint64_t num = stats.numCompletions.load(std::memory_order_relaxed);
+        return num == 0 ? 0 : stats.totalLatencyUs.load(std::memory_order_relaxed) / num;
+    }
+
+    uint64_t FileIOManager::GetMaxCompletionLatencyUs(EFileIOCompletionMode mode) const
+    {
+        return completionStats[static_cast<size_t>(mode)].maxLatencyUs.load(std::memory_order_relaxed);
+    }
+
+    uint64_t FileIOManager::GetNumCompletions(EFilePriority priority) const
+    {
+        return priorityStats[static_cast<size_t>(priority) - 1].numCompletions.load(std::memory_order_relaxed);
+    }
+
+    uint64_t FileIOManager::GetAverageCompletionLatencyUs(EFilePriority priority) const
+    {
+        const auto &stats = priorityStats[static_cast<size_t>(priority) - 1];
+        const uint64_t num = stats.numCompletions.load(std::memory_order_relaxed);
+        return num == 0 ? 0 : stats.totalLatencyUs.load(std::memory_order_relaxed) / num;
+    }
+
+    uint64_t FileIOManager::GetMaxCompletionLatencyUs(EFilePriority priority) const
+    {
+        return priorityStats[static_cast<size_t>(priority) - 1].maxLatencyUs.load(std::memory_order_relaxed);
+    }
+
+    uint64_t FileIOManager::GetNumDeadlineMisses(EFilePriority priority) const
+    {
+        return priorityStats[static_cast<size_t>(priority) - 1].numDeadlineMisses.load(std::memory_order_relaxed);
+    }
+
+    uint64_t FileIOManager::GetCompletionLatencyPercentileUs(double percentile) const
+    {
+        return allCompletionLatencies.GetPercentileUs(percentile);
+    }
+
+    uint64_t FileIOManager::GetCompletionLatencyPercentileUs(EFilePriority priority, double percentile) const
+    {
+        return priorityStats[static_cast<size_t>(priority) - 1].histogram.GetPercentileUs(percentile);
+    }
+
+    void FileIOManager::ProcessPendingReads()
+    {
+        std::vector<PendingReadRequest> reads;
+        {
+            std::lock_guard lock(mutexPendingRequests);
+            reads.swap(pendingReads);
+        }
+
+        // Forget states of closed files.
+        for (auto it = fileReadStates.begin(); it != fileReadStates.end();)
+        {
+            if (it->second.handle.expired())
+                it = fileReadStates.erase(it);
+            else
+                ++it;
+        }
+
+        // Drop requests canceled before they got to I/O.
+        std::erase_if(reads, [](PendingReadRequest &request)
+        {
+            if (!request.control || !request.control->IsCancelRequested())
+                return false;
+            FileIOCompletion completion;
+            completion.callback = std::move(request.callback);
+            completion.completionMode = request.completionMode;
+            completion.submitTime = request.submitTime;
+            completion.priority = request.GetPriority();
+            completion.deadline = request.deadline;
+            completion.buffer = request.buffer;
+            FileIOManager::Get().DeliverCompletion(std::move(completion));
+            return true;
+        });
+
+        if (reads.empty())
+            return;
+
+        // Group by file, requests of the same offset keep submission order.
+        std::stable_sort(reads.begin(), reads.end(), [](const PendingReadRequest &a, const PendingReadRequest &b)
+        {
+            if (a.handle != b.handle)
+                return a.handle.get() < b.handle.get();
+            return a.offset < b.offset;
+        });
+
+        auto isMergeable = [this](const PendingReadRequest &request)
+        {
+            return request.buffer && request.size > 0 && request.size < maxCoalescedReadSize;
+        };
+
+        size_t i = 0;
+        while (i < reads.size())
+        {
+            if (reads[i].handle->IsCompressed())
+            {
+                size_t j = i + 1;
+                while (j < reads.size() && reads[j].handle == reads[i].handle)
+                    ++j;
+                std::vector<PendingReadRequest> run(std::make_move_iterator(reads.begin() + i), std::make_move_iterator(reads.begin() + j));
+                ProcessCompressedReads(std::move(run));
+                i = j;
+                continue;
+            }
+
+            if (!isMergeable(reads[i]))
+            {
+                IssueReadTask(std::move(reads[i]));
+                ++i;
+                continue;
+            }
+
+            const int64_t runStart = reads[i].offset;
+            int64_t runEnd = runStart + reads[i].size;
+            size_t j = i + 1;
+            for (; j < reads.size(); ++j)
+            {
+                const auto &next = reads[j];
+                if (next.handle != reads[i].handle || !isMergeable(next) || next.offset > runEnd + coalesceGap)
+                    break;
+                const int64_t newEnd = std::max(runEnd, next.offset + next.size);
+                if (newEnd - runStart > maxCoalescedReadSize)
+                    break;
+                runEnd = newEnd;
+            }
+
+            std::vector<PendingReadRequest> run(std::make_move_iterator(reads.begin() + i), std::make_move_iterator(reads.begin() + j));
+            ProcessReadRun(runStart, runEnd, std::move(run));
+            i = j;
+        }
+    }
+
+    // Read serving several requests is scheduled as the most urgent of them.
+    static FileIORequestOptions GetRunSchedule(const std::vector<PendingReadRequest> &run)
+    {
+        FileIORequestOptions options;
+        options.priority = EFilePriority::Lowest;
+        for (const auto &request: run)
+        {
+            options.priority = std::max(*options.priority, request.GetPriority());
+            options.deadline = std::min(options.deadline, request.deadline);
+        }
+        return options;
+    }
+
+    FileReadState& FileIOManager::FindFileReadState(const FileHandle &handle)
+    {
+        FileReadState &state = fileReadStates[handle->fileName];
+        if (state.handle.lock() != handle)
+        {
+            state = FileReadState{};
+            state.handle = handle;
+        }
+        // File was written since, or while data was read.
+        if (state.lastStagedRead && state.lastStagedRead->writeGeneration != handle->writeGeneration.load())
+            state.lastStagedRead = nullptr;
+        return state;
+    }
+
+    void FileIOManager::ProcessCompressedReads(std::vector<PendingReadRequest> &&run)
+    {
+        FileHandle handle = run.front().handle;
+        FileReadState &state = FindFileReadState(handle);
+
+        // Whole entry is decompressed once, then all reads are served from memory.
+        if (auto staged = state.lastStagedRead)
+        {
+            std::unique_lock lock(staged->mutex);
+            if (staged->Covers(0, staged->size))
+            {
+                if (!staged->bReady)
+                {
+                    std::move(run.begin(), run.end(), std::back_inserter(staged->waiters));
+                    return;
+                }
+
+                lock.unlock();
+                // Entry read up to its end is most likely done with, do not keep it until file is closed.
+                if (std::any_of(run.begin(), run.end(), [&staged](const PendingReadRequest &request) { return request.offset + request.size >= staged->size; }))
+                    state.lastStagedRead = nullptr;
+                for (auto &request: run)
+                {
+                    staged->Serve(request);
+                }
+                return;
+            }
+        }
+
+        const FileIORequestOptions schedule = GetRunSchedule(run);
+        auto staged = std::make_shared<StagedRead>();
+        staged->offset = 0;
+        staged->size = static_cast<int64_t>(handle->fileSize);
+        staged->writeGeneration = handle->writeGeneration.load();
+        staged->data.resize(staged->size);
+        staged->waiters = std::move(run);
+        state.lastStagedRead = staged;
+
+        RequestReadBlockCompressedAsync(handle, 0, staged->data.size(), staged->data.data(),
+            [staged](bool bOk, int64_t performedSize, const void*)
+            {
+                std::vector<PendingReadRequest> waiters;
+                {
+                    std::lock_guard lock(staged->mutex);
+                    staged->bReady = true;
+                    staged->bOK = bOk;
+                    staged->performedSize = performedSize;
+                    waiters.swap(staged->waiters);
+                }
+                for (auto &waiter: waiters)
+                {
+                    staged->Serve(waiter);
+                }
+            }, EFileIOCompletionMode::IOThread, schedule);
+    }
+
+    void FileIOManager::ProcessReadRun(int64_t runStart, int64_t runEnd, std::vector<PendingReadRequest> &&run)
+    {
+        FileHandle handle = run.front().handle;
+        FileReadState &state = FindFileReadState(handle);
+
+        // Whole run is inside last merged read or readahead: no I/O needed.
+        if (auto staged = state.lastStagedRead)
+        {
+            std::unique_lock lock(staged->mutex);
+            if (staged->Covers(runStart, runEnd - runStart))
+            {
+                state.nextExpectedOffset = runEnd;
+                // Consumed up to its end, sequential reads go on past it. Waiters keep it alive until it arrives.
+                if (runEnd == staged->offset + staged->size)
+                    state.lastStagedRead = nullptr;
+                if (!staged->bReady)
+                {
+                    std::move(run.begin(), run.end(), std::back_inserter(staged->waiters));
+                    return;
+                }
+
+                lock.unlock();
+                for (auto &request: run)
+                {
+                    staged->Serve(request);
+                }
+                return;
+            }
+            // Read goes past it or elsewhere, it is not needed anymore.
+            state.lastStagedRead = nullptr;
+        }
+
+        // Grow readahead on sequential access, drop it on random access.
+        if (runStart == state.nextExpectedOffset && maxReadAheadWindow > 0)
+            state.readAheadWindow = std::min(std::max(state.readAheadWindow * 2, MinReadAheadWindow), maxReadAheadWindow);
+        else
+            state.readAheadWindow = 0;
+        state.nextExpectedOffset = runEnd;
+
+        int64_t readEnd = runEnd;
+        if (state.readAheadWindow > 0)
+            readEnd = std::max(runEnd, std::min(runStart + state.readAheadWindow, static_cast<int64_t>(handle->fileSize)));
+
+        if (run.size() == 1 && readEnd == runEnd)
+        {
+            // Nothing to merge and nothing to prefetch, read into caller's buffer directly.
+            IssueReadTask(std::move(run.front()));
+            return;
+        }
+
+        const FileIORequestOptions schedule = GetRunSchedule(run);
+        auto staged = std::make_shared<StagedRead>();
+        staged->offset = runStart;
+        staged->size = readEnd - runStart;
+        staged->writeGeneration = handle->writeGeneration.load();
+        staged->data.resize(staged->size);
+        staged->waiters = std::move(run);
+        state.lastStagedRead = staged;
+
+        PendingReadRequest request;
+        request.handle = handle;
+        request.offset = staged->offset;
+        request.size = staged->size;
+        request.buffer = staged->data.data();
+        request.priority = *schedule.priority;
+        request.deadline = schedule.deadline;
+        // Waiters carry their own completion mode, scatter them as soon as data arrives.
+        request.completionMode = EFileIOCompletionMode::IOThread;
+        request.callback = [staged](bool bOk, int64_t performedSize, const void*)
+        {
+            std::vector<PendingReadRequest> waiters;
+            {
+                std::lock_guard lock(staged->mutex);
+                staged->bReady = true;
+                staged->bOK = bOk;
+                staged->performedSize = performedSize;
+                waiters.swap(staged->waiters);
+            }
+            for (auto &waiter: waiters)
+            {
+                staged->Serve(waiter);
+            }
+        };
+        IssueReadTask(std::move(request));
+    }
+
+    void FileIOManager::TickRemainingIOTasks(std::queue<FileIOTask> &taskQueue, const std::vector<IThread*> &threadHandles, bool bPinFileToThread)
     {
         while (!taskQueue.empty())
         {
-            auto task = taskQueue.front();
-            auto fileName = task.handle->fileName;
-            if (task.handle->currWorkingIOThread)
+            auto &task = taskQueue.front();
+            if (bPinFileToThread && task.handle->currWorkingIOThread)
             {
                 FileIOThread* thread = dynamic_cast<FileIOThread*> (task.handle->currWorkingIOThread);
                 thread->PushTask(std::move(task));
@@ -130,6 +791,8 @@ namespace Koala::FileIO
                 if (minThread->GetQueueLength() > IOThreadMaxQueueLength)
                     break;
 
+                if (bPinFileToThread)
+                    task.handle->currWorkingIOThread = minThread;
                 minThread->PushTask(std::move(task));
             }
 
@@ -137,29 +800,353 @@ namespace Koala::FileIO
         }
     }
 
-    void FileIOManager::RequestReadFileAsync(FileHandle inHandle, size_t offset, size_t size, void *buffer,
-        FileIOCallback callback)
+    FileIORequestRef FileIOManager::RequestReadFileAsync(FileHandle inHandle, size_t offset, size_t size, void *buffer,
+        FileIOCallback callback, EFileIOCompletionMode completionMode, const FileIORequestOptions &options)
+    {
+        auto control = std::make_shared<FileIORequestControl>(options.priority.value_or(inHandle->priority));
+
+        PendingReadRequest request;
+        request.handle = std::move(inHandle);
+        request.offset = static_cast<int64_t>(offset);
+        request.size = static_cast<int64_t>(size);
+        request.buffer = buffer;
+        request.callback = std::move(callback);
+        request.completionMode = completionMode;
+        request.submitTime = FileIOClock::now();
+        request.priority = control->GetPriority();
+        request.deadline = options.deadline;
+        request.control = control;
+
+        std::lock_guard lock(mutexPendingRequests);
+        pendingReads.push_back(std::move(request));
+        return control;
+    }
+
+    void FileIOManager::IssueReadTask(PendingReadRequest &&request)
+    {
+        FileHandle inHandle = std::move(request.handle);
+        const size_t offset = request.offset;
+        const size_t size = request.size;
+        void *buffer = request.buffer;
+        FileIOCallback callback = std::move(request.callback);
+        const EFileIOCompletionMode completionMode = request.completionMode;
+        const FileIOClock::time_point submitTime = request.submitTime;
+        const EFilePriority priority = request.priority;
+        const FileIOClock::time_point deadline = request.deadline;
+        FileIORequestRef control = std::move(request.control);
+
+        // Large reads are split into disjoint ranges, so that several I/O threads can read one file in parallel.
+        const size_t numSplits = std::min<size_t>(numReadThreads, size / ParallelReadSplitSize);
+        if (numSplits <= 1)
+        {
+            FileIOTask task;
+            task.handle = std::move(inHandle);
+            task.offset = offset;
+            task.remainingSize = size;
+            task.bufferStart = buffer;
+            task.callback = std::move(callback);
+            task.completionMode = completionMode;
+            task.submitTime = submitTime;
+            task.priority = priority;
+            task.deadline = deadline;
+            task.control = std::move(control);
+
+            ScheduleReadTask(std::move(task));
+            return;
+        }
+
+        struct SplitReadState
+        {
+            std::atomic<size_t>  numRemaining;
+            std::atomic<int64_t> performedSize{0};
+            std::atomic<bool>    bOK{true};
+            FileIOCallback       callback;
+            EFileIOCompletionMode completionMode;
+            FileIOClock::time_point submitTime;
+            FileIOClock::time_point deadline;
+            FileIORequestRef     control;
+            EFilePriority        priority;
+            void                *buffer;
+        };
+        auto state = std::make_shared<SplitReadState>();
+        state->numRemaining = numSplits;
+        state->callback = std::move(callback);
+        state->completionMode = completionMode;
+        state->submitTime = submitTime;
+        state->deadline = deadline;
+        state->control = control;
+        state->priority = priority;
+        state->buffer = buffer;
+
+        // Round slices up to the I/O block size, so that each thread issues full blocks.
+        const size_t splitSize = (size / numSplits + ParallelReadSplitAlignment - 1) / ParallelReadSplitAlignment * ParallelReadSplitAlignment;
+        size_t splitOffset = 0;
+        for (size_t i = 0; i < numSplits; ++i)
+        {
+            FileIOTask task;
+            task.handle = inHandle;
+            task.offset = offset + splitOffset;
+            task.remainingSize = i + 1 == numSplits ? size - splitOffset : splitSize;
+            task.bufferStart = static_cast<char*>(buffer) + splitOffset;
+            task.priority = priority;
+            task.deadline = deadline;
+            task.control = control;
+            // Slices are joined on I/O thread, the whole read is then delivered as caller requested.
+            task.completionMode = EFileIOCompletionMode::IOThread;
+            task.callback = [state](bool bOk, int64_t performedSize, const void*)
+            {
+                state->performedSize.fetch_add(performedSize);
+                if (!bOk)
+                    state->bOK.store(false);
+                if (state->numRemaining.fetch_sub(1) != 1)
+                    return;
+
+                FileIOCompletion completion;
+                completion.callback = std::move(state->callback);
+                completion.completionMode = state->completionMode;
+                completion.submitTime = state->submitTime;
+                completion.priority = state->control ? state->control->GetPriority() : state->priority;
+                completion.deadline = state->deadline;
+                completion.bOK = state->bOK.load();
+                completion.performedSize = state->performedSize.load();
+                completion.buffer = state->buffer;
+                FileIOManager::Get().DeliverCompletion(std::move(completion));
+            };
+            splitOffset += task.remainingSize;
+
+            ScheduleReadTask(std::move(task));
+        }
+    }
+
+    void FileIOManager::ScheduleReadTask(FileIOTask &&task)
     {
+        readScheduler.Push(std::move(task));
+        // Busy threads pull it on their next batch anyway, only an idle one needs a signal.
+        for (auto threadHandle: readThreadHandles)
+        {
+            if (dynamic_cast<FileIOThread*>(threadHandle)->WakeUp())
+                break;
+        }
+    }
+
+    struct BlockCompressedReadState
+    {
+        FileHandle     handle;
+        uint64_t       streamOffset{0};
+        uint8_t       *buffer{nullptr};
+        size_t         size{0};
+        FileIOCallback callback;
+        EFileIOCompletionMode completionMode{EFileIOCompletionMode::MainThread};
+        FileIOClock::time_point submitTime;
+        FileIOClock::time_point deadline;
+        FileIORequestRef control;
+
+        std::vector<uint8_t> tableData;
+        CompressedBlockTable table;
+        // Stored bytes of each block, released once decoded.
+        std::vector<std::vector<uint8_t>> blockData;
+        std::atomic<uint32_t> numRemainingBlocks{0};
+        std::atomic<bool>     bOK{true};
+
+        void Finish(bool bSucceeded)
+        {
+            FileIOCompletion completion;
+            completion.callback = std::move(callback);
+            completion.completionMode = completionMode;
+            completion.submitTime = submitTime;
+            completion.priority = control->GetPriority();
+            completion.deadline = deadline;
+            completion.bOK = bSucceeded;
+            completion.performedSize = bSucceeded ? static_cast<int64_t>(size) : 0;
+            completion.buffer = buffer;
+            FileIOManager::Get().DeliverCompletion(std::move(completion));
+        }
+
+        void FinishBlock()
+        {
+            if (numRemainingBlocks.fetch_sub(1) == 1)
+                Finish(bOK.load());
+        }
+    };
+
+    FileIORequestRef FileIOManager::RequestReadBlockCompressedAsync(FileHandle inHandle, size_t streamOffset, size_t size, void *buffer,
+        FileIOCallback callback, EFileIOCompletionMode completionMode, const FileIORequestOptions &options)
+    {
+        auto state = std::make_shared<BlockCompressedReadState>();
+        state->control = std::make_shared<FileIORequestControl>(options.priority.value_or(inHandle->priority));
+        state->deadline = options.deadline;
+        state->handle = std::move(inHandle);
+        state->streamOffset = streamOffset;
+        state->buffer = static_cast<uint8_t*>(buffer);
+        state->size = size;
+        state->callback = std::move(callback);
+        state->completionMode = completionMode;
+        state->submitTime = FileIOClock::now();
+        state->tableData.resize(CompressedBlockTable::GetMaxTableSize(size));
+
+        // First read header and block table, then every block as its own read.
+        // A block is decoded on a worker as soon as it arrives, while remaining blocks are still being read.
+        FileIOTask tableTask;
+        tableTask.handle = state->handle;
+        tableTask.offset = static_cast<int64_t>(streamOffset);
+        tableTask.remainingSize = static_cast<int64_t>(state->tableData.size());
+        tableTask.bufferStart = state->tableData.data();
+        tableTask.completionMode = EFileIOCompletionMode::IOThread;
+        tableTask.deadline = state->deadline;
+        tableTask.control = state->control;
+        tableTask.callback = [this, state](bool, int64_t performedSize, const void*)
+        {
+            // Table read may stop at EOF of a small stream, that is fine as long as the table is complete.
+            if (performedSize <= 0 || !state->table.Parse(state->tableData.data(), performedSize) ||
+                state->table.GetHeader().uncompressedSize != state->size)
+            {
+                logger.error("Invalid block compressed data in file {}", state->handle->fileName.GetString());
+                state->Finish(false);
+                return;
+            }
+            state->tableData = {};
+
+            const uint32_t numBlocks = state->table.GetNumBlocks();
+            if (numBlocks == 0)
+            {
+                state->Finish(true);
+                return;
+            }
+
+            state->blockData.resize(numBlocks);
+            state->numRemainingBlocks = numBlocks;
+            for (uint32_t index = 0; index < numBlocks; ++index)
+            {
+                state->blockData[index].resize(state->table.GetBlockStoredSize(index));
+
+                FileIOTask blockTask;
+                blockTask.handle = state->handle;
+                blockTask.offset = static_cast<int64_t>(state->streamOffset + state->table.GetBlockOffset(index));
+                blockTask.remainingSize = static_cast<int64_t>(state->blockData[index].size());
+                blockTask.bufferStart = state->blockData[index].data();
+                blockTask.completionMode = EFileIOCompletionMode::IOThread;
+                blockTask.deadline = state->deadline;
+                blockTask.control = state->control;
+                blockTask.callback = [state, index](bool bBlockOK, int64_t, const void*)
+                {
+                    if (!bBlockOK)
+                    {
+                        state->bOK.store(false);
+                        state->FinishBlock();
+                        return;
+                    }
+
+                    AsyncTask([state, index](void*)
+                    {
+                        uint8_t *output = state->buffer + static_cast<size_t>(index) * state->table.GetHeader().blockSize;
+                        if (!state->table.DecodeBlock(index, state->blockData[index].data(), output))
+                            state->bOK.store(false);
+                        state->blockData[index] = {};
+                        state->FinishBlock();
+                    });
+                };
+                ScheduleReadTask(std::move(blockTask));
+            }
+        };
+
+        ScheduleReadTask(std::move(tableTask));
+        return state->control;
+    }
+
+    FileIORequestRef FileIOManager::RequestWriteFileAsync(FileHandle inHandle, size_t offset, size_t size, const void *buffer,
+        FileIOCallback callback, EFileIOCompletionMode completionMode)
+    {
+        auto control = std::make_shared<FileIORequestControl>(inHandle->priority);
+
         FileIOTask task;
         task.handle = std::move(inHandle);
         task.offset = offset;
         task.remainingSize = size;
-        task.bufferStart = buffer;
+        task.bufferStart = const_cast<void *>(buffer);
         task.callback = std::move(callback);
+        task.completionMode = completionMode;
+        task.submitTime = FileIOClock::now();
+        task.priority = control->GetPriority();
+        task.control = control;
 
-        remainingReadTasks.push(std::move(task));
+        task.handle->writeGeneration.fetch_add(1);
+        std::lock_guard lock(mutexPendingRequests);
+        remainingWriteTasks.push(std::move(task));
+        return control;
     }
 
-    void FileIOManager::RequestWriteFileAsync(FileHandle inHandle, size_t offset, size_t size, const void *buffer,
-        FileIOCallback callback)
+    FileIORequestRef FileIOManager::RequestWriteGatherAsync(FileHandle inHandle, size_t offset, std::vector<FileIOBufferSpan> spans,
+        FileIOCallback callback, EFileIOCompletionMode completionMode)
     {
+        auto control = std::make_shared<FileIORequestControl>(inHandle->priority);
+
         FileIOTask task;
         task.handle = std::move(inHandle);
         task.offset = offset;
-        task.remainingSize = size;
-        task.bufferStart = const_cast<void *>(buffer);
+        for (const auto &span: spans)
+        {
+            task.remainingSize += static_cast<int64_t>(span.size);
+        }
+        task.gatherSpans = std::move(spans);
+        task.bufferStart = nullptr;
+        task.callback = std::move(callback);
+        task.completionMode = completionMode;
+        task.submitTime = FileIOClock::now();
+        task.priority = control->GetPriority();
+        task.control = control;
+
+        task.handle->writeGeneration.fetch_add(1);
+        std::lock_guard lock(mutexPendingRequests);
+        remainingWriteTasks.push(std::move(task));
+        return control;
+    }
+
+    FileIORequestRef FileIOManager::RequestSyncFileAsync(FileHandle inHandle, EFileSyncMode syncMode,
+        FileIOCallback callback, EFileIOCompletionMode completionMode)
+    {
+        auto control = std::make_shared<FileIORequestControl>(inHandle->priority);
+
+        FileIOTask task;
+        task.handle = std::move(inHandle);
+        task.syncMode = syncMode == EFileSyncMode::None ? EFileSyncMode::Data : syncMode;
+        task.bufferStart = nullptr;
         task.callback = std::move(callback);
+        task.completionMode = completionMode;
+        task.submitTime = FileIOClock::now();
+        task.priority = control->GetPriority();
+        task.control = control;
 
+        // Queued along with writes, so it lands on the write thread the file is pinned to, after writes before it.
+        std::lock_guard lock(mutexPendingRequests);
         remainingWriteTasks.push(std::move(task));
+        return control;
+    }
+
+    std::shared_ptr<WriteBehindBuffer> FileIOManager::CreateWriteBehindBuffer(FileHandle inHandle, size_t startOffset,
+        size_t flushSize, FileIOClock::duration flushInterval)
+    {
+        auto buffer = std::make_shared<WriteBehindBuffer>(std::move(inHandle), startOffset,
+            flushSize == 0 ? writeBehindFlushSize : flushSize,
+            flushInterval == FileIOClock::duration::zero() ? writeBehindFlushInterval : flushInterval);
+
+        std::lock_guard lock(mutexWriteBehindBuffers);
+        writeBehindBuffers.push_back(buffer);
+        return buffer;
+    }
+
+    void FileIOManager::RegisterIOBuffers(const std::vector<FileIOBufferSpan> &inBuffers)
+    {
+        std::vector<FileIOBufferSpan> buffers = directIOBufferPool.GetBufferSpans();
+        buffers.insert(buffers.end(), inBuffers.begin(), inBuffers.end());
+
+        for (auto handle: readThreadHandles)
+        {
+            dynamic_cast<FileIOThread*>(handle)->SetRegisteredBuffers(buffers);
+        }
+
+        for (auto handle: writeThreadHandles)
+        {
+            dynamic_cast<FileIOThread*>(handle)->SetRegisteredBuffers(buffers);
+        }
     }
 }
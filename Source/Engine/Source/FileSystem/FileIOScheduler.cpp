@@ -0,0 +1,206 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "FileSystem/FileIOScheduler.h"
+
+#include <algorithm>
+
+namespace Koala::FileIO
+{
+    // Heaps with more stale entries than this many times live tasks are rebuilt.
+    constexpr size_t MaxStaleEntryFactor = 4;
+
+    bool FileIOScheduler::QueueEntry::operator<(const QueueEntry &rhs) const
+    {
+        if (deadline != rhs.deadline)
+            return deadline > rhs.deadline;
+        return sequence > rhs.sequence;
+    }
+
+    static FORCEINLINE size_t GetPriorityQueueIndex(EFilePriority priority)
+    {
+        return std::clamp<size_t>(static_cast<size_t>(priority), 1, static_cast<size_t>(EFilePriority::Highest)) - 1;
+    }
+
+    void FileIOScheduler::Initialize(uint64_t backgroundBytesPerSecond, uint64_t backgroundBurstBytes, FileIOClock::duration inDeadlineSlack)
+    {
+        std::lock_guard lock(mutex);
+        backgroundRate = static_cast<double>(backgroundBytesPerSecond);
+        backgroundBurst = static_cast<double>(std::max<uint64_t>(backgroundBurstBytes, FileIOBlockSize));
+        backgroundTokens = backgroundBurst;
+        lastRefillTime = FileIOClock::now();
+        deadlineSlack = inDeadlineSlack;
+    }
+
+    void FileIOScheduler::AddQueueEntries(uint32_t slot)
+    {
+        const FileIOTask &task = slots[slot].task;
+        const QueueEntry entry{task.deadline, task.sequence, slots[slot].pushId, slot};
+        if (task.deadline != FileIOClock::time_point::max())
+        {
+            deadlineQueue.push_back(entry);
+            std::push_heap(deadlineQueue.begin(), deadlineQueue.end());
+            ++numQueueEntries;
+        }
+        std::vector<QueueEntry> &queue = priorityQueues[GetPriorityQueueIndex(task.GetPriority())];
+        queue.push_back(entry);
+        std::push_heap(queue.begin(), queue.end());
+        ++numQueueEntries;
+    }
+
+    void FileIOScheduler::Push(FileIOTask &&task)
+    {
+        std::lock_guard lock(mutex);
+        // Requeued remaining part of a task keeps its place.
+        if (task.sequence == 0)
+            task.sequence = nextSequence++;
+
+        uint32_t slot;
+        if (!freeSlots.empty())
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else
+        {
+            slot = static_cast<uint32_t>(slots.size());
+            slots.emplace_back();
+        }
+        slots[slot].task = std::move(task);
+        slots[slot].pushId = nextPushId++;
+        AddQueueEntries(slot);
+        numPendingTasks.fetch_add(1);
+    }
+
+    void FileIOScheduler::RebuildQueues()
+    {
+        deadlineQueue.clear();
+        for (std::vector<QueueEntry> &queue: priorityQueues)
+        {
+            queue.clear();
+        }
+        numQueueEntries = 0;
+        for (uint32_t slot = 0; slot < slots.size(); ++slot)
+        {
+            if (slots[slot].pushId != 0)
+                AddQueueEntries(slot);
+        }
+    }
+
+    void FileIOScheduler::TakeTop(std::vector<QueueEntry> &queue, std::vector<FileIOTask> &outTasks)
+    {
+        const uint32_t slot = queue.front().slot;
+        std::pop_heap(queue.begin(), queue.end());
+        queue.pop_back();
+        --numQueueEntries;
+
+        outTasks.push_back(std::move(slots[slot].task));
+        slots[slot].task = FileIOTask{};
+        slots[slot].pushId = 0;
+        freeSlots.push_back(slot);
+    }
+
+    void FileIOScheduler::RefillBackgroundTokens(FileIOClock::time_point now)
+    {
+        const double elapsedSeconds = std::chrono::duration<double>(now - lastRefillTime).count();
+        lastRefillTime = now;
+        backgroundTokens = std::min(backgroundBurst, backgroundTokens + elapsedSeconds * backgroundRate);
+    }
+
+    FileIOClock::duration FileIOScheduler::Pop(std::vector<FileIOTask> &outTasks, size_t maxCount)
+    {
+        std::lock_guard lock(mutex);
+        if (numPendingTasks.load() == 0 || maxCount == 0)
+            return {};
+
+        const FileIOClock::time_point now = FileIOClock::now();
+        if (backgroundRate > 0)
+            RefillBackgroundTokens(now);
+
+        // Priorities of queued requests can be changed by caller, rare enough to reorder whole queue for it.
+        const uint64_t serial = FileIORequestControl::GetPriorityChangeSerial();
+        if (serial != priorityChangeSerial)
+        {
+            priorityChangeSerial = serial;
+            RebuildQueues();
+        }
+
+        const size_t numTakenBefore = outTasks.size();
+        auto isFull = [&outTasks, numTakenBefore, maxCount]() { return outTasks.size() - numTakenBefore >= maxCount; };
+
+        // Urgent tasks first. Each task has an entry in deadline queue and one in its priority queue, whichever is
+        // not used to take it turns stale and is dropped once it comes to top.
+        while (!isFull() && !deadlineQueue.empty())
+        {
+            const QueueEntry &top = deadlineQueue.front();
+            if (IsStale(top))
+            {
+                std::pop_heap(deadlineQueue.begin(), deadlineQueue.end());
+                deadlineQueue.pop_back();
+                --numQueueEntries;
+                continue;
+            }
+            if (top.deadline - now > deadlineSlack)
+                break;
+            TakeTop(deadlineQueue, outTasks);
+        }
+
+        bool bThrottled = false;
+        for (size_t index = NumPriorities; index-- > 0 && !isFull();)
+        {
+            const EFilePriority priority = static_cast<EFilePriority>(index + 1);
+            const bool bLimited = backgroundRate > 0 && IsBackgroundPriority(priority);
+            std::vector<QueueEntry> &queue = priorityQueues[index];
+            while (!isFull() && !queue.empty())
+            {
+                if (IsStale(queue.front()))
+                {
+                    std::pop_heap(queue.begin(), queue.end());
+                    queue.pop_back();
+                    --numQueueEntries;
+                    continue;
+                }
+                if (bLimited)
+                {
+                    if (backgroundTokens <= 0)
+                    {
+                        bThrottled = true;
+                        break;
+                    }
+                    // Charge what I/O thread is going to read before requeueing the task.
+                    const FileIOTask &task = slots[queue.front().slot].task;
+                    backgroundTokens -= static_cast<double>(std::min(task.remainingSize, FilePriorityToBlockNum(priority) * FileIOBlockSize));
+                }
+                TakeTop(queue, outTasks);
+            }
+        }
+
+        const size_t numTaken = outTasks.size() - numTakenBefore;
+        numPendingTasks.fetch_sub(numTaken);
+        if (numQueueEntries > MaxStaleEntryFactor * (numPendingTasks.load() + 16))
+            RebuildQueues();
+
+        if (numTaken == 0 && bThrottled)
+        {
+            const double waitSeconds = -backgroundTokens / backgroundRate;
+            return std::max<FileIOClock::duration>(std::chrono::duration_cast<FileIOClock::duration>(std::chrono::duration<double>(waitSeconds)),
+                std::chrono::microseconds(100));
+        }
+        return {};
+    }
+}
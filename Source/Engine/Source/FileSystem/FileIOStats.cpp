@@ -0,0 +1,83 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "FileSystem/FileIOStats.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace Koala::FileIO
+{
+    uint32_t FileIOLatencyHistogram::GetBucketIndex(uint64_t latencyUs)
+    {
+        if (latencyUs < 2)
+            return 0;
+        // Power of two from highest bit, quarter from the two bits below it.
+        const uint32_t exponent = 63 - std::countl_zero(latencyUs);
+        const uint32_t fraction = exponent >= 2 ? static_cast<uint32_t>(latencyUs >> (exponent - 2)) & 3 : static_cast<uint32_t>(latencyUs << (2 - exponent)) & 3;
+        return std::min(exponent * BucketsPerPowerOfTwo + fraction, NumBuckets - 1);
+    }
+
+    uint64_t FileIOLatencyHistogram::GetBucketUpperBoundUs(uint32_t index)
+    {
+        const uint32_t exponent = index / BucketsPerPowerOfTwo;
+        const uint32_t fraction = index % BucketsPerPowerOfTwo;
+        return static_cast<uint64_t>(std::ldexp(1.0 + (fraction + 1) / 4.0, static_cast<int>(exponent)));
+    }
+
+    void FileIOLatencyHistogram::Add(uint64_t latencyUs)
+    {
+        buckets[GetBucketIndex(latencyUs)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void FileIOLatencyHistogram::Reset()
+    {
+        for (auto &bucket: buckets)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t FileIOLatencyHistogram::GetCount() const
+    {
+        uint64_t count = 0;
+        for (const auto &bucket: buckets)
+        {
+            count += bucket.load(std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+    uint64_t FileIOLatencyHistogram::GetPercentileUs(double percentile) const
+    {
+        const uint64_t count = GetCount();
+        if (count == 0)
+            return 0;
+
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * count)));
+        uint64_t accumulated = 0;
+        for (uint32_t index = 0; index < NumBuckets; ++index)
+        {
+            accumulated += buckets[index].load(std::memory_order_relaxed);
+            if (accumulated >= rank)
+                return GetBucketUpperBoundUs(index);
+        }
+        return GetBucketUpperBoundUs(NumBuckets - 1);
+    }
+}
@@ -18,11 +18,15 @@
 
 #include "FileSystem/FileIOThread.h"
 
+#include <cerrno>
+#include <cstring>
+
 #include "Core/Check.h"
+#include "FileSystem/FileIOManager.h"
+#include "Memory/Allocator.h"
 
 namespace Koala::FileIO
 {
-    constexpr int64_t BlockSize = 16384;
     constexpr int64_t MaxContinuousIOWorkBlocks = 256;
 
     int64_t FilePriorityToBlockNum(EFilePriority inPriority)
@@ -44,154 +48,456 @@ namespace Koala::FileIO
     }
     void FileIOThread::Run()
     {
+        backend = CreateFileIOBackend(backendType, queueDepth);
+        check(backend != nullptr, "Failed to create FileIO backend!");
+
         while (!atomicShouldShutdown.load())
         {
             while (atomicAwakeSignal.load() == false)
                 atomicAwakeSignal.wait(false);
             DoWork();
         }
+
+        backend->Shutdown();
     }
 
     void FileIOThread::ShutdownIOThread()
     {
         atomicShouldShutdown.store(true);
         atomicShouldShutdown.notify_all();
-        atomicAwakeSignal.store(true);
-        atomicAwakeSignal.notify_all();
+        SignalAwake();
     }
 
+    void FileIOThread::SetRegisteredBuffers(const std::vector<FileIOBufferSpan> &inBuffers)
+    {
+        {
+            std::lock_guard lock(mutexRegisteredBuffers);
+            pendingRegisteredBuffers = inBuffers;
+            bRegisteredBuffersDirty = true;
+        }
+        // Wake up thread to apply them.
+        SignalAwake();
+    }
 
-    void FileIOThread::DoWork()
+    void FileIOThread::ApplyRegisteredBuffers()
+    {
+        std::lock_guard lock(mutexRegisteredBuffers);
+        if (!bRegisteredBuffersDirty)
+            return;
+        backend->RegisterBuffers(pendingRegisteredBuffers);
+        bRegisteredBuffersDirty = false;
+    }
+
+    static FORCEINLINE int64_t AlignUpForDirectIO(int64_t value)
+    {
+        return (value + DirectIOAlignment - 1) & ~(DirectIOAlignment - 1);
+    }
+
+    static FORCEINLINE bool IsDirectIOAligned(const FileIORequest &request)
+    {
+        return request.offset % DirectIOAlignment == 0 && request.size % DirectIOAlignment == 0 &&
+            reinterpret_cast<uintptr_t>(request.buffer) % DirectIOAlignment == 0;
+    }
+
+    void FileIOThread::PrepareDirectIORead(FileIORequest &request, DirectIOStaging &staging)
     {
-        FileIOTask task;
-        
+        if (IsDirectIOAligned(request))
+            return;
+
+        DirectIOBufferPool &pool = FileIOManager::Get().GetDirectIOBufferPool();
+        const int64_t alignedOffset = request.offset & ~(DirectIOAlignment - 1);
+        staging.headSize = request.offset - alignedOffset;
+
+        int64_t stagingSize = static_cast<int64_t>(pool.GetBufferSize());
+        staging.buffer = stagingSize > staging.headSize ? pool.Acquire() : nullptr;
+        staging.bPooled = staging.buffer != nullptr;
+        if (!staging.bPooled)
         {
-            std::lock_guard lock(mutexTQ);
-            if (taskQueue.empty())
-            {
-                // Put the thread to sleep until we has new task.
-                atomicAwakeSignal.store(false);
-                return;
-            }
+            // Pool exhausted, pay for a temporary allocation rather than stall.
+            stagingSize = AlignUpForDirectIO(staging.headSize + request.size);
+            staging.buffer = Memory::MallocAligned(stagingSize, DirectIOAlignment);
+        }
+
+        // Requests larger than staging buffer are continued by next batch.
+        staging.copySize = std::min(request.size, stagingSize - staging.headSize);
+        request.offset = alignedOffset;
+        request.size = AlignUpForDirectIO(staging.headSize + staging.copySize);
+        request.buffer = staging.buffer;
+    }
+
+    int64_t FileIOThread::FinishDirectIORead(const FileIORequest &request, DirectIOStaging &staging, void *taskBuffer)
+    {
+        int64_t result = request.result;
+        if (result > 0)
+        {
+            // Drop head, and tail beyond requested range (or EOF).
+            result = std::clamp<int64_t>(result - staging.headSize, 0, staging.copySize);
+            if (result > 0)
+                std::memcpy(taskBuffer, static_cast<uint8_t*>(staging.buffer) + staging.headSize, result);
+        }
+
+        if (staging.bPooled)
+            FileIOManager::Get().GetDirectIOBufferPool().Release(staging.buffer);
+        else
+            Memory::FreeAligned(staging.buffer);
+        staging.buffer = nullptr;
+        return result;
+    }
+
+    bool FileIOThread::TakeBatchFromQueue()
+    {
+        std::lock_guard lock(mutexTQ);
+        if (taskQueue.empty())
+        {
+            // Put the thread to sleep until we has new task.
+            atomicAwakeSignal.store(false);
+            if (numPendingWork.load() > 0)
+                atomicAwakeSignal.store(true);
+            return false;
+        }
 
-            task = std::move(taskQueue.front());
-            taskQueue.pop();
+        // Take as many tasks as backend can keep in-flight at once.
+        // Requests of one batch run concurrently, so a sync barrier always goes in a batch of its own.
+        const size_t maxBatchSize = backend->GetQueueDepth();
+        while (!taskQueue.empty() && batchTasks.size() < maxBatchSize)
+        {
+            const bool bBarrier = taskQueue.front().syncMode != EFileSyncMode::None;
+            if (bBarrier && !batchTasks.empty())
+                break;
 
+            batchTasks.push_back(std::move(taskQueue.front()));
+            taskQueue.pop_front();
             atomicTQLength.fetch_sub(1);
+            if (bBarrier)
+                break;
         }
+        return true;
+    }
 
-        if (!task.bOK || task.bCanceled)
+    bool FileIOThread::TakeBatchFromScheduler()
+    {
+        const FileIOClock::duration throttleTime = scheduler->Pop(batchTasks, backend->GetQueueDepth());
+        if (!batchTasks.empty())
+            return true;
+
+        if (throttleTime > FileIOClock::duration::zero())
         {
-            std::lock_guard lock(mutexFinishedTaskList);
-            finishedTasks.push_back(task);
-            
+            // Only background reads over their bandwidth are left, come back once they can go. Thread counts as
+            // sleeping meanwhile, so a new read waking it up is not held back by the throttle.
+            std::unique_lock lock(mutexThrottle);
+            atomicAwakeSignal.store(false);
+            cvThrottle.wait_for(lock, throttleTime, [this] { return atomicAwakeSignal.load(); });
+            atomicAwakeSignal.store(true);
+            return false;
+        }
+
+        atomicAwakeSignal.store(false);
+        // Task may be pushed while we are going to sleep, and pusher saw us still awake.
+        if (scheduler->GetNumPendingTasks() > 0 || numPendingWork.load() > 0)
+            atomicAwakeSignal.store(true);
+        return false;
+    }
+
+    void FileIOThread::RunPendingWork()
+    {
+        if (numPendingWork.load() == 0)
             return;
+
+        std::vector<std::function<void()>> works;
+        {
+            std::lock_guard lock(mutexPendingWork);
+            works.swap(pendingWork);
+            numPendingWork.store(0);
         }
+        for (auto &work: works)
+        {
+            work();
+        }
+    }
+
+    void FileIOThread::PrepareGatherWrite(const FileIOTask &task, FileIORequest &request)
+    {
+        batchGatherSpanStarts.back() = batchGatherSpans.size();
 
-        if (task.bCancelRequested)
+        // Skip what is written by previous batches.
+        size_t skipSize = static_cast<size_t>(task.performedSize);
+        uint32_t numSpans = 0;
+        int64_t size = 0;
+        for (const FileIOBufferSpan &span: task.gatherSpans)
         {
-            task.bOK = false;
-            task.bCanceled = true;
-            task.bFinished = true;
-            
+            if (skipSize >= span.size)
             {
-                std::lock_guard lock(mutexFinishedTaskList);
-                finishedTasks.push_back(task);
+                skipSize -= span.size;
+                continue;
             }
-            
-            return;
+            if (numSpans == MaxGatherSpansPerRequest)
+                break;
+
+            FileIOBufferSpan remaining;
+            remaining.buffer = static_cast<uint8_t*>(span.buffer) + skipSize;
+            remaining.size = span.size - skipSize;
+            skipSize = 0;
+            batchGatherSpans.push_back(remaining);
+            size += static_cast<int64_t>(remaining.size);
+            ++numSpans;
         }
-        
-        
-        if (task.remainingSize != 0 && task.bufferStart)
+
+        request.opType = EFileIOOpType::WriteGather;
+        request.numSpans = numSpans;
+        request.size = size;
+    }
+
+    void FileIOThread::DoWork()
+    {
+        ApplyRegisteredBuffers();
+        RunPendingWork();
+
+        batchTasks.clear();
+        if (!(scheduler ? TakeBatchFromScheduler() : TakeBatchFromQueue()))
+            return;
+
+        batchRequests.clear();
+        batchRequestTaskIndices.clear();
+        batchStagings.clear();
+        batchGatherSpans.clear();
+        batchGatherSpanStarts.clear();
+        batchUnfinishedWriteHandles.clear();
+        for (size_t index = 0; index < batchTasks.size(); ++index)
         {
-            
-            FileHandle handle = task.handle;
-            
-            int64_t blocks = std::min(task.remainingSize / BlockSize, FilePriorityToBlockNum(task.handle->priority));
+            FileIOTask &task = batchTasks[index];
+            if (!task.bOK || task.bCanceled)
+            {
+                task.bFinished = true;
+                continue;
+            }
+
+            if (task.IsCancelRequested())
+            {
+                task.bOK = false;
+                task.bCanceled = true;
+                task.bFinished = true;
+                continue;
+            }
+
+            // Requeued behind the earlier write of same file, writes must hit the file in order they were requested.
+            if (!bIsReadThread && IsWriteUnfinished(task.handle->nativeHandle))
+                continue;
+
+            if (task.syncMode != EFileSyncMode::None)
+            {
+                FileIORequest request;
+                request.nativeHandle = task.handle->nativeHandle;
+                request.opType = EFileIOOpType::Sync;
+                request.syncMode = task.syncMode;
+                batchRequests.push_back(request);
+                batchRequestTaskIndices.push_back(index);
+                batchStagings.emplace_back();
+                batchGatherSpanStarts.push_back(0);
+                continue;
+            }
+
+            if (task.remainingSize == 0 || (!task.bufferStart && task.gatherSpans.empty()))
+            {
+                task.bOK = task.bufferStart != nullptr || !task.gatherSpans.empty();
+                task.bCompleted = task.bOK;
+                task.bFinished = true;
+                continue;
+            }
+
+            FileHandle &handle = task.handle;
+            if (!bIsReadThread)
+                check(handle->CanWrite());
+
+            // Pak entry ends inside pak, never read into the next entry.
+            int64_t entryRemainingSize = task.remainingSize;
+            if (handle->IsPakEntry())
+            {
+                entryRemainingSize = std::min<int64_t>(task.remainingSize, static_cast<int64_t>(handle->storedSize) - task.offset);
+                if (entryRemainingSize <= 0)
+                {
+                    task.bOK = false;
+                    task.bFinished = true;
+                    continue;
+                }
+            }
+
+            int64_t blocks = std::min(task.remainingSize / FileIOBlockSize, FilePriorityToBlockNum(task.GetPriority()));
             blocks = std::min(blocks, MaxContinuousIOWorkBlocks);
-            
+
             if (blocks == 0)
                 blocks = 1;
 
-            int64_t remainingSize = task.remainingSize;
-            int64_t size = 0;
+            FileIORequest request;
+            request.nativeHandle = handle->nativeHandle;
+            request.opType = bIsReadThread ? EFileIOOpType::Read : EFileIOOpType::Write;
+            request.offset = static_cast<int64_t>(handle->baseOffset) + task.offset;
+            request.size = std::min(blocks * FileIOBlockSize, entryRemainingSize);
+            request.buffer = static_cast<char*>(task.bufferStart) + task.performedSize;
+
+            batchGatherSpanStarts.push_back(0);
+            if (!task.gatherSpans.empty())
+                PrepareGatherWrite(task, request);
+
+            DirectIOStaging staging;
+            if (bIsReadThread && handle->IsDirectIO())
+                PrepareDirectIORead(request, staging);
+
+            if (!bIsReadThread && request.size < task.remainingSize)
+                batchUnfinishedWriteHandles.push_back(request.nativeHandle);
 
-            if (bIsReadThread)
+            batchRequests.push_back(request);
+            batchRequestTaskIndices.push_back(index);
+            batchStagings.push_back(staging);
+        }
+
+        // Span storage is final now, point requests into it.
+        for (size_t i = 0; i < batchRequests.size(); ++i)
+        {
+            if (batchRequests[i].opType == EFileIOOpType::WriteGather)
+                batchRequests[i].spans = batchGatherSpans.data() + batchGatherSpanStarts[i];
+        }
+
+        if (!batchRequests.empty())
+        {
+            for (const FileIORequest &request: batchRequests)
             {
-                char * buffer = static_cast<char*>(task.bufferStart) + task.offset;
-                for (auto i = 0; i < blocks; ++i)
-                {
-                    int64_t blockSize = std::min(BlockSize, remainingSize);
-
-                    auto fileOffset = handle->fileStream.tellg() + size;
-                    if (fileOffset != task.offset)
-                        handle->fileStream.seekg(task.offset, std::ios::beg);
-                    
-                    handle->fileStream.read(buffer + size, blockSize);
-                    int64_t readSize = handle->fileStream.gcount();
-                    size += readSize;
-                    remainingSize -= readSize;
-                }
+                if (request.opType == EFileIOOpType::Sync)
+                    continue;
+                if (request.nativeHandle != lastRequestHandle || request.offset != lastRequestEnd)
+                    stats.numSeeks.fetch_add(1, std::memory_order_relaxed);
+                lastRequestHandle = request.nativeHandle;
+                lastRequestEnd = request.offset + request.size;
             }
-            else
+
+            const FileIOClock::time_point submitTime = FileIOClock::now();
+            backend->SubmitAndWait(batchRequests.data(), static_cast<uint32_t>(batchRequests.size()));
+            const uint64_t busyTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(FileIOClock::now() - submitTime).count();
+
+            const uint64_t depth = batchRequests.size();
+            stats.busyTimeUs.fetch_add(busyTimeUs, std::memory_order_relaxed);
+            stats.numBatches.fetch_add(1, std::memory_order_relaxed);
+            stats.numRequests.fetch_add(depth, std::memory_order_relaxed);
+            stats.totalBatchDepth.fetch_add(depth, std::memory_order_relaxed);
+            if (depth > stats.maxBatchDepth.load(std::memory_order_relaxed))
+                stats.maxBatchDepth.store(depth, std::memory_order_relaxed);
+        }
+
+        for (size_t i = 0; i < batchRequests.size(); ++i)
+        {
+            const FileIORequest &request = batchRequests[i];
+            FileIOTask &task = batchTasks[batchRequestTaskIndices[i]];
+
+            int64_t result = request.result;
+            if (batchStagings[i].buffer)
+                result = FinishDirectIORead(request, batchStagings[i], static_cast<char*>(task.bufferStart) + task.performedSize);
+
+            if (result > 0)
+                stats.bytesTransferred.fetch_add(result, std::memory_order_relaxed);
+
+            // Backend skipped it after a short write of same file, requeued behind the rest of that write.
+            if (result == -ECANCELED && !bIsReadThread && IsWriteUnfinished(request.nativeHandle))
+                continue;
+
+            if (request.opType == EFileIOOpType::Sync)
             {
-                const char * buffer = static_cast<const char*>(task.bufferStart) + task.offset;
-                for (auto i = 0; i < blocks; ++i)
-                {
-                    check(handle->openMode & (uint32_t)EFileOpenMode::OpenFileForWrite);
-                    check(handle->fileStream.good());
-                    int64_t blockSize = std::min(BlockSize, remainingSize);
+                task.bOK = result == 0;
+                task.bCompleted = task.bOK;
+                task.bFinished = true;
+                continue;
+            }
 
-                    handle->fileStream.write(buffer + size, blockSize);
-                    size += blockSize;
-                    remainingSize -= blockSize;
-                }
+            // Error, or EOF before all requested data is read.
+            if (result <= 0)
+            {
+                task.bOK = false;
+                task.bFinished = true;
+                continue;
             }
-            
-            task.offset += size;
-            task.performedSize += size;
-            task.remainingSize = remainingSize;
 
-            if (remainingSize == 0)
+            if (!bIsReadThread && result < request.size && !IsWriteUnfinished(request.nativeHandle))
+                batchUnfinishedWriteHandles.push_back(request.nativeHandle);
+
+            task.offset += result;
+            task.performedSize += result;
+            task.remainingSize -= result;
+
+            if (task.remainingSize == 0)
             {
                 task.bOK = true;
                 task.bFinished = true;
                 task.bCompleted = true;
             }
-            
-            if (handle->IsEOF() || !handle->IsValid())
+        }
+
+        if (scheduler)
+        {
+            // Remaining part competes with other requests again.
+            for (auto &task: batchTasks)
             {
-                task.bOK = false;
-                task.bFinished = true;
+                if (!task.bFinished)
+                    scheduler->Push(std::move(task));
             }
         }
-
-        if (!task.bFinished && !task.bCanceled && task.bOK)
+        else
         {
             std::lock_guard lock(mutexTQ);
-            taskQueue.push(std::move(task));
-            atomicTQLength.fetch_add(1);
+            for (auto it = batchTasks.rbegin(); it != batchTasks.rend(); ++it)
+            {
+                if (!it->bFinished)
+                {
+                    taskQueue.push_front(std::move(*it));
+                    atomicTQLength.fetch_add(1);
+                }
+            }
         }
-        else
+
+        // Delivered right here, not waiting for main thread to poll us.
+        for (auto &task: batchTasks)
+        {
+            if (!task.bFinished)
+                continue;
+            // Reads staged while the write ran are stale from now on.
+            if (!bIsReadThread && task.syncMode == EFileSyncMode::None)
+                task.handle->writeGeneration.fetch_add(1);
+            FileIOManager::Get().DeliverCompletion(std::move(task));
+        }
+    }
+
+    void FileIOThread::PushWork(std::function<void()> &&work)
+    {
+        {
+            std::lock_guard lock(mutexPendingWork);
+            pendingWork.push_back(std::move(work));
+            numPendingWork.fetch_add(1);
+        }
+        SignalAwake();
+    }
+
+    void FileIOThread::SignalAwake()
+    {
         {
-            std::lock_guard lock(mutexFinishedTaskList);
-            finishedTasks.push_back(task);
+            // Throttled thread checks the signal under this lock right before its timed wait.
+            std::lock_guard lock(mutexThrottle);
+            atomicAwakeSignal.store(true);
         }
+        atomicAwakeSignal.notify_all();
+        cvThrottle.notify_all();
+    }
+
+    bool FileIOThread::WakeUp()
+    {
+        if (atomicAwakeSignal.load())
+            return false;
+        SignalAwake();
+        return true;
     }
 
     void FileIOThread::PushTask(FileIOTask && inTask)
     {
-        check(
-            inTask.handle->currWorkingIOThread == nullptr || inTask.handle->currWorkingIOThread == this,
-            "The task is already assigned to other I/O thread. Reassigning is currently unsupported!");
         std::lock_guard lock(mutexTQ);
 
-        if (inTask.handle->currWorkingIOThread == nullptr)
-            inTask.handle->currWorkingIOThread = this;
-        taskQueue.push(std::move(inTask));
+        taskQueue.push_back(std::move(inTask));
         atomicTQLength.fetch_add(1);
-        atomicAwakeSignal.store(true);
-        atomicAwakeSignal.notify_all();
+        SignalAwake();
     }
 }
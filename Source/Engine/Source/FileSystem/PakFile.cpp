@@ -0,0 +1,226 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "FileSystem/PakFile.h"
+
+#include <cstring>
+
+#include "Core/KoalaLogger.h"
+#include "FileSystem/PlatformFile.h"
+
+namespace Koala::FileIO
+{
+    static Logger logger("PakFile");
+
+    PakFile::~PakFile()
+    {
+        PlatformFile::Close(nativeHandle);
+    }
+
+    std::shared_ptr<PakFile> PakFile::Open(const std::string &path)
+    {
+        NativeFileHandle handle = PlatformFile::Open(path, EFileOpenMode::OpenFileForRead | EFileOpenMode::OpenFileAsBinary);
+        if (handle == InvalidNativeFileHandle)
+        {
+            logger.error("Failed to open pak {}", path);
+            return nullptr;
+        }
+
+        std::shared_ptr<PakFile> pak(new PakFile());
+        pak->pakPath = HashedString(path);
+        pak->nativeHandle = handle;
+
+        const int64_t fileSize = PlatformFile::GetFileSize(handle);
+        PakFileHeader header;
+        if (PlatformFile::ReadAt(handle, &header, sizeof(header), 0) != sizeof(header) ||
+            header.magic != PakFileMagic || header.version != PakFileVersion)
+        {
+            logger.error("Pak {} has invalid header", path);
+            return nullptr;
+        }
+
+        const uint64_t entriesSize = static_cast<uint64_t>(header.numEntries) * sizeof(PakEntry);
+        if (header.tocOffset > static_cast<uint64_t>(fileSize) || header.tocSize > fileSize - header.tocOffset || entriesSize > header.tocSize)
+        {
+            logger.error("Pak {} has invalid TOC", path);
+            return nullptr;
+        }
+
+        // Whole TOC is read by one read.
+        std::vector<uint8_t> toc(header.tocSize);
+        if (PlatformFile::ReadAt(handle, toc.data(), header.tocSize, header.tocOffset) != static_cast<int64_t>(header.tocSize))
+        {
+            logger.error("Failed to read TOC of pak {}", path);
+            return nullptr;
+        }
+
+        const uint8_t *names = toc.data() + entriesSize;
+        const uint8_t *namesEnd = toc.data() + toc.size();
+        pak->entries.reserve(header.numEntries);
+        for (uint32_t i = 0; i < header.numEntries; ++i)
+        {
+            PakEntry entry;
+            std::memcpy(&entry, toc.data() + i * sizeof(PakEntry), sizeof(PakEntry));
+            if (entry.offset > static_cast<uint64_t>(fileSize) || entry.storedSize > fileSize - entry.offset)
+            {
+                logger.error("Pak {} has entry out of file range", path);
+                return nullptr;
+            }
+
+            // Register path so HashedString::GetString() works for entries.
+            uint32_t nameLength = 0;
+            if (namesEnd - names >= static_cast<ptrdiff_t>(sizeof(nameLength)))
+            {
+                std::memcpy(&nameLength, names, sizeof(nameLength));
+                names += sizeof(nameLength);
+                if (nameLength <= namesEnd - names)
+                {
+                    HashedString(std::string(reinterpret_cast<const char*>(names), nameLength));
+                    names += nameLength;
+                }
+            }
+
+            pak->entries.emplace(HashedString(entry.pathHash), entry);
+        }
+
+        return pak;
+    }
+
+    const PakEntry* PakFile::FindEntry(HashedString entryPath) const
+    {
+        auto it = entries.find(entryPath);
+        return it == entries.end() ? nullptr : &it->second;
+    }
+
+    void PakWriter::AddEntry(const std::string &entryPath, const void *data, size_t size, uint32_t alignment, ECompressionMethod compression,
+        uint32_t compressionBlockSize)
+    {
+        PendingEntry entry;
+        entry.path = entryPath;
+        entry.size = size;
+        entry.alignment = alignment == 0 ? 1 : alignment;
+        entry.compression = compression;
+
+        if (compression != ECompressionMethod::None && size > 0)
+        {
+            entry.data = Compression::CompressBlocks(compression, data, size, compressionBlockSize);
+            if (entry.data.size() >= size)
+                entry.compression = ECompressionMethod::None;
+        }
+        else
+        {
+            entry.compression = ECompressionMethod::None;
+        }
+
+        if (entry.compression == ECompressionMethod::None)
+            entry.data.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+
+        for (auto &existing: entries)
+        {
+            if (existing.path == entryPath)
+            {
+                existing = std::move(entry);
+                return;
+            }
+        }
+        entries.push_back(std::move(entry));
+    }
+
+    bool PakWriter::AddFile(const std::string &entryPath, const std::string &diskPath, uint32_t alignment, ECompressionMethod compression,
+        uint32_t compressionBlockSize)
+    {
+        NativeFileHandle handle = PlatformFile::Open(diskPath, EFileOpenMode::OpenFileForRead | EFileOpenMode::OpenFileAsBinary);
+        if (handle == InvalidNativeFileHandle)
+        {
+            logger.error("Failed to open {} for packing", diskPath);
+            return false;
+        }
+
+        const int64_t size = PlatformFile::GetFileSize(handle);
+        std::vector<uint8_t> data(size > 0 ? size : 0);
+        const bool bOK = size >= 0 && PlatformFile::ReadAt(handle, data.data(), data.size(), 0) == static_cast<int64_t>(data.size());
+        PlatformFile::Close(handle);
+
+        if (!bOK)
+        {
+            logger.error("Failed to read {} for packing", diskPath);
+            return false;
+        }
+
+        AddEntry(entryPath, data.data(), data.size(), alignment, compression, compressionBlockSize);
+        return true;
+    }
+
+    bool PakWriter::Write(const std::string &pakPath) const
+    {
+        NativeFileHandle handle = PlatformFile::Open(pakPath, EFileOpenMode::OpenFileForWrite | EFileOpenMode::OpenFileAsBinary);
+        if (handle == InvalidNativeFileHandle)
+        {
+            logger.error("Failed to open pak {} for write", pakPath);
+            return false;
+        }
+
+        bool bOK = true;
+        std::vector<PakEntry> tocEntries;
+        tocEntries.reserve(entries.size());
+
+        uint64_t offset = sizeof(PakFileHeader);
+        for (auto &pending: entries)
+        {
+            offset = (offset + pending.alignment - 1) / pending.alignment * pending.alignment;
+
+            PakEntry entry;
+            entry.pathHash = HashedString(pending.path).GetHash();
+            entry.offset = offset;
+            entry.storedSize = pending.data.size();
+            entry.size = pending.size;
+            entry.alignment = pending.alignment;
+            entry.compression = pending.compression;
+            tocEntries.push_back(entry);
+
+            if (!pending.data.empty())
+                bOK &= PlatformFile::WriteAt(handle, pending.data.data(), pending.data.size(), offset) == static_cast<int64_t>(pending.data.size());
+            offset += pending.data.size();
+        }
+
+        std::vector<uint8_t> toc(tocEntries.size() * sizeof(PakEntry));
+        if (!tocEntries.empty())
+            std::memcpy(toc.data(), tocEntries.data(), toc.size());
+        for (auto &pending: entries)
+        {
+            const uint32_t nameLength = static_cast<uint32_t>(pending.path.size());
+            const size_t pos = toc.size();
+            toc.resize(pos + sizeof(nameLength) + nameLength);
+            std::memcpy(toc.data() + pos, &nameLength, sizeof(nameLength));
+            std::memcpy(toc.data() + pos + sizeof(nameLength), pending.path.data(), nameLength);
+        }
+
+        PakFileHeader header;
+        header.numEntries = static_cast<uint32_t>(tocEntries.size());
+        header.tocOffset = offset;
+        header.tocSize = toc.size();
+
+        bOK &= PlatformFile::WriteAt(handle, toc.data(), toc.size(), offset) == static_cast<int64_t>(toc.size());
+        bOK &= PlatformFile::WriteAt(handle, &header, sizeof(header), 0) == static_cast<int64_t>(sizeof(header));
+        PlatformFile::Close(handle);
+
+        if (!bOK)
+            logger.error("Failed to write pak {}", pakPath);
+        return bOK;
+    }
+}
@@ -0,0 +1,342 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "FileSystem/PlatformFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#endif
+
+namespace Koala::FileIO::PlatformFile
+{
+#ifdef _WIN32
+    NativeFileHandle Open(const std::string &path, EOpenFileModes openMode)
+    {
+        DWORD access = 0;
+        DWORD creation = OPEN_EXISTING;
+        if (openMode & EFileOpenMode::OpenFileForRead)
+            access |= GENERIC_READ;
+        if (openMode & EFileOpenMode::OpenFileForWrite)
+        {
+            if (openMode & EFileOpenMode::OpenFileAtAppend)
+            {
+                access |= FILE_APPEND_DATA;
+                creation = OPEN_ALWAYS;
+            }
+            else
+            {
+                access |= GENERIC_WRITE;
+                creation = CREATE_ALWAYS;
+            }
+        }
+
+        DWORD flags = FILE_ATTRIBUTE_NORMAL;
+        if ((openMode & EFileOpenMode::OpenFileUnbuffered) && !(openMode & EFileOpenMode::OpenFileForWrite))
+            flags |= FILE_FLAG_NO_BUFFERING;
+
+        HANDLE handle = ::CreateFileA(path.c_str(), access, FILE_SHARE_READ, nullptr, creation, flags, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+            return InvalidNativeFileHandle;
+        return handle;
+    }
+
+    void Close(NativeFileHandle handle)
+    {
+        if (handle != InvalidNativeFileHandle)
+            ::CloseHandle(handle);
+    }
+
+    int64_t GetFileSize(NativeFileHandle handle)
+    {
+        LARGE_INTEGER size;
+        if (!::GetFileSizeEx(handle, &size))
+            return -1;
+        return size.QuadPart;
+    }
+
+    bool Stat(const std::string &path, FileStat &outStat)
+    {
+        outStat = FileStat{};
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!::GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data))
+            return false;
+
+        outStat.bExists = true;
+        outStat.bIsDirectory = data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY;
+        outStat.size = (static_cast<int64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+        // FILETIME counts 100ns intervals since 1601-01-01.
+        const uint64_t fileTime = (static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+        outStat.modifiedTime = static_cast<int64_t>(fileTime / 10000000ULL) - 11644473600LL;
+        return true;
+    }
+
+    int64_t ReadAt(NativeFileHandle handle, void *buffer, int64_t size, int64_t offset)
+    {
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+        DWORD readSize = 0;
+        if (!::ReadFile(handle, buffer, static_cast<DWORD>(size), &readSize, &overlapped))
+        {
+            return ::GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+        }
+        return readSize;
+    }
+
+    int64_t WriteAt(NativeFileHandle handle, const void *buffer, int64_t size, int64_t offset)
+    {
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+        DWORD writtenSize = 0;
+        if (!::WriteFile(handle, buffer, static_cast<DWORD>(size), &writtenSize, &overlapped))
+            return -1;
+        return writtenSize;
+    }
+
+    int64_t WriteGatherAt(NativeFileHandle handle, const FileIOBufferSpan *spans, uint32_t numSpans, int64_t offset)
+    {
+        // WriteFileGather requires page sized unbuffered buffers, write spans one by one instead.
+        int64_t totalWritten = 0;
+        for (uint32_t i = 0; i < numSpans; ++i)
+        {
+            const int64_t result = WriteAt(handle, spans[i].buffer, static_cast<int64_t>(spans[i].size), offset + totalWritten);
+            if (result < 0)
+                return totalWritten > 0 ? totalWritten : -1;
+            totalWritten += result;
+            if (result < static_cast<int64_t>(spans[i].size))
+                break;
+        }
+        return totalWritten;
+    }
+
+    bool Sync(NativeFileHandle handle, EFileSyncMode)
+    {
+        return ::FlushFileBuffers(handle);
+    }
+
+    const void* MapReadOnly(NativeFileHandle handle, size_t size)
+    {
+        HANDLE mapping = ::CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+            return nullptr;
+        const void *ptr = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+        // The view keeps mapping object alive.
+        ::CloseHandle(mapping);
+        return ptr;
+    }
+
+    void Unmap(const void *mappedPtr, size_t)
+    {
+        ::UnmapViewOfFile(mappedPtr);
+    }
+
+    void AdviseMapped(const void *mappedPtr, size_t offset, size_t size, EMappedFileAccessHint hint)
+    {
+        // Windows has no access pattern hints for views, only prefetch.
+        if (hint != EMappedFileAccessHint::WillNeed)
+            return;
+        WIN32_MEMORY_RANGE_ENTRY range;
+        range.VirtualAddress = const_cast<uint8_t*>(static_cast<const uint8_t*>(mappedPtr) + offset);
+        range.NumberOfBytes = size;
+        ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+    }
+
+    size_t GetPageSize()
+    {
+        SYSTEM_INFO info;
+        ::GetSystemInfo(&info);
+        return info.dwPageSize;
+    }
+#else
+    NativeFileHandle Open(const std::string &path, EOpenFileModes openMode)
+    {
+        int flags = O_CLOEXEC;
+        const bool bRead = openMode & EFileOpenMode::OpenFileForRead;
+        const bool bWrite = openMode & EFileOpenMode::OpenFileForWrite;
+        if (bRead && bWrite)
+            flags |= O_RDWR;
+        else if (bWrite)
+            flags |= O_WRONLY;
+        else
+            flags |= O_RDONLY;
+
+        if (bWrite)
+        {
+            flags |= O_CREAT;
+            flags |= (openMode & EFileOpenMode::OpenFileAtAppend) ? O_APPEND : O_TRUNC;
+        }
+
+        const bool bUnbuffered = (openMode & EFileOpenMode::OpenFileUnbuffered) && !bWrite;
+#ifdef O_DIRECT
+        if (bUnbuffered)
+            flags |= O_DIRECT;
+#endif
+
+        int fd;
+        do
+        {
+            fd = ::open(path.c_str(), flags, 0644);
+        } while (fd < 0 && errno == EINTR);
+
+        if (fd < 0)
+            return InvalidNativeFileHandle;
+
+#ifdef F_NOCACHE
+        // macOS has no O_DIRECT, turn off caching per descriptor instead.
+        if (bUnbuffered)
+            ::fcntl(fd, F_NOCACHE, 1);
+#endif
+        return fd;
+    }
+
+    void Close(NativeFileHandle handle)
+    {
+        if (handle != InvalidNativeFileHandle)
+            ::close(handle);
+    }
+
+    int64_t GetFileSize(NativeFileHandle handle)
+    {
+        struct stat st{};
+        if (::fstat(handle, &st) != 0)
+            return -1;
+        return st.st_size;
+    }
+
+    bool Stat(const std::string &path, FileStat &outStat)
+    {
+        outStat = FileStat{};
+        struct stat st{};
+        int result;
+        do
+        {
+            result = ::stat(path.c_str(), &st);
+        } while (result != 0 && errno == EINTR);
+
+        if (result != 0)
+            return false;
+
+        outStat.bExists = true;
+        outStat.bIsDirectory = S_ISDIR(st.st_mode);
+        outStat.size = st.st_size;
+        outStat.modifiedTime = st.st_mtime;
+        return true;
+    }
+
+    int64_t ReadAt(NativeFileHandle handle, void *buffer, int64_t size, int64_t offset)
+    {
+        ssize_t result;
+        do
+        {
+            result = ::pread(handle, buffer, size, offset);
+        } while (result < 0 && errno == EINTR);
+        return result;
+    }
+
+    int64_t WriteAt(NativeFileHandle handle, const void *buffer, int64_t size, int64_t offset)
+    {
+        ssize_t result;
+        do
+        {
+            result = ::pwrite(handle, buffer, size, offset);
+        } while (result < 0 && errno == EINTR);
+        return result;
+    }
+
+    int64_t WriteGatherAt(NativeFileHandle handle, const FileIOBufferSpan *spans, uint32_t numSpans, int64_t offset)
+    {
+        static_assert(sizeof(FileIOBufferSpan) == sizeof(iovec) && offsetof(FileIOBufferSpan, size) == offsetof(iovec, iov_len));
+        ssize_t result;
+        do
+        {
+            result = ::pwritev(handle, reinterpret_cast<const iovec*>(spans), static_cast<int>(std::min(numSpans, MaxGatherSpansPerRequest)), offset);
+        } while (result < 0 && errno == EINTR);
+        return result;
+    }
+
+    bool Sync(NativeFileHandle handle, EFileSyncMode syncMode)
+    {
+        int result;
+        do
+        {
+#if defined(__APPLE__)
+            // No fdatasync on macOS.
+            (void)syncMode;
+            result = ::fsync(handle);
+#else
+            result = syncMode == EFileSyncMode::Data ? ::fdatasync(handle) : ::fsync(handle);
+#endif
+        } while (result != 0 && errno == EINTR);
+        return result == 0;
+    }
+
+    const void* MapReadOnly(NativeFileHandle handle, size_t size)
+    {
+        void *ptr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, handle, 0);
+        return ptr == MAP_FAILED ? nullptr : ptr;
+    }
+
+    void Unmap(const void *mappedPtr, size_t size)
+    {
+        ::munmap(const_cast<void*>(mappedPtr), size);
+    }
+
+    void AdviseMapped(const void *mappedPtr, size_t offset, size_t size, EMappedFileAccessHint hint)
+    {
+        int advice = MADV_NORMAL;
+        switch (hint)
+        {
+        case EMappedFileAccessHint::Sequential:
+            advice = MADV_SEQUENTIAL;
+            break;
+        case EMappedFileAccessHint::Random:
+            advice = MADV_RANDOM;
+            break;
+        case EMappedFileAccessHint::WillNeed:
+            advice = MADV_WILLNEED;
+            break;
+        default: break;
+        }
+
+        // madvise requires page aligned address.
+        const size_t pageSize = GetPageSize();
+        const size_t alignedOffset = offset / pageSize * pageSize;
+        auto start = const_cast<uint8_t*>(static_cast<const uint8_t*>(mappedPtr)) + alignedOffset;
+        ::madvise(start, size + offset - alignedOffset, advice);
+    }
+
+    size_t GetPageSize()
+    {
+        static const size_t pageSize = ::sysconf(_SC_PAGESIZE);
+        return pageSize;
+    }
+#endif
+}
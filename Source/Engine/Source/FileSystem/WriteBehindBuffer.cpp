@@ -0,0 +1,155 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "FileSystem/WriteBehindBuffer.h"
+
+#include <cstring>
+
+#include "FileSystem/FileIOManager.h"
+
+namespace Koala::FileIO
+{
+    // Appends smaller than this are copied into shared chunks of this size.
+    constexpr size_t WriteBehindChunkSize = 64 * 1024;
+
+    WriteBehindBuffer::~WriteBehindBuffer()
+    {
+        std::lock_guard lock(mutex);
+        FlushLocked(nullptr, EFileIOCompletionMode::IOThread);
+    }
+
+    void WriteBehindBuffer::Append(const void *data, size_t size)
+    {
+        if (size == 0)
+            return;
+
+        std::lock_guard lock(mutex);
+        if (pendingSize == 0)
+            firstPendingTime = FileIOClock::now();
+
+        if (size >= WriteBehindChunkSize)
+        {
+            chunks.emplace_back(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+        }
+        else
+        {
+            if (chunks.empty() || chunks.back().capacity() != WriteBehindChunkSize || chunks.back().size() + size > WriteBehindChunkSize)
+            {
+                chunks.emplace_back();
+                chunks.back().reserve(WriteBehindChunkSize);
+            }
+            std::vector<uint8_t> &chunk = chunks.back();
+            chunk.insert(chunk.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+        }
+
+        pendingSize += size;
+        if (pendingSize >= flushSize)
+            FlushLocked(nullptr, EFileIOCompletionMode::IOThread);
+    }
+
+    void WriteBehindBuffer::Append(std::vector<uint8_t> &&data)
+    {
+        if (data.empty())
+            return;
+
+        std::lock_guard lock(mutex);
+        if (pendingSize == 0)
+            firstPendingTime = FileIOClock::now();
+
+        pendingSize += data.size();
+        chunks.push_back(std::move(data));
+        if (pendingSize >= flushSize)
+            FlushLocked(nullptr, EFileIOCompletionMode::IOThread);
+    }
+
+    void WriteBehindBuffer::Flush(FileIOCallback callback, EFileIOCompletionMode completionMode)
+    {
+        {
+            std::lock_guard lock(mutex);
+            if (pendingSize > 0)
+            {
+                FlushLocked(std::move(callback), completionMode);
+                return;
+            }
+        }
+
+        // Nothing to write. Completed outside of lock, IOThread callbacks run right here and may append again.
+        if (callback)
+        {
+            FileIOCompletion completion;
+            completion.callback = std::move(callback);
+            completion.completionMode = completionMode;
+            completion.bOK = true;
+            FileIOManager::Get().DeliverCompletion(std::move(completion));
+        }
+    }
+
+    void WriteBehindBuffer::FlushAndSync(EFileSyncMode syncMode, FileIOCallback callback, EFileIOCompletionMode completionMode)
+    {
+        // Both are queued under lock, so no later flush can get between them.
+        std::lock_guard lock(mutex);
+        FlushLocked(nullptr, EFileIOCompletionMode::IOThread);
+        FileIOManager::Get().RequestSyncFileAsync(handle, syncMode, std::move(callback), completionMode);
+    }
+
+    void WriteBehindBuffer::FlushIfDue(FileIOClock::time_point now)
+    {
+        std::lock_guard lock(mutex);
+        if (pendingSize > 0 && now - firstPendingTime >= flushInterval)
+            FlushLocked(nullptr, EFileIOCompletionMode::IOThread);
+    }
+
+    size_t WriteBehindBuffer::GetPendingSize() const
+    {
+        std::lock_guard lock(mutex);
+        return pendingSize;
+    }
+
+    size_t WriteBehindBuffer::GetOffset() const
+    {
+        std::lock_guard lock(mutex);
+        return offset + pendingSize;
+    }
+
+    void WriteBehindBuffer::FlushLocked(FileIOCallback callback, EFileIOCompletionMode completionMode)
+    {
+        if (pendingSize == 0)
+            return;
+
+        // Chunks are kept alive by the request, buffer can take new appends right away.
+        auto flushedChunks = std::make_shared<std::vector<std::vector<uint8_t>>>(std::move(chunks));
+        chunks.clear();
+
+        std::vector<FileIOBufferSpan> spans;
+        spans.reserve(flushedChunks->size());
+        for (auto &chunk: *flushedChunks)
+        {
+            spans.push_back({chunk.data(), chunk.size()});
+        }
+
+        FileIOManager::Get().RequestWriteGatherAsync(handle, offset, std::move(spans),
+            [flushedChunks, callback = std::move(callback)](bool bOk, int64_t size, const void *buffer)
+            {
+                if (callback)
+                    callback(bOk, size, buffer);
+            }, completionMode);
+
+        offset += pendingSize;
+        pendingSize = 0;
+    }
+}
@@ -18,10 +18,20 @@
 
 #include "Game/Components/MeshComponent.h"
 
+#include "Game/ECS/EntityWorld.h"
+
 namespace Koala
 {
-    void MeshComponent::DoLoad()
+    void LoadMeshComponents(EntityWorld &world)
     {
-        
+        world.ForEach<MeshComponent>([](MeshComponent &component)
+        {
+            if (!component.meshes.empty())
+                return;
+            for (const HashedString &path: component.meshPaths)
+            {
+                component.meshes.push_back(AssetManager::Get().LoadAsync<MeshAsset>(path));
+            }
+        });
     }
 }
@@ -0,0 +1,141 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Game/ECS/Archetype.h"
+
+#include <cstring>
+
+#include "Core/Check.h"
+#include "Memory/Allocator.h"
+
+namespace Koala
+{
+    static FORCEINLINE uint32_t AlignOffset(uint32_t offset, uint32_t alignment)
+    {
+        return (offset + alignment - 1) & ~(alignment - 1);
+    }
+
+    Archetype::Archetype(const ComponentMask &inMask)
+        : mask(inMask)
+    {
+        uint32_t entitySize = sizeof(Entity);
+        uint32_t maxPadding = 0;
+        for (ComponentTypeId typeId = 0; typeId < MaxComponentTypes; ++typeId)
+        {
+            if (!mask.test(typeId))
+                continue;
+            const ComponentTypeInfo &info = ComponentTypeRegistry::GetInfo(typeId);
+            check(info.alignment <= ArchetypeChunkAlignment, "Component alignment exceeds chunk alignment");
+            componentColumns[typeId] = static_cast<uint16_t>(componentTypes.size());
+            componentTypes.push_back(typeId);
+            entitySize += info.size;
+            maxPadding += info.size != 0 ? info.alignment - 1 : 0;
+        }
+        chunkCapacity = (ArchetypeChunkSize - maxPadding) / entitySize;
+        ensure(chunkCapacity > 0, "Components of archetype do not fit into chunk");
+
+        // Empty components have no array, they all point at start of chunk.
+        uint32_t offset = sizeof(Entity) * chunkCapacity;
+        for (ComponentTypeId typeId : componentTypes)
+        {
+            const ComponentTypeInfo &info = ComponentTypeRegistry::GetInfo(typeId);
+            if (info.size == 0)
+            {
+                componentOffsets.push_back(0);
+                continue;
+            }
+            offset = AlignOffset(offset, info.alignment);
+            componentOffsets.push_back(offset);
+            offset += info.size * chunkCapacity;
+        }
+        check(offset <= ArchetypeChunkSize);
+    }
+
+    Archetype::~Archetype()
+    {
+        for (Chunk &chunk : chunks)
+        {
+            for (uint32_t column = 0; column < componentTypes.size(); ++column)
+            {
+                const ComponentTypeInfo &info = ComponentTypeRegistry::GetInfo(componentTypes[column]);
+                if (info.bTrivial || info.size == 0)
+                    continue;
+                for (uint32_t row = 0; row < chunk.numEntities; ++row)
+                    info.destruct(chunk.data + componentOffsets[column] + static_cast<size_t>(row) * info.size);
+            }
+            MemoryAllocator::Get().FreeAligned(chunk.data);
+        }
+    }
+
+    EntityLocation Archetype::Allocate(Entity entity)
+    {
+        if (chunks.empty() || chunks.back().numEntities == chunkCapacity)
+        {
+            Chunk chunk;
+            chunk.data = static_cast<uint8_t*>(MemoryAllocator::Get().MallocAligned(ArchetypeChunkSize, ArchetypeChunkAlignment));
+            chunks.push_back(chunk);
+        }
+        Chunk &chunk = chunks.back();
+        const EntityLocation location{this, static_cast<uint32_t>(chunks.size() - 1), chunk.numEntities++};
+        GetEntityArray(location.chunk)[location.row] = entity;
+        ++numEntities;
+        return location;
+    }
+
+    Entity Archetype::Remove(const EntityLocation &location)
+    {
+        Chunk &chunk = chunks[location.chunk];
+        Chunk &lastChunk = chunks.back();
+        const uint32_t lastRow = lastChunk.numEntities - 1;
+        const bool bMoveLast = location.chunk != chunks.size() - 1 || location.row != lastRow;
+        for (uint32_t column = 0; column < componentTypes.size(); ++column)
+        {
+            const ComponentTypeInfo &info = ComponentTypeRegistry::GetInfo(componentTypes[column]);
+            if (info.size == 0)
+                continue;
+            uint8_t *component = chunk.data + componentOffsets[column] + static_cast<size_t>(location.row) * info.size;
+            uint8_t *lastComponent = lastChunk.data + componentOffsets[column] + static_cast<size_t>(lastRow) * info.size;
+            if (info.bTrivial)
+            {
+                if (bMoveLast)
+                    std::memcpy(component, lastComponent, info.size);
+                continue;
+            }
+            info.destruct(component);
+            if (bMoveLast)
+            {
+                info.moveConstruct(component, lastComponent);
+                info.destruct(lastComponent);
+            }
+        }
+
+        Entity movedEntity;
+        if (bMoveLast)
+        {
+            movedEntity = GetEntityArray(static_cast<uint32_t>(chunks.size() - 1))[lastRow];
+            GetEntityArray(location.chunk)[location.row] = movedEntity;
+        }
+        --numEntities;
+        if (--lastChunk.numEntities == 0)
+        {
+            MemoryAllocator::Get().FreeAligned(lastChunk.data);
+            chunks.pop_back();
+        }
+        return movedEntity;
+    }
+}
@@ -0,0 +1,52 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Game/ECS/ComponentType.h"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+
+#include "Core/Check.h"
+
+namespace Koala
+{
+    static std::mutex componentTypeMutex;
+    static std::array<ComponentTypeInfo, MaxComponentTypes> componentTypeInfos;
+    static std::atomic<uint32_t> numComponentTypes{0};
+
+    ComponentTypeId ComponentTypeRegistry::Register(const ComponentTypeInfo &info)
+    {
+        std::lock_guard lock(componentTypeMutex);
+        const uint32_t typeId = numComponentTypes.load(std::memory_order_relaxed);
+        ensure(typeId < MaxComponentTypes, "Too many component types");
+        componentTypeInfos[typeId] = info;
+        numComponentTypes.store(typeId + 1, std::memory_order_release);
+        return typeId;
+    }
+
+    const ComponentTypeInfo& ComponentTypeRegistry::GetInfo(ComponentTypeId typeId)
+    {
+        return componentTypeInfos[typeId];
+    }
+
+    uint32_t ComponentTypeRegistry::GetNumTypes()
+    {
+        return numComponentTypes.load(std::memory_order_acquire);
+    }
+}
@@ -0,0 +1,144 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Game/ECS/EntityWorld.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "AsyncWorker/AsyncTask.h"
+
+namespace Koala
+{
+    // Queries over fewer entities run on calling thread.
+    constexpr size_t MinEntitiesForParallelQuery = 4096;
+
+    Archetype* EntityWorld::GetOrCreateArchetype(const ComponentMask &mask)
+    {
+        auto found = archetypeMap.find(mask);
+        if (found != archetypeMap.end())
+            return found->second;
+        archetypes.push_back(std::make_unique<Archetype>(mask));
+        archetypeMap.emplace(mask, archetypes.back().get());
+        return archetypes.back().get();
+    }
+
+    Archetype* EntityWorld::GetArchetypeWith(Archetype *archetype, ComponentTypeId typeId)
+    {
+        auto found = archetype->addEdges.find(typeId);
+        if (found != archetype->addEdges.end())
+            return found->second;
+        Archetype *target = GetOrCreateArchetype(ComponentMask(archetype->GetMask()).set(typeId));
+        archetype->addEdges.emplace(typeId, target);
+        target->removeEdges.emplace(typeId, archetype);
+        return target;
+    }
+
+    Archetype* EntityWorld::GetArchetypeWithout(Archetype *archetype, ComponentTypeId typeId)
+    {
+        auto found = archetype->removeEdges.find(typeId);
+        if (found != archetype->removeEdges.end())
+            return found->second;
+        Archetype *target = GetOrCreateArchetype(ComponentMask(archetype->GetMask()).reset(typeId));
+        archetype->removeEdges.emplace(typeId, target);
+        target->addEdges.emplace(typeId, archetype);
+        return target;
+    }
+
+    Entity EntityWorld::AllocateEntity(Archetype *archetype)
+    {
+        Entity entity;
+        if (!freeIndices.empty())
+        {
+            entity.index = freeIndices.back();
+            freeIndices.pop_back();
+        }
+        else
+        {
+            entity.index = static_cast<uint32_t>(records.size());
+            records.emplace_back();
+        }
+        entity.generation = records[entity.index].generation;
+        records[entity.index].location = archetype->Allocate(entity);
+        ++numEntities;
+        return entity;
+    }
+
+    void EntityWorld::RemoveFromArchetype(const EntityLocation &location)
+    {
+        const Entity movedEntity = location.archetype->Remove(location);
+        if (movedEntity.IsValid())
+            records[movedEntity.index].location = location;
+    }
+
+    EntityLocation EntityWorld::MoveEntity(Entity entity, Archetype *target)
+    {
+        const EntityLocation source = records[entity.index].location;
+        const EntityLocation location = target->Allocate(entity);
+        for (ComponentTypeId typeId : source.archetype->GetComponentTypes())
+        {
+            const ComponentTypeInfo &info = ComponentTypeRegistry::GetInfo(typeId);
+            if (info.size == 0 || !target->HasComponent(typeId))
+                continue;
+            void *sourceComponent = source.archetype->GetComponent(source, typeId);
+            void *targetComponent = target->GetComponent(location, typeId);
+            if (info.bTrivial)
+                std::memcpy(targetComponent, sourceComponent, info.size);
+            else
+                info.moveConstruct(targetComponent, sourceComponent);
+        }
+        // Moved from components are destructed along with the ones target does not have.
+        RemoveFromArchetype(source);
+        records[entity.index].location = location;
+        return location;
+    }
+
+    void EntityWorld::DestroyEntity(Entity entity)
+    {
+        if (!IsAlive(entity))
+            return;
+        EntityRecord &record = records[entity.index];
+        RemoveFromArchetype(record.location);
+        record.location = {};
+        // Skip 0, which marks invalid handles.
+        record.generation = record.generation == UINT32_MAX ? 1 : record.generation + 1;
+        freeIndices.push_back(entity.index);
+        --numEntities;
+    }
+
+    void EntityWorld::Clear()
+    {
+        for (uint32_t index = 0; index < records.size(); ++index)
+        {
+            EntityRecord &record = records[index];
+            if (record.location.archetype != nullptr)
+                DestroyEntity({index, record.generation});
+        }
+    }
+
+    bool EntityWorld::IsAlive(Entity entity) const
+    {
+        return entity.IsValid() && entity.index < records.size() && records[entity.index].generation == entity.generation &&
+            records[entity.index].location.archetype != nullptr;
+    }
+
+    void EntityWorld::ForEachChunkRange(size_t numChunks, size_t numEntities, const std::function<void(size_t, size_t)> &rangeFunction)
+    {
+        ParallelForRanges(numChunks, numEntities >= MinEntitiesForParallelQuery, rangeFunction);
+    }
+}
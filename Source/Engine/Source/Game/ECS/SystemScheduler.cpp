@@ -0,0 +1,151 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Game/ECS/SystemScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "CPUProfiler.h"
+#include "RGBAColor.h"
+#include "AsyncWorker/AsyncTask.h"
+#include "Core/ThreadManager.h"
+
+namespace Koala
+{
+    SystemId SystemScheduler::AddSystem(SystemDesc desc)
+    {
+        SystemState &system = systems.emplace_back();
+        system.desc = std::move(desc);
+        return static_cast<SystemId>(systems.size() - 1);
+    }
+
+    void SystemScheduler::SetSystemEnabled(SystemId system, bool bEnabled)
+    {
+        systems[system].bEnabled = bEnabled;
+    }
+
+    void SystemScheduler::RunSystem(SystemState &system, EntityWorld &world, float deltaTime)
+    {
+        SCOPED_CPU_MARKER(Colors::Yellow, system.desc.name.c_str())
+        const auto startTime = std::chrono::steady_clock::now();
+        system.desc.update(world, deltaTime);
+        system.lastTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    void SystemScheduler::FinishSystem(uint32_t system)
+    {
+        --numUnfinishedSystems;
+        for (uint32_t dependent : systems[system].dependents)
+        {
+            if (--systems[dependent].numPendingDependencies == 0)
+                readySystems.push_back(dependent);
+        }
+    }
+
+    void SystemScheduler::Run(EntityWorld &world, float deltaTime)
+    {
+        SCOPED_CPU_MARKER(Colors::Yellow, "SystemScheduler::Run")
+        std::vector<uint32_t> enabledSystems;
+        for (uint32_t index = 0; index < systems.size(); ++index)
+        {
+            if (!systems[index].bEnabled)
+                continue;
+            enabledSystems.push_back(index);
+            systems[index].dependents.clear();
+            systems[index].numPendingDependencies = 0;
+        }
+        if (enabledSystems.size() < 2 || AsyncWorker::WorkDispatcher::Get().GetNumWorkerThreads() == 0 ||
+            ThreadTLS::threadType == EThreadType::WorkerThread)
+        {
+            for (uint32_t system : enabledSystems)
+                RunSystem(systems[system], world, deltaTime);
+            return;
+        }
+
+        // Each system waits for earlier ones it conflicts with. Systems are few, comparing all pairs is cheap.
+        for (size_t later = 1; later < enabledSystems.size(); ++later)
+        {
+            SystemState &laterSystem = systems[enabledSystems[later]];
+            for (size_t earlier = 0; earlier < later; ++earlier)
+            {
+                SystemState &earlierSystem = systems[enabledSystems[earlier]];
+                if (earlierSystem.desc.access.ConflictsWith(laterSystem.desc.access))
+                {
+                    earlierSystem.dependents.push_back(enabledSystems[later]);
+                    ++laterSystem.numPendingDependencies;
+                }
+            }
+        }
+
+        std::unique_lock lock(mutex);
+        readySystems.clear();
+        for (uint32_t system : enabledSystems)
+        {
+            if (systems[system].numPendingDependencies == 0)
+                readySystems.push_back(system);
+        }
+        numUnfinishedSystems = static_cast<uint32_t>(enabledSystems.size());
+        while (numUnfinishedSystems > 0)
+        {
+            // Calling thread keeps one ready system, one that has to run here if any, otherwise the earliest added,
+            // which tends to have most systems waiting for it. The rest go to workers.
+            std::sort(readySystems.begin(), readySystems.end());
+            auto localSystem = std::find_if(readySystems.begin(), readySystems.end(), [this](uint32_t system)
+            {
+                return systems[system].desc.bCallingThread;
+            });
+            if (localSystem == readySystems.end() && !readySystems.empty())
+                localSystem = readySystems.begin();
+            const int64_t localIndex = localSystem != readySystems.end() ? static_cast<int64_t>(*localSystem) : -1;
+
+            std::vector<uint32_t> waitingSystems;
+            for (uint32_t system : readySystems)
+            {
+                if (system == localIndex)
+                    continue;
+                if (systems[system].desc.bCallingThread)
+                {
+                    waitingSystems.push_back(system);
+                    continue;
+                }
+                AsyncTask([this, system, &world, deltaTime](void*)
+                {
+                    RunSystem(systems[system], world, deltaTime);
+                    std::lock_guard workerLock(mutex);
+                    FinishSystem(system);
+                    systemFinished.notify_one();
+                });
+            }
+            readySystems = std::move(waitingSystems);
+
+            if (localIndex >= 0)
+            {
+                const uint32_t system = static_cast<uint32_t>(localIndex);
+                lock.unlock();
+                RunSystem(systems[system], world, deltaTime);
+                lock.lock();
+                FinishSystem(system);
+            }
+            else
+            {
+                systemFinished.wait(lock, [this]() { return !readySystems.empty() || numUnfinishedSystems == 0; });
+            }
+        }
+    }
+}
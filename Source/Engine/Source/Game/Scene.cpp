@@ -15,19 +15,20 @@
 //OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
 //WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
 //CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
-#pragma once
-#include <memory>
-#include <vector>
+
+#include "Game/Scene.h"
+
+#include "Game/Components/MeshComponent.h"
 
 namespace Koala
 {
-    class Component
+    void Scene::Load()
+    {
+        LoadMeshComponents(world);
+    }
+
+    void Scene::Update(float deltaTime)
     {
-    public:
-        virtual ~Component() = default;
-        virtual void PreLoad() = 0;
-        virtual void DoLoad() = 0;
-        virtual void PostLoad() = 0;
-        std::vector<std::shared_ptr<Component>> subComponents;
-    };
+        scheduler.Run(world, deltaTime);
+    }
 }
@@ -24,6 +24,9 @@
 #include "EngineVersion.h"
 #include "RenderThread.h"
 #include "Core/ThreadManager.h"
+#include "Asset/AssetManager.h"
+#include "Asset/DerivedDataCache.h"
+#include "Asset/TextureResidencyManager.h"
 #include "AsyncWorker/AsyncTask.h"
 #include "FileSystem/FileIOManager.h"
 
@@ -80,6 +83,9 @@ namespace Koala
         Logger loggerEngineInit("EngineInitialize");
 
         FileIO::FileIOManager::Get().Initialize_MainThread();
+        AssetManager::Get().Initialize_MainThread();
+        DerivedDataCache::Get().Initialize_MainThread();
+        TextureResidencyManager::Get().Initialize_MainThread();
 
         Scripting::Initialize();
 
@@ -150,6 +156,8 @@ namespace Koala
         RenderThread::Get().Tick_MainThread(deltaTime);
         AsyncWorker::WorkDispatcher::Get().Tick_MainThread(deltaTime);
         FileIO::FileIOManager::Get().Tick_MainThread(deltaTime);
+        AssetManager::Get().Tick_MainThread(deltaTime);
+        TextureResidencyManager::Get().Tick_MainThread(deltaTime);
         // TODO: remove this sleep
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
 
@@ -162,6 +170,10 @@ namespace Koala
         RenderThread::Get().WaitForRTStop();
         RenderThread::Get().Shutdown_MainThread();
         ModuleManager::Get().ShutdownModules();
+        // Loads in flight need workers and I/O.
+        TextureResidencyManager::Get().Shutdown_MainThread();
+        AssetManager::Get().Shutdown_MainThread();
+        DerivedDataCache::Get().Shutdown_MainThread();
         AsyncWorker::WorkDispatcher::Get().Shutdown_MainThread();
         Config::Get().Shutdown_MainThread();
         Scripting::Shutdown();
@@ -0,0 +1,70 @@
+//Copyright 2024 Li Xingru
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+//associated documentation files (the “Software”), to deal in the Software without restriction,
+//including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do
+//so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in all copies or substantial
+//portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+//FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+//OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Renderer/MeshLODSelection.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "ConsoleVariable.h"
+
+namespace Koala::Renderer
+{
+    static TConsoleVariable<int32_t> CVarMeshLODBias("r.meshlod.bias", 0,
+        "Shift mesh LOD selection by this many LODs, positive values pick coarser LODs.");
+    static TConsoleVariable<int32_t> CVarMeshLODForce("r.meshlod.force", -1,
+        "Draw all meshes with this LOD (clamped to their chains), negative to select by screen size.");
+
+    float ComputeScreenSize(const Camera &camera, const Vec3f &center, float radius)
+    {
+        if (camera.cameraMode == ECameraMode::OrthographicCamera)
+        {
+            const float viewHeight = std::abs(camera.top - camera.bottom);
+            return viewHeight > 0 ? 2.0f * radius / viewHeight : 1.0f;
+        }
+
+        // Diameter over view height at sphere distance, 2 * distance * tan(fov / 2).
+        const float distance = (center - camera.position).norm();
+        if (distance <= radius)
+            return 1.0f;
+        const float halfHeight = distance * std::tan(camera.fov * 0.5f);
+        return halfHeight > 0 ? radius / halfHeight : 1.0f;
+    }
+
+    uint32_t SelectMeshLOD(const MeshAsset &mesh, float screenSize)
+    {
+        const int32_t numLODs = static_cast<int32_t>(mesh.GetNumLODs());
+        const int32_t forcedLOD = CVarMeshLODForce.Get();
+        if (forcedLOD >= 0)
+            return static_cast<uint32_t>(std::min(forcedLOD, numLODs - 1));
+
+        // Thresholds shrink along the chain.
+        int32_t lodIndex = 0;
+        while (lodIndex + 1 < numLODs && screenSize <= mesh.GetLOD(lodIndex + 1).screenSize)
+        {
+            ++lodIndex;
+        }
+        return static_cast<uint32_t>(std::clamp(lodIndex + CVarMeshLODBias.Get(), 0, numLODs - 1));
+    }
+
+    uint32_t SelectMeshLOD(const MeshAsset &mesh, const Camera &camera, const Vec3f &translation, float scale)
+    {
+        const BoundingSphere &bounds = mesh.GetBounds();
+        return SelectMeshLOD(mesh, ComputeScreenSize(camera, bounds.center * scale + translation, bounds.radius * scale));
+    }
+}
@@ -0,0 +1,128 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Game/ECS/EntityWorld.h"
+
+using namespace Koala;
+
+namespace
+{
+    struct Position
+    {
+        float x{0}, y{0}, z{0};
+    };
+
+    struct Velocity
+    {
+        float x{0}, y{0}, z{0};
+    };
+
+    struct Name
+    {
+        std::string value;
+    };
+
+    // Counts live instances, to check archetypes construct and destruct each component exactly once.
+    struct Tracked
+    {
+        static inline int numAlive = 0;
+        std::unique_ptr<int> value;
+
+        Tracked() { ++numAlive; }
+        explicit Tracked(int inValue) : value(std::make_unique<int>(inValue)) { ++numAlive; }
+        Tracked(Tracked &&other) noexcept : value(std::move(other.value)) { ++numAlive; }
+        Tracked& operator=(Tracked &&other) noexcept = default;
+        ~Tracked() { --numAlive; }
+    };
+
+    struct PlayerTag {};
+    struct EnemyTag {};
+}
+
+TEST_CASE("Archetype with tag component destructs its entities", "[ECS]")
+{
+    {
+        Archetype archetype(MakeComponentMask<PlayerTag, Position, Tracked>());
+        const EntityLocation location = archetype.Allocate({0, 1});
+        new (archetype.GetComponent(location, GetComponentTypeId<Position>())) Position{};
+        new (archetype.GetComponent(location, GetComponentTypeId<Tracked>())) Tracked(1);
+        REQUIRE(Tracked::numAlive == 1);
+    }
+    CHECK(Tracked::numAlive == 0);
+}
+
+TEST_CASE("Entities move between archetypes as components are added and removed", "[ECS]")
+{
+    EntityWorld world;
+    const Entity entity = world.CreateEntity(Position{1, 2, 3}, Name{"first"});
+    REQUIRE(world.IsAlive(entity));
+    CHECK(world.HasComponent<Position>(entity));
+    CHECK_FALSE(world.HasComponent<Velocity>(entity));
+
+    world.AddComponent(entity, Velocity{4, 5, 6});
+    world.AddComponent(entity, PlayerTag{});
+    REQUIRE(world.HasComponent<Velocity>(entity));
+    CHECK(world.HasComponent<PlayerTag>(entity));
+    // Adding a tag again is a no-op.
+    world.AddComponent(entity, PlayerTag{});
+    CHECK(world.HasComponent<PlayerTag>(entity));
+    CHECK(world.GetComponent<Position>(entity)->y == 2);
+    CHECK(world.GetComponent<Velocity>(entity)->z == 6);
+    CHECK(world.GetComponent<Name>(entity)->value == "first");
+
+    // Assigning existing component does not move entity.
+    world.AddComponent(entity, Position{7, 8, 9});
+    CHECK(world.GetComponent<Position>(entity)->x == 7);
+
+    world.RemoveComponent<Position>(entity);
+    world.RemoveComponent<PlayerTag>(entity);
+    CHECK_FALSE(world.HasComponent<Position>(entity));
+    CHECK_FALSE(world.HasComponent<PlayerTag>(entity));
+    CHECK(world.GetComponent<Position>(entity) == nullptr);
+    CHECK(world.GetComponent<Name>(entity)->value == "first");
+    CHECK(world.GetComponent<Velocity>(entity)->x == 4);
+
+    world.DestroyEntity(entity);
+    CHECK_FALSE(world.IsAlive(entity));
+    CHECK(world.GetNumEntities() == 0);
+}
+
+TEST_CASE("Removing entity moves last one into its place", "[ECS]")
+{
+    EntityWorld world;
+    std::vector<Entity> entities;
+    for (int index = 0; index < 1000; ++index)
+        entities.push_back(world.CreateEntity(Tracked(index), EnemyTag{}));
+    REQUIRE(Tracked::numAlive == 1000);
+
+    for (size_t index = 0; index < entities.size(); index += 3)
+        world.DestroyEntity(entities[index]);
+    CHECK(Tracked::numAlive == static_cast<int>(world.GetNumEntities()));
+
+    for (size_t index = 0; index < entities.size(); ++index)
+    {
+        if (index % 3 == 0)
+        {
+            CHECK_FALSE(world.IsAlive(entities[index]));
+            continue;
+        }
+        REQUIRE(world.IsAlive(entities[index]));
+        CHECK(*world.GetComponent<Tracked>(entities[index])->value == static_cast<int>(index));
+    }
+
+    // Handle of destroyed entity stays invalid when its index is reused.
+    const Entity reused = world.CreateEntity(Tracked(-1));
+    CHECK(reused.index == entities[999].index);
+    CHECK_FALSE(world.IsAlive(entities[999]));
+
+    size_t numTagged = 0;
+    world.ForEach<const Tracked, EnemyTag>([&numTagged](const Tracked&, EnemyTag&) { ++numTagged; });
+    CHECK(numTagged == world.GetNumEntities() - 1);
+
+    world.Clear();
+    CHECK(world.GetNumEntities() == 0);
+    CHECK(Tracked::numAlive == 0);
+}
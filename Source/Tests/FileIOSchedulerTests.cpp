@@ -0,0 +1,90 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+
+#include "FileSystem/FileIOScheduler.h"
+
+using namespace Koala::FileIO;
+
+namespace
+{
+    FileIOTask MakeTask(int64_t offset, EFilePriority priority, FileIOClock::time_point deadline = FileIOClock::time_point::max())
+    {
+        FileIOTask task;
+        task.offset = offset;
+        task.remainingSize = FileIOBlockSize;
+        task.bufferStart = nullptr;
+        task.priority = priority;
+        task.deadline = deadline;
+        return task;
+    }
+
+    std::vector<int64_t> PopOffsets(FileIOScheduler &scheduler, size_t maxCount)
+    {
+        std::vector<FileIOTask> tasks;
+        scheduler.Pop(tasks, maxCount);
+        std::vector<int64_t> offsets;
+        for (const FileIOTask &task: tasks)
+            offsets.push_back(task.offset);
+        return offsets;
+    }
+}
+
+TEST_CASE("Scheduler hands out urgent tasks first, then by priority and submission order", "[FileIO]")
+{
+    FileIOScheduler scheduler;
+    scheduler.Initialize(0, 0, std::chrono::milliseconds(2));
+    const FileIOClock::time_point now = FileIOClock::now();
+
+    scheduler.Push(MakeTask(0, EFilePriority::Normal));
+    scheduler.Push(MakeTask(1, EFilePriority::Highest));
+    scheduler.Push(MakeTask(2, EFilePriority::Lowest, now));
+    scheduler.Push(MakeTask(3, EFilePriority::Normal));
+    scheduler.Push(MakeTask(4, EFilePriority::Normal, now + std::chrono::hours(1)));
+    scheduler.Push(MakeTask(5, EFilePriority::Low, now - std::chrono::milliseconds(1)));
+    REQUIRE(scheduler.GetNumPendingTasks() == 6);
+
+    CHECK(PopOffsets(scheduler, 3) == std::vector<int64_t>{5, 2, 1});
+    CHECK(PopOffsets(scheduler, 10) == std::vector<int64_t>{4, 0, 3});
+    CHECK(scheduler.GetNumPendingTasks() == 0);
+    CHECK(PopOffsets(scheduler, 10).empty());
+}
+
+TEST_CASE("Scheduler picks up priority changed after push", "[FileIO]")
+{
+    FileIOScheduler scheduler;
+    scheduler.Initialize(0, 0, std::chrono::milliseconds(2));
+
+    FileIOTask raised = MakeTask(0, EFilePriority::Lowest);
+    raised.control = std::make_shared<FileIORequestControl>(EFilePriority::Lowest);
+    const FileIORequestRef control = raised.control;
+    scheduler.Push(std::move(raised));
+    scheduler.Push(MakeTask(1, EFilePriority::Normal));
+    scheduler.Push(MakeTask(2, EFilePriority::High));
+
+    control->SetPriority(EFilePriority::Highest);
+    CHECK(PopOffsets(scheduler, 1) == std::vector<int64_t>{0});
+    CHECK(PopOffsets(scheduler, 2) == std::vector<int64_t>{2, 1});
+}
+
+TEST_CASE("Scheduler throttles background tasks but not urgent ones", "[FileIO]")
+{
+    FileIOScheduler scheduler;
+    // Burst of one block per second: first background task goes and overdraws it, second has to wait.
+    scheduler.Initialize(FileIOBlockSize, FileIOBlockSize, std::chrono::milliseconds(2));
+
+    FileIOTask large = MakeTask(0, EFilePriority::Low);
+    large.remainingSize = 4 * FileIOBlockSize;
+    scheduler.Push(std::move(large));
+    scheduler.Push(MakeTask(1, EFilePriority::Lowest));
+    CHECK(PopOffsets(scheduler, 10) == std::vector<int64_t>{0});
+
+    std::vector<FileIOTask> tasks;
+    CHECK(scheduler.Pop(tasks, 10) > FileIOClock::duration::zero());
+    CHECK(tasks.empty());
+
+    scheduler.Push(MakeTask(2, EFilePriority::Normal));
+    scheduler.Push(MakeTask(3, EFilePriority::Lowest, FileIOClock::now()));
+    CHECK(PopOffsets(scheduler, 10) == std::vector<int64_t>{3, 2});
+    CHECK(scheduler.GetNumPendingTasks() == 1);
+}
@@ -0,0 +1,79 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "Config.h"
+#include "Core/ThreadManager.h"
+#include "FileSystem/File.h"
+#include "FileSystem/FileIOManager.h"
+
+using namespace Koala;
+using namespace Koala::FileIO;
+
+namespace
+{
+    std::future<bool> RequestRead(FileHandle handle, size_t offset, size_t size, void *buffer)
+    {
+        auto promise = std::make_shared<std::promise<bool>>();
+        std::future<bool> future = promise->get_future();
+        FileIOManager::Get().RequestReadFileAsync(std::move(handle), offset, size, buffer,
+            [promise, size](bool bOk, int64_t performedSize, const void*) { promise->set_value(bOk && performedSize == static_cast<int64_t>(size)); },
+            EFileIOCompletionMode::IOThread);
+        return future;
+    }
+
+    std::future<bool> RequestWrite(FileHandle handle, size_t offset, size_t size, const void *buffer)
+    {
+        auto promise = std::make_shared<std::promise<bool>>();
+        std::future<bool> future = promise->get_future();
+        FileIOManager::Get().RequestWriteFileAsync(std::move(handle), offset, size, buffer,
+            [promise](bool bOk, int64_t, const void*) { promise->set_value(bOk); }, EFileIOCompletionMode::IOThread);
+        return future;
+    }
+}
+
+TEST_CASE("Reads after a write finished never see data staged before it", "[FileIO]")
+{
+    ThreadTLS::Initialize(EThreadType::MainThread);
+    Config::Get().SetSetting("fileio.backend", "sync", true);
+    FileIOManager &manager = FileIOManager::Get();
+    REQUIRE(manager.Initialize_MainThread());
+
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "KoalaStagedReadTest.bin";
+    FileHandle handle = FileManager::Get().OpenFileForWrite(path.string(), EFileOpenMode::OpenFileForRead | EFileOpenMode::OpenFileAsBinary);
+    REQUIRE(handle);
+
+    constexpr size_t fileSize = 64 * 1024;
+    constexpr size_t readSize = 1024;
+    std::vector<uint8_t> content(fileSize, 0);
+    std::future<bool> initialWrite = RequestWrite(handle, 0, fileSize, content.data());
+    REQUIRE(manager.WaitForResult(initialWrite));
+
+    for (uint8_t round = 1; round <= 32; ++round)
+    {
+        CAPTURE(static_cast<uint32_t>(round));
+        std::vector<uint8_t> newContent(fileSize, round);
+        // Requested in the same tick as the write, these are merged into one staged read, racing the write.
+        std::vector<uint8_t> racing(2 * readSize);
+        std::future<bool> write = RequestWrite(handle, 0, fileSize, newContent.data());
+        std::future<bool> firstRacing = RequestRead(handle, 0, readSize, racing.data());
+        std::future<bool> secondRacing = RequestRead(handle, readSize, readSize, racing.data() + readSize);
+        REQUIRE(manager.WaitForResult(write));
+        REQUIRE(manager.WaitForResult(firstRacing));
+        REQUIRE(manager.WaitForResult(secondRacing));
+
+        // Inside range of the staged read, but requested after the write finished.
+        std::vector<uint8_t> after(readSize);
+        std::future<bool> read = RequestRead(handle, readSize / 2, readSize, after.data());
+        REQUIRE(manager.WaitForResult(read));
+        CHECK(std::all_of(after.begin(), after.end(), [round](uint8_t value) { return value == round; }));
+    }
+
+    FileManager::Get().CloseFile(handle);
+    manager.Shutdown_MainThread();
+    std::filesystem::remove(path);
+}
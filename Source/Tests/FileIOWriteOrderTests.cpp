@@ -0,0 +1,142 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/resource.h>
+#endif
+
+#include "Config.h"
+#include "Core/ThreadManager.h"
+#include "FileSystem/File.h"
+#include "FileSystem/FileIOBackend.h"
+#include "FileSystem/FileIOManager.h"
+#include "FileSystem/PlatformFile.h"
+
+using namespace Koala;
+using namespace Koala::FileIO;
+
+namespace
+{
+    std::future<bool> RequestWrite(FileHandle handle, size_t offset, size_t size, const void *buffer)
+    {
+        auto promise = std::make_shared<std::promise<bool>>();
+        std::future<bool> future = promise->get_future();
+        FileIOManager::Get().RequestWriteFileAsync(std::move(handle), offset, size, buffer,
+            [promise](bool bOk, int64_t, const void*) { promise->set_value(bOk); }, EFileIOCompletionMode::IOThread);
+        return future;
+    }
+
+    FileIORequest MakeWrite(NativeFileHandle file, int64_t offset, int64_t size, void *buffer)
+    {
+        FileIORequest request;
+        request.nativeHandle = file;
+        request.opType = EFileIOOpType::Write;
+        request.offset = offset;
+        request.size = size;
+        request.buffer = buffer;
+        return request;
+    }
+}
+
+TEST_CASE("Later write of a file waits for an earlier one split over batches", "[FileIO]")
+{
+    ThreadTLS::Initialize(EThreadType::MainThread);
+    Config::Get().SetSetting("fileio.backend", "sync", true);
+    FileIOManager &manager = FileIOManager::Get();
+    REQUIRE(manager.Initialize_MainThread());
+
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "KoalaWriteOrderTest.bin";
+    FileHandle handle = FileManager::Get().OpenFileForWrite(path.string(), EFileOpenMode::OpenFileAsBinary);
+    REQUIRE(handle);
+
+    // Written by several batches, the small one overlapping its tail comes after it.
+    constexpr size_t bigSize = 8 * 1024 * 1024;
+    constexpr size_t smallSize = 4096;
+    const std::vector<uint8_t> big(bigSize, 1);
+    const std::vector<uint8_t> small(smallSize, 2);
+    std::future<bool> bigWrite = RequestWrite(handle, 0, bigSize, big.data());
+    std::future<bool> smallWrite = RequestWrite(handle, bigSize - smallSize, smallSize, small.data());
+    REQUIRE(manager.WaitForResult(bigWrite));
+    REQUIRE(manager.WaitForResult(smallWrite));
+    FileManager::Get().CloseFile(handle);
+    manager.Shutdown_MainThread();
+
+    NativeFileHandle file = PlatformFile::Open(path.string(), EFileOpenMode::OpenFileForRead | EFileOpenMode::OpenFileAsBinary);
+    REQUIRE(file != InvalidNativeFileHandle);
+    std::vector<uint8_t> tail(smallSize);
+    CHECK(PlatformFile::ReadAt(file, tail.data(), smallSize, bigSize - smallSize) == static_cast<int64_t>(smallSize));
+    PlatformFile::Close(file);
+    std::filesystem::remove(path);
+    CHECK(tail == small);
+}
+
+#ifndef _WIN32
+TEST_CASE("Backends skip later writes of a file after a short write", "[FileIO]")
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "KoalaShortWriteTest.bin";
+    const std::filesystem::path otherPath = std::filesystem::temp_directory_path() / "KoalaShortWriteOtherTest.bin";
+    constexpr int64_t sizeLimit = 4096;
+
+    // Writes past the file size limit fall short instead of raising SIGXFSZ.
+    std::signal(SIGXFSZ, SIG_IGN);
+    rlimit oldLimit{};
+    REQUIRE(getrlimit(RLIMIT_FSIZE, &oldLimit) == 0);
+    rlimit limit = oldLimit;
+    limit.rlim_cur = sizeLimit;
+    REQUIRE(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+
+    for (EFileIOBackend backendType: {EFileIOBackend::Synchronous, EFileIOBackend::IOUring})
+    {
+        if (!IsFileIOBackendSupported(backendType))
+            continue;
+        CAPTURE(GetFileIOBackendName(backendType));
+        std::unique_ptr<IFileIOBackend> backend = CreateFileIOBackend(backendType, 8);
+        REQUIRE(backend);
+
+        NativeFileHandle file = PlatformFile::Open(path.string(), EFileOpenMode::OpenFileForWrite | EFileOpenMode::OpenFileAsBinary);
+        NativeFileHandle otherFile = PlatformFile::Open(otherPath.string(), EFileOpenMode::OpenFileForWrite | EFileOpenMode::OpenFileAsBinary);
+        REQUIRE(file != InvalidNativeFileHandle);
+        REQUIRE(otherFile != InvalidNativeFileHandle);
+
+        std::vector<uint8_t> first(2 * sizeLimit, 1);
+        std::vector<uint8_t> second(100, 2);
+        std::vector<uint8_t> other(100, 3);
+        FileIORequest requests[4];
+        requests[0] = MakeWrite(file, 0, static_cast<int64_t>(first.size()), first.data());
+        // Fits the limit, would overwrite the start of the first one if it ran.
+        requests[1] = MakeWrite(file, 0, static_cast<int64_t>(second.size()), second.data());
+        requests[2].nativeHandle = file;
+        requests[2].opType = EFileIOOpType::Sync;
+        requests[2].syncMode = EFileSyncMode::Data;
+        requests[3] = MakeWrite(otherFile, 0, static_cast<int64_t>(other.size()), other.data());
+        backend->SubmitAndWait(requests, 4);
+
+        CHECK(requests[0].result < requests[0].size);
+        CHECK(requests[1].result == -ECANCELED);
+        CHECK(requests[2].result == -ECANCELED);
+        CHECK(requests[3].result == requests[3].size);
+        backend->Shutdown();
+        PlatformFile::Close(file);
+        PlatformFile::Close(otherFile);
+
+        file = PlatformFile::Open(path.string(), EFileOpenMode::OpenFileForRead | EFileOpenMode::OpenFileAsBinary);
+        REQUIRE(file != InvalidNativeFileHandle);
+        std::vector<uint8_t> head(second.size());
+        CHECK(PlatformFile::ReadAt(file, head.data(), static_cast<int64_t>(head.size()), 0) == static_cast<int64_t>(head.size()));
+        CHECK(std::all_of(head.begin(), head.end(), [](uint8_t value) { return value == 1; }));
+        PlatformFile::Close(file);
+    }
+
+    setrlimit(RLIMIT_FSIZE, &oldLimit);
+    std::signal(SIGXFSZ, SIG_DFL);
+    std::filesystem::remove(path);
+    std::filesystem::remove(otherPath);
+}
+#endif
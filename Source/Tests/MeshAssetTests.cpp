@@ -0,0 +1,365 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "Config.h"
+#include "Asset/MeshAsset.h"
+#include "Core/ThreadManager.h"
+#include "FileSystem/File.h"
+#include "FileSystem/FileIOManager.h"
+#include "FileSystem/FileStream.h"
+
+using namespace Koala;
+using namespace Koala::FileIO;
+
+namespace
+{
+    // Byte offsets of header fields in baked mesh files, see MeshAssetMetaData.
+    constexpr size_t MagicOffset = 0;
+    constexpr size_t VersionOffset = 4;
+    constexpr size_t VertexStrideOffset = 12;
+    constexpr size_t NumVerticesOffset = 16;
+    constexpr size_t NumIndicesOffset = 24;
+    constexpr size_t IndexDataOffsetOffset = 40;
+    constexpr size_t VertexFormatOffset = 48;
+    constexpr size_t NumLODsOffset = 80;
+    constexpr size_t LODTableOffsetOffset = 84;
+    constexpr size_t NumMeshletsOffset = 104;
+    constexpr size_t MeshletDataOffsetOffset = 120;
+
+    // FileIO is started by first test needing it and kept for all others, it can not be started again.
+    class ScopedFileIO
+    {
+    public:
+        ScopedFileIO()
+        {
+            ThreadTLS::Initialize(EThreadType::MainThread);
+            Config::Get().SetSetting("fileio.backend", "sync", true);
+            bInitialized = FileIOManager::Get().Initialize_MainThread();
+        }
+        ~ScopedFileIO()
+        {
+            if (bInitialized)
+                FileIOManager::Get().Shutdown_MainThread();
+        }
+        bool bInitialized{false};
+    };
+
+    void StartFileIO()
+    {
+        static ScopedFileIO fileIO;
+        REQUIRE(fileIO.bInitialized);
+    }
+
+    // UV sphere, first and last column of vertices share positions and normals but not UVs, like a texture seam.
+    void MakeSphere(uint32_t rings, uint32_t segments, std::vector<Vector> &outVertices, std::vector<uint32_t> &outIndices)
+    {
+        const float pi = 3.14159265f;
+        for (uint32_t ring = 0; ring <= rings; ++ring)
+        {
+            const float theta = pi * static_cast<float>(ring) / static_cast<float>(rings);
+            for (uint32_t segment = 0; segment <= segments; ++segment)
+            {
+                const float phi = 2.0f * pi * static_cast<float>(segment % segments) / static_cast<float>(segments);
+                Vector vertex;
+                vertex.normal = Vec3f(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+                vertex.position = vertex.normal * 2.0f + Vec3f(1.0f, -3.0f, 0.5f);
+                vertex.uv = Vec2f(static_cast<float>(segment) / static_cast<float>(segments), static_cast<float>(ring) / static_cast<float>(rings));
+                outVertices.push_back(vertex);
+            }
+        }
+        const uint32_t numRowVertices = segments + 1;
+        for (uint32_t ring = 0; ring < rings; ++ring)
+        {
+            for (uint32_t segment = 0; segment < segments; ++segment)
+            {
+                const uint32_t corner = ring * numRowVertices + segment;
+                outIndices.insert(outIndices.end(), {corner, corner + numRowVertices, corner + 1});
+                outIndices.insert(outIndices.end(), {corner + 1, corner + numRowVertices, corner + numRowVertices + 1});
+            }
+        }
+    }
+
+    MeshAsset MakeSphereMesh(const MeshBakeSettings &settings)
+    {
+        std::vector<Vector> vertices;
+        std::vector<uint32_t> indices;
+        MakeSphere(24, 48, vertices, indices);
+        MeshAsset mesh;
+        mesh.SetMeshData(std::move(vertices), std::move(indices));
+        mesh.SetBakeSettings(settings);
+        return mesh;
+    }
+
+    std::string GetTestFilePath(const char *name)
+    {
+        return (std::filesystem::temp_directory_path() / name).string();
+    }
+
+    bool BakeToFile(MeshAsset &mesh, const std::string &path)
+    {
+        FileHandle handle = FileManager::Get().OpenFileForWrite(HashedString(path));
+        if (!handle)
+            return false;
+        WriteFileStream stream(handle);
+        const bool bBaked = mesh.Bake(stream);
+        FileManager::Get().CloseFile(handle);
+        return bBaked;
+    }
+
+    bool LoadFromFile(MeshAsset &mesh, const std::string &path, bool bMapped = false)
+    {
+        if (bMapped)
+        {
+            MappedFileRef view = FileManager::Get().MapFileForRead(HashedString(path));
+            if (!view)
+                return false;
+            ReadFileStream stream(std::move(view));
+            return mesh.LoadAsset(stream);
+        }
+        FileHandle handle = FileManager::Get().OpenFileForRead(HashedString(path));
+        if (!handle)
+            return false;
+        ReadFileStream stream(handle);
+        const bool bLoaded = mesh.LoadAsset(stream);
+        FileManager::Get().CloseFile(handle);
+        return bLoaded;
+    }
+
+    std::vector<uint8_t> ReadBytes(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+
+    void WriteBytes(const std::string &path, const std::vector<uint8_t> &bytes)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    template <typename T>
+    T GetField(const std::vector<uint8_t> &bytes, size_t offset)
+    {
+        T value;
+        std::memcpy(&value, bytes.data() + offset, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void SetField(std::vector<uint8_t> &bytes, size_t offset, T value)
+    {
+        std::memcpy(bytes.data() + offset, &value, sizeof(T));
+    }
+
+    std::vector<uint32_t> GetIndices(const MeshAsset &mesh)
+    {
+        std::vector<uint32_t> indices(mesh.GetNumIndices());
+        for (size_t index = 0; index < indices.size(); ++index)
+        {
+            if (mesh.GetIndexStride() == sizeof(uint16_t))
+                indices[index] = static_cast<const uint16_t*>(mesh.GetIndexData())[index];
+            else
+                indices[index] = static_cast<const uint32_t*>(mesh.GetIndexData())[index];
+        }
+        return indices;
+    }
+
+    void CheckSameVerticesAndIndices(const MeshAsset &loaded, const MeshAsset &baked)
+    {
+        CHECK(loaded.IsBakedData());
+        REQUIRE(loaded.GetVertexFormat() == baked.GetVertexFormat());
+        REQUIRE(loaded.GetNumVertices() == baked.GetNumVertices());
+        CHECK(std::memcmp(loaded.GetVertexData(), baked.GetVertexData(), baked.GetNumVertices() * baked.GetVertexStride()) == 0);
+        CHECK(GetIndices(loaded) == GetIndices(baked));
+        CHECK(loaded.GetBounds().center.isApprox(baked.GetBounds().center));
+        CHECK(std::abs(loaded.GetBounds().radius - baked.GetBounds().radius) < 1e-4f);
+    }
+
+    void CheckSameMesh(const MeshAsset &loaded, const MeshAsset &baked)
+    {
+        CheckSameVerticesAndIndices(loaded, baked);
+        const VertexQuantizationBounds &loadedQuantization = loaded.GetQuantizationBounds();
+        const VertexQuantizationBounds &bakedQuantization = baked.GetQuantizationBounds();
+        CHECK(std::memcmp(&loadedQuantization, &bakedQuantization, sizeof(VertexQuantizationBounds)) == 0);
+
+        REQUIRE(loaded.GetNumLODs() == baked.GetNumLODs());
+        for (uint32_t lodIndex = 0; lodIndex < baked.GetNumLODs(); ++lodIndex)
+        {
+            CAPTURE(lodIndex);
+            const MeshLOD loadedLOD = loaded.GetLOD(lodIndex);
+            const MeshLOD bakedLOD = baked.GetLOD(lodIndex);
+            CHECK(loadedLOD.firstIndex == bakedLOD.firstIndex);
+            CHECK(loadedLOD.numIndices == bakedLOD.numIndices);
+            CHECK(loadedLOD.screenSize == bakedLOD.screenSize);
+            CHECK(loadedLOD.error == bakedLOD.error);
+            CHECK(loaded.GetLODMeshletRange(lodIndex) == baked.GetLODMeshletRange(lodIndex));
+        }
+
+        REQUIRE(loaded.GetMeshlets().size() == baked.GetMeshlets().size());
+        CHECK(std::memcmp(loaded.GetMeshlets().data(), baked.GetMeshlets().data(), baked.GetMeshlets().size() * sizeof(Meshlet)) == 0);
+        CHECK(loaded.GetMeshletVertices() == baked.GetMeshletVertices());
+        CHECK(loaded.GetMeshletTriangles() == baked.GetMeshletTriangles());
+    }
+}
+
+TEST_CASE("Baked meshes load back as they were baked", "[MeshAsset]")
+{
+    StartFileIO();
+    const std::string path = GetTestFilePath("KoalaMeshRoundTripTest.mesh");
+
+    for (EVertexFormat format: {EVertexFormat::Float, EVertexFormat::Packed16, EVertexFormat::Packed12})
+    {
+        for (bool bAllow16BitIndices: {false, true})
+        {
+            CAPTURE(static_cast<uint32_t>(format), bAllow16BitIndices);
+            MeshBakeSettings settings;
+            settings.vertexFormat = format;
+            settings.bAllow16BitIndices = bAllow16BitIndices;
+            MeshAsset baked = MakeSphereMesh(settings);
+            REQUIRE(BakeToFile(baked, path));
+            REQUIRE(baked.GetNumLODs() > 1);
+            REQUIRE(baked.HasMeshlets());
+
+            for (bool bMapped: {false, true})
+            {
+                CAPTURE(bMapped);
+                MeshAsset loaded;
+                REQUIRE(LoadFromFile(loaded, path, bMapped));
+                // Indices are narrowed when written, baked mesh keeps them 32-bit.
+                CHECK(loaded.GetIndexStride() == (bAllow16BitIndices ? sizeof(uint16_t) : sizeof(uint32_t)));
+                CheckSameMesh(loaded, baked);
+            }
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Meshes of every supported file version load", "[MeshAsset]")
+{
+    StartFileIO();
+    const std::string path = GetTestFilePath("KoalaMeshVersionTest.mesh");
+    const std::string versionPath = GetTestFilePath("KoalaMeshVersionTestPatched.mesh");
+
+    // Only what version 2 can hold: float vertices, 32-bit indices, one LOD, no meshlets.
+    // Newer versions only append header fields, so older files are the same bytes with another version.
+    MeshBakeSettings settings;
+    settings.vertexFormat = EVertexFormat::Float;
+    settings.bAllow16BitIndices = false;
+    settings.maxLODs = 1;
+    settings.bBuildMeshlets = false;
+    MeshAsset baked = MakeSphereMesh(settings);
+    REQUIRE(BakeToFile(baked, path));
+    std::vector<uint8_t> bytes = ReadBytes(path);
+    REQUIRE(bytes.size() > 128);
+    CHECK(GetField<uint32_t>(bytes, VersionOffset) == 6);
+
+    for (uint32_t version = 2; version <= 6; ++version)
+    {
+        CAPTURE(version);
+        SetField<uint32_t>(bytes, VersionOffset, version);
+        WriteBytes(versionPath, bytes);
+        MeshAsset loaded;
+        REQUIRE(LoadFromFile(loaded, versionPath));
+        // Bounds of files before version 5 are computed from vertices again.
+        CheckSameVerticesAndIndices(loaded, baked);
+        CHECK(loaded.GetNumLODs() == 1);
+        CHECK(loaded.GetLOD(0).numIndices == baked.GetNumIndices());
+        CHECK_FALSE(loaded.HasMeshlets());
+    }
+    std::filesystem::remove(path);
+    std::filesystem::remove(versionPath);
+}
+
+TEST_CASE("Truncated and corrupt mesh files are rejected", "[MeshAsset]")
+{
+    StartFileIO();
+    const std::string path = GetTestFilePath("KoalaMeshCorruptTest.mesh");
+    const std::string corruptPath = GetTestFilePath("KoalaMeshCorruptTestPatched.mesh");
+
+    MeshBakeSettings settings;
+    settings.vertexFormat = EVertexFormat::Packed16;
+    MeshAsset baked = MakeSphereMesh(settings);
+    REQUIRE(BakeToFile(baked, path));
+    REQUIRE(baked.HasMeshlets());
+    const std::vector<uint8_t> bytes = ReadBytes(path);
+    REQUIRE(bytes.size() > 128);
+    {
+        MeshAsset loaded;
+        REQUIRE(LoadFromFile(loaded, path));
+    }
+
+    const auto indexDataOffset = GetField<uint64_t>(bytes, IndexDataOffsetOffset);
+    const auto meshletDataOffset = GetField<uint64_t>(bytes, MeshletDataOffsetOffset);
+    SECTION("Truncated")
+    {
+        for (size_t size: {size_t(0), size_t(4), size_t(60), size_t(100), size_t(200), static_cast<size_t>(indexDataOffset) + 2,
+            static_cast<size_t>(meshletDataOffset) + 8, bytes.size() - 1})
+        {
+            CAPTURE(size);
+            WriteBytes(corruptPath, std::vector<uint8_t>(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(size)));
+            MeshAsset loaded;
+            CHECK_FALSE(LoadFromFile(loaded, corruptPath));
+        }
+    }
+
+    SECTION("Corrupt")
+    {
+        const auto numVertices = GetField<uint64_t>(bytes, NumVerticesOffset);
+        const auto numIndices = GetField<uint64_t>(bytes, NumIndicesOffset);
+        const auto numLODs = GetField<uint32_t>(bytes, NumLODsOffset);
+        const auto lodTableOffset = GetField<uint32_t>(bytes, LODTableOffsetOffset);
+        const auto numMeshlets = GetField<uint32_t>(bytes, NumMeshletsOffset);
+        // Meshlet blob starts with meshlet offsets of LODs (one more than LODs) padded to 16 bytes, then meshlets, then their vertices.
+        const uint64_t meshletVerticesOffset = meshletDataOffset + (((numLODs + 1) * sizeof(uint32_t) + 15) & ~15ull) +
+            numMeshlets * sizeof(Meshlet);
+
+        struct Corruption
+        {
+            const char *name;
+            size_t offset;
+            uint64_t value;
+            size_t size;
+        };
+        const Corruption corruptions[] = {
+            {"magic", MagicOffset, 0x43214321, sizeof(uint32_t)},
+            {"version too old", VersionOffset, 1, sizeof(uint32_t)},
+            {"version too new", VersionOffset, 7, sizeof(uint32_t)},
+            {"vertex format", VertexFormatOffset, 9, sizeof(uint32_t)},
+            {"vertex stride", VertexStrideOffset, sizeof(Vector), sizeof(uint32_t)},
+            {"vertex count", NumVerticesOffset, 1ull << 40, sizeof(uint64_t)},
+            {"index count", NumIndicesOffset, 1ull << 40, sizeof(uint64_t)},
+            {"index data overlapping vertices", IndexDataOffsetOffset, 0, sizeof(uint64_t)},
+            {"LOD count", NumLODsOffset, 17, sizeof(uint32_t)},
+            {"LOD indices", lodTableOffset + offsetof(MeshLOD, numIndices), numIndices + 3, sizeof(uint32_t)},
+            {"meshlet count", NumMeshletsOffset, numMeshlets + 1000000, sizeof(uint32_t)},
+            {"first LOD meshlet offset", meshletDataOffset, 1, sizeof(uint32_t)},
+            {"meshlet vertex", meshletVerticesOffset, numVertices, sizeof(uint32_t)},
+        };
+        for (const Corruption &corruption: corruptions)
+        {
+            CAPTURE(corruption.name);
+            std::vector<uint8_t> corruptBytes = bytes;
+            if (corruption.size == sizeof(uint64_t))
+                SetField<uint64_t>(corruptBytes, corruption.offset, corruption.value);
+            else
+                SetField<uint32_t>(corruptBytes, corruption.offset, static_cast<uint32_t>(corruption.value));
+            WriteBytes(corruptPath, corruptBytes);
+            for (bool bMapped: {false, true})
+            {
+                CAPTURE(bMapped);
+                MeshAsset loaded;
+                CHECK_FALSE(LoadFromFile(loaded, corruptPath, bMapped));
+            }
+        }
+    }
+    std::filesystem::remove(path);
+    std::filesystem::remove(corruptPath);
+}
@@ -0,0 +1,135 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Asset/MeshOptimizer.h"
+
+using namespace Koala;
+
+namespace
+{
+    // Grid of size x size quads in XY plane, facing +Z. UV x holds vertex index, so that vertices can be told apart after reordering.
+    void MakeGrid(uint32_t size, std::vector<Vector> &outVertices, std::vector<uint32_t> &outIndices)
+    {
+        const uint32_t numRowVertices = size + 1;
+        for (uint32_t y = 0; y < numRowVertices; ++y)
+        {
+            for (uint32_t x = 0; x < numRowVertices; ++x)
+            {
+                Vector vertex;
+                vertex.position = Vec3f(static_cast<float>(x), static_cast<float>(y), 0.0f);
+                vertex.normal = Vec3f(0.0f, 0.0f, 1.0f);
+                vertex.uv = Vec2f(static_cast<float>(outVertices.size()), 0.0f);
+                outVertices.push_back(vertex);
+            }
+        }
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                const uint32_t corner = y * numRowVertices + x;
+                outIndices.insert(outIndices.end(), {corner, corner + 1, corner + numRowVertices + 1});
+                outIndices.insert(outIndices.end(), {corner, corner + numRowVertices + 1, corner + numRowVertices});
+            }
+        }
+    }
+
+    // Same triangles in random order, as exporters without cache optimization may write them.
+    void ShuffleTriangles(std::vector<uint32_t> &indices)
+    {
+        std::vector<std::array<uint32_t, 3>> triangles(indices.size() / 3);
+        std::memcpy(triangles.data(), indices.data(), indices.size() * sizeof(uint32_t));
+        std::shuffle(triangles.begin(), triangles.end(), std::mt19937(7));
+        std::memcpy(indices.data(), triangles.data(), indices.size() * sizeof(uint32_t));
+    }
+
+    // Triangles by original vertex index kept in UV x, sorted, each rotated to start at its smallest index with winding kept.
+    std::vector<std::array<uint32_t, 3>> CollectTriangles(const std::vector<Vector> &vertices, const std::vector<uint32_t> &indices)
+    {
+        std::vector<std::array<uint32_t, 3>> triangles;
+        for (size_t index = 0; index < indices.size(); index += 3)
+        {
+            std::array<uint32_t, 3> triangle;
+            for (size_t corner = 0; corner < 3; ++corner)
+                triangle[corner] = static_cast<uint32_t>(vertices[indices[index + corner]].uv.x());
+            std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+            triangles.push_back(triangle);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+}
+
+TEST_CASE("ACMR counts misses of a FIFO cache", "[MeshOptimizer]")
+{
+    // Every vertex used once misses every time.
+    const std::vector<uint32_t> unshared = {0, 1, 2, 3, 4, 5};
+    CHECK(ComputeACMR(unshared, 6) == 3.0f);
+    // Second triangle reuses two vertices of the first.
+    const std::vector<uint32_t> quad = {0, 1, 2, 0, 2, 3};
+    CHECK(ComputeACMR(quad, 4) == 2.0f);
+    CHECK(ComputeACMR({}, 0) == 0.0f);
+}
+
+TEST_CASE("Vertex cache optimization lowers ACMR and keeps triangles", "[MeshOptimizer]")
+{
+    std::vector<Vector> vertices;
+    std::vector<uint32_t> indices;
+    MakeGrid(64, vertices, indices);
+    ShuffleTriangles(indices);
+    const std::vector<std::array<uint32_t, 3>> triangles = CollectTriangles(vertices, indices);
+
+    const float acmrBefore = ComputeACMR(indices, vertices.size());
+    OptimizeVertexCache(indices, vertices.size());
+    const float acmrAfter = ComputeACMR(indices, vertices.size());
+    CAPTURE(acmrBefore, acmrAfter);
+    // Grid has about half as many vertices as triangles, so 0.5 is the best any order can do.
+    CHECK(acmrBefore > 1.5f);
+    CHECK(acmrAfter < 0.8f);
+    CHECK(CollectTriangles(vertices, indices) == triangles);
+
+    // Overdraw reordering gives back at most the threshold.
+    OptimizeOverdraw(indices, vertices, 1.05f);
+    const float acmrOverdraw = ComputeACMR(indices, vertices.size());
+    CAPTURE(acmrOverdraw);
+    CHECK(acmrOverdraw <= acmrAfter * 1.05f + 1e-4f);
+    CHECK(CollectTriangles(vertices, indices) == triangles);
+}
+
+TEST_CASE("Duplicate vertices are merged and fetches walk forward", "[MeshOptimizer]")
+{
+    std::vector<Vector> gridVertices;
+    std::vector<uint32_t> gridIndices;
+    MakeGrid(16, gridVertices, gridIndices);
+
+    // Each corner its own vertex, as in unindexed meshes.
+    std::vector<Vector> vertices;
+    std::vector<uint32_t> indices;
+    for (uint32_t index: gridIndices)
+    {
+        indices.push_back(static_cast<uint32_t>(vertices.size()));
+        vertices.push_back(gridVertices[index]);
+    }
+    const std::vector<std::array<uint32_t, 3>> triangles = CollectTriangles(vertices, indices);
+
+    CHECK(DeduplicateVertices(vertices, indices) == gridVertices.size());
+    CHECK(vertices.size() == gridVertices.size());
+    CHECK(CollectTriangles(vertices, indices) == triangles);
+
+    OptimizeVertexCache(indices, vertices.size());
+    OptimizeVertexFetch(vertices, indices);
+    CHECK(CollectTriangles(vertices, indices) == triangles);
+    // Each vertex is first used right after the one before it.
+    uint32_t numSeen = 0;
+    for (uint32_t index: indices)
+    {
+        CHECK(index <= numSeen);
+        if (index == numSeen)
+            ++numSeen;
+    }
+    CHECK(numSeen == vertices.size());
+}
@@ -0,0 +1,205 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "Asset/MeshAsset.h"
+#include "Asset/MeshSimplifier.h"
+#include "Renderer/MeshLODSelection.h"
+
+using namespace Koala;
+
+namespace
+{
+    // Closed UV sphere, one vertex at each pole and no seam, so that every vertex can collapse.
+    void MakeClosedSphere(uint32_t rings, uint32_t segments, std::vector<Vector> &outVertices, std::vector<uint32_t> &outIndices)
+    {
+        const float pi = 3.14159265f;
+        auto addVertex = [&outVertices](const Vec3f &normal)
+        {
+            Vector vertex;
+            vertex.position = normal;
+            vertex.normal = normal;
+            outVertices.push_back(vertex);
+        };
+        addVertex(Vec3f(0.0f, 1.0f, 0.0f));
+        for (uint32_t ring = 1; ring < rings; ++ring)
+        {
+            const float theta = pi * static_cast<float>(ring) / static_cast<float>(rings);
+            for (uint32_t segment = 0; segment < segments; ++segment)
+            {
+                const float phi = 2.0f * pi * static_cast<float>(segment) / static_cast<float>(segments);
+                addVertex(Vec3f(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+            }
+        }
+        addVertex(Vec3f(0.0f, -1.0f, 0.0f));
+
+        const uint32_t southPole = static_cast<uint32_t>(outVertices.size()) - 1;
+        auto ringVertex = [segments](uint32_t ring, uint32_t segment) { return 1 + (ring - 1) * segments + segment % segments; };
+        for (uint32_t segment = 0; segment < segments; ++segment)
+        {
+            outIndices.insert(outIndices.end(), {0, ringVertex(1, segment + 1), ringVertex(1, segment)});
+            outIndices.insert(outIndices.end(), {southPole, ringVertex(rings - 1, segment), ringVertex(rings - 1, segment + 1)});
+            for (uint32_t ring = 1; ring + 1 < rings; ++ring)
+            {
+                outIndices.insert(outIndices.end(), {ringVertex(ring, segment), ringVertex(ring, segment + 1), ringVertex(ring + 1, segment)});
+                outIndices.insert(outIndices.end(), {ringVertex(ring, segment + 1), ringVertex(ring + 1, segment + 1), ringVertex(ring + 1, segment)});
+            }
+        }
+    }
+
+    // Flat grid of size x size quads in XY plane, facing +Z. Column of vertices at x = seam is doubled, quads right of it use
+    // copies with other UVs, like a texture seam.
+    void MakeGridWithSeam(uint32_t size, uint32_t seam, std::vector<Vector> &outVertices, std::vector<uint32_t> &outIndices)
+    {
+        const uint32_t numRowVertices = size + 1;
+        for (uint32_t y = 0; y < numRowVertices; ++y)
+        {
+            for (uint32_t x = 0; x < numRowVertices; ++x)
+            {
+                Vector vertex;
+                vertex.position = Vec3f(static_cast<float>(x), static_cast<float>(y), 0.0f);
+                vertex.normal = Vec3f(0.0f, 0.0f, 1.0f);
+                vertex.uv = Vec2f(static_cast<float>(x) / static_cast<float>(size), static_cast<float>(y) / static_cast<float>(size));
+                outVertices.push_back(vertex);
+            }
+        }
+        const uint32_t firstSeamCopy = static_cast<uint32_t>(outVertices.size());
+        for (uint32_t y = 0; y < numRowVertices; ++y)
+        {
+            Vector vertex = outVertices[y * numRowVertices + seam];
+            vertex.uv.x() += 1.0f;
+            outVertices.push_back(vertex);
+        }
+
+        auto gridVertex = [&](uint32_t x, uint32_t y, bool bRightOfSeam)
+        {
+            return x == seam && bRightOfSeam ? firstSeamCopy + y : y * numRowVertices + x;
+        };
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                const bool bRight = x >= seam;
+                outIndices.insert(outIndices.end(), {gridVertex(x, y, bRight), gridVertex(x + 1, y, bRight), gridVertex(x + 1, y + 1, bRight)});
+                outIndices.insert(outIndices.end(), {gridVertex(x, y, bRight), gridVertex(x + 1, y + 1, bRight), gridVertex(x, y + 1, bRight)});
+            }
+        }
+    }
+
+    bool HasDegenerateTriangles(const std::vector<uint32_t> &indices)
+    {
+        for (size_t index = 0; index < indices.size(); index += 3)
+        {
+            if (indices[index] == indices[index + 1] || indices[index + 1] == indices[index + 2] || indices[index] == indices[index + 2])
+                return true;
+        }
+        return false;
+    }
+}
+
+TEST_CASE("Simplification stops at target index count or target error", "[MeshSimplifier]")
+{
+    std::vector<Vector> vertices;
+    std::vector<uint32_t> indices;
+    MakeClosedSphere(32, 64, vertices, indices);
+
+    for (size_t targetIndexCount: {indices.size() / 2, indices.size() / 4, indices.size() / 16, size_t(300)})
+    {
+        CAPTURE(targetIndexCount);
+        float error = -1.0f;
+        const std::vector<uint32_t> simplified = SimplifyMesh(vertices, indices, targetIndexCount, 1.0f, &error);
+        CHECK(simplified.size() <= targetIndexCount);
+        CHECK(simplified.size() > targetIndexCount / 2);
+        CHECK(simplified.size() % 3 == 0);
+        CHECK(std::all_of(simplified.begin(), simplified.end(), [&vertices](uint32_t index) { return index < vertices.size(); }));
+        CHECK_FALSE(HasDegenerateTriangles(simplified));
+        CHECK(error > 0.0f);
+        CHECK(error <= 1.0f);
+    }
+
+    // Every collapse on a sphere moves the surface, a tight error limit stops it long before the target.
+    float tightError = -1.0f;
+    const std::vector<uint32_t> tight = SimplifyMesh(vertices, indices, 0, 0.001f, &tightError);
+    CHECK(tight.size() > indices.size() / 2);
+    CHECK(tightError <= 0.001f);
+    float looseError = -1.0f;
+    const std::vector<uint32_t> loose = SimplifyMesh(vertices, indices, 0, 0.05f, &looseError);
+    CHECK(loose.size() < tight.size());
+    CHECK(looseError <= 0.05f);
+}
+
+TEST_CASE("Simplification keeps seam and border vertices", "[MeshSimplifier]")
+{
+    constexpr uint32_t size = 16;
+    constexpr uint32_t seam = 7;
+    std::vector<Vector> vertices;
+    std::vector<uint32_t> indices;
+    MakeGridWithSeam(size, seam, vertices, indices);
+
+    const std::vector<uint32_t> simplified = SimplifyMesh(vertices, indices, 0, 1.0f);
+    CHECK_FALSE(HasDegenerateTriangles(simplified));
+    // Flat interior collapses freely.
+    CHECK(simplified.size() < indices.size() / 2);
+
+    std::vector<bool> bUsed(vertices.size(), false);
+    for (uint32_t index: simplified)
+        bUsed[index] = true;
+    for (uint32_t vertex = 0; vertex < vertices.size(); ++vertex)
+    {
+        const Vec3f &position = vertices[vertex].position;
+        const bool bBorder = position.x() == 0.0f || position.y() == 0.0f || position.x() == size || position.y() == size;
+        const bool bSeam = position.x() == seam;
+        if (bBorder || bSeam)
+        {
+            CAPTURE(vertex, position.x(), position.y());
+            CHECK(bUsed[vertex]);
+        }
+    }
+}
+
+TEST_CASE("LOD selection switches where LOD error reaches pixel error", "[MeshSimplifier]")
+{
+    std::vector<Vector> vertices;
+    std::vector<uint32_t> indices;
+    MakeClosedSphere(32, 64, vertices, indices);
+    MeshAsset mesh;
+    mesh.SetMeshData(std::move(vertices), std::move(indices));
+    MeshBakeSettings settings;
+    settings.maxLODs = 6;
+    mesh.SetBakeSettings(settings);
+    mesh.GenerateLODs();
+
+    const uint32_t numLODs = mesh.GetNumLODs();
+    REQUIRE(numLODs > 2);
+    CHECK(mesh.GetLOD(0).screenSize == std::numeric_limits<float>::max());
+    CHECK(mesh.GetLOD(0).error == 0.0f);
+    for (uint32_t lodIndex = 1; lodIndex < numLODs; ++lodIndex)
+    {
+        CAPTURE(lodIndex);
+        const MeshLOD previous = mesh.GetLOD(lodIndex - 1);
+        const MeshLOD lod = mesh.GetLOD(lodIndex);
+        CHECK(lod.numIndices <= previous.numIndices * 9 / 10);
+        CHECK(lod.error >= previous.error);
+        CHECK(lod.error <= settings.lodMaxError);
+        CHECK(lod.screenSize == std::min(previous.screenSize, 2.0f * settings.lodPixelError / (lod.error * settings.lodReferenceHeight)));
+        // LOD is picked from its threshold down, not just above it.
+        CHECK(Renderer::SelectMeshLOD(mesh, lod.screenSize) >= lodIndex);
+        CHECK(Renderer::SelectMeshLOD(mesh, lod.screenSize * 1.001f) < lodIndex);
+    }
+
+    // Error of selected LOD covers at most lodPixelError pixels at reference height, next coarser one would cover more.
+    for (float screenSize = 2.0f; screenSize > 1e-4f; screenSize *= 0.9f)
+    {
+        CAPTURE(screenSize);
+        const uint32_t lodIndex = Renderer::SelectMeshLOD(mesh, screenSize);
+        REQUIRE(lodIndex < numLODs);
+        const auto getPixelError = [&](uint32_t index) { return mesh.GetLOD(index).error * 0.5f * screenSize * settings.lodReferenceHeight; };
+        CHECK(getPixelError(lodIndex) <= settings.lodPixelError * 1.001f);
+        if (lodIndex + 1 < numLODs)
+            CHECK(getPixelError(lodIndex + 1) > settings.lodPixelError);
+    }
+    CHECK(Renderer::SelectMeshLOD(mesh, 0.0f) == numLODs - 1);
+}
@@ -0,0 +1,145 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "Asset/MeshletBuilder.h"
+
+using namespace Koala;
+
+namespace
+{
+    struct MeshletBuildResult
+    {
+        std::vector<Meshlet>  meshlets;
+        std::vector<uint32_t> meshletVertices;
+        std::vector<uint8_t>  meshletTriangles;
+    };
+
+    // Flat grid of size x size quads in XY plane, facing +Z.
+    void MakeGrid(uint32_t size, std::vector<Vector> &outVertices, std::vector<uint32_t> &outIndices)
+    {
+        const uint32_t numRowVertices = size + 1;
+        for (uint32_t y = 0; y < numRowVertices; ++y)
+        {
+            for (uint32_t x = 0; x < numRowVertices; ++x)
+            {
+                Vector vertex;
+                vertex.position = Vec3f(static_cast<float>(x), static_cast<float>(y), 0.0f);
+                vertex.normal = Vec3f(0.0f, 0.0f, 1.0f);
+                outVertices.push_back(vertex);
+            }
+        }
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                const uint32_t corner = y * numRowVertices + x;
+                outIndices.insert(outIndices.end(), {corner, corner + 1, corner + numRowVertices + 1});
+                outIndices.insert(outIndices.end(), {corner, corner + numRowVertices + 1, corner + numRowVertices});
+            }
+        }
+    }
+
+    MeshletBuildResult Build(const std::vector<Vector> &vertices, const std::vector<uint32_t> &indices,
+        uint32_t maxVertices = MeshletMaxVertices, uint32_t maxTriangles = MeshletMaxTriangles)
+    {
+        MeshletBuildResult result;
+        BuildMeshlets(vertices, indices.data(), indices.size(), result.meshlets, result.meshletVertices, result.meshletTriangles,
+            maxVertices, maxTriangles);
+        return result;
+    }
+
+    // Triangles of all meshlets mapped back to mesh vertex indices, sorted, each triangle rotated to start at its smallest index.
+    std::vector<std::array<uint32_t, 3>> CollectTriangles(const MeshletBuildResult &result)
+    {
+        std::vector<std::array<uint32_t, 3>> triangles;
+        for (const Meshlet &meshlet: result.meshlets)
+        {
+            for (uint32_t triangle = 0; triangle < meshlet.numTriangles; ++triangle)
+            {
+                std::array<uint32_t, 3> corners;
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    const uint8_t local = result.meshletTriangles[(meshlet.firstTriangle + triangle) * 3 + k];
+                    REQUIRE(local < meshlet.numVertices);
+                    corners[k] = result.meshletVertices[meshlet.firstVertex + local];
+                }
+                std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+                triangles.push_back(corners);
+            }
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+}
+
+TEST_CASE("Meshlets respect vertex and triangle limits and keep every triangle", "[Meshlet]")
+{
+    std::vector<Vector> vertices;
+    std::vector<uint32_t> indices;
+    MakeGrid(32, vertices, indices);
+
+    for (auto [maxVertices, maxTriangles]: {std::pair{MeshletMaxVertices, MeshletMaxTriangles}, std::pair{16u, 20u}})
+    {
+        const MeshletBuildResult result = Build(vertices, indices, maxVertices, maxTriangles);
+        REQUIRE_FALSE(result.meshlets.empty());
+        for (const Meshlet &meshlet: result.meshlets)
+        {
+            CHECK(meshlet.numVertices > 0);
+            CHECK(meshlet.numVertices <= maxVertices);
+            CHECK(meshlet.numTriangles > 0);
+            CHECK(meshlet.numTriangles <= maxTriangles);
+        }
+
+        std::vector<std::array<uint32_t, 3>> expected;
+        for (size_t index = 0; index < indices.size(); index += 3)
+        {
+            std::array<uint32_t, 3> corners{indices[index], indices[index + 1], indices[index + 2]};
+            std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+            expected.push_back(corners);
+        }
+        std::sort(expected.begin(), expected.end());
+        CHECK(CollectTriangles(result) == expected);
+    }
+}
+
+TEST_CASE("Meshlet bounds contain their vertices and cull from behind", "[Meshlet]")
+{
+    std::vector<Vector> vertices;
+    std::vector<uint32_t> indices;
+    MakeGrid(16, vertices, indices);
+    const MeshletBuildResult result = Build(vertices, indices);
+
+    for (const Meshlet &meshlet: result.meshlets)
+    {
+        const Vec3f center(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+        for (uint32_t local = 0; local < meshlet.numVertices; ++local)
+        {
+            const Vec3f &position = vertices[result.meshletVertices[meshlet.firstVertex + local]].position;
+            CHECK((position - center).norm() <= meshlet.radius * 1.001f + 1e-4f);
+        }
+        CHECK(IsMeshletBackFacing(meshlet, center - Vec3f(0.0f, 0.0f, 10.0f)));
+        CHECK_FALSE(IsMeshletBackFacing(meshlet, center + Vec3f(0.0f, 0.0f, 10.0f)));
+    }
+}
+
+TEST_CASE("Meshlet building is deterministic", "[Meshlet]")
+{
+    std::vector<Vector> vertices;
+    std::vector<uint32_t> indices;
+    MakeGrid(24, vertices, indices);
+
+    const MeshletBuildResult first = Build(vertices, indices);
+    const MeshletBuildResult second = Build(vertices, indices);
+    REQUIRE(first.meshlets.size() == second.meshlets.size());
+    CHECK(first.meshletVertices == second.meshletVertices);
+    CHECK(first.meshletTriangles == second.meshletTriangles);
+    for (size_t index = 0; index < first.meshlets.size(); ++index)
+    {
+        CHECK(first.meshlets[index].firstVertex == second.meshlets[index].firstVertex);
+        CHECK(first.meshlets[index].numTriangles == second.meshlets[index].numTriangles);
+        CHECK(first.meshlets[index].radius == second.meshlets[index].radius);
+    }
+}
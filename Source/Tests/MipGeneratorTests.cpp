@@ -0,0 +1,92 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "Asset/MipGenerator.h"
+
+using namespace Koala;
+
+namespace
+{
+    // 2x2 RGBA8 image, left column black and transparent, right column white and opaque.
+    std::vector<uint8_t> MakeHalfWhiteImage()
+    {
+        return {0, 0, 0, 0, 255, 255, 255, 255,
+                0, 0, 0, 0, 255, 255, 255, 255};
+    }
+}
+
+TEST_CASE("Mip chain halves size down to 1x1", "[MipGenerator]")
+{
+    constexpr uint32_t width = 100;
+    constexpr uint32_t height = 37;
+    const std::vector<uint8_t> image(ComputeImageSize(PF_R8G8B8A8, width, height), 77);
+
+    CHECK(GetNumMipsInChain(width, height) == 7);
+    CHECK(GetNumMipsInChain(1, 1) == 1);
+    CHECK(GetNumMipsInChain(256, 256) == 9);
+
+    for (EMipFilter filter: {EMipFilter::Box, EMipFilter::Kaiser, EMipFilter::Lanczos})
+    {
+        CAPTURE(static_cast<uint32_t>(filter));
+        const std::vector<std::vector<uint8_t>> mips = GenerateMips(PF_R8G8B8A8, image.data(), width, height, {filter});
+        REQUIRE(mips.size() == 7);
+        CHECK(mips[0] == image);
+        uint32_t mipWidth = width;
+        uint32_t mipHeight = height;
+        for (const std::vector<uint8_t> &mip: mips)
+        {
+            CHECK(mip.size() == ComputeImageSize(PF_R8G8B8A8, mipWidth, mipHeight));
+            // Filter weights sum to one, flat image stays flat.
+            CHECK(std::all_of(mip.begin(), mip.end(), [](uint8_t value) { return value == 77; }));
+            mipWidth = std::max(1u, mipWidth / 2);
+            mipHeight = std::max(1u, mipHeight / 2);
+        }
+    }
+
+    MipGenerationSettings settings;
+    settings.maxMips = 3;
+    CHECK(GenerateMips(PF_R8G8B8A8, image.data(), width, height, settings).size() == 3);
+    CHECK(GenerateMips(PF_DXT1, image.data(), width, height).empty());
+}
+
+TEST_CASE("Float mips keep values without requantizing", "[MipGenerator]")
+{
+    constexpr uint32_t size = 16;
+    std::vector<float> image(size * size * 4, 0.3f);
+    std::vector<uint8_t> bytes(image.size() * sizeof(float));
+    std::memcpy(bytes.data(), image.data(), bytes.size());
+
+    const std::vector<std::vector<uint8_t>> mips = GenerateMips(PF_R32G32B32A32, bytes.data(), size, size);
+    REQUIRE(mips.size() == 5);
+    REQUIRE(mips.back().size() == 4 * sizeof(float));
+    float last[4];
+    std::memcpy(last, mips.back().data(), sizeof(last));
+    for (float value: last)
+        CHECK(std::abs(value - 0.3f) < 1e-5f);
+}
+
+TEST_CASE("sRGB mips average color in linear space, alpha stays linear", "[MipGenerator]")
+{
+    const std::vector<uint8_t> image = MakeHalfWhiteImage();
+
+    MipGenerationSettings settings;
+    settings.filter = EMipFilter::Box;
+    const std::vector<std::vector<uint8_t>> linearMips = GenerateMips(PF_R8G8B8A8, image.data(), 2, 2, settings);
+    REQUIRE(linearMips.size() == 2);
+    REQUIRE(linearMips[1].size() == 4);
+    for (uint8_t value: linearMips[1])
+        CHECK((value == 127 || value == 128));
+
+    settings.bSRGB = true;
+    const std::vector<std::vector<uint8_t>> sRGBMips = GenerateMips(PF_R8G8B8A8, image.data(), 2, 2, settings);
+    REQUIRE(sRGBMips.size() == 2);
+    REQUIRE(sRGBMips[1].size() == 4);
+    // Linear 0.5 encodes to sRGB 0.735.
+    for (uint32_t channel = 0; channel < 3; ++channel)
+        CHECK((sRGBMips[1][channel] >= 187 && sRGBMips[1][channel] <= 189));
+    CHECK((sRGBMips[1][3] == 127 || sRGBMips[1][3] == 128));
+}
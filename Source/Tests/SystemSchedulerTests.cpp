@@ -0,0 +1,231 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "KoalaEngine.h"
+#include "AsyncWorker/WorkDispatcher.h"
+#include "Core/ThreadManager.h"
+#include "Game/ECS/SystemScheduler.h"
+
+using namespace Koala;
+
+namespace
+{
+    struct Position
+    {
+        float x{0}, y{0}, z{0};
+    };
+
+    struct Velocity
+    {
+        float x{0}, y{0}, z{0};
+    };
+
+    struct Health
+    {
+        float value{0};
+    };
+
+    struct Armor
+    {
+        float value{0};
+    };
+
+    // Workers are started by first test needing them and kept for all others, they can not be started again.
+    class ScopedWorkers
+    {
+    public:
+        ScopedWorkers()
+        {
+            ThreadTLS::Initialize(EThreadType::MainThread);
+            AsyncWorker::WorkDispatcher::Get().Initialize_MainThread();
+            AsyncWorker::WorkDispatcher::Get().CreateThread();
+        }
+        ~ScopedWorkers()
+        {
+            // Dispatcher thread runs until engine is exiting.
+            KoalaEngine::Get().RequestEngineStop();
+            AsyncWorker::WorkDispatcher::Get().Shutdown_MainThread();
+        }
+    };
+
+    void StartWorkers()
+    {
+        static ScopedWorkers workers;
+        REQUIRE(AsyncWorker::WorkDispatcher::Get().GetNumWorkerThreads() > 0);
+    }
+
+    // Start and end of each system in one sequence shared by all of them.
+    struct SystemTimeline
+    {
+        std::atomic<uint32_t> sequence{0};
+        std::vector<uint32_t> starts;
+        std::vector<uint32_t> ends;
+
+        explicit SystemTimeline(size_t numSystems): starts(numSystems), ends(numSystems) {}
+
+        // Recorded system sleeps a little, so systems wrongly run concurrently overlap.
+        SystemDesc MakeSystem(uint32_t index, SystemAccess access)
+        {
+            SystemDesc desc;
+            desc.name = "System" + std::to_string(index);
+            desc.access = access;
+            desc.update = [this, index](EntityWorld&, float)
+            {
+                starts[index] = sequence.fetch_add(1);
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                ends[index] = sequence.fetch_add(1);
+            };
+            return desc;
+        }
+    };
+}
+
+TEST_CASE("Conflicting systems run in the order they were added", "[SystemScheduler]")
+{
+    StartWorkers();
+    EntityWorld world;
+    SystemScheduler scheduler;
+    SystemTimeline timeline(4);
+    scheduler.AddSystem(timeline.MakeSystem(0, SystemAccess().Write<Position>()));
+    scheduler.AddSystem(timeline.MakeSystem(1, SystemAccess().Read<Position>()));
+    scheduler.AddSystem(timeline.MakeSystem(2, SystemAccess().Read<Position>().Write<Velocity>()));
+    scheduler.AddSystem(timeline.MakeSystem(3, SystemAccess().Write<Position>().Read<Velocity>()));
+
+    for (uint32_t run = 0; run < 10; ++run)
+    {
+        CAPTURE(run);
+        scheduler.Run(world, 0.0f);
+        // Both readers of Position may overlap, each writer waits for all systems before it.
+        CHECK(timeline.starts[1] > timeline.ends[0]);
+        CHECK(timeline.starts[2] > timeline.ends[0]);
+        CHECK(timeline.starts[3] > timeline.ends[1]);
+        CHECK(timeline.starts[3] > timeline.ends[2]);
+    }
+}
+
+TEST_CASE("Systems without conflicts run concurrently", "[SystemScheduler]")
+{
+    StartWorkers();
+    EntityWorld world;
+    SystemScheduler scheduler;
+
+    // Each system waits for the other one to start, which only happens if they run at the same time.
+    std::atomic<uint32_t> numStarted{0};
+    std::atomic<uint32_t> numMet{0};
+    auto meet = [&numStarted, &numMet](EntityWorld&, float)
+    {
+        numStarted.fetch_add(1);
+        const auto giveUpTime = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (numStarted.load() < 2 && std::chrono::steady_clock::now() < giveUpTime)
+            std::this_thread::yield();
+        if (numStarted.load() >= 2)
+            numMet.fetch_add(1);
+    };
+    scheduler.AddSystem({"Movement", SystemAccess().Write<Position>().Read<Velocity>(), meet});
+    scheduler.AddSystem({"Regeneration", SystemAccess().Write<Health>(), meet});
+
+    scheduler.Run(world, 0.0f);
+    CHECK(numMet.load() == 2);
+}
+
+TEST_CASE("Structural systems wait for all systems before them and hold back all after them", "[SystemScheduler]")
+{
+    StartWorkers();
+    EntityWorld world;
+    SystemScheduler scheduler;
+    SystemTimeline timeline(5);
+    scheduler.AddSystem(timeline.MakeSystem(0, SystemAccess().Write<Position>()));
+    scheduler.AddSystem(timeline.MakeSystem(1, SystemAccess().Write<Velocity>()));
+    SystemAccess structural;
+    structural.bStructural = true;
+    scheduler.AddSystem(timeline.MakeSystem(2, structural));
+    scheduler.AddSystem(timeline.MakeSystem(3, SystemAccess().Write<Health>()));
+    scheduler.AddSystem(timeline.MakeSystem(4, SystemAccess().Write<Armor>()));
+
+    for (uint32_t run = 0; run < 10; ++run)
+    {
+        CAPTURE(run);
+        scheduler.Run(world, 0.0f);
+        CHECK(timeline.starts[2] > timeline.ends[0]);
+        CHECK(timeline.starts[2] > timeline.ends[1]);
+        CHECK(timeline.starts[3] > timeline.ends[2]);
+        CHECK(timeline.starts[4] > timeline.ends[2]);
+    }
+}
+
+TEST_CASE("Calling thread systems run on the thread calling Run", "[SystemScheduler]")
+{
+    StartWorkers();
+    EntityWorld world;
+    SystemScheduler scheduler;
+
+    const std::thread::id callingThread = std::this_thread::get_id();
+    std::mutex mutex;
+    std::vector<std::thread::id> threads(4);
+    auto addSystem = [&](uint32_t index, SystemAccess access, bool bCallingThread)
+    {
+        SystemDesc desc;
+        desc.name = "System" + std::to_string(index);
+        desc.access = access;
+        desc.bCallingThread = bCallingThread;
+        desc.update = [&mutex, &threads, index](EntityWorld&, float)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            std::lock_guard lock(mutex);
+            threads[index] = std::this_thread::get_id();
+        };
+        scheduler.AddSystem(std::move(desc));
+    };
+    // Calling thread prefers the earliest ready system, unless a calling thread system is ready.
+    addSystem(0, SystemAccess().Write<Position>(), false);
+    addSystem(1, SystemAccess().Write<Velocity>(), true);
+    addSystem(2, SystemAccess().Write<Health>(), false);
+    addSystem(3, SystemAccess().Write<Armor>(), true);
+
+    for (uint32_t run = 0; run < 10; ++run)
+    {
+        CAPTURE(run);
+        scheduler.Run(world, 0.0f);
+        std::lock_guard lock(mutex);
+        CHECK(threads[1] == callingThread);
+        CHECK(threads[3] == callingThread);
+    }
+}
+
+TEST_CASE("Disabled systems are skipped", "[SystemScheduler]")
+{
+    StartWorkers();
+    EntityWorld world;
+    SystemScheduler scheduler;
+
+    std::atomic<uint32_t> numRuns[3]{};
+    std::vector<SystemId> systems;
+    for (uint32_t index = 0; index < 3; ++index)
+    {
+        std::atomic<uint32_t> *counter = &numRuns[index];
+        systems.push_back(scheduler.AddSystem({"System" + std::to_string(index), SystemAccess().Write<Position>(),
+            [counter](EntityWorld&, float) { counter->fetch_add(1); }}));
+    }
+
+    scheduler.SetSystemEnabled(systems[1], false);
+    CHECK_FALSE(scheduler.IsSystemEnabled(systems[1]));
+    scheduler.Run(world, 0.0f);
+    CHECK(numRuns[0].load() == 1);
+    CHECK(numRuns[1].load() == 0);
+    CHECK(numRuns[2].load() == 1);
+
+    // A single enabled system takes the path without workers.
+    scheduler.SetSystemEnabled(systems[0], false);
+    scheduler.SetSystemEnabled(systems[2], false);
+    scheduler.SetSystemEnabled(systems[1], true);
+    scheduler.Run(world, 0.0f);
+    CHECK(numRuns[0].load() == 1);
+    CHECK(numRuns[1].load() == 1);
+    CHECK(numRuns[2].load() == 1);
+}
@@ -0,0 +1,98 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "Asset/TextureCompression.h"
+
+using namespace Koala;
+
+namespace
+{
+    // Smooth color gradients with a soft alpha ramp and some noise, size not a multiple of block size.
+    std::vector<uint8_t> MakeTestImage(uint32_t width, uint32_t height)
+    {
+        std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+        uint32_t noise = 12345;
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                noise = noise * 1664525u + 1013904223u;
+                const int jitter = static_cast<int>(noise >> 29) - 4;
+                uint8_t *pixel = rgba.data() + (static_cast<size_t>(y) * width + x) * 4;
+                pixel[0] = static_cast<uint8_t>(std::clamp(static_cast<int>(255 * x / width) + jitter, 0, 255));
+                pixel[1] = static_cast<uint8_t>(std::clamp(static_cast<int>(255 * y / height) + jitter, 0, 255));
+                pixel[2] = static_cast<uint8_t>(128 + 100 * std::sin(0.2 * (x + y)));
+                pixel[3] = static_cast<uint8_t>(255 * (x + y) / (width + height));
+            }
+        }
+        return rgba;
+    }
+
+    double RoundTripPSNR(EPixelFormat format, const std::vector<uint8_t> &rgba, uint32_t width, uint32_t height,
+        ETextureCompressionQuality quality, uint32_t channelMask)
+    {
+        const std::vector<uint8_t> compressed = CompressImage(format, rgba, width, height, quality);
+        REQUIRE(compressed.size() == ComputeImageSize(format, width, height));
+        std::vector<uint8_t> decoded(rgba.size());
+        REQUIRE(DecompressImage(format, compressed.data(), width, height, decoded.data()));
+        return ComputeImagePSNR(rgba.data(), decoded.data(), static_cast<size_t>(width) * height, channelMask);
+    }
+}
+
+TEST_CASE("Block compressed images decode close to their source", "[TextureCompression]")
+{
+    constexpr uint32_t width = 61;
+    constexpr uint32_t height = 37;
+    const std::vector<uint8_t> rgba = MakeTestImage(width, height);
+
+    for (ETextureCompressionQuality quality: {ETextureCompressionQuality::Fast, ETextureCompressionQuality::Normal,
+        ETextureCompressionQuality::High})
+    {
+        CAPTURE(static_cast<uint32_t>(quality));
+        CHECK(RoundTripPSNR(PF_DXT1, rgba, width, height, quality, 0x7) > 30.0);
+        CHECK(RoundTripPSNR(PF_DXT3, rgba, width, height, quality, 0x8) > 31.0);
+        CHECK(RoundTripPSNR(PF_DXT5, rgba, width, height, quality, 0x7) > 30.0);
+        CHECK(RoundTripPSNR(PF_DXT5, rgba, width, height, quality, 0x8) > 45.0);
+        CHECK(RoundTripPSNR(PF_BC5, rgba, width, height, quality, 0x3) > 45.0);
+    }
+
+    // Higher quality refines endpoints, it must not end up worse.
+    CHECK(RoundTripPSNR(PF_DXT1, rgba, width, height, ETextureCompressionQuality::High, 0x7) >=
+        RoundTripPSNR(PF_DXT1, rgba, width, height, ETextureCompressionQuality::Fast, 0x7) - 0.1);
+}
+
+TEST_CASE("Solid blocks of representable colors round trip exactly", "[TextureCompression]")
+{
+    // Red and green are exact in 5:6:5, alpha extremes are exact in every alpha encoding.
+    uint8_t rgba[16 * 4];
+    for (uint32_t pixel = 0; pixel < 16; ++pixel)
+    {
+        rgba[pixel * 4 + 0] = 255;
+        rgba[pixel * 4 + 1] = 0;
+        rgba[pixel * 4 + 2] = 0;
+        rgba[pixel * 4 + 3] = 255;
+    }
+
+    for (EPixelFormat format: {PF_DXT1, PF_DXT3, PF_DXT5})
+    {
+        CAPTURE(static_cast<uint32_t>(format));
+        uint8_t block[16];
+        uint8_t decoded[16 * 4];
+        EncodeBlock(format, rgba, block, ETextureCompressionQuality::Normal);
+        DecodeBlock(format, block, decoded);
+        CHECK(std::memcmp(rgba, decoded, sizeof(rgba)) == 0);
+        CHECK(std::isinf(ComputeImagePSNR(rgba, decoded, 16)));
+    }
+}
+
+TEST_CASE("Uncompressed formats are rejected", "[TextureCompression]")
+{
+    const std::vector<uint8_t> rgba = MakeTestImage(8, 8);
+    std::vector<uint8_t> out(rgba.size());
+    CHECK_FALSE(CompressImage(PF_R8G8B8A8, rgba.data(), 8, 8, out.data()));
+    CHECK_FALSE(DecompressImage(PF_R8G8B8A8, rgba.data(), 8, 8, out.data()));
+}
@@ -0,0 +1,118 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <memory>
+#include <vector>
+
+#include "Asset/TextureResidencyManager.h"
+
+using namespace Koala;
+
+namespace
+{
+    // Residency only streams mips of baked textures. Loading one needs a file, this one just claims to be baked,
+    // which is enough as long as no mip has to be streamed back in.
+    class BakedTestTexture: public TextureAsset
+    {
+    public:
+        explicit BakedTestTexture(uint32_t size)
+        {
+            std::vector<std::vector<uint8_t>> mips;
+            for (uint32_t mipSize = size; ; mipSize /= 2)
+            {
+                mips.emplace_back(ComputeImageSize(PF_R8G8B8A8, mipSize, mipSize), 0x7f);
+                if (mipSize == 1)
+                    break;
+            }
+            SetMips(PF_R8G8B8A8, size, size, std::move(mips));
+            bBaked = true;
+        }
+    };
+
+    uint64_t GetFullSize(const TextureAsset &texture, uint32_t firstMip = 0)
+    {
+        uint64_t size = 0;
+        for (uint32_t mip = firstMip; mip < texture.GetNumMips(); ++mip)
+            size += texture.GetMipSize(mip);
+        return size;
+    }
+}
+
+TEST_CASE("Wanted mip follows screen size and stops at mip tail", "[TextureResidency]")
+{
+    const BakedTestTexture texture(256);
+    REQUIRE(texture.GetNumMips() == 9);
+    REQUIRE(texture.GetFirstTailMip() == 2);
+
+    CHECK(TextureResidencyManager::ComputeWantedMip(texture, 256.0f) == 0);
+    CHECK(TextureResidencyManager::ComputeWantedMip(texture, 1000.0f) == 0);
+    CHECK(TextureResidencyManager::ComputeWantedMip(texture, 128.0f) == 1);
+    CHECK(TextureResidencyManager::ComputeWantedMip(texture, 256.0f, 1.0f) == 1);
+    CHECK(TextureResidencyManager::ComputeWantedMip(texture, 8.0f) == 2);
+    CHECK(TextureResidencyManager::ComputeWantedMip(texture, 0.0f) == 2);
+}
+
+TEST_CASE("Over budget textures drop mips with most texels per pixel first", "[TextureResidency]")
+{
+    TextureResidencyManager &manager = TextureResidencyManager::Get();
+    auto nearTexture = std::make_shared<BakedTestTexture>(256);
+    auto farTexture = std::make_shared<BakedTestTexture>(256);
+    // Not loaded from file, never cut.
+    auto unbakedTexture = std::make_shared<TextureAsset>();
+    REQUIRE(unbakedTexture->SetMips(PF_R8G8B8A8, 1, 1, {std::vector<uint8_t>(4)}));
+    manager.Register(nearTexture);
+    manager.Register(farTexture);
+    manager.Register(unbakedTexture);
+
+    // Both want mip 0, only one of them fits.
+    const uint64_t budget = GetFullSize(*nearTexture) + GetFullSize(*farTexture, 1) + GetFullSize(*unbakedTexture);
+    manager.SetBudget(budget);
+    nearTexture->RequestScreenSize(256.0f);
+    farTexture->RequestScreenSize(200.0f);
+    manager.Tick_MainThread(0.0f);
+
+    const TextureResidencyStats stats = manager.GetStats();
+    CHECK(stats.numTextures == 3);
+    CHECK(stats.numOverBudget == 1);
+    CHECK(stats.wantedSize == budget);
+    CHECK(stats.numStreamingIn == 0);
+    CHECK(nearTexture->GetFirstResidentMip() == 0);
+    CHECK(farTexture->GetFirstResidentMip() == 1);
+    CHECK(farTexture->GetMipData(0).empty());
+    CHECK(farTexture->GetMipData(1).size() == farTexture->GetMipSize(1));
+    CHECK(nearTexture->GetResidentSize() + farTexture->GetResidentSize() + unbakedTexture->GetResidentSize() == budget);
+
+    // Not requested for longer than keep ticks, both go down to their mip tail.
+    for (uint32_t tick = 0; tick < 100; ++tick)
+        manager.Tick_MainThread(0.0f);
+    CHECK(nearTexture->GetFirstResidentMip() == nearTexture->GetFirstTailMip());
+    CHECK(farTexture->GetFirstResidentMip() == farTexture->GetFirstTailMip());
+    CHECK(unbakedTexture->GetFirstResidentMip() == 0);
+    CHECK(manager.GetStats().residentSize == GetFullSize(*nearTexture, 2) + GetFullSize(*farTexture, 2) + 4);
+
+    // Released textures are dropped.
+    nearTexture.reset();
+    farTexture.reset();
+    unbakedTexture.reset();
+    manager.Tick_MainThread(0.0f);
+    CHECK(manager.GetStats().numTextures == 0);
+}
+
+TEST_CASE("Unregistered textures are no longer followed", "[TextureResidency]")
+{
+    TextureResidencyManager &manager = TextureResidencyManager::Get();
+    auto texture = std::make_shared<BakedTestTexture>(64);
+    auto otherTexture = std::make_shared<BakedTestTexture>(64);
+    manager.Register(texture);
+    manager.Register(otherTexture);
+    manager.Tick_MainThread(0.0f);
+    CHECK(manager.GetStats().numTextures == 2);
+
+    manager.Unregister(texture.get());
+    manager.Tick_MainThread(0.0f);
+    CHECK(manager.GetStats().numTextures == 1);
+    CHECK(manager.GetStats().residentSize == otherTexture->GetResidentSize());
+
+    manager.Unregister(otherTexture.get());
+    manager.Tick_MainThread(0.0f);
+    CHECK(manager.GetStats().numTextures == 0);
+}
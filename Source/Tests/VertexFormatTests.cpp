@@ -0,0 +1,178 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "Asset/VertexFormat.h"
+
+using namespace Koala;
+
+namespace
+{
+    // Random vertices with normalized normals, UVs in [0, 1] and positions in a box away from origin.
+    std::vector<Vector> MakeRandomVertices(size_t numVertices)
+    {
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> positive(0.0f, 1.0f);
+        std::vector<Vector> vertices(numVertices);
+        for (Vector &vertex: vertices)
+        {
+            vertex.position = Vec3f(unit(random) * 50.0f + 100.0f, unit(random) * 2.0f, unit(random) * 0.01f - 7.0f);
+            do
+            {
+                vertex.normal = Vec3f(unit(random), unit(random), unit(random));
+            } while (vertex.normal.norm() < 0.1f);
+            vertex.normal.normalize();
+            vertex.uv = Vec2f(positive(random), positive(random));
+        }
+        return vertices;
+    }
+
+    // From cross and dot product, acos of dot product is too coarse for small angles.
+    float GetAngleDegrees(const Vec3f &a, const Vec3f &b)
+    {
+        return std::atan2(a.cross(b).norm(), a.dot(b)) * 180.0f / 3.14159265f;
+    }
+
+    // Largest errors of decoded vertices against the ones they were encoded from.
+    struct VertexErrors
+    {
+        float position[3]{};
+        float normalDegrees{0};
+        float uv{0};
+        float normalLength{0};
+    };
+
+    VertexErrors EncodeDecode(const std::vector<Vector> &vertices, const VertexQuantizationBounds &bounds, EVertexFormat format)
+    {
+        std::vector<uint8_t> packed(vertices.size() * GetVertexStride(format));
+        EncodeVertices(vertices.data(), vertices.size(), bounds, format, packed.data());
+        std::vector<Vector> decoded(vertices.size());
+        DecodeVertices(packed.data(), decoded.size(), bounds, format, decoded.data());
+
+        VertexErrors errors;
+        for (size_t index = 0; index < vertices.size(); ++index)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+                errors.position[axis] = std::max(errors.position[axis], std::abs(decoded[index].position[axis] - vertices[index].position[axis]));
+            errors.normalDegrees = std::max(errors.normalDegrees, GetAngleDegrees(decoded[index].normal, vertices[index].normal));
+            errors.normalLength = std::max(errors.normalLength, std::abs(decoded[index].normal.norm() - 1.0f));
+            errors.uv = std::max(errors.uv, (decoded[index].uv - vertices[index].uv).cwiseAbs().maxCoeff());
+        }
+        return errors;
+    }
+}
+
+TEST_CASE("Half floats round to nearest within half precision", "[VertexFormat]")
+{
+    // Exactly representable values survive.
+    for (float value: {0.0f, -0.0f, 1.0f, -2.5f, 0.5f, 65504.0f, -65504.0f, 6.103515625e-05f, 5.960464477539063e-08f})
+    {
+        CAPTURE(value);
+        CHECK(HalfToFloat(FloatToHalf(value)) == value);
+    }
+    CHECK(FloatToHalf(1.0f) == 0x3c00);
+    CHECK(FloatToHalf(-0.0f) == 0x8000);
+    CHECK(std::signbit(HalfToFloat(FloatToHalf(-0.0f))));
+
+    // Ties go to even mantissa: 1 + 2^-11 is half way between 1 and the next half 1 + 2^-10.
+    CHECK(FloatToHalf(1.0f + std::ldexp(1.0f, -11)) == 0x3c00);
+    CHECK(FloatToHalf(1.0f + 3.0f * std::ldexp(1.0f, -11)) == 0x3c02);
+
+    // Overflow becomes infinity, NaN stays NaN.
+    CHECK(std::isinf(HalfToFloat(FloatToHalf(70000.0f))));
+    CHECK(HalfToFloat(FloatToHalf(-1e10f)) < 0.0f);
+    CHECK(std::isinf(HalfToFloat(FloatToHalf(std::numeric_limits<float>::infinity()))));
+    CHECK(std::isnan(HalfToFloat(FloatToHalf(std::numeric_limits<float>::quiet_NaN()))));
+
+    // Normal range has 11 significant bits, rounding error is at most half a unit in last place.
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> exponent(-14.0f, 15.0f);
+    std::uniform_real_distribution<float> sign(-1.0f, 1.0f);
+    for (uint32_t sample = 0; sample < 10000; ++sample)
+    {
+        const float value = std::copysign(std::exp2(exponent(random)), sign(random));
+        CAPTURE(value);
+        const float roundTrip = HalfToFloat(FloatToHalf(value));
+        CHECK(std::abs(roundTrip - value) <= std::abs(value) * std::ldexp(1.0f, -11));
+    }
+    // Below normal range absolute error is half the smallest subnormal.
+    for (float value: {1e-5f, -3e-6f, 2e-7f, 4e-8f})
+    {
+        CAPTURE(value);
+        CHECK(std::abs(HalfToFloat(FloatToHalf(value)) - value) <= std::ldexp(1.0f, -25));
+    }
+}
+
+TEST_CASE("Octahedral encoding maps unit vectors onto the square and back", "[VertexFormat]")
+{
+    const std::vector<Vector> vertices = MakeRandomVertices(10000);
+    std::vector<Vec3f> normals;
+    for (const Vector &vertex: vertices)
+        normals.push_back(vertex.normal);
+    // Axes and the edges of the lower hemisphere fold.
+    normals.insert(normals.end(), {Vec3f(1, 0, 0), Vec3f(-1, 0, 0), Vec3f(0, 1, 0), Vec3f(0, -1, 0), Vec3f(0, 0, 1), Vec3f(0, 0, -1),
+        Vec3f(1, 1, -1).normalized(), Vec3f(-1, 0, -1).normalized(), Vec3f(0, -1, -1).normalized()});
+
+    for (const Vec3f &normal: normals)
+    {
+        CAPTURE(normal.x(), normal.y(), normal.z());
+        const Vec2f encoded = OctahedralEncode(normal);
+        CHECK(std::abs(encoded.x()) <= 1.0f);
+        CHECK(std::abs(encoded.y()) <= 1.0f);
+        const Vec3f decoded = OctahedralDecode(encoded);
+        CHECK(std::abs(decoded.norm() - 1.0f) < 1e-5f);
+        CHECK(GetAngleDegrees(decoded, normal) < 0.01f);
+    }
+}
+
+TEST_CASE("Packed vertices decode within quantization error", "[VertexFormat]")
+{
+    // Not a multiple of 4, so that tail of lane conversion is covered.
+    const std::vector<Vector> vertices = MakeRandomVertices(1003);
+    const VertexQuantizationBounds bounds = ComputeQuantizationBounds(vertices.data(), vertices.size());
+
+    CHECK(GetVertexStride(EVertexFormat::Float) == sizeof(Vector));
+    CHECK(GetVertexStride(EVertexFormat::Packed16) == 16);
+    CHECK(GetVertexStride(EVertexFormat::Packed12) == 12);
+
+    for (EVertexFormat format: {EVertexFormat::Packed16, EVertexFormat::Packed12})
+    {
+        CAPTURE(static_cast<uint32_t>(format));
+        const VertexErrors errors = EncodeDecode(vertices, bounds, format);
+        // Rounding to nearest step of the 16-bit grid, float math of dequantization adds a little on top.
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            CAPTURE(axis);
+            CHECK(errors.position[axis] <= bounds.scale[axis] * 0.5f + std::abs(bounds.min[axis]) * 1e-6f + 1e-6f);
+        }
+        // UVs in [0, 1] have at most 2^-11 relative error as half floats.
+        CHECK(errors.uv <= std::ldexp(1.0f, -12));
+        CHECK(errors.normalLength < 1e-5f);
+        CHECK(errors.normalDegrees < (format == EVertexFormat::Packed16 ? 0.01f : 1.0f));
+    }
+
+    // Quantization bounds fit the positions exactly, smallest and largest ones land on the grid ends.
+    std::vector<uint8_t> packed(vertices.size() * sizeof(PackedVertex16));
+    EncodeVertices(vertices.data(), vertices.size(), bounds, EVertexFormat::Packed16, packed.data());
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        CAPTURE(axis);
+        uint16_t minQuantized = 0xffff;
+        uint16_t maxQuantized = 0;
+        for (size_t index = 0; index < vertices.size(); ++index)
+        {
+            PackedVertex16 vertex;
+            std::memcpy(&vertex, packed.data() + index * sizeof(PackedVertex16), sizeof(PackedVertex16));
+            minQuantized = std::min(minQuantized, vertex.position[axis]);
+            maxQuantized = std::max(maxQuantized, vertex.position[axis]);
+        }
+        CHECK(minQuantized == 0);
+        CHECK(maxQuantized == 0xffff);
+    }
+}